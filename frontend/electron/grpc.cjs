@@ -176,6 +176,26 @@ function stopConnection() {
   });
 }
 
+// Set send priorities for game ports, ports is [{ port, priority: 'NORMAL' | 'GAME' | 'BULK' }]
+// Replaces whatever was set before, an empty list clears them
+function setPortPriorities(ports) {
+  return new Promise((resolve, reject) => {
+    const client = connectGrpcClient();
+    client.setPortPriorities({ ports: ports }, (error, response) => {
+      if (error) {
+        console.error('Error setting port priorities:', error);
+        reject(error);
+        return;
+      }
+      console.log("SetPortPriorities response:", response);
+      resolve({
+        success: response.success,
+        errorMessage: response.error_message
+      });
+    });
+  });
+}
+
 // Initialize the networking module and gRPC connection
 async function initializeNetworking() {
   try {
@@ -210,5 +230,6 @@ module.exports = {
   getStunInfo,
   startConnection,
   stopConnection,
+  setPortPriorities,
   cleanup
 };
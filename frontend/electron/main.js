@@ -2,7 +2,7 @@ import { app, BrowserWindow, ipcMain } from 'electron';
 import { join } from 'path';
 import isDev from 'electron-is-dev';
 import { spawn } from 'child_process';
-import { initializeNetworking, getStunInfo, startConnection, stopConnection, cleanup } from './grpc.cjs';
+import { initializeNetworking, getStunInfo, startConnection, stopConnection, setPortPriorities, cleanup } from './grpc.cjs';
 import keytar from 'keytar';
 
 import path from 'path';
@@ -112,6 +112,15 @@ ipcMain.handle('grpc:stopConnection', async () => {
   }
 });
 
+ipcMain.handle('grpc:setPortPriorities', async (event, ports) => {
+  try {
+    return await setPortPriorities(ports);
+  } catch (error) {
+    console.error('Error in setPortPriorities:', error);
+    return { success: false, errorMessage: error.message || 'Failed to set port priorities' };
+  }
+});
+
 ipcMain.handle('grpc:cleanup', async () => {
   try {
     await cleanup();
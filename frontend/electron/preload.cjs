@@ -7,6 +7,7 @@ contextBridge.exposeInMainWorld('electron', {
     startConnection: (peerInfo, selfIndex, shouldFail) => 
       ipcRenderer.invoke('grpc:startConnection', peerInfo, selfIndex, shouldFail),
     stopConnection: () => ipcRenderer.invoke('grpc:stopConnection'),
+    setPortPriorities: (ports) => ipcRenderer.invoke('grpc:setPortPriorities', ports),
     cleanup: () => ipcRenderer.invoke('grpc:cleanup'),
   },
 
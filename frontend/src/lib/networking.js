@@ -37,4 +37,19 @@ export const stopConnection = async () => {
     console.error('Error stopping connection:', error);
     return { success: false, errorMessage: error.message || 'Unknown error stopping connection' };
   }
-};
\ No newline at end of file
+};
+
+export const setPortPriorities = async (ports) => {
+  try {
+    if (!window.electron?.grpc?.setPortPriorities) {
+      console.error('gRPC setPortPriorities not available');
+      return { success: false, errorMessage: 'gRPC setPortPriorities not available' };
+    }
+
+    console.log('Setting port priorities:', ports);
+    return await window.electron.grpc.setPortPriorities(ports);
+  } catch (error) {
+    console.error('Error setting port priorities:', error);
+    return { success: false, errorMessage: error.message || 'Unknown error setting port priorities' };
+  }
+};
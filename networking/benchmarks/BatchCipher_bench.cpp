@@ -0,0 +1,107 @@
+// Per-packet libsodium ChaCha20-Poly1305 against the batch kernels, same packets, same keys
+// Usage: BatchCipher_bench [seconds per case]
+#include "BatchCipher.hpp"
+#include <sodium.h>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+namespace
+{
+struct Packets
+{
+    std::vector<std::vector<uint8_t>> data;
+    std::vector<std::array<uint8_t, 32>> keys;
+    std::vector<std::array<uint8_t, 16>> macs;
+    std::vector<BatchCipherItem> items;
+    uint8_t header[14] = {0x21, 1};
+};
+
+void makePackets(Packets& packets, size_t count, size_t size)
+{
+    packets.data.assign(count, std::vector<uint8_t>(size));
+    packets.keys.assign(count, {});
+    packets.macs.assign(count, {});
+    packets.items.assign(count, {});
+    for (size_t i = 0; i < count; i++)
+    {
+        randombytes_buf(packets.data[i].data(), size);
+        randombytes_buf(packets.keys[i].data(), packets.keys[i].size());
+
+        BatchCipherItem& item = packets.items[i];
+        item.data = packets.data[i].data();
+        item.size = size;
+        item.mac = packets.macs[i].data();
+        item.ad = packets.header;
+        item.adSize = sizeof(packets.header);
+        item.key = packets.keys[i].data();
+        randombytes_buf(item.nonce, sizeof(item.nonce));
+    }
+}
+
+// Runs round() (which handles `count` packets) for about `seconds`, returns MB/s of payload
+double measure(const std::function<void()>& round, size_t bytesPerRound, double seconds)
+{
+    using Clock = std::chrono::steady_clock;
+    uint64_t rounds = 0;
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::duration<double>(seconds);
+    while (Clock::now() < deadline)
+    {
+        for (int i = 0; i < 64; i++)
+            round();
+        rounds += 64;
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    return static_cast<double>(rounds) * bytesPerRound / elapsed / 1e6;
+}
+}
+
+int main(int argc, char** argv)
+{
+    if (sodium_init() == -1)
+        return 1;
+    double seconds = argc > 1 ? std::atof(argv[1]) : 0.5;
+
+    std::printf("%-6s %-6s %14s", "size", "batch", "libsodium");
+    const BatchChaCha20Poly1305::Kernel kernels[] = {
+        BatchChaCha20Poly1305::Kernel::SCALAR, BatchChaCha20Poly1305::Kernel::AVX2, BatchChaCha20Poly1305::Kernel::AVX512};
+    for (auto kernel : kernels)
+        std::printf(" %14s", BatchChaCha20Poly1305::kernelName(kernel));
+    std::printf("   (MB/s, seal)\n");
+
+    Packets packets;
+    for (size_t size : {64, 512, 1400})
+    {
+        for (size_t batch : {4, 8, 16})
+        {
+            makePackets(packets, batch, size);
+            size_t bytes = batch * size;
+
+            double perPacket = measure([&]()
+            {
+                for (BatchCipherItem& item : packets.items)
+                    crypto_aead_chacha20poly1305_ietf_encrypt_detached(item.data, item.mac, nullptr, item.data, item.size,
+                        item.ad, item.adSize, nullptr, item.nonce, item.key);
+            }, bytes, seconds);
+            std::printf("%-6zu %-6zu %14.0f", size, batch, perPacket);
+
+            for (auto kernel : kernels)
+            {
+                if (!BatchChaCha20Poly1305::isKernelAvailable(kernel))
+                {
+                    std::printf(" %14s", "n/a");
+                    continue;
+                }
+                BatchChaCha20Poly1305 cipher(kernel);
+                double batched = measure([&]() { cipher.seal(packets.items.data(), batch); }, bytes, seconds);
+                std::printf(" %14.0f", batched);
+            }
+            std::printf("\n");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,197 @@
+// What busy-poll mode buys and costs: wakeup latency against the CPU the spinning thread burns
+// TUN writer: a thread pushes a packet into a TunWriteQueue every `gap`, the writer thread takes it
+// UDP socket: a datagram every `gap` over loopback, received by an io_context thread (BusyPoller::run)
+// Reports push / send to the consumer holding the packet (p50 / p99) and the consumer thread's CPU time as a share
+// of the wall clock; gaps longer than the budget show the backoff, the CPU share should fall back to near idle
+// On a machine with fewer cores than threads the spinner and the sender take turns and the numbers mean little
+// Usage: BusyPoll_bench [packets per case] [budget us] [SO_BUSY_POLL 0/1]
+#include "BusyPoller.hpp"
+#include "TunWriteQueue.hpp"
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+using boost::asio::ip::udp;
+
+uint64_t nowNanoseconds()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count());
+}
+
+std::chrono::nanoseconds threadCpuTime()
+{
+    timespec now{};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return std::chrono::seconds(now.tv_sec) + std::chrono::nanoseconds(now.tv_nsec);
+}
+
+struct Result
+{
+    double p50 = 0;
+    double p99 = 0;
+    double cpuShare = 0;
+    BusyPoller::Stats spinning;
+};
+
+// Latencies in microseconds, consumer CPU and wall time from its own thread
+Result summarize(std::vector<double>& latencies, std::chrono::nanoseconds cpu, Clock::duration wall)
+{
+    Result result;
+    if (!latencies.empty())
+    {
+        std::sort(latencies.begin(), latencies.end());
+        result.p50 = latencies[latencies.size() / 2];
+        result.p99 = latencies[latencies.size() * 99 / 100];
+    }
+    result.cpuShare = static_cast<double>(cpu.count()) /
+        static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(wall).count());
+    return result;
+}
+
+Result runTunWriter(std::chrono::microseconds budget, std::chrono::microseconds gap, size_t packets)
+{
+    auto pool = PacketBufferPool::create();
+    TunWriteQueue queue(CoDelQueue::Parameters(), budget);
+    queue.start();
+
+    std::vector<double> latencies;
+    latencies.reserve(packets);
+    std::chrono::nanoseconds cpu{0};
+    Clock::duration wall{};
+    std::thread writer([&]()
+    {
+        auto cpuStart = threadCpuTime();
+        auto wallStart = Clock::now();
+        std::vector<PacketHandle> batch;
+        while (queue.takeBatch(batch, 64))
+        {
+            uint64_t now = nowNanoseconds();
+            for (const PacketHandle& packet : batch)
+            {
+                uint64_t pushedAt;
+                std::memcpy(&pushedAt, packet.data(), sizeof(pushedAt));
+                latencies.push_back(static_cast<double>(now - pushedAt) / 1000.0);
+            }
+            batch.clear();
+        }
+        cpu = threadCpuTime() - cpuStart;
+        wall = Clock::now() - wallStart;
+    });
+
+    for (size_t i = 0; i < packets; i++)
+    {
+        PacketHandle packet = pool->acquire(100);
+        uint64_t pushedAt = nowNanoseconds();
+        std::memcpy(packet.data(), &pushedAt, sizeof(pushedAt));
+        queue.push(std::move(packet));
+        std::this_thread::sleep_for(gap);
+    }
+    queue.stop();
+    writer.join();
+    queue.clear();
+
+    Result result = summarize(latencies, cpu, wall);
+    result.spinning = queue.getBusyPollStats();
+    return result;
+}
+
+Result runSocket(std::chrono::microseconds budget, std::chrono::microseconds gap, size_t packets, bool socketBusyPoll)
+{
+    boost::asio::io_context context;
+    udp::socket receiver(context, udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    if (socketBusyPoll && budget.count() > 0 && !BusyPoller::enableSocketBusyPoll(receiver.native_handle(), budget))
+        std::printf("  (SO_BUSY_POLL refused, errno %d)\n", errno);
+    udp::socket sender(context, udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+
+    std::vector<double> latencies;
+    latencies.reserve(packets);
+    std::array<uint8_t, 64> buffer{};
+    udp::endpoint from;
+    std::function<void(const boost::system::error_code&, size_t)> onReceive =
+        [&](const boost::system::error_code& error, size_t bytes)
+        {
+            if (error)
+                return;
+            if (bytes >= sizeof(uint64_t))
+            {
+                uint64_t sentAt;
+                std::memcpy(&sentAt, buffer.data(), sizeof(sentAt));
+                latencies.push_back(static_cast<double>(nowNanoseconds() - sentAt) / 1000.0);
+            }
+            if (latencies.size() < packets)
+                receiver.async_receive_from(boost::asio::buffer(buffer), from, onReceive);
+        };
+    receiver.async_receive_from(boost::asio::buffer(buffer), from, onReceive);
+
+    BusyPoller poller(budget);
+    auto work = boost::asio::make_work_guard(context);
+    std::chrono::nanoseconds cpu{0};
+    Clock::duration wall{};
+    std::thread io([&]()
+    {
+        auto cpuStart = threadCpuTime();
+        auto wallStart = Clock::now();
+        poller.run(context);
+        cpu = threadCpuTime() - cpuStart;
+        wall = Clock::now() - wallStart;
+    });
+
+    std::array<uint8_t, 64> datagram{};
+    for (size_t i = 0; i < packets; i++)
+    {
+        uint64_t sentAt = nowNanoseconds();
+        std::memcpy(datagram.data(), &sentAt, sizeof(sentAt));
+        sender.send_to(boost::asio::buffer(datagram), receiver.local_endpoint());
+        std::this_thread::sleep_for(gap);
+    }
+    // Loopback doesn't lose them, but don't wait forever if it does
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    context.stop();
+    io.join();
+
+    Result result = summarize(latencies, cpu, wall);
+    result.spinning = poller.getStats();
+    return result;
+}
+
+void print(const char* path, std::chrono::microseconds budget, std::chrono::microseconds gap, const Result& result)
+{
+    std::printf("%-11s %8lldus %7lldus %9.1fus %9.1fus %8.1f%% %8llu %8llu\n", path,
+        static_cast<long long>(budget.count()), static_cast<long long>(gap.count()), result.p50, result.p99,
+        result.cpuShare * 100, static_cast<unsigned long long>(result.spinning.hits),
+        static_cast<unsigned long long>(result.spinning.misses));
+}
+}
+
+int main(int argc, char** argv)
+{
+    size_t packets = argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 2000;
+    std::chrono::microseconds budget(argc > 2 ? std::atoi(argv[2]) : 200);
+    bool socketBusyPoll = argc > 3 && std::atoi(argv[3]) != 0;
+    packets = std::max<size_t>(1, packets);
+
+    std::printf("%zu packets per case, %u cores\n", packets, std::thread::hardware_concurrency());
+    std::printf("%-11s %10s %9s %11s %11s %9s %8s %8s\n", "path", "budget", "gap", "p50", "p99", "cpu", "hits", "misses");
+    const std::chrono::microseconds gaps[] = {std::chrono::microseconds(50), std::chrono::microseconds(1000)};
+    for (std::chrono::microseconds gap : gaps)
+    {
+        for (std::chrono::microseconds spin : {std::chrono::microseconds(0), budget})
+            print("tun writer", spin, gap, runTunWriter(spin, gap, packets));
+        for (std::chrono::microseconds spin : {std::chrono::microseconds(0), budget})
+            print("udp socket", spin, gap, runSocket(spin, gap, packets, socketBusyPoll));
+    }
+    return 0;
+}
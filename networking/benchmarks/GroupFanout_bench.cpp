@@ -0,0 +1,98 @@
+// Broadcast fan-out from the TUN: a plaintext copy and a pairwise seal per peer against one group-key seal
+// shared by every peer's datagram; the sends themselves cost the same both ways and are left out
+// Usage: GroupFanout_bench [seconds per case]
+#include "CipherSuite.hpp"
+#include "PacketBufferPool.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+constexpr size_t V2_HEADER_SIZE = 14;
+constexpr size_t V2_MESSAGE_OVERHEAD = V2_HEADER_SIZE + PeerCipher::MAC_SIZE;
+
+// Runs broadcast() for about `seconds`, returns ns per broadcast
+template <typename Broadcast>
+double measure(Broadcast broadcast, double seconds)
+{
+    using Clock = std::chrono::steady_clock;
+    uint64_t broadcasts = 0;
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::duration<double>(seconds);
+    while (Clock::now() < deadline)
+    {
+        for (int i = 0; i < 64; i++)
+            broadcast();
+        broadcasts += 64;
+    }
+    double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    return elapsed / static_cast<double>(broadcasts);
+}
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? std::atof(argv[1]) : 0.5;
+    if (sodium_init() < 0)
+        return 1;
+
+    auto pool = PacketBufferPool::create();
+    std::printf("%-6s %6s %14s %14s %8s   (ns per broadcast)\n", "peers", "bytes", "per-peer", "group key", "speedup");
+    for (size_t payloadSize : {512, 1400})
+    {
+        for (size_t peerCount : {2, 8, 32, 64})
+        {
+            std::vector<PeerCipher> ciphers(peerCount);
+            for (PeerCipher& cipher : ciphers)
+            {
+                PeerCipher::SharedKey sharedKey;
+                randombytes_buf(sharedKey.data(), sharedKey.size());
+                cipher.setKeys(sharedKey, true);
+            }
+            GroupCipher group;
+            group.generate();
+
+            std::vector<PacketHandle> datagrams(peerCount);
+            uint64_t counter = 0;
+
+            // Before: every peer gets its own copy, sealed with its own key
+            double perPeer = measure([&]()
+            {
+                counter++;
+                for (size_t peer = 0; peer < peerCount; peer++)
+                {
+                    PacketHandle packet = pool->acquire(payloadSize, PacketBufferPool::DEFAULT_HEADROOM);
+                    std::memset(packet.data(), 0x42, payloadSize);
+                    packet.prepend(V2_MESSAGE_OVERHEAD);
+                    uint8_t* header = packet.data();
+                    ciphers[peer].seal(CipherSuite::CHACHA20_POLY1305, header + V2_MESSAGE_OVERHEAD, payloadSize,
+                        header + V2_HEADER_SIZE, header, V2_HEADER_SIZE, 7, counter);
+                    datagrams[peer] = std::move(packet);
+                }
+                for (PacketHandle& datagram : datagrams)
+                    datagram = PacketHandle();
+            }, seconds);
+
+            // After: one seal, every peer's datagram references the same buffer
+            double grouped = measure([&]()
+            {
+                counter++;
+                PacketHandle packet = pool->acquire(payloadSize, PacketBufferPool::DEFAULT_HEADROOM);
+                std::memset(packet.data(), 0x42, payloadSize);
+                packet.prepend(V2_MESSAGE_OVERHEAD);
+                uint8_t* header = packet.data();
+                group.seal(header + V2_MESSAGE_OVERHEAD, payloadSize, header + V2_HEADER_SIZE, header, V2_HEADER_SIZE, 7, counter);
+                for (size_t peer = 0; peer < peerCount; peer++)
+                    datagrams[peer] = packet;
+                for (PacketHandle& datagram : datagrams)
+                    datagram = PacketHandle();
+            }, seconds);
+
+            std::printf("%-6zu %6zu %14.0f %14.0f %7.1fx\n", peerCount, payloadSize, perPeer, grouped, perPeer / grouped);
+        }
+    }
+    return 0;
+}
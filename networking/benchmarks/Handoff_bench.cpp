@@ -0,0 +1,424 @@
+// Packet hand-off between the TUN threads and the network thread, old designs against the lock-free rings
+// TUN -> network: an asio post per packet, the mutex queue that posts a drain once per burst (the previous
+// BoundedPacketQueue), and BoundedPacketQueue on its ring
+// network -> TUN: a CoDel queue under a mutex with a notify per packet (the previous writer queue), and TunWriteQueue
+// Flood: producers push as fast as they can, reports packets per second through the hand-off and, for the
+// TUN side that drops rather than hold the network thread, how many a full queue lost
+// Paced: one packet every few tens of microseconds, so the consumer goes idle in between; reports the time from
+// push to the consumer holding the packet, which is mostly what waking it costs
+// Usage: Handoff_bench [packets per producer] [producer threads]
+#include "BoundedPacketQueue.hpp"
+#include "TunWriteQueue.hpp"
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+using Deliver = std::function<void(PacketHandle&)>;
+
+constexpr size_t LIMIT = 4096;
+constexpr size_t BATCH = 256;
+
+uint64_t nowNanoseconds()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count());
+}
+
+class Handoff
+{
+public:
+    virtual ~Handoff() = default;
+    virtual void start(Deliver) = 0;
+    virtual void push(PacketHandle) = 0;
+    virtual void stop() = 0;
+    // The TUN side drops from a full queue instead of holding the network thread
+    virtual uint64_t dropped() { return 0; }
+};
+
+// Every packet is its own handler on the network thread
+class PostPerPacket : public Handoff
+{
+public:
+    void start(Deliver callback) override
+    {
+        deliver = std::move(callback);
+        thread = std::thread([this]() { context.run(); });
+    }
+
+    void push(PacketHandle packet) override
+    {
+        boost::asio::post(context, [this, packet = std::move(packet)]() mutable { deliver(packet); });
+    }
+
+    void stop() override
+    {
+        work.reset();
+        thread.join();
+    }
+
+private:
+    boost::asio::io_context context;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work{context.get_executor()};
+    std::thread thread;
+    Deliver deliver;
+};
+
+// The previous BoundedPacketQueue: everything under one mutex, a drain posted once per burst,
+// producers wait on a condition variable while it's full
+class LockedNetworkQueue : public Handoff
+{
+public:
+    void start(Deliver callback) override
+    {
+        deliver = std::move(callback);
+        thread = std::thread([this]() { context.run(); });
+    }
+
+    void push(PacketHandle packet) override
+    {
+        bool schedule = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            spaceAvailable.wait(lock, [this]() { return packets.size() < LIMIT; });
+            packets.push_back(std::move(packet));
+            schedule = !scheduled;
+            scheduled = true;
+        }
+        if (schedule)
+            boost::asio::post(context, [this]() { drain(); });
+    }
+
+    void stop() override
+    {
+        work.reset();
+        thread.join();
+    }
+
+private:
+    void drain()
+    {
+        std::vector<PacketHandle> batch;
+        bool more;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!packets.empty() && batch.size() < BATCH)
+            {
+                batch.push_back(std::move(packets.front()));
+                packets.pop_front();
+            }
+            more = !packets.empty();
+            scheduled = more;
+        }
+        spaceAvailable.notify_all();
+        for (PacketHandle& packet : batch)
+            deliver(packet);
+        if (more)
+            boost::asio::post(context, [this]() { drain(); });
+    }
+
+    boost::asio::io_context context;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work{context.get_executor()};
+    std::thread thread;
+    Deliver deliver;
+    std::mutex mutex;
+    std::condition_variable spaceAvailable;
+    std::deque<PacketHandle> packets;
+    bool scheduled = false;
+};
+
+class RingNetworkQueue : public Handoff
+{
+public:
+    RingNetworkQueue() : queue(parameters()) {}
+
+    void start(Deliver callback) override
+    {
+        deliver = std::move(callback);
+        thread = std::thread([this]() { context.run(); });
+    }
+
+    void push(PacketHandle packet) override
+    {
+        if (queue.push(std::move(packet)))
+            boost::asio::post(context, [this]() { drain(); });
+    }
+
+    void stop() override
+    {
+        work.reset();
+        thread.join();
+    }
+
+private:
+    static BoundedPacketQueue::Parameters parameters()
+    {
+        BoundedPacketQueue::Parameters parameters;
+        parameters.limit = LIMIT;
+        // Hold the producers rather than drop, like the locked queue
+        parameters.maxStall = std::chrono::seconds(10);
+        return parameters;
+    }
+
+    void drain()
+    {
+        batch.clear();
+        bool more = queue.popBatch(batch, BATCH);
+        for (PacketHandle& packet : batch)
+            deliver(packet);
+        if (more)
+            boost::asio::post(context, [this]() { drain(); });
+    }
+
+    BoundedPacketQueue queue;
+    boost::asio::io_context context;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work{context.get_executor()};
+    std::thread thread;
+    Deliver deliver;
+    std::vector<PacketHandle> batch;
+};
+
+// CoDel wide open, the flood shouldn't lose anything
+CoDelQueue::Parameters tunParameters()
+{
+    CoDelQueue::Parameters parameters;
+    parameters.limit = LIMIT;
+    parameters.target = std::chrono::seconds(10);
+    parameters.interval = std::chrono::seconds(10);
+    return parameters;
+}
+
+// The previous writer queue: CoDel under a mutex, a notify for every packet
+class LockedTunQueue : public Handoff
+{
+public:
+    LockedTunQueue() : packets(tunParameters()) {}
+
+    void start(Deliver callback) override
+    {
+        deliver = std::move(callback);
+        thread = std::thread([this]() { write(); });
+    }
+
+    void push(PacketHandle packet) override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            packets.push(std::move(packet), CoDelQueue::Clock::now());
+        }
+        packetReady.notify_one();
+    }
+
+    void stop() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        packetReady.notify_all();
+        thread.join();
+    }
+
+    uint64_t dropped() override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        CoDelQueue::Stats stats = packets.getStats();
+        return stats.codelDrops + stats.overflowDrops;
+    }
+
+private:
+    void write()
+    {
+        std::vector<PacketHandle> batch;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                packetReady.wait(lock, [this]() { return !packets.empty() || !running; });
+                if (!running)
+                    return;
+                auto now = CoDelQueue::Clock::now();
+                while (batch.size() < BATCH)
+                {
+                    PacketHandle packet = packets.pop(now);
+                    if (!packet)
+                        break;
+                    batch.push_back(std::move(packet));
+                }
+            }
+            for (PacketHandle& packet : batch)
+                deliver(packet);
+            batch.clear();
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable packetReady;
+    CoDelQueue packets;
+    bool running = true;
+    std::thread thread;
+    Deliver deliver;
+};
+
+class RingTunQueue : public Handoff
+{
+public:
+    RingTunQueue() : packets(tunParameters()) {}
+
+    void start(Deliver callback) override
+    {
+        deliver = std::move(callback);
+        packets.start();
+        thread = std::thread([this]()
+        {
+            std::vector<PacketHandle> batch;
+            while (packets.takeBatch(batch, BATCH))
+            {
+                for (PacketHandle& packet : batch)
+                    deliver(packet);
+                batch.clear();
+            }
+        });
+    }
+
+    void push(PacketHandle packet) override
+    {
+        packets.push(std::move(packet));
+    }
+
+    void stop() override
+    {
+        packets.stop();
+        thread.join();
+        packets.clear();
+    }
+
+    uint64_t dropped() override
+    {
+        CoDelQueue::Stats stats = packets.getStats();
+        return stats.codelDrops + stats.overflowDrops;
+    }
+
+private:
+    TunWriteQueue packets;
+    std::thread thread;
+    Deliver deliver;
+};
+
+struct Result
+{
+    double packetsPerSecond = 0;
+    double p50 = 0;
+    double p99 = 0;
+    double max = 0;
+    uint64_t dropped = 0;
+};
+
+// Stamps every packet with when it was pushed, the consumer keeps how long it took
+Result run(const std::function<std::unique_ptr<Handoff>()>& make, size_t producers, size_t perProducer,
+    std::chrono::microseconds pace)
+{
+    auto pool = PacketBufferPool::create(LIMIT * 2);
+    std::unique_ptr<Handoff> handoff = make();
+    std::atomic<uint64_t> delivered{0};
+    std::vector<double> latencies;
+    latencies.reserve(producers * perProducer);
+    handoff->start([&](PacketHandle& packet)
+    {
+        uint64_t pushedAt;
+        std::memcpy(&pushedAt, packet.data(), sizeof(pushedAt));
+        latencies.push_back(static_cast<double>(nowNanoseconds() - pushedAt) / 1000.0);
+        // Hands the buffer back to the pool as the device write would
+        packet = PacketHandle();
+        delivered.fetch_add(1, std::memory_order_release);
+    });
+
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < producers; i++)
+    {
+        threads.emplace_back([&]()
+        {
+            for (size_t sent = 0; sent < perProducer; sent++)
+            {
+                PacketHandle packet = pool->acquire(100, PacketBufferPool::DEFAULT_HEADROOM);
+                uint64_t pushedAt = nowNanoseconds();
+                std::memcpy(packet.data(), &pushedAt, sizeof(pushedAt));
+                handoff->push(std::move(packet));
+                if (pace.count() > 0)
+                    std::this_thread::sleep_for(pace);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    uint64_t expected = producers * perProducer;
+    auto deadline = Clock::now() + std::chrono::seconds(10);
+    while (delivered.load(std::memory_order_acquire) + handoff->dropped() < expected && Clock::now() < deadline)
+        std::this_thread::yield();
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    handoff->stop();
+
+    Result result;
+    result.dropped = handoff->dropped();
+    result.packetsPerSecond = static_cast<double>(delivered.load()) / elapsed;
+    if (!latencies.empty())
+    {
+        std::sort(latencies.begin(), latencies.end());
+        result.p50 = latencies[latencies.size() / 2];
+        result.p99 = latencies[latencies.size() * 99 / 100];
+        result.max = latencies.back();
+    }
+    return result;
+}
+
+struct Design
+{
+    const char* direction;
+    const char* name;
+    std::function<std::unique_ptr<Handoff>()> make;
+};
+}
+
+int main(int argc, char** argv)
+{
+    size_t perProducer = argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 200000;
+    size_t producers = argc > 2 ? static_cast<size_t>(std::atoi(argv[2])) : 2;
+    producers = std::max<size_t>(1, producers);
+    size_t pacedPackets = std::max<size_t>(1, std::min<size_t>(perProducer, 5000));
+
+    std::vector<Design> designs = {
+        {"tun->net", "post per packet", []() { return std::make_unique<PostPerPacket>(); }},
+        {"tun->net", "mutex queue", []() { return std::make_unique<LockedNetworkQueue>(); }},
+        {"tun->net", "lock-free ring", []() { return std::make_unique<RingNetworkQueue>(); }},
+        {"net->tun", "mutex + notify", []() { return std::make_unique<LockedTunQueue>(); }},
+        {"net->tun", "lock-free ring", []() { return std::make_unique<RingTunQueue>(); }},
+    };
+
+    std::printf("%zu producer(s), %zu packets each flooded, %zu paced at 20us, %u cores\n",
+        producers, perProducer, pacedPackets, std::thread::hardware_concurrency());
+    std::printf("%-9s %-16s %12s %8s %11s %11s %11s %11s\n", "direction", "design", "flood pkt/s",
+        "dropped", "flood p99", "paced p50", "paced p99", "paced max");
+    for (const Design& design : designs)
+    {
+        Result flood = run(design.make, producers, perProducer, std::chrono::microseconds(0));
+        Result paced = run(design.make, producers, pacedPackets, std::chrono::microseconds(20));
+        std::printf("%-9s %-16s %12.0f %7.1f%% %9.1fus %9.1fus %9.1fus %9.1fus\n", design.direction, design.name,
+            flood.packetsPerSecond, 100.0 * static_cast<double>(flood.dropped) / static_cast<double>(producers * perProducer),
+            flood.p99, paced.p50, paced.p99, paced.max);
+    }
+    return 0;
+}
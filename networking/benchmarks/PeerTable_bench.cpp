@@ -0,0 +1,103 @@
+// Per-packet peer lookup: the old string conversion + std::map pair against PeerTable
+// RX finds the peer from the sender endpoint, TX from the destination virtual IP
+// Usage: PeerTable_bench [seconds per case]
+#include "NetworkingModule.hpp"
+#include "PeerTable.hpp"
+#include "Utils.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+// Runs lookup(i) for i over the traffic pattern for about `seconds`, returns ns per lookup
+template <typename Lookup>
+double measure(Lookup lookup, size_t patternSize, double seconds)
+{
+    using Clock = std::chrono::steady_clock;
+    uint64_t lookups = 0;
+    uintptr_t sink = 0;
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::duration<double>(seconds);
+    while (Clock::now() < deadline)
+    {
+        for (size_t i = 0; i < patternSize; i++)
+            sink += reinterpret_cast<uintptr_t>(lookup(i));
+        lookups += patternSize;
+    }
+    double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    if (sink == 1)
+        std::printf(" ");
+    return elapsed / static_cast<double>(lookups);
+}
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? std::atof(argv[1]) : 0.5;
+
+    std::printf("%-6s %14s %14s %14s %14s   (ns per packet)\n", "peers", "rx map", "rx table", "tx map", "tx table");
+    for (size_t peerCount : {2, 16, 250})
+    {
+        std::vector<boost::asio::ip::udp::endpoint> endpoints;
+        std::vector<uint32_t> virtualIps;
+        std::map<uint32_t, std::pair<std::uint32_t, int>> virtualIpToPublicIp;
+        std::map<uint32_t, PeerConnectionInfo> publicIpToPeerConnection;
+        PeerTable<PeerConnectionInfo> peers;
+
+        for (size_t i = 0; i < peerCount; i++)
+        {
+            uint32_t publicIp = utils::ipToUint32("198.51." + std::to_string(i / 200) + "." + std::to_string(i % 200 + 1));
+            boost::asio::ip::udp::endpoint endpoint(boost::asio::ip::address_v4(publicIp), static_cast<unsigned short>(40000 + i));
+            uint32_t virtualIp = utils::ipToUint32("10.0.0." + std::to_string(i + 2));
+            endpoints.push_back(endpoint);
+            virtualIps.push_back(virtualIp);
+
+            virtualIpToPublicIp[virtualIp] = {publicIp, endpoint.port()};
+            publicIpToPeerConnection[publicIp] = PeerConnectionInfo(endpoint);
+            peers.add(virtualIp, endpoint, PeerConnectionInfo(endpoint));
+        }
+
+        // Packets from / to peers in a scrambled order, so branch prediction doesn't learn the pattern
+        std::vector<size_t> pattern(4096);
+        uint32_t state = 12345;
+        for (size_t& peer : pattern)
+        {
+            state = state * 1664525 + 1013904223;
+            peer = (state >> 8) % peerCount;
+        }
+
+        double rxMap = measure([&](size_t i) -> const void*
+        {
+            uint32_t senderIp = utils::ipToUint32(endpoints[pattern[i]].address().to_string());
+            if (publicIpToPeerConnection.find(senderIp) == publicIpToPeerConnection.end())
+                return nullptr;
+            return &publicIpToPeerConnection[senderIp];
+        }, pattern.size(), seconds);
+
+        double rxTable = measure([&](size_t i) -> const void*
+        {
+            return peers.find(endpoints[pattern[i]]);
+        }, pattern.size(), seconds);
+
+        double txMap = measure([&](size_t i) -> const void*
+        {
+            auto virtualIter = virtualIpToPublicIp.find(virtualIps[pattern[i]]);
+            if (virtualIter == virtualIpToPublicIp.end())
+                return nullptr;
+            auto peerIter = publicIpToPeerConnection.find(virtualIter->second.first);
+            return peerIter == publicIpToPeerConnection.end() ? nullptr : &peerIter->second;
+        }, pattern.size(), seconds);
+
+        double txTable = measure([&](size_t i) -> const void*
+        {
+            return peers.findByVirtualIp(virtualIps[pattern[i]]);
+        }, pattern.size(), seconds);
+
+        std::printf("%-6zu %14.1f %14.1f %14.1f %14.1f\n", peerCount, rxMap, rxTable, txMap, txTable);
+    }
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Group broadcast over loopback: the source sending to every peer itself against the relay tree
+// One process, a UDP socket and receive thread per peer; every hop opens the datagram with the group key
+// and forwards the sealed bytes to its children, as UDPNetwork does
+// Reports the source's uplink per broadcast and the delivery latency over all peers
+// Usage: RelayTree_bench [broadcasts per case] [fan-out]
+#include "CipherSuite.hpp"
+#include "RelayTree.hpp"
+#include <boost/asio.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+using boost::asio::ip::udp;
+
+constexpr size_t V2_HEADER_SIZE = 14;
+constexpr size_t PAYLOAD_SIZE = 1200;
+
+struct Node
+{
+    uint8_t octet = 0;
+    std::unique_ptr<udp::socket> socket;
+    std::thread receiver;
+    std::vector<double> latenciesUs;
+    std::vector<bool> seen;
+};
+
+struct Result
+{
+    double uplinkBytes = 0;
+    double meanUs = 0;
+    double p99Us = 0;
+    double maxUs = 0;
+    size_t lost = 0;
+};
+
+int64_t nowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+Result run(size_t peerCount, size_t fanout, size_t broadcasts)
+{
+    boost::asio::io_context ioContext;
+    GroupCipher group;
+    group.generate();
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::vector<udp::endpoint> endpointByOctet(256);
+    for (size_t i = 0; i < peerCount; i++)
+    {
+        auto node = std::make_unique<Node>();
+        node->octet = static_cast<uint8_t>(i + 2);
+        node->socket = std::make_unique<udp::socket>(ioContext, udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+        node->socket->set_option(boost::asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+        node->seen.assign(broadcasts, false);
+        endpointByOctet[node->octet] = node->socket->local_endpoint();
+        nodes.push_back(std::move(node));
+    }
+
+    RelayTree tree;
+    if (fanout > 0)
+    {
+        std::vector<RelayTree::Member> members;
+        for (const auto& node : nodes)
+            members.push_back({node->octet, std::chrono::microseconds(0)});
+        tree.build(std::move(members), fanout);
+    }
+
+    for (auto& nodePtr : nodes)
+    {
+        Node* node = nodePtr.get();
+        node->receiver = std::thread([node, &group, &endpointByOctet]()
+        {
+            std::vector<uint8_t> datagram(2048), opened(2048);
+            udp::endpoint sender;
+            for (;;)
+            {
+                size_t size = node->socket->receive_from(boost::asio::buffer(datagram), sender);
+                if (size < V2_HEADER_SIZE)
+                    return;
+
+                uint64_t counter = 0;
+                for (int i = 0; i < 8; i++)
+                    counter = (counter << 8) | datagram[6 + i];
+                bool relayed = (datagram[1] & 0x40) != 0;
+                size_t headerSize = V2_HEADER_SIZE + (relayed ? RelayTree::parse(datagram.data() + V2_HEADER_SIZE, size - V2_HEADER_SIZE) : 0);
+                if (counter >= node->seen.size() || node->seen[counter])
+                    continue;
+
+                // Open a copy, the sealed datagram is what goes on down the tree
+                std::memcpy(opened.data(), datagram.data(), size);
+                uint8_t* macPos = opened.data() + headerSize;
+                if (!group.open(macPos + GroupCipher::MAC_SIZE, size - headerSize - GroupCipher::MAC_SIZE, macPos,
+                    opened.data(), headerSize, 7, counter))
+                    continue;
+                node->seen[counter] = true;
+
+                if (relayed)
+                {
+                    uint8_t children[RelayTree::MAX_FANOUT];
+                    size_t childCount = RelayTree::childrenOf(datagram.data() + V2_HEADER_SIZE, node->octet, children);
+                    for (size_t i = 0; i < childCount; i++)
+                        node->socket->send_to(boost::asio::buffer(datagram.data(), size), endpointByOctet[children[i]]);
+                }
+
+                int64_t sentAt = 0;
+                std::memcpy(&sentAt, macPos + GroupCipher::MAC_SIZE, sizeof(sentAt));
+                node->latenciesUs.push_back(static_cast<double>(nowNs() - sentAt) / 1000.0);
+            }
+        });
+    }
+
+    udp::socket source(ioContext, udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    size_t headerSize = V2_HEADER_SIZE + (fanout > 0 ? tree.encodedSize() : 0);
+    std::vector<uint8_t> datagram(headerSize + GroupCipher::MAC_SIZE + PAYLOAD_SIZE);
+    uint64_t uplinkBytes = 0;
+    for (uint64_t counter = 0; counter < broadcasts; counter++)
+    {
+        std::memset(datagram.data(), 0, datagram.size());
+        datagram[0] = (2 << 4) | 0x07;
+        datagram[1] = static_cast<uint8_t>(GroupCipher::SUITE) | (fanout > 0 ? 0x40 : 0);
+        datagram[5] = 7;
+        for (int i = 0; i < 8; i++)
+            datagram[6 + i] = static_cast<uint8_t>(counter >> (56 - 8 * i));
+        if (fanout > 0)
+            tree.encode(datagram.data() + V2_HEADER_SIZE);
+        uint8_t* macPos = datagram.data() + headerSize;
+        int64_t sentAt = nowNs();
+        std::memcpy(macPos + GroupCipher::MAC_SIZE, &sentAt, sizeof(sentAt));
+        group.seal(macPos + GroupCipher::MAC_SIZE, PAYLOAD_SIZE, macPos, datagram.data(), headerSize, 7, counter);
+
+        uint8_t children[RelayTree::MAX_FANOUT];
+        size_t childCount = fanout > 0 ? tree.rootChildren(children) : 0;
+        for (size_t i = 0; i < (fanout > 0 ? childCount : peerCount); i++)
+        {
+            const udp::endpoint& target = fanout > 0 ? endpointByOctet[children[i]] : endpointByOctet[nodes[i]->octet];
+            uplinkBytes += source.send_to(boost::asio::buffer(datagram), target);
+        }
+        // Spaced out like game traffic, so the numbers are hop latency rather than queueing behind a flood
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    uint8_t stop = 0;
+    for (const auto& node : nodes)
+        source.send_to(boost::asio::buffer(&stop, 1), node->socket->local_endpoint());
+
+    Result result;
+    std::vector<double> latencies;
+    for (auto& node : nodes)
+    {
+        node->receiver.join();
+        latencies.insert(latencies.end(), node->latenciesUs.begin(), node->latenciesUs.end());
+        result.lost += broadcasts - node->latenciesUs.size();
+    }
+    std::sort(latencies.begin(), latencies.end());
+    result.uplinkBytes = static_cast<double>(uplinkBytes) / static_cast<double>(broadcasts);
+    if (!latencies.empty())
+    {
+        double sum = 0;
+        for (double latency : latencies)
+            sum += latency;
+        result.meanUs = sum / static_cast<double>(latencies.size());
+        result.p99Us = latencies[latencies.size() * 99 / 100];
+        result.maxUs = latencies.back();
+    }
+    return result;
+}
+}
+
+int main(int argc, char** argv)
+{
+    size_t broadcasts = argc > 1 ? static_cast<size_t>(std::atol(argv[1])) : 1000;
+    size_t fanout = argc > 2 ? static_cast<size_t>(std::atol(argv[2])) : 4;
+    if (sodium_init() < 0)
+        return 1;
+
+    std::printf("%-6s %-10s %14s %10s %10s %10s %6s\n", "peers", "mode", "uplink B/bc", "mean us", "p99 us", "max us", "lost");
+    for (size_t peerCount : {8, 32, 64})
+    {
+        for (size_t caseFanout : {size_t(0), fanout})
+        {
+            Result result = run(peerCount, caseFanout, broadcasts);
+            char mode[16];
+            std::snprintf(mode, sizeof(mode), caseFanout == 0 ? "mesh" : "tree/%zu", caseFanout);
+            std::printf("%-6zu %-10s %14.0f %10.1f %10.1f %10.1f %6zu\n",
+                peerCount, mode, result.uplinkBytes, result.meanUs, result.p99Us, result.maxUs, result.lost);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,195 @@
+// Game packet latency while a download saturates the uplink: one FIFO against the SendScheduler
+// The bottleneck link is simulated in virtual time, so the numbers are queueing delay alone and repeatable:
+// a bulk TCP flow keeps the queue full (as a download behind a full socket buffer does), while the game sends
+// a 120 byte update at 60 Hz and a 1000 byte snapshot every fifth tick
+// Then the scheduler's own cost per packet, enqueue + dequeue over a few flows, in real time
+// Usage: SendScheduler_bench [uplink Mbit/s] [seconds]
+#include "SendScheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+constexpr uint16_t GAME_PORT = 27015;
+constexpr size_t BULK_SIZE = 1400;
+constexpr double TICK_SECONDS = 1.0 / 60.0;
+constexpr size_t QUEUE_PACKETS = SendScheduler::MAX_PACKETS;
+
+enum class Mode
+{
+    FIFO,
+    // Only the small updates qualify, the snapshots wait their flow's turn
+    SCHEDULER,
+    // The UI marked the game's port
+    SCHEDULER_GAME_PORT
+};
+
+struct Result
+{
+    double p50Ms = 0;
+    double p99Ms = 0;
+    double maxMs = 0;
+    double bulkMbps = 0;
+    size_t lost = 0;
+};
+
+PacketHandle makePacket(PacketBufferPool& pool, size_t size, uint8_t protocol, uint16_t dstPort, double enqueuedAt)
+{
+    PacketHandle packet = pool.acquire(size);
+    uint8_t* ip = packet.data();
+    std::memset(ip, 0, 40);
+    ip[0] = 0x45;
+    ip[2] = static_cast<uint8_t>(size >> 8);
+    ip[3] = static_cast<uint8_t>(size);
+    ip[9] = protocol;
+    ip[12] = 10; ip[15] = 1;
+    ip[16] = 10; ip[19] = 2;
+    ip[20] = 0xC3; ip[21] = 0x50;
+    ip[22] = static_cast<uint8_t>(dstPort >> 8); ip[23] = static_cast<uint8_t>(dstPort);
+    ip[32] = 5 << 4;
+    std::memcpy(ip + 40, &enqueuedAt, sizeof(enqueuedAt));
+    return packet;
+}
+
+bool isGame(const PacketHandle& packet)
+{
+    return packet.data()[9] == 17;
+}
+
+Result run(Mode mode, double linkBytesPerSecond, double seconds)
+{
+    auto pool = PacketBufferPool::create();
+    SendScheduler scheduler;
+    std::deque<PacketHandle> fifo;
+    PortPriorities ports;
+    if (mode == Mode::SCHEDULER_GAME_PORT)
+        ports[GAME_PORT] = PortPriority::GAME;
+
+    auto queued = [&]() { return mode == Mode::FIFO ? fifo.size() : scheduler.size(); };
+    auto enqueue = [&](PacketHandle packet)
+    {
+        if (mode == Mode::FIFO)
+        {
+            // Tail drop, as a full socket buffer does
+            if (fifo.size() < QUEUE_PACKETS)
+                fifo.push_back(std::move(packet));
+            return;
+        }
+        scheduler.enqueue(std::move(packet), ports, 256);
+    };
+    auto dequeue = [&]()
+    {
+        if (mode != Mode::FIFO)
+            return scheduler.dequeue();
+        PacketHandle packet = std::move(fifo.front());
+        fifo.pop_front();
+        return packet;
+    };
+
+    std::vector<double> delays;
+    size_t gameSent = 0;
+    uint64_t bulkBytes = 0;
+    double now = 0;
+    double nextTick = 0;
+    size_t tick = 0;
+    while (now < seconds)
+    {
+        while (nextTick <= now)
+        {
+            size_t size = tick % 5 == 0 ? 1000 : 120;
+            enqueue(makePacket(*pool, size, 17, GAME_PORT, nextTick));
+            gameSent++;
+            tick++;
+            nextTick = tick * TICK_SECONDS;
+        }
+        while (queued() < QUEUE_PACKETS)
+            enqueue(makePacket(*pool, BULK_SIZE, 6, 443, now));
+
+        PacketHandle packet = dequeue();
+        now += static_cast<double>(packet.size()) / linkBytesPerSecond;
+        if (isGame(packet))
+        {
+            double enqueuedAt = 0;
+            std::memcpy(&enqueuedAt, packet.data() + 40, sizeof(enqueuedAt));
+            delays.push_back((now - enqueuedAt) * 1000.0);
+        }
+        else
+        {
+            bulkBytes += packet.size();
+        }
+    }
+
+    Result result;
+    // Still queued when time ran out counts as delivered late rather than lost, only drops count
+    size_t stillQueued = 0;
+    while (queued() > 0)
+    {
+        if (isGame(dequeue()))
+            stillQueued++;
+    }
+    result.lost = gameSent - delays.size() - stillQueued;
+    std::sort(delays.begin(), delays.end());
+    if (!delays.empty())
+    {
+        result.p50Ms = delays[delays.size() / 2];
+        result.p99Ms = delays[delays.size() * 99 / 100];
+        result.maxMs = delays.back();
+    }
+    result.bulkMbps = static_cast<double>(bulkBytes) * 8 / seconds / 1e6;
+    return result;
+}
+
+double nsPerPacket(size_t flows, size_t packets)
+{
+    auto pool = PacketBufferPool::create();
+    SendScheduler scheduler;
+    PortPriorities ports = {{GAME_PORT, PortPriority::GAME}};
+    std::vector<PacketHandle> prepared;
+    for (size_t i = 0; i < 256; i++)
+        prepared.push_back(makePacket(*pool, i % 8 == 0 ? 120 : BULK_SIZE, i % 8 == 0 ? 17 : 6,
+            static_cast<uint16_t>(i % 8 == 0 ? GAME_PORT : 1000 + i % flows), 0));
+
+    auto start = Clock::now();
+    for (size_t i = 0; i < packets; i++)
+    {
+        scheduler.enqueue(prepared[i % prepared.size()], ports, 256);
+        if (scheduler.size() >= 128)
+            scheduler.dequeue();
+    }
+    while (!scheduler.empty())
+        scheduler.dequeue();
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(packets);
+}
+}
+
+int main(int argc, char** argv)
+{
+    double mbps = argc > 1 ? std::atof(argv[1]) : 20.0;
+    double seconds = argc > 2 ? std::atof(argv[2]) : 10.0;
+    double linkBytesPerSecond = mbps * 1e6 / 8;
+
+    std::printf("Uplink %.0f Mbit/s, bulk flow saturating it, game at 60 Hz, %.0fs simulated\n", mbps, seconds);
+    std::printf("%-22s %10s %10s %10s %12s %6s\n", "mode", "p50 ms", "p99 ms", "max ms", "bulk Mbit/s", "lost");
+    const std::pair<Mode, const char*> modes[] = {
+        {Mode::FIFO, "fifo"},
+        {Mode::SCHEDULER, "scheduler"},
+        {Mode::SCHEDULER_GAME_PORT, "scheduler + game port"}};
+    for (const auto& [mode, name] : modes)
+    {
+        Result result = run(mode, linkBytesPerSecond, seconds);
+        std::printf("%-22s %10.2f %10.2f %10.2f %12.2f %6zu\n",
+            name, result.p50Ms, result.p99Ms, result.maxMs, result.bulkMbps, result.lost);
+    }
+
+    std::printf("\nScheduler cost, enqueue + dequeue\n");
+    for (size_t flows : {1, 8, 64})
+        std::printf("%3zu flows: %6.1f ns/packet\n", flows, nsPerPacket(flows, 2000000));
+    return 0;
+}
@@ -0,0 +1,226 @@
+// Receive throughput with the port sharded over 1 to 8 sockets (SO_REUSEPORT), one thread per socket
+// Sender threads flood the port over loopback from 64 source ports, each receiving thread takes recvmmsg batches
+// and authenticates every datagram the way a shard opens v2 messages (XSalsa20-Poly1305 here)
+// Shard 0 is read by a thread standing in for the IO thread, the others by SocketShards
+// Reports authenticated packets per second and how evenly the steering spread them; the senders share the cores,
+// so on a small machine the curve flattens early
+// Usage: SocketShards_bench [seconds per case] [datagram bytes] [max shards]
+#include "SocketShards.hpp"
+#include <sodium.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+using boost::asio::ip::udp;
+using ReusePort = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+constexpr size_t SENDER_THREADS = 4;
+constexpr size_t SOCKETS_PER_SENDER = 16;
+constexpr size_t BATCH = 32;
+// v2 header + MAC in front of the payload
+constexpr size_t HEADER = 14;
+constexpr size_t OVERHEAD = HEADER + crypto_box_MACBYTES;
+
+std::array<uint8_t, crypto_box_BEFORENMBYTES> key;
+
+struct Counters
+{
+    std::atomic<uint64_t> opened{0};
+    std::atomic<uint64_t> failed{0};
+};
+
+// What a shard does with each datagram, the nonce comes from the header as in v2
+void openDatagram(PacketHandle& packet, Counters& counters)
+{
+    if (packet.size() < OVERHEAD)
+        return;
+    uint8_t* base = packet.data();
+    uint8_t nonce[crypto_box_NONCEBYTES] = {};
+    std::memcpy(nonce + 1, base + 2, 12);
+    if (crypto_box_open_detached_afternm(base + OVERHEAD, base + OVERHEAD, base + HEADER,
+        packet.size() - OVERHEAD, nonce, key.data()) == 0)
+        counters.opened.fetch_add(1, std::memory_order_relaxed);
+    else
+        counters.failed.fetch_add(1, std::memory_order_relaxed);
+}
+
+void blast(const udp::endpoint& target, size_t bytes, std::atomic<bool>& stop)
+{
+    boost::asio::io_context context;
+    std::vector<std::unique_ptr<udp::socket>> sockets;
+    for (size_t i = 0; i < SOCKETS_PER_SENDER; i++)
+        sockets.push_back(std::make_unique<udp::socket>(context, udp::endpoint(target.address(), 0)));
+
+    std::vector<uint8_t> datagram(bytes, 0);
+    datagram[0] = 0x23;
+    randombytes_buf(datagram.data() + 2, 12);
+    uint8_t nonce[crypto_box_NONCEBYTES] = {};
+    std::memcpy(nonce + 1, datagram.data() + 2, 12);
+    crypto_box_detached_afternm(datagram.data() + OVERHEAD, datagram.data() + HEADER, datagram.data() + OVERHEAD,
+        bytes - OVERHEAD, nonce, key.data());
+
+    std::vector<mmsghdr> messages(BATCH);
+    std::vector<iovec> vectors(BATCH);
+    for (size_t i = 0; i < BATCH; i++)
+    {
+        vectors[i] = {datagram.data(), bytes};
+        messages[i].msg_hdr = {};
+        messages[i].msg_hdr.msg_name = const_cast<sockaddr*>(target.data());
+        messages[i].msg_hdr.msg_namelen = static_cast<socklen_t>(target.size());
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    for (size_t round = 0; !stop.load(std::memory_order_relaxed); round++)
+        ::sendmmsg(sockets[round % SOCKETS_PER_SENDER]->native_handle(), messages.data(), BATCH, 0);
+}
+
+// The IO thread's share: shard 0 is the original socket
+void readPrimary(udp::socket& socket, PacketBufferPool& pool, Counters& counters, std::atomic<bool>& stop)
+{
+    std::vector<PacketHandle> buffers(BATCH);
+    std::vector<mmsghdr> messages(BATCH);
+    std::vector<iovec> vectors(BATCH);
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        for (size_t i = 0; i < BATCH; i++)
+        {
+            if (!buffers[i])
+                buffers[i] = pool.acquire(PacketBufferPool::SLAB_SIZE);
+            vectors[i] = {buffers[i].data(), buffers[i].capacity()};
+            messages[i].msg_hdr = {};
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        int received = ::recvmmsg(socket.native_handle(), messages.data(), BATCH, MSG_WAITFORONE, nullptr);
+        for (int i = 0; i < received; i++)
+        {
+            PacketHandle packet = std::move(buffers[i]);
+            packet.resize(messages[i].msg_len);
+            openDatagram(packet, counters);
+        }
+    }
+}
+
+struct Result
+{
+    double packetsPerSecond = 0;
+    // Busiest and idlest shard's share of the packets
+    double maxShare = 0;
+    double minShare = 0;
+    uint64_t failed = 0;
+    bool steered = false;
+};
+
+Result run(size_t shardCount, double seconds, size_t bytes)
+{
+    boost::asio::io_context context;
+    auto pool = PacketBufferPool::create();
+    udp::socket primary(context);
+    primary.open(udp::v4());
+    primary.set_option(ReusePort(true));
+    primary.set_option(boost::asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+    primary.bind(udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    // Lets the reader see `stop` once the senders are gone
+    timeval timeout{0, 10 * 1000};
+    ::setsockopt(primary.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    std::vector<Counters> counters(shardCount);
+    std::unique_ptr<SocketShards> shards;
+    Result result;
+    if (shardCount > 1)
+    {
+        SocketShards::Parameters parameters;
+        parameters.shards = shardCount;
+        parameters.batchSize = BATCH;
+        shards = SocketShards::create(primary, pool, parameters);
+        if (!shards)
+            return result;
+        result.steered = shards->isSteered();
+        shards->start([&counters](size_t shard, std::vector<SocketShards::Datagram>& batch)
+        {
+            for (SocketShards::Datagram& datagram : batch)
+                openDatagram(datagram.packet, counters[shard]);
+        });
+    }
+
+    std::atomic<bool> stopReader{false};
+    std::thread reader(readPrimary, std::ref(primary), std::ref(*pool), std::ref(counters[0]), std::ref(stopReader));
+    std::atomic<bool> stopSenders{false};
+    std::vector<std::thread> senders;
+    for (size_t i = 0; i < SENDER_THREADS; i++)
+        senders.emplace_back(blast, primary.local_endpoint(), bytes, std::ref(stopSenders));
+
+    // Warm up, then measure what gets authenticated
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    std::vector<uint64_t> before(shardCount);
+    for (size_t i = 0; i < shardCount; i++)
+        before[i] = counters[i].opened.load();
+    auto start = Clock::now();
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    std::vector<uint64_t> opened(shardCount);
+    for (size_t i = 0; i < shardCount; i++)
+        opened[i] = counters[i].opened.load() - before[i];
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    stopSenders = true;
+    for (auto& sender : senders)
+        sender.join();
+    stopReader = true;
+    reader.join();
+    if (shards)
+        shards->stop();
+
+    uint64_t total = 0;
+    for (uint64_t count : opened)
+        total += count;
+    result.packetsPerSecond = static_cast<double>(total) / elapsed;
+    if (total > 0)
+    {
+        result.maxShare = static_cast<double>(*std::max_element(opened.begin(), opened.end())) / static_cast<double>(total);
+        result.minShare = static_cast<double>(*std::min_element(opened.begin(), opened.end())) / static_cast<double>(total);
+    }
+    for (const Counters& shard : counters)
+        result.failed += shard.failed.load();
+    return result;
+}
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? std::atof(argv[1]) : 2.0;
+    size_t bytes = argc > 2 ? static_cast<size_t>(std::atoi(argv[2])) : 200;
+    size_t maxShards = argc > 3 ? static_cast<size_t>(std::atoi(argv[3])) : 8;
+    bytes = std::max(bytes, OVERHEAD + 1);
+    if (sodium_init() < 0)
+        return 1;
+    randombytes_buf(key.data(), key.size());
+
+    std::printf("%zu byte datagrams over loopback, %zu sender threads, %u cores, %.1fs per case\n",
+        bytes, SENDER_THREADS, std::thread::hardware_concurrency(), seconds);
+    std::printf("%-7s %12s %9s %20s\n", "shards", "packets/s", "speedup", "shard share min/max");
+    double baseline = 0;
+    for (size_t shards = 1; shards <= maxShards; shards++)
+    {
+        Result result = run(shards, seconds, bytes);
+        if (result.packetsPerSecond == 0)
+        {
+            std::printf("%-7zu %12s\n", shards, "unavailable");
+            continue;
+        }
+        if (shards == 1)
+            baseline = result.packetsPerSecond;
+        std::printf("%-7zu %12.0f %8.2fx %9.1f%% / %5.1f%%%s%s\n", shards, result.packetsPerSecond,
+            baseline > 0 ? result.packetsPerSecond / baseline : 0.0, result.minShare * 100, result.maxShare * 100,
+            shards > 1 && !result.steered ? " (kernel hashed)" : "", result.failed ? " AUTH FAILURES" : "");
+    }
+    return 0;
+}
@@ -0,0 +1,291 @@
+// UDP socket I/O over loopback: the asio loop UDPNetwork runs by default against the io_uring transport
+// Receive: a blaster thread floods the socket with sendmmsg, the IO thread takes what it can, one async_receive_from
+// re-armed per datagram (startAsyncReceive) or the multishot receive
+// Send: the IO thread keeps a window of sends in flight, one async_send_to per datagram (sendDatagramAsync) or
+// batches queued in the ring with one submission each, a drain thread empties the receiving socket
+// Reports packets per second and the IO thread's CPU time per packet, the second is the one that matters
+// Usage: UringTransport_bench [seconds per case] [datagram bytes]
+#include "UringTransport.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+using boost::asio::ip::udp;
+
+// Sends a window this deep in flight, as UDPNetwork's SEND_BACKLOG_LIMIT does
+constexpr size_t SEND_WINDOW = 64;
+constexpr size_t SEND_BATCH = 32;
+
+struct Result
+{
+    double packetsPerSecond = 0;
+    double cpuNsPerPacket = 0;
+    // Receive only: what the kernel dropped because the IO thread didn't keep up
+    double lossPercent = 0;
+};
+
+double threadCpuSeconds()
+{
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return static_cast<double>(now.tv_sec) + static_cast<double>(now.tv_nsec) / 1e9;
+}
+
+udp::endpoint loopback()
+{
+    return udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0);
+}
+
+// Floods `target` until stopped, counts what it got into the kernel
+void blast(const udp::endpoint& target, size_t bytes, std::atomic<bool>& stop, uint64_t& sent)
+{
+    boost::asio::io_context context;
+    udp::socket socket(context, loopback());
+    std::vector<uint8_t> payload(bytes, 0xAB);
+    std::vector<mmsghdr> messages(SEND_BATCH);
+    std::vector<iovec> vectors(SEND_BATCH);
+    for (size_t i = 0; i < SEND_BATCH; i++)
+    {
+        vectors[i] = {payload.data(), bytes};
+        messages[i].msg_hdr = {};
+        messages[i].msg_hdr.msg_name = const_cast<sockaddr*>(target.data());
+        messages[i].msg_hdr.msg_namelen = static_cast<socklen_t>(target.size());
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        int result = ::sendmmsg(socket.native_handle(), messages.data(), SEND_BATCH, 0);
+        if (result > 0)
+            sent += static_cast<uint64_t>(result);
+    }
+}
+
+// Empties `socket` until stopped
+void drain(udp::socket& socket, std::atomic<bool>& stop)
+{
+    std::vector<std::vector<uint8_t>> buffers(SEND_BATCH, std::vector<uint8_t>(2048));
+    std::vector<mmsghdr> messages(SEND_BATCH);
+    std::vector<iovec> vectors(SEND_BATCH);
+    // recvmmsg's own timeout is only checked between datagrams, the socket's lets it see `stop` once traffic ends
+    timeval timeout{0, 10 * 1000};
+    ::setsockopt(socket.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        for (size_t i = 0; i < SEND_BATCH; i++)
+        {
+            vectors[i] = {buffers[i].data(), buffers[i].size()};
+            messages[i].msg_hdr = {};
+            messages[i].msg_hdr.msg_iov = &vectors[i];
+            messages[i].msg_hdr.msg_iovlen = 1;
+        }
+        ::recvmmsg(socket.native_handle(), messages.data(), SEND_BATCH, MSG_WAITFORONE, nullptr);
+    }
+}
+
+Result receiveAsio(double seconds, size_t bytes)
+{
+    boost::asio::io_context context;
+    auto pool = PacketBufferPool::create();
+    udp::socket socket(context, loopback());
+    socket.set_option(boost::asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+
+    uint64_t received = 0;
+    udp::endpoint sender;
+    std::function<void()> arm = [&]()
+    {
+        PacketHandle buffer = pool->acquire(PacketBufferPool::SLAB_SIZE);
+        socket.async_receive_from(boost::asio::buffer(buffer.data(), buffer.capacity()), sender,
+            [&, buffer](const boost::system::error_code& error, std::size_t) mutable
+            {
+                if (error)
+                    return;
+                arm();
+                buffer.reset();
+                received++;
+            });
+    };
+    arm();
+
+    std::atomic<bool> stop{false};
+    uint64_t sent = 0;
+    std::thread blaster(blast, socket.local_endpoint(), bytes, std::ref(stop), std::ref(sent));
+    double cpuStart = threadCpuSeconds();
+    auto start = Clock::now();
+    context.run_for(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds)));
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    double cpu = threadCpuSeconds() - cpuStart;
+    stop = true;
+    blaster.join();
+
+    Result result;
+    result.packetsPerSecond = static_cast<double>(received) / elapsed;
+    result.cpuNsPerPacket = received ? cpu * 1e9 / static_cast<double>(received) : 0;
+    result.lossPercent = sent ? 100.0 * (1.0 - static_cast<double>(received) / static_cast<double>(sent)) : 0;
+    return result;
+}
+
+Result receiveUring(double seconds, size_t bytes)
+{
+    boost::asio::io_context context;
+    auto pool = PacketBufferPool::create();
+    udp::socket socket(context, loopback());
+    socket.set_option(boost::asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+
+    uint64_t received = 0;
+    auto transport = UringTransport::create(socket.native_handle(), context.get_executor(), pool, UringTransport::Parameters());
+    if (!transport || !transport->start([&](PacketHandle, const udp::endpoint&) { received++; }, nullptr))
+        return Result();
+
+    std::atomic<bool> stop{false};
+    uint64_t sent = 0;
+    std::thread blaster(blast, socket.local_endpoint(), bytes, std::ref(stop), std::ref(sent));
+    double cpuStart = threadCpuSeconds();
+    auto start = Clock::now();
+    context.run_for(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds)));
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    double cpu = threadCpuSeconds() - cpuStart;
+    stop = true;
+    blaster.join();
+    transport->stop();
+
+    Result result;
+    result.packetsPerSecond = static_cast<double>(received) / elapsed;
+    result.cpuNsPerPacket = received ? cpu * 1e9 / static_cast<double>(received) : 0;
+    result.lossPercent = sent ? 100.0 * (1.0 - static_cast<double>(received) / static_cast<double>(sent)) : 0;
+    return result;
+}
+
+Result sendAsio(double seconds, size_t bytes)
+{
+    boost::asio::io_context context;
+    auto pool = PacketBufferPool::create();
+    udp::socket socket(context, loopback());
+    udp::socket sink(context, loopback());
+    sink.set_option(boost::asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+    udp::endpoint target = sink.local_endpoint();
+
+    uint64_t completed = 0;
+    auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    std::function<void()> sendOne = [&]()
+    {
+        PacketHandle packet = pool->acquire(bytes);
+        boost::asio::const_buffer buffer(packet.data(), packet.size());
+        socket.async_send_to(buffer, target, [&, packet](const boost::system::error_code&, std::size_t)
+        {
+            completed++;
+            if (Clock::now() < deadline)
+                sendOne();
+        });
+    };
+
+    std::atomic<bool> stop{false};
+    std::thread drainer(drain, std::ref(sink), std::ref(stop));
+    double cpuStart = threadCpuSeconds();
+    auto start = Clock::now();
+    for (size_t i = 0; i < SEND_WINDOW; i++)
+        sendOne();
+    context.run();
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    double cpu = threadCpuSeconds() - cpuStart;
+    stop = true;
+    drainer.join();
+
+    Result result;
+    result.packetsPerSecond = static_cast<double>(completed) / elapsed;
+    result.cpuNsPerPacket = completed ? cpu * 1e9 / static_cast<double>(completed) : 0;
+    return result;
+}
+
+Result sendUring(double seconds, size_t bytes)
+{
+    boost::asio::io_context context;
+    auto pool = PacketBufferPool::create();
+    udp::socket socket(context, loopback());
+    udp::socket sink(context, loopback());
+    sink.set_option(boost::asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+    udp::endpoint target = sink.local_endpoint();
+
+    auto transport = UringTransport::create(socket.native_handle(), context.get_executor(), pool, UringTransport::Parameters());
+    uint64_t completed = 0;
+    size_t inFlight = 0;
+    auto deadline = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+    // Tops the window up in batches, the way transmitDatagram + flushTxBatch do
+    auto refill = [&]()
+    {
+        while (inFlight + SEND_BATCH <= SEND_WINDOW && Clock::now() < deadline)
+        {
+            for (size_t i = 0; i < SEND_BATCH; i++)
+            {
+                PacketHandle packet = pool->acquire(bytes);
+                if (transport->queueSend(packet, target, 0))
+                    inFlight++;
+            }
+            transport->flush();
+        }
+    };
+    bool started = transport && transport->start(
+        [](PacketHandle, const udp::endpoint&) {},
+        [&](const boost::system::error_code&, std::size_t, uint32_t, const udp::endpoint&)
+        {
+            completed++;
+            inFlight--;
+            refill();
+        });
+    if (!started)
+        return Result();
+
+    std::atomic<bool> stop{false};
+    std::thread drainer(drain, std::ref(sink), std::ref(stop));
+    double cpuStart = threadCpuSeconds();
+    auto start = Clock::now();
+    refill();
+    while (inFlight > 0)
+        context.run_one();
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    double cpu = threadCpuSeconds() - cpuStart;
+    stop = true;
+    drainer.join();
+    transport->stop();
+
+    Result result;
+    result.packetsPerSecond = static_cast<double>(completed) / elapsed;
+    result.cpuNsPerPacket = completed ? cpu * 1e9 / static_cast<double>(completed) : 0;
+    return result;
+}
+
+void print(const char* name, const Result& result, bool withLoss)
+{
+    if (result.packetsPerSecond == 0)
+    {
+        std::printf("%-26s %12s\n", name, "unavailable");
+        return;
+    }
+    std::printf("%-26s %12.0f %14.0f", name, result.packetsPerSecond, result.cpuNsPerPacket);
+    if (withLoss)
+        std::printf(" %9.1f%%", result.lossPercent);
+    std::printf("\n");
+}
+}
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? std::atof(argv[1]) : 2.0;
+    size_t bytes = argc > 2 ? static_cast<size_t>(std::atoi(argv[2])) : 200;
+
+    std::printf("%zu byte datagrams over loopback, %.1fs per case\n", bytes, seconds);
+    std::printf("%-26s %12s %14s %10s\n", "", "packets/s", "CPU ns/packet", "kernel loss");
+    print("receive asio", receiveAsio(seconds, bytes), true);
+    print("receive io_uring", receiveUring(seconds, bytes), true);
+    print("send asio", sendAsio(seconds, bytes), false);
+    print("send io_uring", sendUring(seconds, bytes), false);
+    return 0;
+}
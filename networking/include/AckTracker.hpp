@@ -0,0 +1,135 @@
+#pragma once
+
+#include "ReplayWindow.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// v2 acknowledgement block, carried at the front of the encrypted payload of data packets or on its own
+// Acks the peer's packets of one session: largest counter seen, a bitmap of the 64 counters below it,
+// and how many packets of the session arrived in total (cumulative, so lost acks don't lose loss information)
+struct AckBlock
+{
+    static constexpr size_t SIZE = 32;
+
+    uint32_t sessionId = 0;
+    // Time between receiving `largest` and sending the ack, taken out of the RTT sample
+    uint32_t delayMicroseconds = 0;
+    uint64_t largest = 0;
+    uint64_t receivedCount = 0;
+    // Bit i = counter largest - 1 - i arrived
+    uint64_t bitmap = 0;
+
+    void write(uint8_t*) const;
+    static AckBlock read(const uint8_t*);
+};
+
+// Per-peer ack state for v2 data, both directions
+// Send side: a fixed ring of recent packets (send time, size) for RTT samples and bytes in flight,
+// loss comes from the cumulative count in the peer's acks
+// Receive side: decides when an ack is due, at most one per ack delay or per ACK_EVERY packets
+// Not thread-safe, IO thread only
+class AckTracker
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Packets remembered on the send side, older ones are forgotten (neither acked nor lost) when overwritten
+    static constexpr size_t RING_SIZE = 1024;
+    // Unacked packets this far below the largest acked one are taken as lost
+    static constexpr uint64_t REORDER_THRESHOLD = 3;
+    // Ack at least every this many packets, keeps everything between two acks inside the bitmap
+    static constexpr uint32_t ACK_EVERY = 32;
+
+    struct Stats
+    {
+        std::chrono::microseconds smoothedRtt{0};
+        std::chrono::microseconds rttVariation{0};
+        std::chrono::microseconds minRtt{0};
+        std::chrono::microseconds latestRtt{0};
+        // Recent loss, smoothed over acks, 0..1
+        double lossRate = 0.0;
+        // Packets the peer should have had by its latest ack and never got
+        uint64_t packetsLost = 0;
+        uint64_t packetsSent = 0;
+        uint64_t packetsAcked = 0;
+        uint64_t bytesInFlight = 0;
+        uint64_t bytesDelivered = 0;
+        uint64_t acksSent = 0;
+        uint64_t acksReceived = 0;
+    };
+
+    // Delivery rate over the flight of the newest packet an ack settled, the way BBR samples it:
+    // bytes delivered since that packet was sent, over the longer of its send and ack intervals
+    struct RateSample
+    {
+        uint64_t deliveredBytes = 0;
+        std::chrono::microseconds interval{0};
+        // bytesDelivered when that packet went out, a later sample from a packet sent after this one is a new round
+        uint64_t priorDelivered = 0;
+
+        bool valid() const { return deliveredBytes > 0 && interval.count() > 0; }
+        // Bytes per second
+        uint64_t rate() const { return valid() ? deliveredBytes * 1000000 / static_cast<uint64_t>(interval.count()) : 0; }
+    };
+
+    AckTracker();
+
+    // Send side
+    void onPacketSent(uint64_t counter, size_t bytes, Clock::time_point now);
+    // Caller checks the block is for our current session
+    // Invalid sample when the ack settled nothing new
+    RateSample onAckReceived(const AckBlock&, Clock::time_point now);
+    bool hasRttSample() const { return rttSamples > 0; }
+
+    // Receive side, ack-only packets don't elicit an ack themselves
+    void onPacketReceived(uint64_t counter, bool ackEliciting, Clock::time_point now);
+    // The peer started a new session, its counters start over
+    void resetReceiveSide();
+    bool isAckPending() const { return ackPending > 0; }
+    // Pending and either the delay ran out or enough packets piled up
+    bool isAckDue(Clock::time_point now, std::chrono::microseconds ackDelay) const;
+    bool mustAckNow() const { return ackPending >= ACK_EVERY; }
+    // Ack for everything received so far, clears the pending state
+    AckBlock makeAck(uint32_t peerSessionId, const ReplayWindow&, Clock::time_point now);
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct SentPacket
+    {
+        uint64_t counter = 0;
+        Clock::time_point sentAt;
+        uint32_t bytes = 0;
+        bool inFlight = false;
+        // Rate sampling state when it was sent
+        uint64_t delivered = 0;
+        Clock::time_point deliveredAt;
+        Clock::time_point firstSentAt;
+    };
+
+    void leaveFlight(SentPacket&, bool delivered);
+    void updateRtt(std::chrono::microseconds latest, std::chrono::microseconds ackDelay);
+
+    std::vector<SentPacket> ring;
+    uint64_t nextCounter = 0;
+    // Lowest counter that may still be in flight
+    uint64_t oldestInFlight = 0;
+    uint64_t largestAcked = 0;
+    bool anyAcked = false;
+    uint64_t lastExpected = 0;
+    uint64_t lastLost = 0;
+    uint64_t rttSamples = 0;
+    // When the latest delivery was acked, and when the packet it acked was sent
+    Clock::time_point deliveredTime;
+    Clock::time_point firstSentTime;
+
+    uint32_t ackPending = 0;
+    Clock::time_point firstPendingAt;
+    uint64_t largestReceived = 0;
+    Clock::time_point largestReceivedAt;
+    uint64_t receivedCount = 0;
+
+    Stats stats;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// One packet of a batch, sealed / opened in place with a detached 16-byte tag
+struct BatchCipherItem
+{
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    uint8_t* mac = nullptr;
+    const uint8_t* ad = nullptr;
+    size_t adSize = 0;
+    const uint8_t* key = nullptr; // 32 bytes
+    uint8_t nonce[12] = {};
+    // Set by open(), false if the tag didn't match (data is left untouched then)
+    bool ok = false;
+};
+
+// ChaCha20-Poly1305 (IETF, same output as crypto_aead_chacha20poly1305_ietf_*) over several packets at once
+// The ChaCha20 keystream of 8 (AVX2) or 16 (AVX-512) packets is computed side by side, one packet per SIMD lane,
+// Poly1305 runs per packet through libsodium. The kernel is picked from the CPU features at runtime
+class BatchChaCha20Poly1305
+{
+public:
+    enum class Kernel : uint8_t
+    {
+        SCALAR,
+        AVX2,
+        AVX512
+    };
+
+    static constexpr size_t MAX_BATCH = 16;
+
+    // Best kernel this CPU (and build) can run
+    static Kernel detectKernel();
+    static bool isKernelAvailable(Kernel);
+    static const char* kernelName(Kernel);
+
+    explicit BatchChaCha20Poly1305(Kernel = detectKernel());
+
+    Kernel getKernel() const { return kernel; }
+
+    // Any count, split into chunks of at most MAX_BATCH
+    void seal(BatchCipherItem*, size_t count) const;
+    void open(BatchCipherItem*, size_t count) const;
+
+private:
+    // ChaCha20 work for one packet: block 0 becomes the Poly1305 key, blocks 1.. are XORed into data
+    struct Lane
+    {
+        const uint8_t* key = nullptr;
+        const uint8_t* nonce = nullptr;
+        uint8_t* data = nullptr;
+        size_t size = 0;
+        uint8_t* polyKey = nullptr; // 32 bytes out
+    };
+
+    void runKernel(Lane*, size_t count) const;
+
+    // Kernels, the SIMD ones live in their own translation units built with the matching target flags
+    static void xorKeystreamScalar(Lane*, size_t count);
+    static void xorKeystreamAvx2(Lane*, size_t count);
+    static void xorKeystreamAvx512(Lane*, size_t count);
+
+    Kernel kernel;
+};
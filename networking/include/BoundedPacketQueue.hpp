@@ -0,0 +1,94 @@
+#pragma once
+
+#include "BoundedRing.hpp"
+#include "PacketBufferPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Bounded hand-off of packets from the TUN reader threads to the IO thread, in place of one posted handler each
+// The consumer is scheduled once per burst rather than once per packet: push() says when it has to be posted,
+// and it stays scheduled until popBatch() finds the queue empty
+// A full queue makes the reader wait for room, up to maxStall, so a burst slows the host's sends down instead of
+// piling work onto the io_context; past that the drop policy decides which packet goes
+// Packets go through a lock-free ring sized to the limit up front, nothing is allocated after construction;
+// the mutex is only taken by readers waiting for room and by the consumer when one is waiting
+// Thread-safe, any number of producers, one consumer
+class BoundedPacketQueue
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class DropPolicy : uint8_t
+    {
+        // Lose the packet being pushed, what's queued already goes out in order
+        TAIL,
+        // Lose the oldest queued packet, the newest is likely the one that still matters
+        HEAD
+    };
+
+    struct Parameters
+    {
+        size_t limit = 2048;
+        DropPolicy dropPolicy = DropPolicy::TAIL;
+        // Longest a push waits for room before dropping, 0 drops straight away
+        std::chrono::microseconds maxStall{10000};
+    };
+
+    struct Stats
+    {
+        uint64_t enqueued = 0;
+        uint64_t dequeued = 0;
+        uint64_t drops = 0;
+        uint64_t droppedBytes = 0;
+        // Pushes that had to wait for room, and how long they waited altogether
+        uint64_t stalls = 0;
+        std::chrono::microseconds stallTime{0};
+        // Queued right now and the most there have been
+        size_t depth = 0;
+        size_t maxDepth = 0;
+    };
+
+    BoundedPacketQueue() : BoundedPacketQueue(Parameters()) {}
+    explicit BoundedPacketQueue(Parameters);
+
+    // Producer side; true when the consumer isn't scheduled and the caller has to post it
+    bool push(PacketHandle packet);
+    // Consumer side, moves up to maxPackets into out
+    // Returns true when packets are left and the consumer should post itself again; on false it's unscheduled
+    // and the next push() schedules it
+    bool popBatch(std::vector<PacketHandle>& out, size_t maxPackets);
+    // Throws everything queued away and unschedules the consumer, returns how many packets that was
+    size_t clear();
+
+    size_t size() const;
+    Stats getStats() const;
+
+private:
+    // Unschedules the consumer unless something came in meanwhile, false if it's to stay scheduled
+    bool unschedule();
+    void notifyWaitingProducers();
+    void countDrop(const PacketHandle&);
+    void recordDepth();
+
+    Parameters parameters;
+    BoundedRing<PacketHandle> ring;
+    std::atomic<bool> consumerScheduled{false};
+
+    // Backpressure only: readers wait here for room
+    std::mutex waitMutex;
+    std::condition_variable spaceAvailable;
+    std::atomic<size_t> waitingProducers{0};
+
+    std::atomic<uint64_t> enqueued{0};
+    std::atomic<uint64_t> dequeued{0};
+    std::atomic<uint64_t> drops{0};
+    std::atomic<uint64_t> droppedBytes{0};
+    std::atomic<uint64_t> stalls{0};
+    std::atomic<int64_t> stallMicroseconds{0};
+    std::atomic<size_t> maxDepth{0};
+};
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free FIFO between threads (Vyukov's bounded queue), no mutex on either side
+// Every slot carries a sequence number saying whose turn it is: producers claim slots by moving the tail,
+// consumers by moving the head, and each side only waits on the slot it claimed
+// The batch calls claim a run of slots with one atomic, so a burst costs one contended operation, not one per item
+// SINGLE_PRODUCER skips the compare-and-swap on the tail when only one thread ever pushes (SPSC);
+// pops are always safe from several threads, a producer can pop the oldest item to make room
+// Capacity is fixed at construction, nothing is allocated after
+// Thread-safe, any number of producers (exactly one with SINGLE_PRODUCER) and consumers
+template <typename T, bool SINGLE_PRODUCER = false>
+class BoundedRing
+{
+public:
+    explicit BoundedRing(size_t capacity)
+        : slotCount(capacity > 0 ? capacity : 1),
+          slots(new Slot[slotCount])
+    {
+        for (size_t i = 0; i < slotCount; i++)
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    BoundedRing(const BoundedRing&) = delete;
+    BoundedRing& operator=(const BoundedRing&) = delete;
+
+    // Moves from value only when it returns true, false when the ring is full
+    bool tryPush(T& value)
+    {
+        return tryPushBatch(&value, 1) == 1;
+    }
+
+    // Pushes the first items of values, as many as there's room for, returns how many
+    size_t tryPushBatch(T* values, size_t count)
+    {
+        uint64_t position = tail.load(std::memory_order_relaxed);
+        size_t claimed = 0;
+        while (count > 0)
+        {
+            claimed = 0;
+            while (claimed < count && slotAt(position + claimed).sequence.load(std::memory_order_acquire) == position + claimed)
+                claimed++;
+            if (claimed == 0)
+            {
+                // Still holding an item from the previous lap: full
+                uint64_t sequence = slotAt(position).sequence.load(std::memory_order_acquire);
+                if (static_cast<int64_t>(sequence - position) < 0)
+                    return 0;
+                position = tail.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (SINGLE_PRODUCER)
+            {
+                tail.store(position + claimed, std::memory_order_relaxed);
+                break;
+            }
+            if (tail.compare_exchange_weak(position, position + claimed, std::memory_order_relaxed))
+                break;
+        }
+
+        for (size_t i = 0; i < claimed; i++)
+        {
+            Slot& slot = slotAt(position + i);
+            slot.value = std::move(values[i]);
+            slot.sequence.store(position + i + 1, std::memory_order_release);
+        }
+        return claimed;
+    }
+
+    // False when nothing is ready
+    bool tryPop(T& out)
+    {
+        uint64_t position = 0;
+        size_t claimed = claimPop(1, position);
+        if (claimed == 0)
+            return false;
+        Slot& slot = slotAt(position);
+        out = std::move(slot.value);
+        slot.sequence.store(position + slotCount, std::memory_order_release);
+        return true;
+    }
+
+    // Appends up to maxItems to out, oldest first, returns how many
+    size_t tryPopBatch(std::vector<T>& out, size_t maxItems)
+    {
+        uint64_t position = 0;
+        size_t claimed = claimPop(maxItems, position);
+        for (size_t i = 0; i < claimed; i++)
+        {
+            Slot& slot = slotAt(position + i);
+            out.push_back(std::move(slot.value));
+            slot.sequence.store(position + i + slotCount, std::memory_order_release);
+        }
+        return claimed;
+    }
+
+    // The oldest item is there to pop; false while its producer is still filling it in
+    bool hasReady() const
+    {
+        uint64_t position = head.load(std::memory_order_acquire);
+        return slotAt(position).sequence.load(std::memory_order_acquire) == position + 1;
+    }
+
+    // Claimed slots, filled in or not; a snapshot that can be stale by the time it returns
+    size_t size() const
+    {
+        uint64_t consumed = head.load(std::memory_order_acquire);
+        uint64_t produced = tail.load(std::memory_order_acquire);
+        return produced > consumed ? static_cast<size_t>(produced - consumed) : 0;
+    }
+
+    size_t capacity() const { return slotCount; }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{0};
+        T value{};
+    };
+
+    Slot& slotAt(uint64_t position) const
+    {
+        return slots[position % slotCount];
+    }
+
+    size_t claimPop(size_t maxItems, uint64_t& position)
+    {
+        position = head.load(std::memory_order_relaxed);
+        while (maxItems > 0)
+        {
+            size_t ready = 0;
+            while (ready < maxItems && slotAt(position + ready).sequence.load(std::memory_order_acquire) == position + ready + 1)
+                ready++;
+            if (ready == 0)
+            {
+                // Not filled in yet for this lap: empty, or a producer is still writing it
+                uint64_t sequence = slotAt(position).sequence.load(std::memory_order_acquire);
+                if (static_cast<int64_t>(sequence - (position + 1)) < 0)
+                    return 0;
+                position = head.load(std::memory_order_relaxed);
+                continue;
+            }
+            // seq_cst so a consumer freeing room and a producer deciding to wait can't both miss each other
+            if (head.compare_exchange_weak(position, position + ready, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return ready;
+        }
+        return 0;
+    }
+
+    // Producers and consumers each on their own cache line
+    static constexpr size_t CACHE_LINE = 64;
+
+    size_t slotCount;
+    std::unique_ptr<Slot[]> slots;
+    alignas(CACHE_LINE) std::atomic<uint64_t> tail{0};
+    alignas(CACHE_LINE) std::atomic<uint64_t> head{0};
+};
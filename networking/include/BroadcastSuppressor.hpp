@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <sodium.h>
+
+// Keeps broadcast / multicast storms from our host off the peers' links before they're fanned out
+// Identical packets within the collapse window go out once (a game announcing itself on every interface, or
+// resending its discovery packet back to back), and every source socket gets a token bucket of packets per second
+// Packets are fingerprinted with a keyed SipHash over what doesn't change between resends: addresses, protocol,
+// fragment offset and the IP payload, not the IP id, TTL or header checksum
+// Fingerprints are direct-mapped, a collision only costs a missed collapse, never a wrong drop
+// Buckets are matched on the whole source, so sources can't refill each other's; past SOURCE_SLOTS busy sources
+// the newcomers share one overflow bucket
+// Not thread-safe, IO thread only
+class BroadcastSuppressor
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum class Verdict
+    {
+        PASS,
+        DUPLICATE,
+        RATE_LIMITED
+    };
+
+    struct Stats
+    {
+        uint64_t passed = 0;
+        uint64_t duplicates = 0;
+        uint64_t duplicateBytes = 0;
+        uint64_t rateLimited = 0;
+        uint64_t rateLimitedBytes = 0;
+    };
+
+    static constexpr size_t FINGERPRINT_SLOTS = 256;
+    static constexpr size_t SOURCE_SLOTS = 64;
+
+    BroadcastSuppressor();
+
+    // A zero window or rate turns that stage off; non-IPv4 packets always pass
+    Verdict inspect(const uint8_t* packet, size_t size, Clock::time_point now,
+        std::chrono::milliseconds collapseWindow, size_t ratePerSource);
+    // Forgets what was seen, the stats stay
+    void clear();
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct Fingerprint
+    {
+        uint64_t hash = 0;
+        Clock::time_point sent;
+        bool used = false;
+    };
+
+    // Source address, protocol and port for UDP / TCP
+    struct Bucket
+    {
+        uint64_t source = 0;
+        double tokens = 0;
+        Clock::time_point refilled;
+        bool used = false;
+    };
+
+    uint64_t fingerprint(const uint8_t* packet, size_t headerSize, size_t size) const;
+    Bucket& bucketFor(uint64_t source, Clock::time_point now);
+    bool takeToken(uint64_t source, Clock::time_point now, size_t ratePerSource);
+
+    std::array<uint8_t, crypto_shorthash_KEYBYTES> key{};
+    std::array<Fingerprint, FINGERPRINT_SLOTS> fingerprints{};
+    std::array<Bucket, SOURCE_SLOTS> buckets{};
+    Bucket overflowBucket;
+    Stats stats;
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <boost/asio/io_context.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+// Spin-then-block for the data path threads, the low-latency ("competitive gaming") mode
+// Before a thread goes to sleep waiting for packets it keeps checking for up to a budget, so a packet that shows up
+// within it is picked up without a wakeup, and without the scheduler's jitter on top of the interrupt
+// The budget adapts: a spin that finds nothing halves it, down to no spinning once traffic stops, and a sleep
+// short enough that spinning would have covered it brings it back to full; an idle thread doesn't burn its core
+// A budget of 0 is off, spin() returns false without looking and the caller blocks as before
+// Thread-safe, but give each waiting thread its own so the budget follows that thread's traffic
+class BusyPoller
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stats
+    {
+        // Spins that found work, each one a wakeup that didn't happen
+        uint64_t hits = 0;
+        // Spins that ran out of budget before the thread blocked
+        uint64_t misses = 0;
+        // Blocks without spinning first because the budget had backed off to nothing
+        uint64_t skipped = 0;
+        // CPU time the spinning cost
+        std::chrono::microseconds spinTime{0};
+
+        Stats& operator+=(const Stats&);
+    };
+
+    explicit BusyPoller(std::chrono::microseconds budget = std::chrono::microseconds(0));
+
+    bool isEnabled() const { return maxBudget > 0; }
+
+    // Calls ready() until it returns true or the budget runs out, true if it did
+    template <typename Ready>
+    bool spin(Ready&& ready)
+    {
+        if (maxBudget == 0)
+            return false;
+        int64_t budget = currentBudget.load(std::memory_order_relaxed);
+        if (budget == 0)
+        {
+            skipped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        Clock::time_point start = Clock::now();
+        Clock::time_point deadline = start + std::chrono::nanoseconds(budget);
+        // When the last check began, so the work ready() did on a hit isn't counted as spinning
+        Clock::time_point checkedAt = start;
+        while (!ready())
+        {
+            checkedAt = Clock::now();
+            if (checkedAt >= deadline)
+            {
+                missed(checkedAt - start);
+                return false;
+            }
+            pause();
+        }
+        hit(checkedAt - start);
+        return true;
+    }
+
+    // Caller blocked at blockedAt after spin() gave up and has just woken up
+    void woke(Clock::time_point blockedAt);
+
+    // io_context::run() for a spinning thread: polls for ready handlers (and the reactor) while the budget lasts,
+    // then blocks in run_one(); returns when the context is stopped or out of work, with the handlers it ran
+    size_t run(boost::asio::io_context&);
+
+    Stats getStats() const;
+
+#ifdef __linux__
+    // SO_BUSY_POLL: the kernel polls the device queue this long in a blocking read on the socket before sleeping
+    // Values above net.core.busy_read need CAP_NET_ADMIN, false if refused
+    static bool enableSocketBusyPoll(int socketFd, std::chrono::microseconds);
+#endif
+
+private:
+    static void pause()
+    {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+        _mm_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+
+    void hit(Clock::duration spun);
+    void missed(Clock::duration spun);
+
+    // Below this a spin isn't worth starting
+    static constexpr int64_t MIN_BUDGET_NS = 1000;
+
+    // Nanoseconds
+    const int64_t maxBudget;
+    std::atomic<int64_t> currentBudget;
+
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> skipped{0};
+    std::atomic<int64_t> spinNanoseconds{0};
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <sodium.h>
+
+// AEADs a v2 MESSAGE can be sealed with, the id travels in the second header byte
+// All of them use a 16-byte MAC, so the v2 overhead doesn't depend on the suite
+enum class CipherSuite : uint8_t
+{
+    XSALSA20_POLY1305 = 0, // crypto_box key and nonce, Poly1305 over header and ciphertext; what every v2 peer has
+    CHACHA20_POLY1305 = 1, // IETF variant, fast everywhere
+    AES256_GCM = 2,        // only with AES-NI + PCLMUL
+    COUNT
+};
+
+// Per-peer keys and the seal / open calls for every suite
+// The AEAD suites get their own key per suite and direction, derived from the crypto_box_beforenm key,
+// so their 12-byte nonce is just session id + counter. XSalsa20 keeps the v2 nonce with the direction bit
+class PeerCipher
+{
+public:
+    using SharedKey = std::array<uint8_t, crypto_box_BEFORENMBYTES>;
+
+    static constexpr size_t MAC_SIZE = 16;
+
+    void setKeys(const SharedKey&, bool localIsLower);
+
+    // In place, every suite authenticates the header as additional data
+    void seal(CipherSuite, uint8_t* data, size_t size, uint8_t* mac,
+        const uint8_t* header, size_t headerSize, uint32_t sessionId, uint64_t counter) const;
+    bool open(CipherSuite, uint8_t* data, size_t size, const uint8_t* mac,
+        const uint8_t* header, size_t headerSize, uint32_t sessionId, uint64_t counter) const;
+
+    // Raw key of an AEAD suite, for callers batching packets themselves (BatchChaCha20Poly1305)
+    const uint8_t* getAeadKey(CipherSuite, bool transmit) const;
+    // 12-byte AEAD nonce: session id then counter, big endian
+    static void buildAeadNonce(uint8_t* nonce, uint32_t sessionId, uint64_t counter);
+
+    // Bit n set = suite n works on this host
+    static uint8_t supportedSuites();
+    static bool isSupported(CipherSuite);
+    static const char* suiteName(CipherSuite);
+    static std::optional<CipherSuite> parseSuite(const std::string&);
+
+    // Seals a few hundred MTU-sized packets with each supported suite, measured once per process
+    static CipherSuite fastestSuite();
+
+    // What we send with: our pick if the peer can open it, else theirs if we have it, else XSalsa20
+    static CipherSuite chooseSuite(CipherSuite local, uint8_t peerSupported, uint8_t peerPreferred);
+
+private:
+    using Key = std::array<uint8_t, crypto_aead_chacha20poly1305_ietf_KEYBYTES>;
+    static constexpr size_t SUITE_COUNT = static_cast<size_t>(CipherSuite::COUNT);
+
+    SharedKey sharedKey{};
+    bool localIsLower = false;
+    std::array<Key, SUITE_COUNT> txKeys{};
+    std::array<Key, SUITE_COUNT> rxKeys{};
+    // Expanded AES key schedules, saves redoing them per packet
+    alignas(16) crypto_aead_aes256gcm_state aesTxState;
+    alignas(16) crypto_aead_aes256gcm_state aesRxState;
+};
+
+// Key a lobby member seals its broadcast / multicast with, once for all the peers holding it
+// Every member has its own, handed to each peer over the pairwise channel; always ChaCha20-Poly1305, which every host has
+// Nonce is key id (the sender's session) + counter, so a fresh key per session keeps it unique
+class GroupCipher
+{
+public:
+    using Key = std::array<uint8_t, crypto_aead_chacha20poly1305_ietf_KEYBYTES>;
+
+    static constexpr CipherSuite SUITE = CipherSuite::CHACHA20_POLY1305;
+    static constexpr size_t MAC_SIZE = crypto_aead_chacha20poly1305_ietf_ABYTES;
+
+    // Fresh random key
+    void generate();
+    void setKey(const Key&);
+    const Key& getKey() const { return key; }
+
+    void seal(uint8_t* data, size_t size, uint8_t* mac,
+        const uint8_t* header, size_t headerSize, uint32_t keyId, uint64_t counter) const;
+    bool open(uint8_t* data, size_t size, const uint8_t* mac,
+        const uint8_t* header, size_t headerSize, uint32_t keyId, uint64_t counter) const;
+    // open() in two steps, for a datagram that is relayed as it arrived once it authenticated:
+    // verify() checks the MAC without touching the data, decrypt() then only deciphers what passed it
+    bool verify(const uint8_t* data, size_t size, const uint8_t* mac,
+        const uint8_t* header, size_t headerSize, uint32_t keyId, uint64_t counter) const;
+    void decrypt(uint8_t* data, size_t size, uint32_t keyId, uint64_t counter) const;
+
+private:
+    Key key{};
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "PacketBufferPool.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounded FIFO of packets waiting to be written to the TUN device, with CoDel (RFC 8289) on top
+// Every packet is stamped when it's queued; once the time packets spend in the queue stays above the target
+// for a whole interval, packets are dropped from the head at a rate that rises until the standing queue is gone
+// Short bursts pass untouched, and a queue that's full anyway loses its oldest packet rather than the newest
+// Storage is a ring sized to the limit up front, nothing is allocated after construction
+// Not thread-safe, owned by one writer thread (see TunWriteQueue)
+class CoDelQueue
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Parameters
+    {
+        size_t limit = 1024;
+        // Standing delay we tolerate
+        std::chrono::microseconds target{5000};
+        // How long it has to stand before we drop, about a worst-case RTT
+        std::chrono::microseconds interval{100000};
+    };
+
+    struct Stats
+    {
+        uint64_t enqueued = 0;
+        uint64_t dequeued = 0;
+        // Dropped by CoDel for standing in the queue too long
+        uint64_t codelDrops = 0;
+        // Dropped because the queue was at its limit
+        uint64_t overflowDrops = 0;
+        uint64_t droppedBytes = 0;
+        // Queued right now and the most there have been
+        size_t depth = 0;
+        size_t maxDepth = 0;
+    };
+
+    CoDelQueue() : CoDelQueue(Parameters()) {}
+    explicit CoDelQueue(Parameters);
+
+    void push(PacketHandle packet, Clock::time_point now);
+    // Next packet to write, after whatever CoDel decided to drop; empty handle when nothing is left
+    PacketHandle pop(Clock::time_point now);
+    // Throws everything queued away, returns how many packets that was
+    size_t clear();
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+    size_t bytes() const { return byteCount; }
+    // True while CoDel is in its dropping state
+    bool isDropping() const { return dropping; }
+    Stats getStats() const;
+
+private:
+    struct Entry
+    {
+        PacketHandle packet;
+        Clock::time_point enqueuedAt;
+    };
+
+    PacketHandle popHead(Clock::time_point& enqueuedAt);
+    // Takes the head and says whether its sojourn time makes it a candidate for dropping
+    PacketHandle popAndCheck(Clock::time_point now, bool& okToDrop);
+    Clock::time_point controlLaw(Clock::time_point t) const;
+    void drop(PacketHandle& packet);
+
+    Parameters parameters;
+    std::vector<Entry> ring;
+    size_t head = 0;
+    size_t count = 0;
+    size_t byteCount = 0;
+
+    // RFC 8289 state
+    Clock::time_point firstAboveTime{};
+    Clock::time_point dropNext{};
+    uint32_t dropCount = 0;
+    uint32_t lastDropCount = 0;
+    bool dropping = false;
+
+    Stats stats;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "AckTracker.hpp"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Per-peer congestion control for v2 data, BBR-style: a model of the path instead of reacting to every loss
+// Bandwidth is the max delivery rate over the last BANDWIDTH_ROUNDS round trips, the RTT floor is the min RTT
+// over MIN_RTT_WINDOW; sends are paced at a gain times that bandwidth and capped at a gain times their product
+// Startup doubles the rate each round until it stops growing, drain empties the queue that built, then probe
+// cycles the gain around 1 so a queue at the bottleneck never stands for long
+// Loss above LOSS_THRESHOLD in a round caps the flight at what was out when it happened, like BBRv2's inflight_hi
+// Fed from the AckTracker, asked by the send path whether a peer may send now and when it may next
+// Not thread-safe, IO thread only
+class CongestionController
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr uint64_t MAX_DATAGRAM = 1500;
+    static constexpr uint64_t INITIAL_WINDOW = 32 * MAX_DATAGRAM;
+    static constexpr uint64_t MIN_WINDOW = 4 * MAX_DATAGRAM;
+    static constexpr size_t BANDWIDTH_ROUNDS = 10;
+    static constexpr std::chrono::seconds MIN_RTT_WINDOW{10};
+    static constexpr std::chrono::milliseconds PROBE_RTT_TIME{200};
+    static constexpr double LOSS_THRESHOLD = 0.02;
+    // The pacer lets this much time's worth of data out back to back, timers don't fire any finer
+    static constexpr std::chrono::microseconds PACING_BURST{1000};
+    // A window-limited peer that heard no ack for this long sends one packet anyway, so lost acks can't stall it
+    static constexpr std::chrono::milliseconds PROBE_TIMEOUT{200};
+
+    enum class State : uint8_t
+    {
+        STARTUP,
+        DRAIN,
+        PROBE_BW,
+        PROBE_RTT
+    };
+
+    struct Stats
+    {
+        State state = State::STARTUP;
+        // Bytes per second, 0 until the first sample
+        uint64_t bandwidth = 0;
+        uint64_t pacingRate = 0;
+        uint64_t congestionWindow = INITIAL_WINDOW;
+        std::chrono::microseconds minRtt{0};
+        // Times a send had to wait for the pacer or for the window
+        uint64_t pacingDelays = 0;
+        uint64_t windowLimited = 0;
+        // Rounds whose loss capped the flight
+        uint64_t lossRounds = 0;
+    };
+
+    // bytesInFlight from before this packet
+    void onPacketSent(size_t bytes, uint64_t bytesInFlight, Clock::time_point now);
+    void onAck(const AckTracker::RateSample&, const AckTracker::Stats&, Clock::time_point now);
+    // Nothing left to send while the window had room: samples until this flight is delivered understate the path
+    void onAppLimited(const AckTracker::Stats&);
+
+    bool canSend(uint64_t bytesInFlight, Clock::time_point now) const;
+    // When canSend() turns true without an ack arriving first
+    Clock::time_point nextSendTime(uint64_t bytesInFlight) const;
+    // Counts a send that had to wait, for the stats
+    void onBlocked(uint64_t bytesInFlight);
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    // 2 / ln 2, the smallest gain that still doubles delivery every round
+    static constexpr double STARTUP_GAIN = 2.885;
+
+    void updateBandwidth(const AckTracker::RateSample&);
+    void updateMinRtt(std::chrono::microseconds, Clock::time_point now);
+    void updateState(const AckTracker::Stats&, Clock::time_point now);
+    void updateModel();
+    uint64_t bandwidthDelayProduct() const;
+    void enterProbeBw(Clock::time_point now);
+
+    // Windowed max filter, one slot per round
+    std::array<uint64_t, BANDWIDTH_ROUNDS> bandwidthSamples{};
+    uint64_t round = 0;
+    uint64_t nextRoundDelivered = 0;
+    bool roundStart = false;
+    uint64_t roundStartLost = 0;
+    uint64_t roundStartAcked = 0;
+
+    uint64_t appLimitedUntil = 0;
+    bool appLimited = false;
+
+    Clock::time_point minRttStamp;
+    std::chrono::microseconds minRtt{0};
+
+    // Startup ends once the bandwidth stops growing by a quarter for three rounds
+    uint64_t fullBandwidth = 0;
+    size_t fullBandwidthRounds = 0;
+
+    double pacingGain = STARTUP_GAIN;
+    double windowGain = STARTUP_GAIN;
+    size_t cycleIndex = 0;
+    Clock::time_point cycleStamp;
+    Clock::time_point probeRttDone;
+    // Flight cap learned from loss, 0 = none
+    uint64_t inflightHigh = 0;
+
+    Clock::time_point nextSend;
+    Clock::time_point lastProgress;
+
+    Stats stats;
+};
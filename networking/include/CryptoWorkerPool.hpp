@@ -0,0 +1,138 @@
+#pragma once
+
+#include "BatchCipher.hpp"
+#include "CipherSuite.hpp"
+#include "PacketBufferPool.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One v2 packet to seal or open, laid out as header + MAC + payload starting at packet.data()
+struct CryptoJob
+{
+    enum class Operation : uint8_t
+    {
+        SEAL,
+        OPEN
+    };
+
+    Operation operation = Operation::SEAL;
+    CipherSuite suite = CipherSuite::XSALSA20_POLY1305;
+    // Shared so the keys outlive a peer that goes away while its packets are in flight
+    std::shared_ptr<const PeerCipher> cipher;
+    PacketHandle packet;
+    size_t headerSize = 0;
+    uint32_t sessionId = 0;
+    uint64_t counter = 0;
+    // Set by the worker, false if the packet didn't authenticate
+    bool ok = false;
+};
+
+// Ordered stream of jobs, one per peer and direction
+// Jobs run on any worker but completions come out in submission order
+class CryptoFlow
+{
+public:
+    // Called in order, on whichever worker finished the job that unblocked the head, keep it short (post somewhere)
+    using CompletionCallback = std::function<void(CryptoJob&)>;
+
+    CryptoFlow(size_t capacity, CompletionCallback);
+
+private:
+    friend class CryptoWorkerPool;
+
+    struct Slot
+    {
+        CryptoJob job;
+        std::atomic<bool> done{false};
+    };
+
+    std::mutex flowMutex;
+    // Fixed ring, allocated once, head is the oldest job still waiting for its completion
+    std::vector<Slot> slots;
+    size_t head = 0;
+    size_t count = 0;
+    CompletionCallback onComplete;
+};
+
+// Runs the per-packet AEAD work of every peer on a few threads, so throughput isn't capped by the io thread
+// Bursts (broadcast fan-out, recvmmsg batches) queue up and get sealed / opened several packets at a time
+// Submitting never blocks, a full flow or queue rejects the job instead
+class CryptoWorkerPool
+{
+public:
+    static constexpr size_t FLOW_CAPACITY = 1024;
+    static constexpr size_t QUEUE_CAPACITY = 4096;
+    static constexpr size_t MAX_WORKERS = 8;
+    // Jobs a worker takes off the queue at once, ChaCha20 jobs among them are run as one batch
+    static constexpr size_t MAX_JOBS_PER_WAKE = BatchChaCha20Poly1305::MAX_BATCH;
+
+    struct Stats
+    {
+        size_t workers = 0;
+        size_t queueDepth = 0;
+        size_t queueHighWaterMark = 0;
+        uint64_t jobs = 0;
+        uint64_t rejected = 0;
+        // Busy share of each worker since the previous call, 0..1
+        std::vector<double> utilization;
+    };
+
+    explicit CryptoWorkerPool(size_t workers);
+    ~CryptoWorkerPool();
+
+    // One worker per core besides the io thread, capped, 0 (crypto inline) on a single core
+    static size_t autoWorkerCount();
+
+    std::shared_ptr<CryptoFlow> createFlow(CryptoFlow::CompletionCallback, size_t capacity = FLOW_CAPACITY);
+    bool submit(const std::shared_ptr<CryptoFlow>&, CryptoJob&&);
+
+    // Workers finish the job they're on, queued jobs are dropped without completing
+    void stop();
+
+    size_t getWorkerCount() const { return workers.size(); }
+    Stats getStats();
+
+    // One job on the calling thread, for callers ordering jobs themselves
+    static void runJob(CryptoJob&);
+
+private:
+    struct QueueEntry
+    {
+        std::shared_ptr<CryptoFlow> flow;
+        CryptoFlow::Slot* slot = nullptr;
+    };
+
+    struct WorkerStats
+    {
+        std::atomic<uint64_t> busyNanoseconds{0};
+        uint64_t lastBusyNanoseconds = 0;
+    };
+
+    void workerLoop(size_t index);
+    void runJobs(QueueEntry*, size_t count) const;
+    static void completeInOrder(CryptoFlow&);
+
+    std::mutex queueMutex;
+    std::condition_variable queueCondition;
+    // Fixed ring of pending jobs
+    std::vector<QueueEntry> queue;
+    size_t queueHead = 0;
+    size_t queueCount = 0;
+    size_t queueHighWaterMark = 0;
+    bool stopping = false;
+
+    BatchChaCha20Poly1305 batchCipher;
+    std::vector<std::thread> workers;
+    std::unique_ptr<WorkerStats[]> workerStats;
+    std::atomic<uint64_t> jobs{0};
+    std::atomic<uint64_t> rejected{0};
+    std::chrono::steady_clock::time_point lastStatsTime;
+};
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "BoundedPacketQueue.hpp"
+#include "CipherSuite.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+// Tuning knobs for the packet data path (TUN <-> UDP)
+// Defaults are what we ship, loadConfig() lets them be overridden through PEERBRIDGE_* environment variables
+struct DataPathConfig
+{
+    // Batched datagram I/O with recvmmsg / sendmmsg, Linux only, ignored elsewhere
+    bool batchedIo = true;
+    // Max datagrams per recvmmsg / sendmmsg call
+    size_t ioBatchSize = 32;
+    // How long outgoing datagrams may wait for a batch to fill up
+    // 0 flushes at the end of the current io_context handler
+    std::chrono::microseconds batchFlushDeadline{0};
+    // Socket I/O through io_uring instead of asio's reactor: multishot receives into pool slabs and one submission
+    // per send batch; Linux only, falls back to the above when the kernel can't
+    bool ioUring = false;
+    // Sockets sharing our UDP port (SO_REUSEPORT), each received on its own thread; peers are steered to a shard
+    // by address and their v2 messages are opened there, the IO thread keeps the first socket; 1 = off, Linux only
+    size_t socketShards = 1;
+    // Pin shard i's thread to core i
+    bool pinShardThreads = true;
+    // Threads running the network io_context; UDPNetwork's tables stay on one strand, with more than one thread
+    // each v2 peer's seal / open runs on its own strand on the others (when there are no crypto workers)
+    size_t ioThreads = 1;
+    // Low-latency mode: the IO threads, socket shards and TUN readers / writers spin this long looking for packets
+    // before they sleep, backing off while traffic is quiet; sockets get SO_BUSY_POLL on Linux
+    // Costs up to a core per spinning thread under traffic for lower wakeup latency, 0 = off
+    std::chrono::microseconds busyPollBudget{0};
+
+    // Highest wire protocol version we advertise, peers settle on the lower of both
+    // 2 = compact MESSAGE header with counter-derived nonces, 1 = original framing
+    uint8_t maxProtocolVersion = 2;
+    // Cipher suite for v2 messages, unset = benchmark the supported ones at startup and take the fastest
+    std::optional<CipherSuite> cipherSuite;
+    // Threads sealing / opening v2 messages, -1 = one per core besides the IO thread (capped), 0 = inline on the IO thread
+    int cryptoWorkers = -1;
+    // Longest a v2 ack waits for outgoing data to ride on before it's sent on its own
+    std::chrono::milliseconds ackDelay{20};
+    // Broadcast / multicast to v2 peers sealed once with our group key instead of once per peer
+    bool groupBroadcast = true;
+    // Group broadcasts go down a relay tree with this many children per node once there are more peers than that
+    // Cuts our uplink per broadcast from one datagram per peer to this many, 0 = always send to every peer ourselves
+    size_t relayFanout = 0;
+    // Multicast only to peers whose hosts joined the group, learned from IGMP (224.0.0.0/24 still goes to everyone)
+    bool multicastSnooping = true;
+    // Identical broadcast / multicast packets from our host within this window go out once, 0 = off
+    // Off by default: some LAN games resend discovery on purpose and count on every copy arriving
+    std::chrono::milliseconds broadcastCollapseWindow{0};
+    // Broadcast / multicast packets per second each source socket on our host may send, 0 = unlimited
+    size_t broadcastRateLimit = 0;
+    // Packets to a peer queue in a scheduler while the socket is backed up: strict priority for game traffic,
+    // fair queuing by flow for the rest; off sends everything in arrival order
+    bool sendScheduler = true;
+    // UDP packets up to this size (IP header included) count as game traffic, 0 = only ports and DSCP decide
+    size_t priorityPacketBytes = 256;
+    // Drain v2 peers' schedulers at a BBR-style pacing rate inside a congestion window learned from their acks,
+    // so we don't overrun a slow uplink ourselves; needs sendScheduler
+    bool congestionControl = true;
+    // Packets read from the TUN device waiting for the IO thread; once it's full the readers wait up to
+    // tunBackpressure for room before the drop policy applies
+    size_t tunBacklogLimit = 2048;
+    BoundedPacketQueue::DropPolicy tunBacklogDrop = BoundedPacketQueue::DropPolicy::TAIL;
+    std::chrono::microseconds tunBackpressure{10000};
+
+    // TUN queues (one reader / writer thread pair each), Linux multi-queue backend only
+    // 0 picks one queue per core
+    size_t tunQueueCount = 0;
+    // Packets waiting to be written to the TUN device, per queue; past it the oldest are dropped
+    size_t tunQueueLimit = 1024;
+    // CoDel on those queues: drop from the head once packets have waited longer than the target for a whole interval
+    std::chrono::microseconds tunCodelTarget{5000};
+    std::chrono::milliseconds tunCodelInterval{100};
+
+    static DataPathConfig loadConfig();
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "PacketBufferPool.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Where an IPv4 packet on the virtual network goes, decided from its destination address alone
+// Compiled once per session from the /24, our virtual IP and the peer set into a table indexed by the last octet,
+// classifying is then a header check and one table load, no config reads or string work per packet
+// Not thread-safe, IO thread only
+class ForwardingEngine
+{
+public:
+    enum class Action : uint8_t
+    {
+        // Malformed, or not for anyone on the virtual network
+        DROP,
+        // To the peer in peerSlot
+        UNICAST,
+        // Subnet or limited broadcast
+        BROADCAST,
+        // 224.0.0.0/4
+        MULTICAST,
+        // To our own virtual IP
+        LOCAL
+    };
+
+    struct Route
+    {
+        Action action = Action::DROP;
+        // Index into the peer table, only meaningful for UNICAST
+        uint16_t peerSlot = 0;
+    };
+
+    static constexpr size_t IPV4_MIN_HEADER = 20;
+
+    ForwardingEngine();
+
+    // New session, forgets the peers
+    void compile(uint32_t selfVirtualIp, uint32_t subnetBroadcastIp);
+    void clearPeers();
+    // Peers outside our /24 are ignored
+    void setPeerSlot(uint32_t virtualIp, uint16_t slot);
+
+    // Bounds-checked: anything that isn't a whole IPv4 header is dropped
+    Route classify(const uint8_t* packet, size_t size) const;
+    // Same, for a burst, routes[i] belongs to packets[i]
+    void classifyBatch(const PacketHandle* packets, size_t count, Route* routes) const;
+
+private:
+    Route routeFor(uint32_t dstIp) const;
+
+    uint32_t subnet = 0;
+    uint32_t selfVirtualIp = 0;
+    uint32_t subnetBroadcastIp = 0;
+    std::array<Route, 256> octetRoutes;
+};
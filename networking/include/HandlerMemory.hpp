@@ -0,0 +1,132 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Recycles the memory asio allocates for our data path completion handlers (sends, receives, posts)
+// asio's own per-thread cache only holds one block, so as soon as two ops of different sizes alternate
+// (receive completion, then an ACK send) every op goes to the heap again
+// Blocks are a fixed size, bigger requests fall through to operator new
+class HandlerMemory
+{
+public:
+    static constexpr size_t BLOCK_SIZE = 512;
+
+    ~HandlerMemory()
+    {
+        for (void* block : freeBlocks)
+            ::operator delete(block);
+    }
+
+    void* allocate(size_t size)
+    {
+        if (size > BLOCK_SIZE)
+            return ::operator new(size);
+
+        {
+            std::lock_guard<std::mutex> lock(memoryMutex);
+            if (!freeBlocks.empty())
+            {
+                void* block = freeBlocks.back();
+                freeBlocks.pop_back();
+                return block;
+            }
+            blocksAllocated++;
+        }
+        return ::operator new(BLOCK_SIZE);
+    }
+
+    void deallocate(void* pointer, size_t size)
+    {
+        if (size > BLOCK_SIZE)
+        {
+            ::operator delete(pointer);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(memoryMutex);
+        // Grow the list once up front instead of a few elements at a time
+        if (freeBlocks.capacity() == freeBlocks.size())
+            freeBlocks.reserve(std::max<size_t>(64, freeBlocks.capacity() * 2));
+        freeBlocks.push_back(pointer);
+    }
+
+    size_t getBlocksAllocated() const
+    {
+        std::lock_guard<std::mutex> lock(memoryMutex);
+        return blocksAllocated;
+    }
+
+private:
+    mutable std::mutex memoryMutex;
+    std::vector<void*> freeBlocks;
+    size_t blocksAllocated = 0;
+};
+
+// Allocator handed to asio through the handler's allocator_type
+// Holds the memory by shared_ptr, ops still queued in the io_context may outlive their owner
+template <typename T>
+class HandlerAllocator
+{
+public:
+    using value_type = T;
+
+    explicit HandlerAllocator(std::shared_ptr<HandlerMemory> memory) noexcept : memory(std::move(memory)) {}
+
+    template <typename U>
+    HandlerAllocator(const HandlerAllocator<U>& other) noexcept : memory(other.memory) {}
+
+    T* allocate(size_t count) const
+    {
+        return static_cast<T*>(memory->allocate(sizeof(T) * count));
+    }
+
+    void deallocate(T* pointer, size_t count) const
+    {
+        memory->deallocate(pointer, sizeof(T) * count);
+    }
+
+    template <typename U>
+    bool operator==(const HandlerAllocator<U>& other) const noexcept { return memory == other.memory; }
+    template <typename U>
+    bool operator!=(const HandlerAllocator<U>& other) const noexcept { return memory != other.memory; }
+
+private:
+    template <typename> friend class HandlerAllocator;
+    std::shared_ptr<HandlerMemory> memory;
+};
+
+// Wraps a completion handler so asio allocates its op from a HandlerMemory
+template <typename Handler>
+class AllocHandler
+{
+public:
+    using allocator_type = HandlerAllocator<Handler>;
+
+    AllocHandler(const std::shared_ptr<HandlerMemory>& memory, Handler handler)
+        : memory(memory), handler(std::move(handler)) {}
+
+    allocator_type get_allocator() const noexcept { return allocator_type(memory); }
+
+    template <typename... Args>
+    void operator()(Args&&... args)
+    {
+        handler(std::forward<Args>(args)...);
+    }
+
+private:
+    std::shared_ptr<HandlerMemory> memory;
+    Handler handler;
+};
+
+template <typename Handler>
+AllocHandler<std::decay_t<Handler>> makeAllocHandler(const std::shared_ptr<HandlerMemory>& memory, Handler&& handler)
+{
+    return AllocHandler<std::decay_t<Handler>>(memory, std::forward<Handler>(handler));
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// Power-of-two bucket histogram, bucket i counts values in [2^(i-1), 2^i), bucket 0 counts zeros
+// Not thread-safe, meant to be owned by whatever thread records into it
+class Log2Histogram
+{
+public:
+    static constexpr size_t BUCKETS = 16;
+
+    void record(uint64_t value)
+    {
+        size_t bucket = 0;
+        while (value != 0 && bucket < BUCKETS - 1)
+        {
+            value >>= 1;
+            bucket++;
+        }
+        counts[bucket]++;
+        total++;
+    }
+
+    uint64_t count(size_t bucket) const { return counts[bucket]; }
+    uint64_t totalCount() const { return total; }
+
+    // Lower bound of the bucket, for printing
+    static uint64_t bucketFloor(size_t bucket) { return bucket == 0 ? 0 : (1ull << (bucket - 1)); }
+
+    void reset()
+    {
+        counts = {};
+        total = 0;
+    }
+
+    // Compact "floor:count" list of the non-empty buckets, e.g. "1:120 2:40 16:3"
+    std::string toString() const
+    {
+        std::string result;
+        for (size_t i = 0; i < BUCKETS; i++)
+        {
+            if (counts[i] == 0)
+                continue;
+            if (!result.empty())
+                result += ' ';
+            result += std::to_string(bucketFloor(i)) + ":" + std::to_string(counts[i]);
+        }
+        return result.empty() ? "-" : result;
+    }
+
+private:
+    std::array<uint64_t, BUCKETS> counts{};
+    uint64_t total = 0;
+};
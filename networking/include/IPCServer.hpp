@@ -1,7 +1,7 @@
 #pragma once
 
 #include "SystemStateManager.hpp"
-#include "NetworkConfigManager.hpp"
+#include "interfaces/INetworkConfigManager.hpp"
 #include "interfaces/IIPCServer.hpp"
 #include <grpcpp/grpcpp.h>
 #include "peerbridge.grpc.pb.h"
@@ -54,6 +54,12 @@ public:
         const peerbridge::GetConnectionStatusRequest*,
         peerbridge::GetConnectionStatusResponse*) override;
 
+    // RPC method implementation for SetPortPriorities
+    grpc::Status SetPortPriorities(
+        grpc::ServerContext*,
+        const peerbridge::SetPortPrioritiesRequest*,
+        peerbridge::SetPortPrioritiesResponse*) override;
+
 private:
     std::unique_ptr<grpc::Server> server;
 
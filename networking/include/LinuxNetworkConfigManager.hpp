@@ -0,0 +1,36 @@
+#pragma once
+
+#include "interfaces/INetworkConfigManager.hpp"
+#include <string>
+#include <vector>
+
+// Addressing, routing and firewall setup for the /dev/net/tun device on Linux
+// Drives iproute2 and iptables the way the Windows manager drives netsh, so both need CAP_NET_ADMIN
+// Commands are spawned with an argument vector, never through a shell
+// Not thread-safe, P2PSystem calls it from its control thread only
+class LinuxNetworkConfigManager : public INetworkConfigManager
+{
+public:
+    LinuxNetworkConfigManager();
+
+    bool configureInterface(const ConnectionConfig&) override;
+    bool setupRouting(const ConnectionConfig&) override;
+    void setupFirewall() override;
+
+    void resetInterfaceConfiguration(const std::vector<std::string>&) override;
+    bool removeRouting(const std::vector<std::string>&) override;
+    void removeFirewall() override;
+
+    void setNarrowAlias(const std::string&) override;
+
+    SetupConfig getSetupConfig() override;
+
+private:
+    RouteConfigApproach routeApproach = RouteConfigApproach::GENERIC_ROUTE;
+    std::string narrowAlias;
+    SetupConfig setupConfig;
+
+    int maskBits() const;
+    bool setForwarding(bool enabled);
+    bool executeCommand(const std::vector<std::string>& args);
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "interfaces/ITunInterface.hpp"
+#include "TunWriteQueue.hpp"
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// /dev/net/tun backend for Linux hosts
+// Opens the device with IFF_MULTI_QUEUE, every queue gets its own reader and writer thread
+// Readers block in epoll instead of polling, writers sleep only when their queue is empty
+// Packets for the device go through a lock-free ring into a bounded CoDel queue per writer,
+// so senders never wait on a writer and a slow device drops instead of building delay
+// In busy-poll mode readers and writers spin for a while before they sleep, trading CPU for wakeup latency
+class LinuxTunInterface : public ITunInterface
+{
+public:
+    // 0 picks one queue per core, capped at MAX_QUEUES
+    // Packets are read straight into buffers from the pool, a private one is created if null
+    // A busy-poll budget above 0 has every reader and writer spin that long for packets before it sleeps
+    explicit LinuxTunInterface(size_t = 0, std::shared_ptr<PacketBufferPool> = nullptr,
+        CoDelQueue::Parameters = CoDelQueue::Parameters(),
+        std::chrono::microseconds busyPoll = std::chrono::microseconds(0));
+    ~LinuxTunInterface();
+
+    bool initialize(const std::string&) override;
+
+    bool startPacketProcessing() override;
+    void stopPacketProcessing() override;
+
+    // Add a packet to the injection queue of its flow, it's written to the device straight from the handle
+    bool sendPacket(PacketHandle) override;
+
+    void setPacketCallback(PacketCallback callback) override;
+
+    bool isRunning() const override;
+    CoDelQueue::Stats getQueueStats() const override;
+    BusyPoller::Stats getBusyPollStats() const override;
+
+    void close() override;
+
+    // Kernel-assigned interface name, e.g. "PeerBridge" or "tun0"
+    std::string getNarrowAlias() const override;
+
+    size_t getQueueCount() const;
+
+    static constexpr size_t MAX_QUEUES = 16;
+    // Most packets a writer takes off its queue per wakeup
+    static constexpr size_t WRITE_BATCH_RESERVE = 256;
+    // Writers warn about drops at most this often
+    static constexpr std::chrono::seconds DROP_REPORT_INTERVAL{10};
+
+private:
+    struct Queue
+    {
+        Queue(CoDelQueue::Parameters parameters, std::chrono::microseconds busyPoll)
+            : outgoingPackets(parameters, busyPoll),
+              readerPoller(busyPoll)
+        {
+        }
+
+        int fd = -1;
+        int epollFd = -1;
+        std::thread readerThread;
+        std::thread writerThread;
+
+        // The writer takes a batch at a time, CoDel judges each packet as it leaves
+        TunWriteQueue outgoingPackets;
+        BusyPoller readerPoller;
+    };
+
+    bool openQueue(Queue&, const std::string&);
+    bool setInterfaceUp();
+    void readerThreadFunc(Queue&);
+    void writerThreadFunc(Queue&);
+
+    // Same flow -> same queue, so packets of one flow are never reordered between writers
+    size_t selectQueue(const PacketHandle&) const;
+
+    size_t queueCount;
+    CoDelQueue::Parameters queueParameters;
+    std::chrono::microseconds busyPoll;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::string interfaceName;
+    // Device MTU, the size of the buffers reads land in
+    size_t maxPacketSize = 1500;
+
+    // State management
+    std::atomic<bool> running{false};
+    // Wakes the readers out of epoll_wait on shutdown
+    int stopEventFd = -1;
+
+    // Callback for received packets, may be called from several reader threads at once
+    PacketCallback packetCallback;
+    std::shared_ptr<PacketBufferPool> packetPool;
+};
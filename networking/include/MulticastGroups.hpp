@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+// IGMP snooping for the virtual network: which peers' hosts joined which multicast group
+// Learned from the IGMP v1 / v2 / v3 reports and leaves the peers' hosts send through the tunnel, refreshed by the
+// general queries every member puts into its own TUN, so multicast only goes to the peers that asked for it
+// Members are keyed by the last octet of their virtual IP, like ForwardingEngine
+// Not thread-safe, IO thread only
+class MulticastGroups
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Members = std::bitset<256>;
+
+    struct Counters
+    {
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+        // Datagrams that went to members
+        uint64_t datagrams = 0;
+        // Peers that didn't get one because they aren't members
+        uint64_t skipped = 0;
+    };
+
+    struct Group
+    {
+        Members members;
+        std::array<Clock::time_point, 256> expires{};
+        Counters counters;
+    };
+
+    // RFC 2236 defaults: query interval, and membership interval = robustness (2) x query interval + response time
+    static constexpr std::chrono::seconds QUERY_INTERVAL{125};
+    static constexpr std::chrono::seconds MEMBERSHIP_TIMEOUT{260};
+    // Groups we keep, with their counters, once a member joined; joins past this are ignored
+    static constexpr size_t MAX_GROUPS = 256;
+    // Router-alert IPv4 header + IGMPv2 general query
+    static constexpr size_t QUERY_SIZE = 24 + 8;
+
+    static bool isIgmp(const uint8_t* packet, size_t size);
+    // 224.0.0.0/24: routing protocols, mDNS, LLMNR... hosts don't reliably report these, they go everywhere (RFC 4541)
+    static bool isLinkLocal(uint32_t group) { return (group & 0xFFFFFF00) == 0xE0000000; }
+
+    // Applies a report or leave from the host at `octet`, false if the packet isn't one
+    bool snoop(const uint8_t* packet, size_t size, uint8_t octet, Clock::time_point now);
+    // Drops memberships past MEMBERSHIP_TIMEOUT, and those of hosts no longer in `present`
+    void expire(Clock::time_point now);
+    void retainOnly(const Members& present);
+    void clear();
+
+    // Null until a member joined the group
+    Group* find(uint32_t group);
+    const std::unordered_map<uint32_t, Group>& getGroups() const { return groups; }
+
+    // General query, from 0.0.0.0 as snooping proxies send them (RFC 4541), so the host reports all its groups
+    static void writeGeneralQuery(uint8_t* out);
+
+private:
+    void join(uint32_t group, uint8_t octet, Clock::time_point now);
+    void leave(uint32_t group, uint8_t octet);
+
+    std::unordered_map<uint32_t, Group> groups;
+};
@@ -1,23 +1,49 @@
 #pragma once
 #include "SystemStateManager.hpp"
-#include "NetworkConfigManager.hpp"
+#include "interfaces/INetworkConfigManager.hpp"
+#include "PacketBufferPool.hpp"
+#include "HandlerMemory.hpp"
+#include "DataPathConfig.hpp"
+#include "Histogram.hpp"
+#include "ReplayWindow.hpp"
+#include "CipherSuite.hpp"
+#include "CryptoWorkerPool.hpp"
+#include "AckTracker.hpp"
+#include "CongestionController.hpp"
+#include "PeerTable.hpp"
+#include "ForwardingEngine.hpp"
+#include "RelayTree.hpp"
+#include "BroadcastSuppressor.hpp"
+#include "MulticastGroups.hpp"
+#include "SendScheduler.hpp"
+#include "BusyPoller.hpp"
 #include "interfaces/INetworkModule.hpp"
 #include <memory>
 #include <atomic>
 #include <thread>
 #include <mutex>
 #include <queue>
+#include <deque>
 #include <chrono>
 #include <optional>
 #include <boost/asio.hpp>
 #include <boost/asio/executor_work_guard.hpp>
 #include <boost/asio/steady_timer.hpp>
+#ifdef __linux__
+#include "SocketShards.hpp"
+#include <sys/socket.h>
+#include <unordered_map>
+#endif
+#ifdef PB_IO_URING
+#include "UringTransport.hpp"
+#endif
 
 // Helper class for peer connection information
 class PeerConnectionInfo
 {
 public:
     using SharedKey = std::array<uint8_t, crypto_box_BEFORENMBYTES>;
+    using Strand = boost::asio::strand<boost::asio::io_context::executor_type>;
 
     PeerConnectionInfo();
     PeerConnectionInfo(const boost::asio::ip::udp::endpoint&);
@@ -39,12 +65,82 @@ public:
     
     // Access shared key for encryption
     const SharedKey& getSharedKey() const;
+
+    // Wire protocol we send the peer, 1 until its hole-punch packets advertise more
+    void setProtocolVersion(uint8_t);
+    uint8_t getProtocolVersion() const;
+    // A v2 packet from the peer authenticated, so it really speaks v2: hole punches can't change the version
+    // any more and v1 messages from it are replays
+    void confirmProtocolVersion();
+    bool isProtocolVersionConfirmed() const;
+
+    // Which side we are decides the direction keys and nonces, derives the v2 cipher keys
+    void setLocalIsLower(bool);
+    bool isLocalLower() const;
+    const std::shared_ptr<const PeerCipher>& getCipher() const;
+    // Suite our v2 messages to the peer are sealed with, XSalsa20 until the peer's SUITES packet picks another
+    void setCipherSuite(CipherSuite);
+    CipherSuite getCipherSuite() const;
+    // Our v2 packet counter towards this peer
+    uint64_t nextTxCounter();
+
+    // Receive side state for the peer's current v2 session
+    uint32_t getPeerSessionId() const;
+    void setPeerSessionId(uint32_t);
+    ReplayWindow& getReplayWindow();
+
+    // Ordered crypto streams towards / from the peer, unset when crypto runs inline
+    void setCryptoFlows(std::shared_ptr<CryptoFlow> tx, std::shared_ptr<CryptoFlow> rx);
+    const std::shared_ptr<CryptoFlow>& getTxFlow() const;
+    const std::shared_ptr<CryptoFlow>& getRxFlow() const;
+    // The peer's crypto on the IO threads instead, in order; unset with crypto workers or a single IO thread
+    void setStrand(std::shared_ptr<Strand>);
+    Strand* getStrand() const;
+
+    // v2 acks both ways, RTT and loss towards the peer
+    AckTracker& getAckTracker();
+    const AckTracker& getAckTracker() const;
+    // Pacing and window for our v2 data to the peer, fed by its acks
+    CongestionController& getCongestionController();
+    const CongestionController& getCongestionController() const;
+
+    // Group key the peer seals its broadcasts with, key id = its session, null for any other id
+    void setPeerGroupKey(uint32_t keyId, const GroupCipher::Key&);
+    const GroupCipher* getPeerGroupCipher(uint32_t keyId) const;
+    ReplayWindow& getGroupReplayWindow();
+    // The peer confirmed it holds our group key with this id
+    void setGroupKeyConfirmed(uint32_t keyId);
+    bool hasConfirmedGroupKey(uint32_t keyId) const;
+
+    // Our packets for the peer waiting for the uplink
+    SendScheduler& getSendScheduler();
+    const SendScheduler& getSendScheduler() const;
     
 private:
     std::chrono::steady_clock::time_point lastActivity;
     bool connected;
     boost::asio::ip::udp::endpoint peerEndpoint;
     SharedKey sharedKey;
+
+    uint8_t protocolVersion = 1;
+    bool protocolVersionConfirmed = false;
+    bool localIsLower = false;
+    // Replaced, never modified, packets still in the crypto workers keep the old keys
+    std::shared_ptr<const PeerCipher> cipher = std::make_shared<PeerCipher>();
+    CipherSuite cipherSuite = CipherSuite::XSALSA20_POLY1305;
+    uint64_t txCounter = 0;
+    uint32_t peerSessionId = 0;
+    ReplayWindow replayWindow;
+    std::shared_ptr<CryptoFlow> txFlow;
+    std::shared_ptr<CryptoFlow> rxFlow;
+    std::shared_ptr<Strand> strand;
+    AckTracker ackTracker;
+    CongestionController congestionController;
+    uint32_t peerGroupKeyId = 0;
+    GroupCipher peerGroupCipher;
+    ReplayWindow groupReplayWindow;
+    uint32_t confirmedGroupKeyId = 0;
+    SendScheduler sendScheduler;
 };
 
 
@@ -61,14 +157,37 @@ public:
         HEARTBEAT = 0x02,
         MESSAGE = 0x03,
         ACK = 0x04,
-        DISCONNECT = 0x05
+        DISCONNECT = 0x05,
+        // v2 framing, pairwise-sealed: hands our group key to a peer, or confirms we hold theirs
+        GROUP_KEY = 0x06,
+        // v2 framing, broadcast / multicast sealed once with the sender's group key
+        GROUP_MESSAGE = 0x07,
+        // v2 framing, pairwise-sealed: the suites we can open and the one we prefer, confirms the hole punch's hint
+        SUITES = 0x08
+    };
+
+    // Broadcast / multicast fan-out from the TUN, one seal per datagram without a group key
+    struct FanoutStats
+    {
+        uint64_t packets = 0;
+        uint64_t datagrams = 0;
+        uint64_t groupSeals = 0;
+        uint64_t pairwiseSeals = 0;
+        // Plaintext copies for peers sealed one by one
+        uint64_t copies = 0;
+        // Datagrams we forwarded down other peers' relay trees
+        uint64_t relayed = 0;
+        // Multicast to groups no peer joined, not sent at all
+        uint64_t multicastUnjoined = 0;
     };
     
     UDPNetwork(
         std::unique_ptr<boost::asio::ip::udp::socket>,
         boost::asio::io_context&,
         std::shared_ptr<ISystemStateManager>,
-        std::shared_ptr<INetworkConfigManager>);
+        std::shared_ptr<INetworkConfigManager>,
+        std::shared_ptr<PacketBufferPool> = nullptr,
+        const DataPathConfig& = DataPathConfig());
     ~UDPNetwork();
     
     // Setup and connection
@@ -85,19 +204,47 @@ public:
     bool isConnected() const override;
     
     // Async operations, sending to peer, queued by TUNInterface
-    void processPacketFromTun(const std::vector<uint8_t>&) override;
+    // The packet is encrypted in place and framed inside its own headroom when it's the only reference to the buffer
+    void processPacketFromTun(PacketHandle) override;
+    void processPacketsFromTun(PacketHandle* packets, size_t count) override;
     bool sendMessage(
-        const std::vector<uint8_t>& data,
+        PacketHandle data,
         const boost::asio::ip::udp::endpoint& peerEndpoint,
         const std::array<uint8_t, crypto_box_BEFORENMBYTES>& sharedKey) override;
     void setMessageCallback(MessageCallback callback) override;
+    // Replaces the whole table, kept across connections, IO thread
+    void setPortPriorities(const PortPriorities&) override;
     
     // Get local information
     // int getLocalPort() const;
     // std::string getLocalAddress() const;
 
-    // External handle to IOContext
-    boost::asio::io_context& getIOContext() override;
+    // The network strand, everything below that isn't marked otherwise runs on it
+    boost::asio::any_io_executor getExecutor() override;
+
+    // Packet buffers shared by the whole data path
+    std::shared_ptr<PacketBufferPool> getPacketPool() const;
+
+    // Batch size histograms for recvmmsg / sendmmsg, only touched on the IO thread
+    const Log2Histogram& getRxBatchHistogram() const;
+    const Log2Histogram& getTxBatchHistogram() const;
+
+    // Outgoing payloads that had to be copied before encryption (shared buffer or no headroom), IO thread only
+    uint64_t getTxCopyCount() const;
+    uint64_t getReplayDropCount() const;
+    // v2 packets, sent or received, dropped because their crypto flow or the worker queue was full
+    uint64_t getCryptoDropCount() const;
+    // Outgoing data dropped because SEND_BACKLOG_LIMIT datagrams were already on their way
+    uint64_t getTxBacklogDropCount() const;
+    // Datagrams too big for a receive slab, dropped by whichever receive path got them
+    uint64_t getTruncatedDropCount() const;
+    // 0 when v2 crypto runs inline on the IO thread
+    size_t getCryptoWorkerCount() const;
+    const FanoutStats& getFanoutStats() const;
+    const MulticastGroups& getMulticastGroups() const;
+    const BroadcastSuppressor::Stats& getBroadcastSuppressionStats() const;
+    // Sockets receiving on our port, 1 unless sharded
+    size_t getSocketShardCount() const;
 
 private:
 
@@ -106,13 +253,96 @@ private:
     void handleReceiveFrom(
         const boost::system::error_code&,
         std::size_t, 
-        std::shared_ptr<std::vector<uint8_t>>, 
-        std::shared_ptr<boost::asio::ip::udp::endpoint>);
+        PacketHandle);
+    // authenticated: a v2 MESSAGE / ACK a socket shard already opened
     void processReceivedData(
         std::size_t, 
-        std::shared_ptr<std::vector<uint8_t>>, 
-        std::shared_ptr<boost::asio::ip::udp::endpoint>);
-    void deliverPacketToTun(const std::vector<uint8_t>);
+        PacketHandle,
+        const boost::asio::ip::udp::endpoint&,
+        bool authenticated = false);
+    void processMessageV2(
+        PacketHandle,
+        std::size_t,
+        PeerConnectionInfo&,
+        const boost::asio::ip::udp::endpoint&,
+        bool authenticated);
+    // Replay check, ack processing and delivery of an authenticated v2 message, IO thread
+    void acceptMessageV2(PacketHandle, PeerConnectionInfo&, uint32_t sessionId, uint64_t counter);
+    // A session of the peer's we already left behind, its packets are recordings
+    bool isPastPeerSession(const PeerConnectionInfo&, uint32_t sessionId) const;
+    // Authenticated v2 broadcast / multicast from a peer, opened with the group key it gave us
+    void processGroupMessage(PacketHandle, std::size_t, PeerConnectionInfo&, const boost::asio::ip::udp::endpoint&);
+    // Offer or confirmation that authenticated in the peer's current session
+    void handleGroupKey(const uint8_t*, std::size_t, PeerConnectionInfo&);
+    // The peer's suites, authenticated in its current session; the only thing that changes our suite towards it
+    void handleSuites(const uint8_t*, std::size_t, PeerConnectionInfo&);
+    // Peer slots move when peers go away, call after every change to the peer table
+    void updateForwarding();
+    void createCryptoFlows(PeerTable<PeerConnectionInfo>::Key peerKey, PeerConnectionInfo&);
+    // Finished crypto from a worker or a peer strand, called in order per peer; moves the rest onto the network strand
+    void handleSealed(CryptoJob&, const boost::asio::ip::udp::endpoint&);
+    void handleOpened(CryptoJob&, PeerTable<PeerConnectionInfo>::Key);
+    // `sender` is the peer the packet came from, for group messages the key's owner rather than who relayed it
+    void deliverPacketToTun(PacketHandle, const PeerConnectionInfo& sender);
+
+    // Framing / encryption of outgoing MESSAGEs, picks the wire version the peer agreed on
+    bool sendToPeer(PacketHandle, PeerConnectionInfo&);
+    // Unicast from the TUN goes through the peer's SendScheduler, drained round-robin over the peers
+    // while the datagrams already on their way stay under SEND_BACKLOG_LIMIT
+    // v2 peers are also held to their CongestionController, the pacing timer picks them up when it lets them
+    void queueToPeer(PacketHandle, PeerTable<PeerConnectionInfo>::Key, PeerConnectionInfo&);
+    void scheduleSendDrain();
+    void drainSendQueues();
+    void schedulePacingTimer(std::chrono::steady_clock::time_point);
+    void releaseTxBacklog();
+    // Sends that can't wait in a SendScheduler (broadcast, relaying, unicast with the scheduler off) go only
+    // while the backlog has room, otherwise they're dropped and counted
+    bool admitToTxBacklog();
+    bool sendMessageV1(
+        PacketHandle,
+        const boost::asio::ip::udp::endpoint&,
+        const std::array<uint8_t, crypto_box_BEFORENMBYTES>&);
+    bool sendMessageV2(PacketHandle, PeerConnectionInfo&, PacketType = PacketType::MESSAGE);
+    // Ack-only v2 packet, when no data is going to the peer to carry the ack
+    void sendAckV2(PeerConnectionInfo&);
+    // A TUN packet along the route the forwarding engine picked for it
+    void routeFromTun(PacketHandle, const ForwardingEngine::Route&);
+    // Broadcast / multicast: one group-sealed datagram shared by the peers holding our key, pairwise for the rest
+    // With members given, only to those peers
+    void fanOutToPeers(PacketHandle, const MulticastGroups::Members* = nullptr);
+    bool usesGroupKey(const PeerConnectionInfo&) const;
+    std::vector<RelayTree::Member> groupKeyHolders(const MulticastGroups::Members*) const;
+    void forwardMulticast(PacketHandle);
+    // General query into our TUN, our host answers with reports for its groups that the peers snoop
+    void queryLocalMemberships();
+    void sendGroupKey(PeerConnectionInfo&, uint8_t kind, uint32_t keyId);
+    void sendSuites(PeerConnectionInfo&, uint8_t kind);
+    void scheduleAckTimer();
+    void handleAckTimer();
+    // Makes sure the packet can be framed in place, copies it once if it can't
+    bool prepareForFraming(PacketHandle&, size_t);
+
+    // Outgoing data datagrams, batched into sendmmsg on Linux
+    void transmitDatagram(PacketHandle, const boost::asio::ip::udp::endpoint&, uint32_t);
+    void sendDatagramAsync(PacketHandle, const boost::asio::ip::udp::endpoint&, uint32_t);
+    void scheduleTxFlush();
+    void flushTxBatch();
+
+    #ifdef __linux__
+    // Batched receive, drains up to ioBatchSize datagrams per wakeup with recvmmsg
+    void startBatchedReceive();
+    void handleBatchedReceive(const boost::system::error_code&);
+    // More sockets on our port, each received on its own thread, false leaves everything to the IO thread
+    bool startSocketShards();
+    // Shard thread: opens the v2 messages of the shard's peers, hands the batch to the IO thread
+    void openOnShard(size_t shard, std::vector<SocketShards::Datagram>&);
+    // Gives every shard the receive keys of the peers steered to it, after every change to the peer table
+    void publishShardPeers();
+    #endif
+    #ifdef PB_IO_URING
+    // Moves the socket's I/O onto io_uring, false leaves it to asio
+    bool startUring();
+    #endif
     void handleSendComplete(
         const boost::system::error_code&,
         std::size_t, uint32_t,
@@ -137,12 +367,42 @@ private:
 
     // Custom header
     uint32_t attachCustomHeader(
-        const std::shared_ptr<std::vector<uint8_t>>&,
+        uint8_t*,
         PacketType,
         std::optional<uint32_t> = std::nullopt);
+    // Zeroed 16-byte v1 packet with just the header (hole-punch, disconnect)
+    PacketHandle makeControlPacket(PacketType, std::optional<uint32_t> = std::nullopt);
     
     // Constants
     static constexpr size_t MAX_PACKET_SIZE = 65507;
+    // Custom header (16 bytes) + nonce (24 bytes) + MAC (16 bytes) in front of every MESSAGE payload
+    static constexpr size_t MESSAGE_OVERHEAD = 16 + crypto_box_NONCEBYTES + crypto_box_MACBYTES;
+    static_assert(MESSAGE_OVERHEAD <= PacketBufferPool::DEFAULT_HEADROOM, "TUN headroom too small for MESSAGE framing");
+
+    // Protocol v2: data, acks, group keys and suites; hole punches, heartbeats and disconnects stay v1
+    // Header: (version << 4 | type) (1) + suite / flags (1) + sender session id (4) + packet counter (8), then MAC (16) + ciphertext
+    // The nonce isn't sent, both sides derive it from direction, session id and counter
+    // With V2_ACK_FLAG set the plaintext starts with an AckBlock, an ACK packet is just that
+    // v1 packets start with the magic number, whose top nibble is 1, so the first byte tells them apart
+    static constexpr uint8_t PROTOCOL_VERSION_V2 = 2;
+    static constexpr size_t V2_HEADER_SIZE = 14;
+    static constexpr size_t V2_MESSAGE_OVERHEAD = V2_HEADER_SIZE + crypto_box_MACBYTES;
+    static constexpr uint8_t V2_SUITE_MASK = 0x7F;
+    static constexpr uint8_t V2_ACK_FLAG = 0x80;
+    // GROUP_MESSAGE only: a RelayTree follows the header and is authenticated with it
+    static constexpr uint8_t V2_RELAY_FLAG = 0x40;
+    static_assert(V2_MESSAGE_OVERHEAD + AckBlock::SIZE <= PacketBufferPool::DEFAULT_HEADROOM, "TUN headroom too small for v2 framing with an ack");
+    // GROUP_KEY plaintext: kind (1) + key id (4) + key (32, zero in a confirmation)
+    static constexpr uint8_t GROUP_KEY_OFFER = 1;
+    static constexpr uint8_t GROUP_KEY_CONFIRM = 2;
+    static constexpr size_t GROUP_KEY_PAYLOAD_SIZE = 1 + 4 + sizeof(GroupCipher::Key);
+    // SUITES plaintext: kind (1) + suites we can open (1) + suite we prefer (1), an offer wants the peer's back
+    static constexpr uint8_t SUITES_OFFER = 1;
+    static constexpr uint8_t SUITES_ANSWER = 2;
+    static constexpr size_t SUITES_PAYLOAD_SIZE = 3;
+    // Datagrams on the crypto workers or waiting on the socket before the schedulers hold on to the rest,
+    // so the queue builds where it can still be reordered rather than in the kernel; data nobody can queue is dropped
+    static constexpr size_t SEND_BACKLOG_LIMIT = 64;
     static constexpr uint16_t PROTOCOL_VERSION = 1;
     static constexpr uint32_t MAGIC_NUMBER = 0x12345678;
 
@@ -153,18 +413,106 @@ private:
     // ASIO and IO context objects
     std::unique_ptr<boost::asio::ip::udp::socket> socket;
     boost::asio::io_context& ioContext;
-    std::thread ioThread;
+    // Serializes the handlers touching our state, so ioContext can run on several threads (config.ioThreads)
+    PeerConnectionInfo::Strand networkStrand;
+    std::vector<std::thread> ioThreads;
+    // One per IO thread, they spin on the io_context before blocking when config.busyPollBudget is set
+    std::vector<std::unique_ptr<BusyPoller>> ioPollers;
+    // Busy-poll totals at the last keep-alive report, for the CPU share since then
+    BusyPoller::Stats reportedBusyPoll;
+    std::chrono::steady_clock::time_point lastBusyPollReport;
     boost::asio::steady_timer keepAliveTimer;
+
+    // Pooled packet buffers, one receive is outstanding at a time so the sender endpoint can live here
+    std::shared_ptr<PacketBufferPool> packetPool;
+    boost::asio::ip::udp::endpoint receiveEndpoint;
+    // Op memory for the per-packet sends / receives, see HandlerMemory
+    std::shared_ptr<HandlerMemory> handlerMemory = std::make_shared<HandlerMemory>();
+
+    // Batched datagram I/O
+    struct PendingDatagram
+    {
+        PacketHandle packet;
+        boost::asio::ip::udp::endpoint endpoint;
+        uint32_t seq;
+    };
+    DataPathConfig config;
+    bool batchedIoActive = false;
+    std::vector<PendingDatagram> txBatch;
+    bool txFlushScheduled = false;
+    boost::asio::steady_timer txFlushTimer;
+    Log2Histogram rxBatchSizes;
+    // Datagrams too big for a receive slab, dropped by the recvmmsg path
+    uint64_t rxTruncated = 0;
+    Log2Histogram txBatchSizes;
+    uint64_t txCopies = 0;
+    // v2 packets dropped by the replay window
+    uint64_t replayDrops = 0;
+    // v2 packets the crypto workers had no room for
+    uint64_t cryptoDrops = 0;
+    // Suite we ask peers for, configured or the fastest one measured on this host
+    CipherSuite preferredSuite = CipherSuite::XSALSA20_POLY1305;
+    // Our v2 session, picked at random on every startConnection so counters can start over
+    uint32_t localSessionId = 0;
+    // Every session a peer's packets authenticated in, by pairwise key and kept across startConnection:
+    // the key pair lives as long as the process, so packets recorded in an earlier session still open
+    std::map<PeerConnectionInfo::SharedKey, std::vector<uint32_t>> peerSessionHistory;
+    // Our group key, new with every session and identified by it, and its own counter
+    GroupCipher groupCipher;
+    uint64_t groupTxCounter = 0;
+    // Relay tree over the peers holding our group key, rebuilt when they or their RTTs change
+    RelayTree relayTree;
+    bool relayTreeStale = true;
+    MulticastGroups multicastGroups;
+    std::chrono::steady_clock::time_point lastMulticastQuery;
+    BroadcastSuppressor broadcastSuppressor;
+    PortPriorities portPriorities;
+    // Peers with packets in their SendScheduler, in drain order
+    std::deque<PeerTable<PeerConnectionInfo>::Key> backloggedPeers;
+    bool sendDrainScheduled = false;
+    size_t txBacklog = 0;
+    uint64_t txBacklogDrops = 0;
+    // Wakes the drain when the first paced peer may send again
+    boost::asio::steady_timer pacingTimer;
+    bool pacingTimerScheduled = false;
+    std::chrono::steady_clock::time_point pacingTimerAt;
+    FanoutStats fanoutStats;
+    #ifdef __linux__
+    std::vector<PacketHandle> rxBuffers;
+    std::vector<mmsghdr> rxMessages;
+    std::vector<iovec> rxIovecs;
+    std::vector<sockaddr_storage> rxAddresses;
+    std::vector<mmsghdr> txMessages;
+    std::vector<iovec> txIovecs;
+    // Per shard, the keys its thread opens v2 messages with, replaced whole under the mutex
+    using ShardCiphers = std::unordered_map<PeerTable<PeerConnectionInfo>::Key, std::shared_ptr<const PeerCipher>>;
+    struct ShardPeers
+    {
+        std::mutex mutex;
+        std::shared_ptr<const ShardCiphers> ciphers;
+    };
+    std::vector<std::unique_ptr<ShardPeers>> shardPeers;
+    // Null unless sharded, its threads use shardPeers and post into ioContext, stopped first in shutdown()
+    std::unique_ptr<SocketShards> socketShards;
+    #endif
+    #ifdef PB_IO_URING
+    // Set while io_uring carries the socket's I/O, sends queue in its ring instead of txBatch
+    std::unique_ptr<UringTransport> uring;
+    #endif
     
-    // Ack tracking
+    // v1 header sequence numbers, only used in logs
     std::atomic<uint32_t> nextSeqNumber;
-    std::unordered_map<uint32_t, std::chrono::time_point<std::chrono::steady_clock>> pendingAcks;
-    std::mutex pendingAcksMutex;
+    // One timer for every peer's delayed acks
+    boost::asio::steady_timer ackTimer;
+    bool ackTimerScheduled = false;
     
     // Peer connection management
-    std::map<uint32_t, std::pair<std::uint32_t, int>> virtualIpToPublicIp;
-    std::map<uint32_t, PeerConnectionInfo> publicIpToPeerConnection;
+    PeerTable<PeerConnectionInfo> peers;
     uint32_t selfVirtualIp;
+    // Routes TUN packets to peer slots, recompiled whenever the peer table changes
+    ForwardingEngine forwarding;
+    // Routes of the TUN burst being processed
+    std::array<ForwardingEngine::Route, 64> tunRoutes;
     
     // State manager for event queuing
     std::shared_ptr<ISystemStateManager> stateManager;
@@ -173,6 +521,10 @@ private:
     // Callbacks
     MessageCallback onMessageCallback;
 
+    // v2 seal / open off the IO thread, null when it runs inline
+    // Last member, its workers post back into everything above and are stopped first
+    std::unique_ptr<CryptoWorkerPool> cryptoPool;
+
 
     /* ====================================================================================================== */
 public:
@@ -183,10 +535,20 @@ public:
         PacketType t,
         std::optional<uint32_t> seq = std::nullopt)
     {
-        return attachCustomHeader(sp, t, seq);
+        return attachCustomHeader(sp->data(), t, seq);
+    }
+
+    void testSetRunning(bool value) { running = value; }
+    DataPathConfig& testConfig() { return config; }
+    // Every job submitted afterwards is rejected, as with a full queue
+    void testStopCryptoWorkers() { if (cryptoPool) cryptoPool->stop(); }
+    void testProcessReceivedData(PacketHandle packet, const boost::asio::ip::udp::endpoint& sender)
+    {
+        size_t size = packet.size();
+        processReceivedData(size, std::move(packet), sender);
     }
 
-    const auto& testVirtualToPublic() const { return virtualIpToPublicIp; }
-    const auto& testPublicToPeer()   const { return publicIpToPeerConnection; }
+    const PeerTable<PeerConnectionInfo>& testPeers() const { return peers; }
+    PeerTable<PeerConnectionInfo>& testPeers() { return peers; }
     #endif
 };
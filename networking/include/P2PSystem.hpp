@@ -1,11 +1,19 @@
 #pragma once
-#include "Stun.hpp"
+#include "stun.hpp"
 #include "IPCServer.hpp"
 #include "NetworkingModule.hpp"
+#ifdef _WIN32
 #include "TUNInterface.hpp"
 #include "NetworkConfigManager.hpp"
+#else
+#include "LinuxTunInterface.hpp"
+#include "LinuxNetworkConfigManager.hpp"
+#endif
+#include "BoundedPacketQueue.hpp"
 #include "SystemStateManager.hpp"
 #include <string>
+#include <chrono>
+#include <vector>
 #include <atomic>
 #include <thread>
 #include <mutex>
@@ -53,12 +61,29 @@ private:
     // Network discovery
     bool discoverPublicAddress();
 
+    // TUN packets onto the network io_context, a batch per handler
+    void postTunDrain();
+    void drainTunBacklog();
+
     // Initialize connection
     void initializeConnectionData(
         const NetworkEventData::SelfIndexAndPeerMap&);
 
     // Data
-    NetworkConfigManager::ConnectionConfig currentConnectionConfig;
+    INetworkConfigManager::ConnectionConfig currentConnectionConfig;
+    DataPathConfig dataPathConfig;
+    // Shared by the TUN reader and the network module, so packets flow between them without copies
+    std::shared_ptr<PacketBufferPool> packetPool;
+    // Op memory for posting TUN packets onto the network io_context, the reader threads have no asio cache of their own
+    std::shared_ptr<HandlerMemory> tunHandlerMemory;
+    // Packets from the TUN readers waiting for the IO thread, full = the readers are held back
+    std::unique_ptr<BoundedPacketQueue> tunBacklog;
+    // IO thread only
+    static constexpr size_t TUN_DRAIN_BATCH = 64;
+    static constexpr std::chrono::seconds BACKLOG_REPORT_INTERVAL{10};
+    std::vector<PacketHandle> tunDrainBatch;
+    uint64_t reportedBacklogDrops = 0;
+    std::chrono::steady_clock::time_point lastBacklogReport;
 
     // TO REMOVE
     std::atomic<bool> running;
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class PacketBufferPool;
+
+// A single pooled slab, never handed out directly, always through a PacketHandle
+struct PacketBuffer
+{
+    std::atomic<uint32_t> refCount{0};
+    // Keeps the pool alive while the slab is out, reset when it goes back to the free list
+    std::shared_ptr<PacketBufferPool> owner;
+    std::unique_ptr<uint8_t[]> storage;
+    size_t capacity = 0;
+    // Start of the packet inside storage, everything before it is headroom for headers
+    size_t offset = 0;
+    size_t length = 0;
+    bool jumbo = false;
+};
+
+// Refcounted handle to a pooled slab
+// Copies are cheap (one atomic increment), so it can be captured by asio completion handlers
+// The slab goes back to its pool when the last handle is destroyed
+class PacketHandle
+{
+public:
+    PacketHandle() noexcept = default;
+    explicit PacketHandle(PacketBuffer*) noexcept;
+    PacketHandle(const PacketHandle&) noexcept;
+    PacketHandle(PacketHandle&&) noexcept;
+    PacketHandle& operator=(const PacketHandle&) noexcept;
+    PacketHandle& operator=(PacketHandle&&) noexcept;
+    ~PacketHandle();
+
+    uint8_t* data() noexcept { return buffer->storage.get() + buffer->offset; }
+    const uint8_t* data() const noexcept { return buffer->storage.get() + buffer->offset; }
+
+    size_t size() const noexcept { return buffer ? buffer->length : 0; }
+    // Room from data() to the end of the slab
+    size_t capacity() const noexcept { return buffer ? buffer->capacity - buffer->offset : 0; }
+    size_t headroom() const noexcept { return buffer ? buffer->offset : 0; }
+    bool empty() const noexcept { return size() == 0; }
+
+    // Only the holder of the last reference may modify the slab in place
+    bool unique() const noexcept { return buffer && buffer->refCount.load(std::memory_order_acquire) == 1; }
+
+    // Only changes the logical length, contents are left untouched (no zero-fill)
+    void resize(size_t) noexcept;
+
+    // Grow the packet into the headroom, e.g. to put a header in front of it without moving the payload
+    // Returns false (and changes nothing) if there isn't enough headroom
+    bool prepend(size_t) noexcept;
+    // Drop bytes from the front, they become headroom again
+    void trimFront(size_t) noexcept;
+
+    void reset() noexcept;
+    explicit operator bool() const noexcept { return buffer != nullptr; }
+
+private:
+    PacketBuffer* buffer = nullptr;
+};
+
+class PacketBufferPool : public std::enable_shared_from_this<PacketBufferPool>
+{
+public:
+    // Slabs are sized for the tunnel MTU plus our header / crypto overhead, with some slack
+    static constexpr size_t SLAB_SIZE = 2048;
+    // Fallback for anything that doesn't fit in a slab (max UDP payload, rounded up)
+    static constexpr size_t JUMBO_SIZE = 65536;
+    // Headroom reserved in front of packets read from the TUN, covers our header and crypto overhead
+    // so the datagram can be built around the packet in place
+    static constexpr size_t DEFAULT_HEADROOM = 128;
+
+    struct Stats
+    {
+        size_t slabsAllocated = 0;
+        size_t slabsInUse = 0;
+        size_t slabsHighWaterMark = 0;
+        size_t jumboAllocated = 0;
+        size_t jumboInUse = 0;
+        size_t jumboHighWaterMark = 0;
+        uint64_t acquisitions = 0;
+        // Free list was empty and a new slab had to be allocated
+        uint64_t misses = 0;
+        uint64_t jumboMisses = 0;
+        // Requests bigger than JUMBO_SIZE, these fail
+        uint64_t oversizeRequests = 0;
+    };
+
+    // Pool must be owned by a shared_ptr, slabs keep it alive while they are in flight
+    static std::shared_ptr<PacketBufferPool> create(size_t = 512, size_t = 4);
+    ~PacketBufferPool();
+
+    PacketBufferPool(const PacketBufferPool&) = delete;
+    PacketBufferPool& operator=(const PacketBufferPool&) = delete;
+
+    // Returns an empty handle if the size can't be served
+    // The second argument reserves headroom in front of data()
+    PacketHandle acquire(size_t, size_t = 0);
+
+    Stats getStats() const;
+
+private:
+    friend class PacketHandle;
+
+    PacketBufferPool(size_t, size_t);
+
+    PacketBuffer* allocateSlab(size_t, bool);
+    void release(PacketBuffer*);
+
+    mutable std::mutex poolMutex;
+    std::vector<PacketBuffer*> freeSlabs;
+    std::vector<PacketBuffer*> freeJumbo;
+    // Jumbo slabs above this count are freed instead of cached
+    size_t maxCachedJumbo;
+    Stats stats;
+};
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <boost/asio/ip/udp.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Peers of the current session, at most one per virtual IP of the /24
+// Found in O(1) by the endpoint they send from (address and port, so peers behind one NAT don't collide)
+// or by the last octet of their virtual IP, neither lookup touches strings or allocates
+// Entries are packed in one vector for the broadcast fan-out, removing one moves the last entry into its place:
+// pointers and iterators are only good until the next add / remove
+// Not thread-safe, IO thread only
+template <typename Peer>
+class PeerTable
+{
+public:
+    // IPv4 address and port, packed, 0 for endpoints that can't be a peer
+    using Key = uint64_t;
+
+    static constexpr size_t MAX_PEERS = 256;
+
+    struct Entry
+    {
+        uint32_t virtualIp = 0;
+        Key key = 0;
+        Peer peer;
+    };
+
+    PeerTable()
+    {
+        entries.reserve(MAX_PEERS);
+        clear();
+    }
+
+    static Key endpointKey(const boost::asio::ip::udp::endpoint& endpoint)
+    {
+        const boost::asio::ip::address address = endpoint.address();
+        if (!address.is_v4())
+            return 0;
+        return VALID_KEY | (static_cast<Key>(address.to_v4().to_uint()) << 16) | endpoint.port();
+    }
+
+    // Replaces whatever was at the virtual IP or the endpoint, null if the endpoint isn't IPv4
+    Peer* add(uint32_t virtualIp, const boost::asio::ip::udp::endpoint& endpoint, Peer peer)
+    {
+        Key key = endpointKey(endpoint);
+        if (key == 0)
+            return nullptr;
+
+        int previous = octetIndex[virtualIp & 0xFF];
+        if (previous != NONE)
+            removeEntry(static_cast<size_t>(previous));
+        previous = findEntry(key);
+        if (previous != NONE)
+            removeEntry(static_cast<size_t>(previous));
+
+        int index = static_cast<int>(entries.size());
+        entries.push_back({virtualIp, key, std::move(peer)});
+        octetIndex[virtualIp & 0xFF] = static_cast<int16_t>(index);
+        insertKey(key, index);
+        return &entries.back().peer;
+    }
+
+    Peer* find(Key key)
+    {
+        int index = findEntry(key);
+        return index == NONE ? nullptr : &entries[index].peer;
+    }
+
+    Peer* find(const boost::asio::ip::udp::endpoint& endpoint) { return find(endpointKey(endpoint)); }
+
+    Peer* findByVirtualIp(uint32_t virtualIp)
+    {
+        int index = octetIndex[virtualIp & 0xFF];
+        if (index == NONE || entries[index].virtualIp != virtualIp)
+            return nullptr;
+        return &entries[index].peer;
+    }
+
+    const Peer* findByVirtualIp(uint32_t virtualIp) const
+    {
+        return const_cast<PeerTable*>(this)->findByVirtualIp(virtualIp);
+    }
+
+    bool remove(const boost::asio::ip::udp::endpoint& endpoint)
+    {
+        int index = findEntry(endpointKey(endpoint));
+        if (index == NONE)
+            return false;
+        removeEntry(static_cast<size_t>(index));
+        return true;
+    }
+
+    void clear()
+    {
+        entries.clear();
+        octetIndex.fill(NONE);
+        keyIndex.fill(KeySlot());
+    }
+
+    // Entries by position, what ForwardingEngine routes to
+    Entry& operator[](size_t slot) { return entries[slot]; }
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+
+    typename std::vector<Entry>::iterator begin() { return entries.begin(); }
+    typename std::vector<Entry>::iterator end() { return entries.end(); }
+    typename std::vector<Entry>::const_iterator begin() const { return entries.begin(); }
+    typename std::vector<Entry>::const_iterator end() const { return entries.end(); }
+
+private:
+    static constexpr Key VALID_KEY = Key(1) << 48;
+    static constexpr int NONE = -1;
+    // Open addressing with linear probing, kept at most half full
+    static constexpr size_t KEY_INDEX_BITS = 9;
+    static constexpr size_t KEY_INDEX_SIZE = size_t(1) << KEY_INDEX_BITS;
+    static_assert(KEY_INDEX_SIZE >= 2 * MAX_PEERS, "endpoint index must stay at most half full");
+
+    // Key next to the entry index, a hit costs one cache line in the index and one in the entries
+    struct KeySlot
+    {
+        Key key = 0;
+        int32_t entry = NONE;
+    };
+
+    static size_t keyHome(Key key)
+    {
+        // Fibonacci hashing, the port and low address bits end up in the top bits
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> (64 - KEY_INDEX_BITS));
+    }
+
+    int findEntry(Key key) const
+    {
+        if (key == 0)
+            return NONE;
+        for (size_t slot = keyHome(key); ; slot = (slot + 1) % KEY_INDEX_SIZE)
+        {
+            const KeySlot& keySlot = keyIndex[slot];
+            if (keySlot.entry == NONE)
+                return NONE;
+            if (keySlot.key == key)
+                return keySlot.entry;
+        }
+    }
+
+    void insertKey(Key key, int entry)
+    {
+        size_t slot = keyHome(key);
+        while (keyIndex[slot].entry != NONE)
+            slot = (slot + 1) % KEY_INDEX_SIZE;
+        keyIndex[slot] = {key, entry};
+    }
+
+    void removeEntry(size_t index)
+    {
+        octetIndex[entries[index].virtualIp & 0xFF] = NONE;
+        if (index != entries.size() - 1)
+        {
+            entries[index] = std::move(entries.back());
+            octetIndex[entries[index].virtualIp & 0xFF] = static_cast<int16_t>(index);
+        }
+        entries.pop_back();
+
+        // Peers only go away on timeouts and disconnects, rebuilding beats tombstones here
+        keyIndex.fill(KeySlot());
+        for (size_t i = 0; i < entries.size(); i++)
+            insertKey(entries[i].key, static_cast<int>(i));
+    }
+
+    std::vector<Entry> entries;
+    std::array<int16_t, 256> octetIndex;
+    std::array<KeySlot, KEY_INDEX_SIZE> keyIndex;
+};
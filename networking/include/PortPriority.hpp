@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+
+// How the send scheduler treats packets from / to a port, set per game from the UI
+enum class PortPriority : uint8_t
+{
+    // Up to the scheduler: small and DSCP-marked packets go first, the rest shares the link fairly by flow
+    NORMAL,
+    // Always ahead of everything else
+    GAME,
+    // Map and mod downloads, never ahead and a quarter of a normal flow's share
+    BULK
+};
+
+using PortPriorities = std::map<uint16_t, PortPriority>;
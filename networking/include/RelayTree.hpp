@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Overlay tree a group broadcast travels down instead of the source sending it to every peer itself
+// The source lists the peers that get it, best links first, and only sends to the first `fanout` of them;
+// the peer at position i forwards to positions fanout * (i + 1) .. fanout * (i + 1) + fanout - 1
+// The list rides in the authenticated header of the datagram, so every peer sees the same tree
+// and the source can reorder it as links change or peers come and go without telling anyone
+// Wire format: fanout (1) + member count (1) + last octet of each member's virtual IP
+class RelayTree
+{
+public:
+    struct Member
+    {
+        uint8_t octet = 0;
+        // 0 = not measured yet, those end up as leaves
+        std::chrono::microseconds rtt{0};
+    };
+
+    static constexpr size_t HEADER_SIZE = 2;
+    static constexpr size_t MAX_MEMBERS = 255;
+    static constexpr size_t MAX_FANOUT = 16;
+
+    // Lowest RTT first, so the peers closest to us do the relaying; ties by octet to keep rebuilds stable
+    void build(std::vector<Member>, size_t fanout);
+    void clear();
+    size_t size() const { return order.size(); }
+    size_t encodedSize() const { return HEADER_SIZE + order.size(); }
+    void encode(uint8_t*) const;
+    // Peers the source sends to itself
+    size_t rootChildren(uint8_t* children) const;
+
+    // Size of the encoded tree at the start of `data`, 0 if it's malformed or doesn't fit in `available`
+    static size_t parse(const uint8_t* data, size_t available);
+    // Who `selfOctet` forwards to in a parsed tree, none if it's a leaf or not in the tree at all
+    // `children` needs room for MAX_FANOUT
+    static size_t childrenOf(const uint8_t* tree, uint8_t selfOctet, uint8_t* children);
+    // Hops from the source to the farthest member
+    static size_t depth(size_t members, size_t fanout);
+
+private:
+    // Position 0 is the source, member i sits at position i + 1
+    static size_t childrenAt(const uint8_t* octets, size_t count, size_t fanout, size_t position, uint8_t* children);
+
+    size_t fanout = 0;
+    std::vector<uint8_t> order;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Sliding bitmap over the packet counters of one peer session, rejects duplicates and anything too old
+// check() before decrypting, update() only once the packet authenticated, so forged counters can't move the window
+// Not thread-safe, owned by the thread that receives from the peer
+class ReplayWindow
+{
+public:
+    static constexpr size_t WINDOW_BITS = 1024;
+    // One block is always being recycled as the window slides, so this is how far back we accept
+    static constexpr uint64_t MAX_REORDER = WINDOW_BITS - 64;
+
+    // True if the counter is new and not older than the window
+    bool check(uint64_t) const;
+    // Mark the counter as seen, slides the window forward if it's the newest yet
+    void update(uint64_t);
+    void reset();
+
+    uint64_t getHighest() const { return highest; }
+    // Bit i set = counter highest - 1 - i was seen, what an ack's selective bitmap carries
+    uint64_t getRecentBitmap() const;
+
+private:
+    static constexpr size_t BLOCK_BITS = 64;
+    static constexpr size_t BLOCKS = WINDOW_BITS / BLOCK_BITS;
+
+    std::array<uint64_t, BLOCKS> bitmap{};
+    uint64_t highest = 0;
+    bool initialized = false;
+};
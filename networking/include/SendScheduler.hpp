@@ -0,0 +1,90 @@
+#pragma once
+
+#include "PacketBufferPool.hpp"
+#include "PortPriority.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Plaintext IP packets waiting for the uplink to one peer, so a bulk transfer can't sit in front of game packets
+// Strict priority for game ports, DSCP CS4 and up, UDP packets up to the small-packet size and bare TCP acks;
+// everything else is deficit round-robin over flows (the inner 5-tuple hashed into FLOW_SLOTS)
+// When full, the flow with the most bytes queued loses its oldest packet, like fq_codel
+// Queued packets live in a node pool that's reused, nothing is allocated once it has grown to the backlog
+// Not thread-safe, IO thread only
+class SendScheduler
+{
+public:
+    struct Stats
+    {
+        uint64_t enqueued = 0;
+        // Went out through the priority queue
+        uint64_t priority = 0;
+        uint64_t dropped = 0;
+        uint64_t droppedBytes = 0;
+    };
+
+    static constexpr size_t FLOW_SLOTS = 64;
+    static constexpr size_t MAX_PACKETS = 1024;
+    // Priority packets past this many queued go to their flow instead
+    static constexpr size_t PRIORITY_LIMIT = 128;
+    // After this many priority packets in a row a waiting flow gets one out, so a flood marked EF can't starve the rest
+    static constexpr size_t PRIORITY_BURST = 16;
+    // Bytes a flow may send per round, about one full-size packet
+    static constexpr int32_t QUANTUM = 1500;
+
+    // smallPacketBytes = 0 turns the small UDP packet rule off
+    void enqueue(PacketHandle packet, const PortPriorities& ports, size_t smallPacketBytes);
+    // Empty handle when nothing is queued
+    PacketHandle dequeue();
+    void clear();
+
+    bool empty() const { return packetCount == 0; }
+    size_t size() const { return packetCount; }
+    size_t bytes() const { return byteCount; }
+    const Stats& getStats() const { return stats; }
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Node
+    {
+        PacketHandle packet;
+        uint32_t next = NONE;
+    };
+
+    struct Queue
+    {
+        uint32_t head = NONE;
+        uint32_t tail = NONE;
+        size_t packets = 0;
+        size_t bytes = 0;
+    };
+
+    struct Flow
+    {
+        Queue queue;
+        int32_t deficit = 0;
+        int32_t quantum = QUANTUM;
+        // In the round-robin ring, possibly with nothing left queued until the ring gets to it
+        bool active = false;
+    };
+
+    void push(Queue& queue, PacketHandle packet);
+    PacketHandle pop(Queue& queue);
+    void dropFromFattestFlow();
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> freeNodes;
+    Queue priorityQueue;
+    std::array<Flow, FLOW_SLOTS> flows{};
+    // Ring of active flow slots, each at most once
+    std::array<uint8_t, FLOW_SLOTS> activeRing{};
+    size_t activeHead = 0;
+    size_t activeCount = 0;
+    size_t priorityStreak = 0;
+    size_t packetCount = 0;
+    size_t byteCount = 0;
+    Stats stats;
+};
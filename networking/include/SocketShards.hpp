@@ -0,0 +1,107 @@
+#pragma once
+
+#include "PacketBufferPool.hpp"
+#include "BusyPoller.hpp"
+#include <boost/asio.hpp>
+#include <sys/socket.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// More sockets on the port of an existing UDP socket (SO_REUSEPORT), each read with recvmmsg by its own thread
+// running its own io_context, so receiving is spread over cores instead of one IO thread
+// Shard 0 is the existing socket and stays with whoever reads it now, shards 1..N-1 are opened here
+// The existing socket must have been bound with SO_REUSEPORT set, its port (and so the NAT binding) is shared
+// On IPv4 a steering program has the kernel hand each sender's datagrams to shardFor(sender), so everything
+// per peer can live on that shard; without it (IPv6, or the kernel refused it) the kernel's own hash still keeps
+// a sender on one shard, only we can't tell which
+// Linux only. Not thread-safe, create / start / stop from one thread; the handler runs on the shard threads
+class SocketShards
+{
+public:
+    static constexpr size_t MAX_SHARDS = 64;
+
+    struct Parameters
+    {
+        // Sockets in total, the existing one included
+        size_t shards = 2;
+        // Datagrams per recvmmsg
+        size_t batchSize = 32;
+        // Shard i runs on core i (modulo the core count)
+        bool pinThreads = true;
+        int receiveBufferBytes = 4 * 1024 * 1024;
+        // Shard threads spin this long for datagrams before they sleep, sockets get SO_BUSY_POLL; 0 = off
+        std::chrono::microseconds busyPoll{0};
+    };
+
+    struct Datagram
+    {
+        PacketHandle packet;
+        boost::asio::ip::udp::endpoint sender;
+    };
+
+    // Called on shard `shard`'s thread with one recvmmsg worth of datagrams, take what you keep out of the vector
+    using BatchHandler = std::function<void(size_t shard, std::vector<Datagram>&)>;
+
+    // Null if the extra sockets can't join the port (no SO_REUSEPORT on the existing one, socket not bound)
+    static std::unique_ptr<SocketShards> create(boost::asio::ip::udp::socket& primary,
+        std::shared_ptr<PacketBufferPool>, Parameters);
+    ~SocketShards();
+
+    SocketShards(const SocketShards&) = delete;
+    SocketShards& operator=(const SocketShards&) = delete;
+
+    void start(BatchHandler);
+    // Joins the shard threads, the handler isn't called once it returns
+    void stop();
+
+    size_t getShardCount() const { return shardCount; }
+    // The kernel steers by shardFor(), false leaves it to its hash
+    bool isSteered() const { return steered; }
+    // Shard a sender's datagrams arrive on when steered, same hash as the steering program
+    static size_t shardFor(const boost::asio::ip::udp::endpoint&, size_t shardCount);
+
+    // Datagrams received per shard, 0 for shard 0 which isn't ours to read; any thread
+    std::vector<uint64_t> getReceiveCounts() const;
+    // Datagrams too big for a receive slab, dropped, summed over the shards; any thread
+    uint64_t getTruncatedCount() const;
+    // Spinning of the shard threads, summed; any thread
+    BusyPoller::Stats getBusyPollStats() const;
+
+private:
+    struct Shard
+    {
+        Shard(size_t index, std::chrono::microseconds busyPoll);
+
+        size_t index;
+        boost::asio::io_context context;
+        boost::asio::ip::udp::socket socket;
+        std::thread thread;
+        std::vector<PacketHandle> buffers;
+        std::vector<mmsghdr> messages;
+        std::vector<iovec> vectors;
+        std::vector<sockaddr_storage> addresses;
+        std::vector<Datagram> batch;
+        std::atomic<uint64_t> received{0};
+        std::atomic<uint64_t> truncated{0};
+        BusyPoller poller;
+    };
+
+    SocketShards(std::shared_ptr<PacketBufferPool>, Parameters);
+    bool attachSteering(int socketFd);
+    void startReceive(Shard&);
+    void handleReceive(Shard&, const boost::system::error_code&);
+
+    std::shared_ptr<PacketBufferPool> packetPool;
+    Parameters parameters;
+    size_t shardCount = 1;
+    bool steered = false;
+    // Shards 1..N-1, in the order they joined the port's socket group (the existing socket is first)
+    std::vector<std::unique_ptr<Shard>> shards;
+    BatchHandler onBatch;
+    bool running = false;
+};
@@ -1,14 +1,13 @@
 #pragma once
 
 #include "interfaces/ITunInterface.hpp"
+#include "TunWriteQueue.hpp"
 #include <Windows.h>
 #include <wintun.h>
 #include <thread>
 #include <atomic>
 #include <memory>
-#include <mutex>
-#include <condition_variable>
-#include <queue>
+#include <chrono>
 
 #ifdef __cplusplus
 extern "C" {
@@ -26,7 +25,11 @@ BOOL WINAPI WintunGetAdapterLUID(_In_ WINTUN_ADAPTER_HANDLE Adapter, _Out_ NET_L
 class TunInterface : public ITunInterface
 {
 public:
-    TunInterface();
+    // Received packets are copied out of the Wintun ring into this pool, a private one is created if null
+    // Packets for the adapter wait in a bounded CoDel queue with these parameters
+    // A busy-poll budget above 0 has the receive and send threads spin that long for packets before they sleep
+    explicit TunInterface(std::shared_ptr<PacketBufferPool> = nullptr, CoDelQueue::Parameters = CoDelQueue::Parameters(),
+        std::chrono::microseconds busyPoll = std::chrono::microseconds(0));
     ~TunInterface();
 
     bool initialize(const std::string&) override;
@@ -34,12 +37,14 @@ public:
     bool startPacketProcessing() override;
     void stopPacketProcessing() override;
 
-    // Add a packet to injection queue
-    bool sendPacket(std::vector<uint8_t>) override;
+    // Add a packet to injection queue, copied into the Wintun ring straight from the handle
+    bool sendPacket(PacketHandle) override;
 
     void setPacketCallback(PacketCallback callback) override;
 
     bool isRunning() const override;
+    CoDelQueue::Stats getQueueStats() const override;
+    BusyPoller::Stats getBusyPollStats() const override;
 
     void close() override;
 
@@ -82,9 +87,14 @@ private:
 
     // State management
     std::atomic<bool> running{false};
-    std::mutex packetQueueMutex;
-    std::condition_variable packetConditionVariable;
-    std::queue<std::vector<uint8_t>> outgoingPackets;
+    // The send thread takes a batch at a time, CoDel judges each packet as it leaves
+    TunWriteQueue outgoingPackets;
+    // The receive thread's spinning, the send thread's is in outgoingPackets
+    BusyPoller receivePoller;
+    // Most packets the send thread takes per wakeup
+    static constexpr size_t SEND_BATCH = 256;
+    // Drops are logged at most this often
+    static constexpr std::chrono::seconds DROP_REPORT_INTERVAL{10};
     
     // Thread for packet processing
     std::thread receiveThread;
@@ -92,6 +102,7 @@ private:
     
     // Callback for received packets
     PacketCallback packetCallback;
+    std::shared_ptr<PacketBufferPool> packetPool;
     
     // Interface management
     bool loadWintunFunctions(HMODULE);
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "BoundedRing.hpp"
+#include "BusyPoller.hpp"
+#include "CoDelQueue.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Packets on their way to a TUN writer thread
+// Senders push into a lock-free ring and never wait on the writer; the writer moves what arrived into its own
+// CoDel queue and takes batches from there, so CoDel still judges the whole time a packet waited
+// A writer with nothing to do parks on a condition variable, senders only touch its mutex to wake it from there
+// The limit holds for the ring and the CoDel queue together: at the limit the oldest packet still in the ring is
+// dropped, or the new one when the writer already holds them all
+// With a busy-poll budget the writer spins that long for the next packet before it parks
+// Thread-safe: push() from any thread, takeBatch() from the one writer, clear() once the writer is gone
+class TunWriteQueue
+{
+public:
+    using Clock = CoDelQueue::Clock;
+
+    explicit TunWriteQueue(CoDelQueue::Parameters = CoDelQueue::Parameters(),
+        std::chrono::microseconds busyPoll = std::chrono::microseconds(0));
+
+    void push(PacketHandle packet);
+    // Waits for packets and appends up to maxPackets that CoDel lets through, false once stopped
+    bool takeBatch(std::vector<PacketHandle>& out, size_t maxPackets);
+
+    // takeBatch() waits again after a stop
+    void start();
+    // Wakes the writer, takeBatch() returns false until start(); what's queued stays until clear()
+    void stop();
+    // Throws everything queued away, returns how many packets that was
+    size_t clear();
+
+    // Counters as of the writer's last batch, plus what's waiting in the ring
+    CoDelQueue::Stats getStats() const;
+    BusyPoller::Stats getBusyPollStats() const { return poller.getStats(); }
+
+private:
+    struct Entry
+    {
+        PacketHandle packet;
+        Clock::time_point enqueuedAt;
+    };
+
+    // Writer: moves everything in the ring into the CoDel queue, returns how many packets that was
+    size_t drainRing();
+    void countDrop(const PacketHandle& packet);
+    void publishStats();
+
+    BoundedRing<Entry> ring;
+    size_t limit;
+    // Packets in the ring and the CoDel queue together
+    std::atomic<size_t> queued{0};
+    // Only the writer touches these
+    CoDelQueue outgoingPackets;
+    // CoDel queue depth already counted in `queued`
+    size_t writerHeld = 0;
+    std::vector<Entry> arrivals;
+    BusyPoller poller;
+
+    std::atomic<bool> writerIdle{false};
+    std::atomic<bool> stopped{false};
+    std::mutex waitMutex;
+    std::condition_variable packetsReady;
+
+    std::atomic<uint64_t> enqueued{0};
+    std::atomic<uint64_t> ringDrops{0};
+    std::atomic<uint64_t> ringDroppedBytes{0};
+    mutable std::mutex statsMutex;
+    CoDelQueue::Stats writerStats;
+
+    // Most arrivals moved per ring pop
+    static constexpr size_t DRAIN_BATCH = 256;
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "PacketBufferPool.hpp"
+#include <boost/asio.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// io_uring socket I/O for the UDP data path, Linux only, in place of asio's reactor
+// Receives are one multishot recvmsg: the kernel picks a pool slab from a provided buffer ring for every datagram,
+// so a burst costs no syscall and no wakeup per packet, and the slab goes up the data path as it is
+// Sends are queued as sendmsg entries and submitted all at once by flush(), one io_uring_enter per batch
+// Completions raise an eventfd waited on through the given executor, so every handler runs there (the IO thread)
+// Talks to the kernel ABI directly, there's no liburing to depend on
+// create() returns null when the kernel can't do it (too old, or io_uring disabled), callers keep the asio path
+// Not thread-safe, IO thread only
+class UringTransport
+{
+public:
+    struct Parameters
+    {
+        // Submission queue entries, the completion queue gets four times as many
+        unsigned ringEntries = 256;
+        // Slabs posted for receives, a power of two
+        unsigned receiveBuffers = 512;
+        // Sends in flight at once, queueSend() refuses past it
+        size_t sendSlots = 256;
+    };
+
+    struct Stats
+    {
+        uint64_t received = 0;
+        uint64_t sent = 0;
+        uint64_t sendErrors = 0;
+        // io_uring_enter calls, for submissions and for waiting out a stop
+        uint64_t enters = 0;
+        // Completion batches reaped after an eventfd wakeup
+        uint64_t wakeups = 0;
+        uint64_t completions = 0;
+        // The multishot receive ended (ran out of buffers, or an error) and was armed again
+        uint64_t receiveRearms = 0;
+        uint64_t truncated = 0;
+    };
+
+    using ReceiveHandler = std::function<void(PacketHandle, const boost::asio::ip::udp::endpoint&)>;
+    // Every queued send completes through here exactly once, unless the transport is stopped first
+    using SendHandler = std::function<void(const boost::system::error_code&, std::size_t, uint32_t tag,
+        const boost::asio::ip::udp::endpoint&)>;
+
+    static std::unique_ptr<UringTransport> create(int socketFd, const boost::asio::any_io_executor&,
+        std::shared_ptr<PacketBufferPool>, Parameters);
+    ~UringTransport();
+
+    UringTransport(const UringTransport&) = delete;
+    UringTransport& operator=(const UringTransport&) = delete;
+
+    // Arms the multishot receive and starts reaping completions, false if the kernel rejected it
+    bool start(ReceiveHandler, SendHandler);
+    // Cancels everything in flight and waits for the kernel to let go of our buffers, no handlers run after it
+    void stop();
+
+    // Takes the packet only when it returns true, a full slot table or ring leaves it with the caller
+    bool queueSend(PacketHandle& packet, const boost::asio::ip::udp::endpoint&, uint32_t tag);
+    // Submits what queueSend() queued, returns how many
+    size_t flush();
+    size_t queuedSends() const { return unsubmitted; }
+    size_t sendsInFlight() const { return sendSlots.size() - freeSendSlots.size(); }
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct SendSlot
+    {
+        PacketHandle packet;
+        boost::asio::ip::udp::endpoint endpoint;
+        msghdr header{};
+        iovec vector{};
+        uint32_t tag = 0;
+    };
+
+    UringTransport(int socketFd, const boost::asio::any_io_executor&, std::shared_ptr<PacketBufferPool>, Parameters);
+    bool setupRing();
+    bool setupBufferRing();
+
+    io_uring_sqe* nextSqe();
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags);
+    void armReceive();
+    void waitForCompletions();
+    void reapCompletions();
+    void handleCompletion(const io_uring_cqe&);
+    void handleReceive(const io_uring_cqe&);
+    void handleSend(const io_uring_cqe&);
+    // Hands slab `bufferId` back to the kernel, replaced by a fresh one if the old one went up the data path
+    void recycleBuffer(uint16_t bufferId);
+
+    int socketFd;
+    std::shared_ptr<PacketBufferPool> packetPool;
+    Parameters parameters;
+
+    // Shared with the kernel, indices are read and published with acquire / release atomics
+    int ringFd = -1;
+    void* ringMemory = nullptr;
+    size_t ringMemorySize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+    uint32_t* sqHead = nullptr;
+    uint32_t* sqTail = nullptr;
+    uint32_t* sqFlags = nullptr;
+    uint32_t sqMask = 0;
+    uint32_t sqEntries = 0;
+    uint32_t* sqArray = nullptr;
+    // Entries are filled past the published tail, flush() publishes them
+    uint32_t sqLocalTail = 0;
+    uint32_t* cqHead = nullptr;
+    uint32_t* cqTail = nullptr;
+    uint32_t cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+    // Entries written but not yet submitted
+    unsigned unsubmitted = 0;
+
+    // Provided buffers, bufferSlabs[id] is the slab the kernel knows as id
+    // Indexed as plain entries: in C++ the flexible array of io_uring_buf_ring starts 8 bytes late
+    io_uring_buf* bufferRing = nullptr;
+    size_t bufferRingSize = 0;
+    uint16_t bufferRingTail = 0;
+    std::vector<PacketHandle> bufferSlabs;
+    // Layout the multishot receive writes into each slab: io_uring_recvmsg_out, the sender address, the payload
+    msghdr receiveHeader{};
+    bool receiveArmed = false;
+
+    std::vector<SendSlot> sendSlots;
+    std::vector<uint32_t> freeSendSlots;
+
+    int eventFd = -1;
+    boost::asio::posix::stream_descriptor eventDescriptor;
+
+    ReceiveHandler onReceive;
+    SendHandler onSend;
+    bool running = false;
+    Stats stats;
+};
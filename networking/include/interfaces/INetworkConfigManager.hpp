@@ -1,19 +1,28 @@
 #pragma once
 
 #include <string>
-#include <guiddef.h>
 #include <cstdint>
 #include <vector>
+#ifdef _WIN32
+#include <guiddef.h>
+#endif
 
 class INetworkConfigManager
 {
 public:
     enum class RouteConfigApproach : uint8_t { GENERIC_ROUTE, FALLBACK_ROUTE_ALL, FAILED };
 
+#ifdef _WIN32
+    using AdapterGuid = GUID;
+#else
+    // Only Wintun adapters are identified by a GUID, elsewhere it stays zeroed
+    struct AdapterGuid { uint8_t bytes[16]; };
+#endif
+
     struct SetupConfig
     {
         const std::string IP_SPACE;
-        const GUID ADAPTER_GUID;
+        const AdapterGuid ADAPTER_GUID;
 
         // Provide a default implementation that can be overridden by derived classes
         static SetupConfig loadConfig()
@@ -5,12 +5,16 @@
 #include <string>
 #include <cstdint>
 #include <map>
+#include <boost/asio/any_io_executor.hpp>
 #include <boost/asio/ip/udp.hpp>
 #include <sodium/crypto_box.h>
+#include "PacketBufferPool.hpp"
+#include "PortPriority.hpp"
 
 class IUDPNetwork {
 public:
-    using MessageCallback = std::function<void(const std::vector<uint8_t>)>;
+    // Decrypted IP packets, a view into the receive buffer they arrived in
+    using MessageCallback = std::function<void(PacketHandle)>;
 
     virtual ~IUDPNetwork() = default;
 
@@ -25,12 +29,16 @@ public:
     
     virtual bool isConnected() const = 0;
     
-    virtual void processPacketFromTun(const std::vector<uint8_t>&) = 0;
+    virtual void processPacketFromTun(PacketHandle) = 0;
+    // A burst from the TUN backlog, routed in one pass; the handles are moved from
+    virtual void processPacketsFromTun(PacketHandle* packets, size_t count) = 0;
     virtual bool sendMessage(
-        const std::vector<uint8_t>& data,
+        PacketHandle data,
         const boost::asio::ip::udp::endpoint& peerEndpoint,
         const std::array<uint8_t, crypto_box_BEFORENMBYTES>& sharedKey) = 0;
     virtual void setMessageCallback(MessageCallback callback) = 0;
+    virtual void setPortPriorities(const PortPriorities&) = 0;
 
-    virtual boost::asio::io_context& getIOContext() = 0;
+    // Where work touching the network module has to be posted, its state is serialized there
+    virtual boost::asio::any_io_executor getExecutor() = 0;
 };
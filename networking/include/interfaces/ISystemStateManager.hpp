@@ -6,6 +6,7 @@
 #include <optional>
 #include <boost/asio/ip/udp.hpp>
 #include <sodium/crypto_box.h>
+#include "PortPriority.hpp"
 
 // System states
 enum class SystemState
@@ -24,7 +25,8 @@ enum class NetworkEvent
     PEER_CONNECTED,
     PEER_DISCONNECTED,
     ALL_PEERS_DISCONNECTED,
-    SHUTDOWN_REQUESTED
+    SHUTDOWN_REQUESTED,
+    SET_PORT_PRIORITIES
 };
 
 // Event data to be sent by the network module
@@ -36,7 +38,8 @@ struct NetworkEventData
     std::variant<
         std::monostate,
         std::string,
-        SelfIndexAndPeerMap> data;
+        SelfIndexAndPeerMap,
+        PortPriorities> data;
     std::chrono::steady_clock::time_point timestamp; // UNUSED
     
     // Constructor for events with string data
@@ -50,6 +53,10 @@ struct NetworkEventData
     // Constructor for events with peer map
     NetworkEventData(NetworkEvent e, const SelfIndexAndPeerMap& peerMap)
         : event(e), data(peerMap), timestamp(std::chrono::steady_clock::now()) {}
+
+    // Constructor for events with port priorities
+    NetworkEventData(NetworkEvent e, const PortPriorities& priorities)
+        : event(e), data(priorities), timestamp(std::chrono::steady_clock::now()) {}
 };
 
 class ISystemStateManager
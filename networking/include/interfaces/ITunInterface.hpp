@@ -4,6 +4,9 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include "PacketBufferPool.hpp"
+#include "CoDelQueue.hpp"
+#include "BusyPoller.hpp"
 
 
 class ITunInterface
@@ -11,16 +14,21 @@ class ITunInterface
 public:
     virtual ~ITunInterface() = default;
 
-    using PacketCallback = std::function<void(const std::vector<uint8_t>&)>;
+    // Packets read from the device, in pooled buffers with PacketBufferPool::DEFAULT_HEADROOM in front
+    using PacketCallback = std::function<void(PacketHandle)>;
 
     virtual bool initialize(const std::string&) = 0;
 
     virtual bool startPacketProcessing() = 0;
     virtual void stopPacketProcessing() = 0;
-    virtual bool sendPacket(std::vector<uint8_t>) = 0;
+    virtual bool sendPacket(PacketHandle) = 0;
     virtual void setPacketCallback(PacketCallback callback) = 0;
 
     virtual bool isRunning() const = 0;
+    // Outgoing (network -> device) queues, summed over all of them
+    virtual CoDelQueue::Stats getQueueStats() const = 0;
+    // Spinning of the reader and writer threads in busy-poll mode, summed over all of them
+    virtual BusyPoller::Stats getBusyPollStats() const = 0;
     virtual void close() = 0;
 
     virtual std::string getNarrowAlias() const = 0;
@@ -8,7 +8,8 @@
 class StunClient : public IStunClient
 {
 public:
-    StunClient(const std::string& server = "stun.l.google.com", const std::string& port = "19302");
+    // reusePort: let UDPNetwork open more sockets on the discovered port later (socket shards)
+    StunClient(const std::string& server = "stun.l.google.com", const std::string& port = "19302", bool reusePort = false);
     
     // Get public IP and port
     std::optional<PublicAddress> discoverPublicAddress() override;
@@ -22,6 +23,7 @@ public:
 private:
     std::string stunServer;
     std::string stunPort;
+    bool reusePort;
     std::unique_ptr<boost::asio::ip::udp::socket> scoket;
     boost::asio::io_context ioContext;
 };
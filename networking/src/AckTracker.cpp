@@ -0,0 +1,228 @@
+#include "AckTracker.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+void writeBigEndian(uint8_t* out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        out[i] = static_cast<uint8_t>(value >> (8 * (bytes - 1 - i)));
+}
+
+uint64_t readBigEndian(const uint8_t* in, int bytes)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+        value = (value << 8) | in[i];
+    return value;
+}
+}
+
+void AckBlock::write(uint8_t* out) const
+{
+    writeBigEndian(out, sessionId, 4);
+    writeBigEndian(out + 4, delayMicroseconds, 4);
+    writeBigEndian(out + 8, largest, 8);
+    writeBigEndian(out + 16, receivedCount, 8);
+    writeBigEndian(out + 24, bitmap, 8);
+}
+
+AckBlock AckBlock::read(const uint8_t* in)
+{
+    AckBlock block;
+    block.sessionId = static_cast<uint32_t>(readBigEndian(in, 4));
+    block.delayMicroseconds = static_cast<uint32_t>(readBigEndian(in + 4, 4));
+    block.largest = readBigEndian(in + 8, 8);
+    block.receivedCount = readBigEndian(in + 16, 8);
+    block.bitmap = readBigEndian(in + 24, 8);
+    return block;
+}
+
+AckTracker::AckTracker()
+    : ring(RING_SIZE)
+{
+}
+
+void AckTracker::onPacketSent(uint64_t counter, size_t bytes, Clock::time_point now)
+{
+    SentPacket& slot = ring[counter % RING_SIZE];
+    if (slot.inFlight)
+    {
+        // Never heard of again within a ring's worth of packets, forget it
+        leaveFlight(slot, false);
+    }
+
+    if (stats.bytesInFlight == 0)
+    {
+        // Starting from idle, the time before doesn't belong in any rate sample
+        firstSentTime = now;
+        deliveredTime = now;
+    }
+
+    slot.counter = counter;
+    slot.sentAt = now;
+    slot.bytes = static_cast<uint32_t>(bytes);
+    slot.inFlight = true;
+    slot.delivered = stats.bytesDelivered;
+    slot.deliveredAt = deliveredTime;
+    slot.firstSentAt = firstSentTime;
+    stats.bytesInFlight += bytes;
+    stats.packetsSent++;
+    nextCounter = counter + 1;
+}
+
+AckTracker::RateSample AckTracker::onAckReceived(const AckBlock& ack, Clock::time_point now)
+{
+    stats.acksReceived++;
+    RateSample sample;
+
+    // An ack overtaken by a newer one has nothing to add, the counts in it are cumulative
+    if (anyAcked && ack.largest < largestAcked)
+        return sample;
+
+    if (!anyAcked || ack.largest > largestAcked)
+    {
+        // One RTT sample per ack, from its largest packet, if that's a data packet we still remember
+        const SentPacket& largest = ring[ack.largest % RING_SIZE];
+        if (largest.counter == ack.largest && largest.sentAt != Clock::time_point() && now >= largest.sentAt)
+        {
+            updateRtt(std::chrono::duration_cast<std::chrono::microseconds>(now - largest.sentAt),
+                std::chrono::microseconds(ack.delayMicroseconds));
+        }
+        largestAcked = ack.largest;
+        anyAcked = true;
+    }
+
+    // Settle what was in flight up to the largest: acked per the bitmap, lost once it's far enough behind
+    uint64_t ringStart = nextCounter > RING_SIZE ? nextCounter - RING_SIZE : 0;
+    bool stillWaiting = false;
+    const SentPacket* newestAcked = nullptr;
+    for (uint64_t counter = std::max(oldestInFlight, ringStart); counter <= ack.largest && counter < nextCounter; counter++)
+    {
+        SentPacket& slot = ring[counter % RING_SIZE];
+        if (slot.counter == counter && slot.inFlight)
+        {
+            uint64_t distance = ack.largest - counter;
+            bool acked = distance == 0 || (distance <= 64 && ((ack.bitmap >> (distance - 1)) & 1));
+            if (acked)
+            {
+                leaveFlight(slot, true);
+                stats.packetsAcked++;
+                // Counters only go up, so the last one settled here was sent last
+                newestAcked = &slot;
+            }
+            else if (distance >= REORDER_THRESHOLD)
+            {
+                leaveFlight(slot, false);
+            }
+            else
+            {
+                stillWaiting = true;
+            }
+        }
+
+        if (!stillWaiting)
+            oldestInFlight = counter + 1;
+    }
+
+    if (newestAcked)
+    {
+        deliveredTime = now;
+        firstSentTime = newestAcked->sentAt;
+        // An ack compressed in time (acks bunched up on the way back) mustn't read as more bandwidth than the sends had
+        auto sendElapsed = newestAcked->sentAt - newestAcked->firstSentAt;
+        auto ackElapsed = now - newestAcked->deliveredAt;
+        sample.deliveredBytes = stats.bytesDelivered - newestAcked->delivered;
+        sample.interval = std::chrono::duration_cast<std::chrono::microseconds>(std::max(sendElapsed, ackElapsed));
+        sample.priorDelivered = newestAcked->delivered;
+    }
+
+    // Counters start at 0 every session, so the peer should have had largest + 1 packets by now
+    uint64_t expected = ack.largest + 1;
+    uint64_t lost = expected > ack.receivedCount ? expected - ack.receivedCount : 0;
+    if (expected > lastExpected)
+    {
+        // Late arrivals can bring the count down again, that interval just counts as lossless
+        double sample = lost > lastLost ? static_cast<double>(lost - lastLost) / (expected - lastExpected) : 0.0;
+        stats.lossRate += (std::min(1.0, sample) - stats.lossRate) / 8;
+        lastExpected = expected;
+        lastLost = lost;
+    }
+    stats.packetsLost = lost;
+    return sample;
+}
+
+void AckTracker::onPacketReceived(uint64_t counter, bool ackEliciting, Clock::time_point now)
+{
+    receivedCount++;
+    if (receivedCount == 1 || counter > largestReceived)
+    {
+        largestReceived = counter;
+        largestReceivedAt = now;
+    }
+
+    if (ackEliciting)
+    {
+        if (ackPending == 0)
+            firstPendingAt = now;
+        ackPending++;
+    }
+}
+
+void AckTracker::resetReceiveSide()
+{
+    ackPending = 0;
+    largestReceived = 0;
+    receivedCount = 0;
+}
+
+bool AckTracker::isAckDue(Clock::time_point now, std::chrono::microseconds ackDelay) const
+{
+    return ackPending > 0 && (ackPending >= ACK_EVERY || now - firstPendingAt >= ackDelay);
+}
+
+AckBlock AckTracker::makeAck(uint32_t peerSessionId, const ReplayWindow& replayWindow, Clock::time_point now)
+{
+    AckBlock ack;
+    ack.sessionId = peerSessionId;
+    ack.largest = replayWindow.getHighest();
+    ack.bitmap = replayWindow.getRecentBitmap();
+    ack.receivedCount = receivedCount;
+
+    auto delay = std::chrono::duration_cast<std::chrono::microseconds>(now - largestReceivedAt).count();
+    ack.delayMicroseconds = static_cast<uint32_t>(std::clamp<int64_t>(delay, 0, std::numeric_limits<uint32_t>::max()));
+
+    ackPending = 0;
+    stats.acksSent++;
+    return ack;
+}
+
+void AckTracker::leaveFlight(SentPacket& slot, bool delivered)
+{
+    slot.inFlight = false;
+    stats.bytesInFlight -= slot.bytes;
+    if (delivered)
+        stats.bytesDelivered += slot.bytes;
+}
+
+void AckTracker::updateRtt(std::chrono::microseconds latest, std::chrono::microseconds ackDelay)
+{
+    // RFC 9002 estimator, the peer's ack delay is only taken out if that doesn't go below the minimum
+    stats.latestRtt = latest;
+    if (rttSamples == 0)
+    {
+        stats.minRtt = latest;
+        stats.smoothedRtt = latest;
+        stats.rttVariation = latest / 2;
+    }
+    else
+    {
+        stats.minRtt = std::min(stats.minRtt, latest);
+        std::chrono::microseconds adjusted = latest - ackDelay >= stats.minRtt ? latest - ackDelay : latest;
+        std::chrono::microseconds deviation = stats.smoothedRtt > adjusted ? stats.smoothedRtt - adjusted : adjusted - stats.smoothedRtt;
+        stats.rttVariation = (3 * stats.rttVariation + deviation) / 4;
+        stats.smoothedRtt = (7 * stats.smoothedRtt + adjusted) / 8;
+    }
+    rttSamples++;
+}
@@ -0,0 +1,249 @@
+#include "BatchCipher.hpp"
+#include <algorithm>
+#include <cstring>
+#include <sodium.h>
+
+#if defined(_MSC_VER) && defined(PB_X86_KERNELS)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace
+{
+inline uint32_t load32(const uint8_t* in)
+{
+    return uint32_t(in[0]) | (uint32_t(in[1]) << 8) | (uint32_t(in[2]) << 16) | (uint32_t(in[3]) << 24);
+}
+
+inline void store32(uint8_t* out, uint32_t value)
+{
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+    out[2] = static_cast<uint8_t>(value >> 16);
+    out[3] = static_cast<uint8_t>(value >> 24);
+}
+
+inline uint32_t rotl(uint32_t value, int bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+#define PB_QUARTERROUND(a, b, c, d) \
+    a += b; d = rotl(d ^ a, 16);    \
+    c += d; b = rotl(b ^ c, 12);    \
+    a += b; d = rotl(d ^ a, 8);     \
+    c += d; b = rotl(b ^ c, 7);
+
+void chachaBlock(const uint8_t* key, const uint8_t* nonce, uint32_t counter, uint8_t* out)
+{
+    uint32_t input[16] = {
+        0x61707865, 0x3320646e, 0x79622d32, 0x6b206574,
+        load32(key), load32(key + 4), load32(key + 8), load32(key + 12),
+        load32(key + 16), load32(key + 20), load32(key + 24), load32(key + 28),
+        counter, load32(nonce), load32(nonce + 4), load32(nonce + 8)
+    };
+    uint32_t x[16];
+    std::memcpy(x, input, sizeof(x));
+
+    for (int i = 0; i < 10; i++)
+    {
+        PB_QUARTERROUND(x[0], x[4], x[8], x[12])
+        PB_QUARTERROUND(x[1], x[5], x[9], x[13])
+        PB_QUARTERROUND(x[2], x[6], x[10], x[14])
+        PB_QUARTERROUND(x[3], x[7], x[11], x[15])
+        PB_QUARTERROUND(x[0], x[5], x[10], x[15])
+        PB_QUARTERROUND(x[1], x[6], x[11], x[12])
+        PB_QUARTERROUND(x[2], x[7], x[8], x[13])
+        PB_QUARTERROUND(x[3], x[4], x[9], x[14])
+    }
+
+    for (int i = 0; i < 16; i++)
+        store32(out + 4 * i, x[i] + input[i]);
+}
+
+#undef PB_QUARTERROUND
+
+// RFC 8439 tag: Poly1305 over ad | pad | ciphertext | pad | le64(ad length) | le64(ciphertext length)
+void computeTag(const uint8_t* polyKey, const uint8_t* ad, size_t adSize, const uint8_t* ciphertext, size_t size, uint8_t* tag)
+{
+    static const uint8_t zeros[16] = {};
+    crypto_onetimeauth_poly1305_state state;
+    crypto_onetimeauth_poly1305_init(&state, polyKey);
+    crypto_onetimeauth_poly1305_update(&state, ad, adSize);
+    crypto_onetimeauth_poly1305_update(&state, zeros, (16 - adSize % 16) % 16);
+    crypto_onetimeauth_poly1305_update(&state, ciphertext, size);
+    crypto_onetimeauth_poly1305_update(&state, zeros, (16 - size % 16) % 16);
+
+    uint8_t lengths[16];
+    for (int i = 0; i < 8; i++)
+    {
+        lengths[i] = static_cast<uint8_t>(static_cast<uint64_t>(adSize) >> (8 * i));
+        lengths[8 + i] = static_cast<uint8_t>(static_cast<uint64_t>(size) >> (8 * i));
+    }
+    crypto_onetimeauth_poly1305_update(&state, lengths, sizeof(lengths));
+    crypto_onetimeauth_poly1305_final(&state, tag);
+}
+
+#ifdef PB_X86_KERNELS
+#ifdef _MSC_VER
+bool cpuSupports(BatchChaCha20Poly1305::Kernel kernel)
+{
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave)
+        return false;
+    unsigned long long xcr0 = _xgetbv(0);
+
+    __cpuidex(info, 7, 0);
+    if (kernel == BatchChaCha20Poly1305::Kernel::AVX2)
+        return (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+    // AVX-512F, plus the OS saving the opmask / ZMM state
+    return (info[1] & (1 << 16)) != 0 && (xcr0 & 0xE6) == 0xE6;
+}
+#else
+bool cpuSupports(BatchChaCha20Poly1305::Kernel kernel)
+{
+    // Also checks the OS saves the wider register state
+    if (kernel == BatchChaCha20Poly1305::Kernel::AVX2)
+        return __builtin_cpu_supports("avx2");
+    return __builtin_cpu_supports("avx512f");
+}
+#endif
+#endif
+}
+
+BatchChaCha20Poly1305::Kernel BatchChaCha20Poly1305::detectKernel()
+{
+    if (isKernelAvailable(Kernel::AVX512))
+        return Kernel::AVX512;
+    if (isKernelAvailable(Kernel::AVX2))
+        return Kernel::AVX2;
+    return Kernel::SCALAR;
+}
+
+bool BatchChaCha20Poly1305::isKernelAvailable(Kernel kernel)
+{
+    if (kernel == Kernel::SCALAR)
+        return true;
+    #ifdef PB_X86_KERNELS
+    return cpuSupports(kernel);
+    #else
+    return false;
+    #endif
+}
+
+const char* BatchChaCha20Poly1305::kernelName(Kernel kernel)
+{
+    switch (kernel)
+    {
+        case Kernel::AVX2: return "avx2";
+        case Kernel::AVX512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+BatchChaCha20Poly1305::BatchChaCha20Poly1305(Kernel requested)
+    : kernel(isKernelAvailable(requested) ? requested : Kernel::SCALAR)
+{
+}
+
+void BatchChaCha20Poly1305::runKernel(Lane* lanes, size_t count) const
+{
+    switch (kernel)
+    {
+        #ifdef PB_X86_KERNELS
+        case Kernel::AVX512:
+            xorKeystreamAvx512(lanes, count);
+            break;
+        case Kernel::AVX2:
+            xorKeystreamAvx2(lanes, count);
+            break;
+        #endif
+        default:
+            xorKeystreamScalar(lanes, count);
+            break;
+    }
+}
+
+void BatchChaCha20Poly1305::seal(BatchCipherItem* items, size_t count) const
+{
+    for (size_t start = 0; start < count; start += MAX_BATCH)
+    {
+        size_t chunk = std::min(MAX_BATCH, count - start);
+        Lane lanes[MAX_BATCH];
+        uint8_t polyKeys[MAX_BATCH][64];
+        for (size_t i = 0; i < chunk; i++)
+        {
+            BatchCipherItem& item = items[start + i];
+            lanes[i] = {item.key, item.nonce, item.data, item.size, polyKeys[i]};
+        }
+
+        runKernel(lanes, chunk);
+
+        for (size_t i = 0; i < chunk; i++)
+        {
+            BatchCipherItem& item = items[start + i];
+            computeTag(polyKeys[i], item.ad, item.adSize, item.data, item.size, item.mac);
+            item.ok = true;
+        }
+        sodium_memzero(polyKeys, sizeof(polyKeys));
+    }
+}
+
+void BatchChaCha20Poly1305::open(BatchCipherItem* items, size_t count) const
+{
+    for (size_t start = 0; start < count; start += MAX_BATCH)
+    {
+        size_t chunk = std::min(MAX_BATCH, count - start);
+        Lane lanes[MAX_BATCH];
+        uint8_t polyKeys[MAX_BATCH][64];
+
+        // First pass only derives the Poly1305 keys, nothing gets decrypted before its tag checks out
+        for (size_t i = 0; i < chunk; i++)
+        {
+            BatchCipherItem& item = items[start + i];
+            lanes[i] = {item.key, item.nonce, nullptr, 0, polyKeys[i]};
+        }
+        runKernel(lanes, chunk);
+
+        size_t verified = 0;
+        for (size_t i = 0; i < chunk; i++)
+        {
+            BatchCipherItem& item = items[start + i];
+            uint8_t tag[16];
+            computeTag(polyKeys[i], item.ad, item.adSize, item.data, item.size, tag);
+            item.ok = crypto_verify_16(tag, item.mac) == 0;
+            if (item.ok)
+                lanes[verified++] = {item.key, item.nonce, item.data, item.size, polyKeys[i]};
+        }
+
+        runKernel(lanes, verified);
+        sodium_memzero(polyKeys, sizeof(polyKeys));
+    }
+}
+
+void BatchChaCha20Poly1305::xorKeystreamScalar(Lane* lanes, size_t count)
+{
+    uint8_t block[64];
+    for (size_t i = 0; i < count; i++)
+    {
+        Lane& lane = lanes[i];
+        chachaBlock(lane.key, lane.nonce, 0, block);
+        std::memcpy(lane.polyKey, block, 32);
+
+        uint32_t counter = 1;
+        for (size_t offset = 0; offset < lane.size; offset += 64, counter++)
+        {
+            chachaBlock(lane.key, lane.nonce, counter, block);
+            size_t length = std::min<size_t>(64, lane.size - offset);
+            for (size_t b = 0; b < length; b++)
+                lane.data[offset + b] ^= block[b];
+        }
+    }
+    sodium_memzero(block, sizeof(block));
+}
@@ -0,0 +1,174 @@
+// Built with AVX2 enabled (-mavx2), only called once detectKernel() saw AVX2 on the CPU
+#include "BatchCipher.hpp"
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+constexpr size_t LANES = 8;
+
+inline __m256i rotl16(__m256i x)
+{
+    const __m256i shuffle = _mm256_setr_epi8(
+        2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+        2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    return _mm256_shuffle_epi8(x, shuffle);
+}
+
+inline __m256i rotl8(__m256i x)
+{
+    const __m256i shuffle = _mm256_setr_epi8(
+        3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+        3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+    return _mm256_shuffle_epi8(x, shuffle);
+}
+
+template <int BITS>
+inline __m256i rotl(__m256i x)
+{
+    return _mm256_or_si256(_mm256_slli_epi32(x, BITS), _mm256_srli_epi32(x, 32 - BITS));
+}
+
+inline void quarterRound(__m256i& a, __m256i& b, __m256i& c, __m256i& d)
+{
+    a = _mm256_add_epi32(a, b); d = rotl16(_mm256_xor_si256(d, a));
+    c = _mm256_add_epi32(c, d); b = rotl<12>(_mm256_xor_si256(b, c));
+    a = _mm256_add_epi32(a, b); d = rotl8(_mm256_xor_si256(d, a));
+    c = _mm256_add_epi32(c, d); b = rotl<7>(_mm256_xor_si256(b, c));
+}
+
+// rows[w] holds word w of all 8 lanes, afterwards rows[l] holds words 0..7 of lane l
+inline void transpose8x8(__m256i* rows)
+{
+    __m256i t0 = _mm256_unpacklo_epi32(rows[0], rows[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(rows[0], rows[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(rows[2], rows[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(rows[2], rows[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(rows[4], rows[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(rows[4], rows[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(rows[6], rows[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(rows[6], rows[7]);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    rows[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    rows[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    rows[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    rows[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    rows[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    rows[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    rows[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    rows[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+inline __m256i laneWords(const uint32_t (&words)[LANES])
+{
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words));
+}
+}
+
+void BatchChaCha20Poly1305::xorKeystreamAvx2(Lane* lanes, size_t count)
+{
+    static const uint8_t zeroKey[32] = {};
+    static const uint8_t zeroNonce[12] = {};
+
+    for (size_t group = 0; group < count; group += LANES)
+    {
+        size_t active = std::min(LANES, count - group);
+        Lane* groupLanes = lanes + group;
+
+        // Initial state, word by word across the lanes, idle lanes run on a zero key and are thrown away
+        uint32_t keyWords[8][LANES];
+        uint32_t nonceWords[3][LANES];
+        size_t blocks = 1;
+        for (size_t l = 0; l < LANES; l++)
+        {
+            const uint8_t* key = l < active ? groupLanes[l].key : zeroKey;
+            const uint8_t* nonce = l < active ? groupLanes[l].nonce : zeroNonce;
+            for (int w = 0; w < 8; w++)
+                std::memcpy(&keyWords[w][l], key + 4 * w, 4);
+            for (int w = 0; w < 3; w++)
+                std::memcpy(&nonceWords[w][l], nonce + 4 * w, 4);
+            if (l < active)
+                blocks = std::max(blocks, 1 + (groupLanes[l].size + 63) / 64);
+        }
+
+        __m256i input[16];
+        input[0] = _mm256_set1_epi32(0x61707865);
+        input[1] = _mm256_set1_epi32(0x3320646e);
+        input[2] = _mm256_set1_epi32(0x79622d32);
+        input[3] = _mm256_set1_epi32(0x6b206574);
+        for (int w = 0; w < 8; w++)
+            input[4 + w] = laneWords(keyWords[w]);
+        for (int w = 0; w < 3; w++)
+            input[13 + w] = laneWords(nonceWords[w]);
+
+        // Every lane is at the same block counter, packets all start at block 0
+        for (size_t block = 0; block < blocks; block++)
+        {
+            input[12] = _mm256_set1_epi32(static_cast<int>(block));
+
+            __m256i x[16];
+            for (int i = 0; i < 16; i++)
+                x[i] = input[i];
+
+            for (int round = 0; round < 10; round++)
+            {
+                quarterRound(x[0], x[4], x[8], x[12]);
+                quarterRound(x[1], x[5], x[9], x[13]);
+                quarterRound(x[2], x[6], x[10], x[14]);
+                quarterRound(x[3], x[7], x[11], x[15]);
+                quarterRound(x[0], x[5], x[10], x[15]);
+                quarterRound(x[1], x[6], x[11], x[12]);
+                quarterRound(x[2], x[7], x[8], x[13]);
+                quarterRound(x[3], x[4], x[9], x[14]);
+            }
+
+            for (int i = 0; i < 16; i++)
+                x[i] = _mm256_add_epi32(x[i], input[i]);
+
+            // x[0..7] -> first half of each lane's block, x[8..15] -> second half
+            transpose8x8(x);
+            transpose8x8(x + 8);
+
+            for (size_t l = 0; l < active; l++)
+            {
+                Lane& lane = groupLanes[l];
+                if (block == 0)
+                {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane.polyKey), x[l]);
+                    continue;
+                }
+
+                size_t offset = (block - 1) * 64;
+                if (offset >= lane.size)
+                    continue;
+
+                uint8_t* out = lane.data + offset;
+                if (lane.size - offset >= 64)
+                {
+                    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out));
+                    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out + 32));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_xor_si256(lo, x[l]));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), _mm256_xor_si256(hi, x[8 + l]));
+                }
+                else
+                {
+                    alignas(32) uint8_t keystream[64];
+                    _mm256_store_si256(reinterpret_cast<__m256i*>(keystream), x[l]);
+                    _mm256_store_si256(reinterpret_cast<__m256i*>(keystream + 32), x[8 + l]);
+                    for (size_t b = 0; b < lane.size - offset; b++)
+                        out[b] ^= keystream[b];
+                }
+            }
+        }
+    }
+}
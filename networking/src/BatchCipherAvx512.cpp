@@ -0,0 +1,116 @@
+// Built with AVX-512F enabled (-mavx512f), only called once detectKernel() saw AVX-512F on the CPU
+#include "BatchCipher.hpp"
+#include <algorithm>
+#include <cstring>
+#include <immintrin.h>
+
+namespace
+{
+constexpr size_t LANES = 16;
+
+inline void quarterRound(__m512i& a, __m512i& b, __m512i& c, __m512i& d)
+{
+    a = _mm512_add_epi32(a, b); d = _mm512_rol_epi32(_mm512_xor_si512(d, a), 16);
+    c = _mm512_add_epi32(c, d); b = _mm512_rol_epi32(_mm512_xor_si512(b, c), 12);
+    a = _mm512_add_epi32(a, b); d = _mm512_rol_epi32(_mm512_xor_si512(d, a), 8);
+    c = _mm512_add_epi32(c, d); b = _mm512_rol_epi32(_mm512_xor_si512(b, c), 7);
+}
+}
+
+void BatchChaCha20Poly1305::xorKeystreamAvx512(Lane* lanes, size_t count)
+{
+    static const uint8_t zeroKey[32] = {};
+    static const uint8_t zeroNonce[12] = {};
+
+    // Word w of lane l sits at w * LANES + l once stored, this picks one lane's 16 words back out
+    const __m512i wordStride = _mm512_setr_epi32(0, 16, 32, 48, 64, 80, 96, 112, 128, 144, 160, 176, 192, 208, 224, 240);
+
+    for (size_t group = 0; group < count; group += LANES)
+    {
+        size_t active = std::min(LANES, count - group);
+        Lane* groupLanes = lanes + group;
+
+        alignas(64) uint32_t keyWords[8][LANES];
+        alignas(64) uint32_t nonceWords[3][LANES];
+        size_t blocks = 1;
+        for (size_t l = 0; l < LANES; l++)
+        {
+            const uint8_t* key = l < active ? groupLanes[l].key : zeroKey;
+            const uint8_t* nonce = l < active ? groupLanes[l].nonce : zeroNonce;
+            for (int w = 0; w < 8; w++)
+                std::memcpy(&keyWords[w][l], key + 4 * w, 4);
+            for (int w = 0; w < 3; w++)
+                std::memcpy(&nonceWords[w][l], nonce + 4 * w, 4);
+            if (l < active)
+                blocks = std::max(blocks, 1 + (groupLanes[l].size + 63) / 64);
+        }
+
+        __m512i input[16];
+        input[0] = _mm512_set1_epi32(0x61707865);
+        input[1] = _mm512_set1_epi32(0x3320646e);
+        input[2] = _mm512_set1_epi32(0x79622d32);
+        input[3] = _mm512_set1_epi32(0x6b206574);
+        for (int w = 0; w < 8; w++)
+            input[4 + w] = _mm512_load_si512(keyWords[w]);
+        for (int w = 0; w < 3; w++)
+            input[13 + w] = _mm512_load_si512(nonceWords[w]);
+
+        alignas(64) uint32_t state[16 * LANES];
+        for (size_t block = 0; block < blocks; block++)
+        {
+            input[12] = _mm512_set1_epi32(static_cast<int>(block));
+
+            __m512i x[16];
+            for (int i = 0; i < 16; i++)
+                x[i] = input[i];
+
+            for (int round = 0; round < 10; round++)
+            {
+                quarterRound(x[0], x[4], x[8], x[12]);
+                quarterRound(x[1], x[5], x[9], x[13]);
+                quarterRound(x[2], x[6], x[10], x[14]);
+                quarterRound(x[3], x[7], x[11], x[15]);
+                quarterRound(x[0], x[5], x[10], x[15]);
+                quarterRound(x[1], x[6], x[11], x[12]);
+                quarterRound(x[2], x[7], x[8], x[13]);
+                quarterRound(x[3], x[4], x[9], x[14]);
+            }
+
+            for (int i = 0; i < 16; i++)
+                _mm512_store_si512(state + i * LANES, _mm512_add_epi32(x[i], input[i]));
+
+            for (size_t l = 0; l < active; l++)
+            {
+                Lane& lane = groupLanes[l];
+                __m512i keystream = _mm512_i32gather_epi32(
+                    _mm512_add_epi32(wordStride, _mm512_set1_epi32(static_cast<int>(l))), state, 4);
+
+                if (block == 0)
+                {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lane.polyKey), _mm512_castsi512_si256(keystream));
+                    continue;
+                }
+
+                size_t offset = (block - 1) * 64;
+                if (offset >= lane.size)
+                    continue;
+
+                uint8_t* out = lane.data + offset;
+                size_t length = std::min<size_t>(64, lane.size - offset);
+                // Byte-masked loads / stores would need AVX-512BW, the tail goes through a buffer instead
+                if (length == 64)
+                {
+                    __m512i data = _mm512_loadu_si512(out);
+                    _mm512_storeu_si512(out, _mm512_xor_si512(data, keystream));
+                }
+                else
+                {
+                    alignas(64) uint8_t bytes[64];
+                    _mm512_store_si512(bytes, keystream);
+                    for (size_t b = 0; b < length; b++)
+                        out[b] ^= bytes[b];
+                }
+            }
+        }
+    }
+}
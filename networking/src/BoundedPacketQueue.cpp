@@ -0,0 +1,132 @@
+#include "BoundedPacketQueue.hpp"
+#include <algorithm>
+
+BoundedPacketQueue::BoundedPacketQueue(Parameters parameters)
+    : parameters(parameters),
+      ring(std::max<size_t>(1, parameters.limit))
+{
+}
+
+bool BoundedPacketQueue::push(PacketHandle packet)
+{
+    if (!packet)
+        return false;
+
+    if (!ring.tryPush(packet) && parameters.maxStall.count() > 0)
+    {
+        // Backpressure: hold the reader until the IO thread makes room
+        Clock::time_point start = Clock::now();
+        {
+            std::unique_lock<std::mutex> lock(waitMutex);
+            waitingProducers.fetch_add(1);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            spaceAvailable.wait_for(lock, parameters.maxStall, [this, &packet]() { return ring.tryPush(packet); });
+            waitingProducers.fetch_sub(1);
+        }
+        stalls.fetch_add(1, std::memory_order_relaxed);
+        stallMicroseconds.fetch_add(
+            std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count(), std::memory_order_relaxed);
+    }
+
+    // Still holding the packet: the ring is full
+    while (packet)
+    {
+        if (parameters.dropPolicy == DropPolicy::TAIL)
+        {
+            countDrop(packet);
+            return false;
+        }
+        PacketHandle oldest;
+        if (ring.tryPop(oldest))
+            countDrop(oldest);
+        ring.tryPush(packet);
+    }
+
+    enqueued.fetch_add(1, std::memory_order_relaxed);
+    recordDepth();
+
+    // Pairs with the fence in unschedule(), one of us sees the other
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumerScheduled.load(std::memory_order_relaxed))
+        return false;
+    return !consumerScheduled.exchange(true);
+}
+
+bool BoundedPacketQueue::popBatch(std::vector<PacketHandle>& out, size_t maxPackets)
+{
+    size_t taken = ring.tryPopBatch(out, maxPackets);
+    dequeued.fetch_add(taken, std::memory_order_relaxed);
+    if (taken > 0)
+        notifyWaitingProducers();
+
+    if (ring.hasReady())
+        return true;
+    return !unschedule();
+}
+
+size_t BoundedPacketQueue::clear()
+{
+    size_t discarded = 0;
+    PacketHandle packet;
+    while (ring.tryPop(packet))
+    {
+        packet = PacketHandle();
+        discarded++;
+    }
+    consumerScheduled.store(false);
+    notifyWaitingProducers();
+    return discarded;
+}
+
+size_t BoundedPacketQueue::size() const
+{
+    return ring.size();
+}
+
+BoundedPacketQueue::Stats BoundedPacketQueue::getStats() const
+{
+    Stats current;
+    current.enqueued = enqueued.load(std::memory_order_relaxed);
+    current.dequeued = dequeued.load(std::memory_order_relaxed);
+    current.drops = drops.load(std::memory_order_relaxed);
+    current.droppedBytes = droppedBytes.load(std::memory_order_relaxed);
+    current.stalls = stalls.load(std::memory_order_relaxed);
+    current.stallTime = std::chrono::microseconds(stallMicroseconds.load(std::memory_order_relaxed));
+    current.depth = ring.size();
+    current.maxDepth = maxDepth.load(std::memory_order_relaxed);
+    return current;
+}
+
+bool BoundedPacketQueue::unschedule()
+{
+    consumerScheduled.store(false);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // A push that still saw us scheduled didn't post, so look once more
+    if (ring.hasReady() && !consumerScheduled.exchange(true))
+        return false;
+    return true;
+}
+
+void BoundedPacketQueue::notifyWaitingProducers()
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waitingProducers.load(std::memory_order_relaxed) == 0)
+        return;
+    std::lock_guard<std::mutex> lock(waitMutex);
+    spaceAvailable.notify_all();
+}
+
+void BoundedPacketQueue::countDrop(const PacketHandle& packet)
+{
+    drops.fetch_add(1, std::memory_order_relaxed);
+    droppedBytes.fetch_add(packet.size(), std::memory_order_relaxed);
+}
+
+void BoundedPacketQueue::recordDepth()
+{
+    size_t depth = ring.size();
+    size_t deepest = maxDepth.load(std::memory_order_relaxed);
+    while (depth > deepest && !maxDepth.compare_exchange_weak(deepest, depth, std::memory_order_relaxed))
+    {
+    }
+}
@@ -0,0 +1,143 @@
+#include "BroadcastSuppressor.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+constexpr size_t IPV4_MIN_HEADER = 20;
+constexpr uint8_t IPPROTO_TCP_NUMBER = 6;
+constexpr uint8_t IPPROTO_UDP_NUMBER = 17;
+}
+
+BroadcastSuppressor::BroadcastSuppressor()
+{
+    // Keyed so nobody on the LAN can line up packets that collide on purpose
+    randombytes_buf(key.data(), key.size());
+}
+
+BroadcastSuppressor::Verdict BroadcastSuppressor::inspect(const uint8_t* packet, size_t size, Clock::time_point now,
+    std::chrono::milliseconds collapseWindow, size_t ratePerSource)
+{
+    if ((collapseWindow.count() <= 0 && ratePerSource == 0) || size < IPV4_MIN_HEADER || (packet[0] >> 4) != 4)
+    {
+        stats.passed++;
+        return Verdict::PASS;
+    }
+    size_t headerSize = static_cast<size_t>(packet[0] & 0x0F) * 4;
+    size_t totalSize = (static_cast<size_t>(packet[2]) << 8) | packet[3];
+    size_t ipSize = totalSize >= headerSize && totalSize < size ? totalSize : size;
+    if (headerSize < IPV4_MIN_HEADER || headerSize > ipSize)
+    {
+        stats.passed++;
+        return Verdict::PASS;
+    }
+
+    Fingerprint* slot = nullptr;
+    uint64_t hash = 0;
+    if (collapseWindow.count() > 0)
+    {
+        hash = fingerprint(packet, headerSize, ipSize);
+        slot = &fingerprints[hash % FINGERPRINT_SLOTS];
+        // Measured from the copy that went out, so a packet resent every few ms still goes out once per window
+        if (slot->used && slot->hash == hash && now - slot->sent < collapseWindow)
+        {
+            stats.duplicates++;
+            stats.duplicateBytes += size;
+            return Verdict::DUPLICATE;
+        }
+    }
+
+    if (ratePerSource > 0)
+    {
+        uint64_t source = static_cast<uint64_t>(packet[12]) << 40 | static_cast<uint64_t>(packet[13]) << 32 |
+                          static_cast<uint64_t>(packet[14]) << 24 | static_cast<uint64_t>(packet[15]) << 16;
+        source |= static_cast<uint64_t>(packet[9]) << 48;
+        bool firstFragment = ((packet[6] & 0x1F) | packet[7]) == 0;
+        if ((packet[9] == IPPROTO_UDP_NUMBER || packet[9] == IPPROTO_TCP_NUMBER) && firstFragment && headerSize + 2 <= ipSize)
+            source |= (static_cast<uint64_t>(packet[headerSize]) << 8) | packet[headerSize + 1];
+
+        if (!takeToken(source, now, ratePerSource))
+        {
+            // Not remembered, so the next copy gets its chance once the bucket refills
+            stats.rateLimited++;
+            stats.rateLimitedBytes += size;
+            return Verdict::RATE_LIMITED;
+        }
+    }
+
+    if (slot)
+    {
+        slot->hash = hash;
+        slot->sent = now;
+        slot->used = true;
+    }
+    stats.passed++;
+    return Verdict::PASS;
+}
+
+void BroadcastSuppressor::clear()
+{
+    fingerprints.fill(Fingerprint{});
+    buckets.fill(Bucket{});
+    overflowBucket = Bucket{};
+}
+
+uint64_t BroadcastSuppressor::fingerprint(const uint8_t* packet, size_t headerSize, size_t size) const
+{
+    // Flags / fragment offset, protocol, source and destination, then the hash of the payload
+    uint8_t fields[2 + 1 + 8 + crypto_shorthash_BYTES];
+    std::memcpy(fields, packet + 6, 2);
+    fields[2] = packet[9];
+    std::memcpy(fields + 3, packet + 12, 8);
+    crypto_shorthash(fields + 11, packet + headerSize, size - headerSize, key.data());
+
+    uint8_t out[crypto_shorthash_BYTES];
+    crypto_shorthash(out, fields, sizeof(fields), key.data());
+    uint64_t hash = 0;
+    std::memcpy(&hash, out, sizeof(hash));
+    return hash;
+}
+
+BroadcastSuppressor::Bucket& BroadcastSuppressor::bucketFor(uint64_t source, Clock::time_point now)
+{
+    // Only our own host's broadcasting sockets end up here, a handful at most, so a scan is cheapest
+    Bucket* reusable = nullptr;
+    for (Bucket& bucket : buckets)
+    {
+        if (bucket.used && bucket.source == source)
+            return bucket;
+        // Untouched for a second means refilled to capacity, the same as a fresh bucket
+        if (!reusable && (!bucket.used || now - bucket.refilled >= std::chrono::seconds(1)))
+            reusable = &bucket;
+    }
+
+    if (!reusable)
+        return overflowBucket;
+    reusable->used = false;
+    return *reusable;
+}
+
+bool BroadcastSuppressor::takeToken(uint64_t source, Clock::time_point now, size_t ratePerSource)
+{
+    Bucket& bucket = bucketFor(source, now);
+    double capacity = static_cast<double>(ratePerSource);
+    if (!bucket.used)
+    {
+        // A new source starts with a full second's worth
+        bucket.source = source;
+        bucket.tokens = capacity;
+        bucket.refilled = now;
+        bucket.used = true;
+    }
+    else if (now > bucket.refilled)
+    {
+        double elapsed = std::chrono::duration<double>(now - bucket.refilled).count();
+        bucket.tokens = std::min(capacity, bucket.tokens + elapsed * capacity);
+        bucket.refilled = now;
+    }
+
+    if (bucket.tokens < 1.0)
+        return false;
+    bucket.tokens -= 1.0;
+    return true;
+}
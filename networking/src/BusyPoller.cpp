@@ -0,0 +1,88 @@
+#include "BusyPoller.hpp"
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
+BusyPoller::Stats& BusyPoller::Stats::operator+=(const Stats& other)
+{
+    hits += other.hits;
+    misses += other.misses;
+    skipped += other.skipped;
+    spinTime += other.spinTime;
+    return *this;
+}
+
+BusyPoller::BusyPoller(std::chrono::microseconds budget)
+    : maxBudget(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::nanoseconds>(budget).count())),
+      currentBudget(maxBudget)
+{
+}
+
+void BusyPoller::woke(Clock::time_point blockedAt)
+{
+    if (maxBudget == 0)
+        return;
+    // Traffic is back at gaps a spin would have bridged
+    if (std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - blockedAt).count() <= maxBudget)
+        currentBudget.store(maxBudget, std::memory_order_relaxed);
+}
+
+size_t BusyPoller::run(boost::asio::io_context& context)
+{
+    if (maxBudget == 0)
+        return context.run();
+
+    size_t handlers = 0;
+    while (!context.stopped())
+    {
+        size_t ran = 0;
+        if (spin([&context, &ran]() { ran = context.poll(); return ran > 0 || context.stopped(); }))
+        {
+            handlers += ran;
+            continue;
+        }
+        Clock::time_point blockedAt = Clock::now();
+        ran = context.run_one();
+        woke(blockedAt);
+        if (ran == 0)
+            break;
+        handlers += ran;
+    }
+    return handlers;
+}
+
+BusyPoller::Stats BusyPoller::getStats() const
+{
+    Stats stats;
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.misses = misses.load(std::memory_order_relaxed);
+    stats.skipped = skipped.load(std::memory_order_relaxed);
+    stats.spinTime = std::chrono::microseconds(spinNanoseconds.load(std::memory_order_relaxed) / 1000);
+    return stats;
+}
+
+#ifdef __linux__
+bool BusyPoller::enableSocketBusyPoll(int socketFd, std::chrono::microseconds budget)
+{
+    int microseconds = static_cast<int>(budget.count());
+    return ::setsockopt(socketFd, SOL_SOCKET, SO_BUSY_POLL, &microseconds, sizeof(microseconds)) == 0;
+}
+#endif
+
+void BusyPoller::hit(Clock::duration spun)
+{
+    hits.fetch_add(1, std::memory_order_relaxed);
+    spinNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(spun).count(), std::memory_order_relaxed);
+    currentBudget.store(maxBudget, std::memory_order_relaxed);
+}
+
+void BusyPoller::missed(Clock::duration spun)
+{
+    misses.fetch_add(1, std::memory_order_relaxed);
+    spinNanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(spun).count(), std::memory_order_relaxed);
+    // Back off, the next quiet spell costs half as much
+    int64_t budget = currentBudget.load(std::memory_order_relaxed) / 2;
+    currentBudget.store(budget < MIN_BUDGET_NS ? 0 : budget, std::memory_order_relaxed);
+}
@@ -0,0 +1,149 @@
+#include "CoDelQueue.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// A queue holding less than one full-size packet can't be standing, whatever its head waited
+constexpr size_t MTU_BYTES = 1500;
+}
+
+CoDelQueue::CoDelQueue(Parameters parameters)
+    : parameters(parameters),
+      ring(std::max<size_t>(1, parameters.limit))
+{
+}
+
+void CoDelQueue::push(PacketHandle packet, Clock::time_point now)
+{
+    if (!packet)
+        return;
+    if (count == ring.size())
+    {
+        // Head drop, the packets behind it are the ones still worth delivering
+        Clock::time_point ignored;
+        PacketHandle oldest = popHead(ignored);
+        stats.overflowDrops++;
+        stats.droppedBytes += oldest.size();
+    }
+
+    Entry& entry = ring[(head + count) % ring.size()];
+    byteCount += packet.size();
+    entry.packet = std::move(packet);
+    entry.enqueuedAt = now;
+    count++;
+    stats.enqueued++;
+    stats.maxDepth = std::max(stats.maxDepth, count);
+}
+
+PacketHandle CoDelQueue::pop(Clock::time_point now)
+{
+    bool okToDrop = false;
+    PacketHandle packet = popAndCheck(now, okToDrop);
+
+    if (dropping)
+    {
+        if (!okToDrop)
+        {
+            // Sojourn is back under the target
+            dropping = false;
+        }
+        while (dropping && now >= dropNext)
+        {
+            drop(packet);
+            dropCount++;
+            packet = popAndCheck(now, okToDrop);
+            if (!okToDrop)
+                dropping = false;
+            else
+                dropNext = controlLaw(dropNext);
+        }
+    }
+    else if (okToDrop)
+    {
+        drop(packet);
+        packet = popAndCheck(now, okToDrop);
+        dropping = true;
+        // Coming back soon after the last dropping state, so pick up near the rate that worked then
+        uint32_t delta = dropCount - lastDropCount;
+        dropCount = delta > 1 && now - dropNext < 16 * parameters.interval ? delta : 1;
+        dropNext = controlLaw(now);
+        lastDropCount = dropCount;
+    }
+
+    if (packet)
+        stats.dequeued++;
+    return packet;
+}
+
+size_t CoDelQueue::clear()
+{
+    size_t discarded = count;
+    for (size_t i = 0; i < count; i++)
+        ring[(head + i) % ring.size()].packet = PacketHandle();
+    head = 0;
+    count = 0;
+    byteCount = 0;
+    firstAboveTime = Clock::time_point();
+    dropping = false;
+    return discarded;
+}
+
+CoDelQueue::Stats CoDelQueue::getStats() const
+{
+    Stats current = stats;
+    current.depth = count;
+    return current;
+}
+
+PacketHandle CoDelQueue::popHead(Clock::time_point& enqueuedAt)
+{
+    Entry& entry = ring[head];
+    PacketHandle packet = std::move(entry.packet);
+    enqueuedAt = entry.enqueuedAt;
+    head = (head + 1) % ring.size();
+    count--;
+    byteCount -= packet.size();
+    return packet;
+}
+
+PacketHandle CoDelQueue::popAndCheck(Clock::time_point now, bool& okToDrop)
+{
+    okToDrop = false;
+    if (count == 0)
+    {
+        firstAboveTime = Clock::time_point();
+        return PacketHandle();
+    }
+
+    Clock::time_point enqueuedAt;
+    PacketHandle packet = popHead(enqueuedAt);
+    if (now - enqueuedAt < parameters.target || byteCount <= MTU_BYTES)
+    {
+        firstAboveTime = Clock::time_point();
+    }
+    else if (firstAboveTime == Clock::time_point())
+    {
+        // Above the target, it has to stay there for an interval before it counts
+        firstAboveTime = now + parameters.interval;
+    }
+    else if (now >= firstAboveTime)
+    {
+        okToDrop = true;
+    }
+    return packet;
+}
+
+CoDelQueue::Clock::time_point CoDelQueue::controlLaw(Clock::time_point t) const
+{
+    // Drops come closer together with the square root of how many it took so far
+    auto spacing = std::chrono::duration<double, std::micro>(parameters.interval) / std::sqrt(static_cast<double>(dropCount));
+    return t + std::chrono::duration_cast<Clock::duration>(spacing);
+}
+
+void CoDelQueue::drop(PacketHandle& packet)
+{
+    stats.codelDrops++;
+    stats.droppedBytes += packet.size();
+    packet = PacketHandle();
+}
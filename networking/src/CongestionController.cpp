@@ -0,0 +1,224 @@
+#include "CongestionController.hpp"
+#include <algorithm>
+
+namespace
+{
+constexpr double DRAIN_GAIN = 1.0 / 2.885;
+constexpr double PROBE_WINDOW_GAIN = 2.0;
+// Probe up for one round, drain what that queued for one, then cruise
+constexpr std::array<double, 8> PROBE_GAINS = {1.25, 0.75, 1.0, 1.0, 1.0, 1.0, 1.0, 1.0};
+// Kept out of the flight cap after a lossy round
+constexpr double LOSS_BETA = 0.7;
+// Room for acks that arrive bunched up, on top of the window
+constexpr uint64_t ACK_AGGREGATION_ALLOWANCE = 3 * CongestionController::MAX_DATAGRAM;
+}
+
+void CongestionController::onPacketSent(size_t bytes, uint64_t bytesInFlight, Clock::time_point now)
+{
+    if (stats.pacingRate > 0)
+    {
+        // Credit for idle time is capped at one burst
+        nextSend = std::max(nextSend, now - PACING_BURST);
+        nextSend += std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(bytes) / static_cast<double>(stats.pacingRate)));
+    }
+    // Leaving idle, or a probe past the window: either way the wait for the next ack starts now
+    if (bytesInFlight == 0 || bytesInFlight >= stats.congestionWindow)
+        lastProgress = now;
+}
+
+void CongestionController::onAck(const AckTracker::RateSample& sample, const AckTracker::Stats& ackStats, Clock::time_point now)
+{
+    lastProgress = now;
+
+    roundStart = false;
+    if (sample.valid() && sample.priorDelivered >= nextRoundDelivered)
+    {
+        // The packet this ack settled was sent after the last round began, so that round trip is done
+        nextRoundDelivered = ackStats.bytesDelivered;
+        round++;
+        roundStart = true;
+    }
+
+    if (sample.valid())
+    {
+        bool sampleAppLimited = appLimited && sample.priorDelivered < appLimitedUntil;
+        if (appLimited && ackStats.bytesDelivered >= appLimitedUntil)
+            appLimited = false;
+        if (!sampleAppLimited || sample.rate() > stats.bandwidth)
+            updateBandwidth(sample);
+    }
+    if (ackStats.latestRtt.count() > 0)
+        updateMinRtt(ackStats.latestRtt, now);
+
+    if (roundStart)
+    {
+        uint64_t lost = ackStats.packetsLost > roundStartLost ? ackStats.packetsLost - roundStartLost : 0;
+        uint64_t acked = ackStats.packetsAcked - roundStartAcked;
+        if (lost > 0 && static_cast<double>(lost) / static_cast<double>(lost + acked) > LOSS_THRESHOLD)
+        {
+            // Too much for the path: cap the flight below where it was, and stop doubling if still starting up
+            uint64_t flight = std::max(ackStats.bytesInFlight, bandwidthDelayProduct());
+            inflightHigh = std::max(MIN_WINDOW, static_cast<uint64_t>(static_cast<double>(flight) * LOSS_BETA));
+            stats.lossRounds++;
+            if (stats.state == State::STARTUP)
+            {
+                stats.state = State::DRAIN;
+                pacingGain = DRAIN_GAIN;
+            }
+        }
+        else if (inflightHigh > 0)
+        {
+            // A clean round, feel back towards the model's window
+            inflightHigh += std::max(MAX_DATAGRAM, inflightHigh / 8);
+            if (bandwidthDelayProduct() > 0 && inflightHigh >= 2 * PROBE_WINDOW_GAIN * bandwidthDelayProduct())
+                inflightHigh = 0;
+        }
+        roundStartLost = ackStats.packetsLost;
+        roundStartAcked = ackStats.packetsAcked;
+    }
+
+    updateState(ackStats, now);
+    updateModel();
+}
+
+void CongestionController::onAppLimited(const AckTracker::Stats& ackStats)
+{
+    appLimited = true;
+    appLimitedUntil = std::max<uint64_t>(1, ackStats.bytesDelivered + ackStats.bytesInFlight);
+}
+
+bool CongestionController::canSend(uint64_t bytesInFlight, Clock::time_point now) const
+{
+    if (bytesInFlight >= stats.congestionWindow)
+        return now - lastProgress >= PROBE_TIMEOUT;
+    return stats.pacingRate == 0 || now >= nextSend;
+}
+
+CongestionController::Clock::time_point CongestionController::nextSendTime(uint64_t bytesInFlight) const
+{
+    if (bytesInFlight >= stats.congestionWindow)
+        return lastProgress + PROBE_TIMEOUT;
+    return nextSend;
+}
+
+void CongestionController::onBlocked(uint64_t bytesInFlight)
+{
+    if (bytesInFlight >= stats.congestionWindow)
+        stats.windowLimited++;
+    else
+        stats.pacingDelays++;
+}
+
+void CongestionController::updateBandwidth(const AckTracker::RateSample& sample)
+{
+    uint64_t& slot = bandwidthSamples[round % BANDWIDTH_ROUNDS];
+    if (roundStart)
+        slot = 0;
+    slot = std::max(slot, sample.rate());
+    stats.bandwidth = *std::max_element(bandwidthSamples.begin(), bandwidthSamples.end());
+}
+
+void CongestionController::updateMinRtt(std::chrono::microseconds sample, Clock::time_point now)
+{
+    bool expired = minRtt.count() > 0 && now - minRttStamp > MIN_RTT_WINDOW;
+    if (minRtt.count() == 0 || sample <= minRtt || expired)
+    {
+        minRtt = sample;
+        minRttStamp = now;
+    }
+    stats.minRtt = minRtt;
+
+    if (expired && stats.state != State::PROBE_RTT && stats.state != State::STARTUP)
+    {
+        // Not seen the floor in a while, maybe because we keep a queue ourselves: back off to a few packets to look
+        stats.state = State::PROBE_RTT;
+        pacingGain = 1.0;
+        probeRttDone = now + PROBE_RTT_TIME;
+    }
+}
+
+void CongestionController::updateState(const AckTracker::Stats& ackStats, Clock::time_point now)
+{
+    switch (stats.state)
+    {
+    case State::STARTUP:
+        if (roundStart && !appLimited)
+        {
+            if (static_cast<double>(stats.bandwidth) >= static_cast<double>(fullBandwidth) * 1.25)
+            {
+                fullBandwidth = stats.bandwidth;
+                fullBandwidthRounds = 0;
+            }
+            else if (++fullBandwidthRounds >= 3)
+            {
+                stats.state = State::DRAIN;
+                pacingGain = DRAIN_GAIN;
+            }
+        }
+        break;
+    case State::DRAIN:
+        if (ackStats.bytesInFlight <= bandwidthDelayProduct())
+            enterProbeBw(now);
+        break;
+    case State::PROBE_BW:
+        if (now - cycleStamp > std::max<std::chrono::microseconds>(minRtt, PACING_BURST))
+        {
+            cycleIndex = (cycleIndex + 1) % PROBE_GAINS.size();
+            cycleStamp = now;
+            pacingGain = PROBE_GAINS[cycleIndex];
+        }
+        break;
+    case State::PROBE_RTT:
+        if (now >= probeRttDone)
+        {
+            minRttStamp = now;
+            enterProbeBw(now);
+        }
+        break;
+    }
+}
+
+void CongestionController::updateModel()
+{
+    uint64_t bdp = bandwidthDelayProduct();
+    uint64_t pacingRate = static_cast<uint64_t>(static_cast<double>(stats.bandwidth) * pacingGain);
+    if (stats.state == State::STARTUP)
+    {
+        // Never below the initial window per RTT, and never down while starting up: app-limited samples
+        // from a game's trickle mustn't hold back the first real burst
+        if (minRtt.count() > 0)
+            pacingRate = std::max(pacingRate,
+                static_cast<uint64_t>(STARTUP_GAIN * static_cast<double>(INITIAL_WINDOW * 1000000 / static_cast<uint64_t>(minRtt.count()))));
+        pacingRate = std::max(pacingRate, stats.pacingRate);
+    }
+    stats.pacingRate = pacingRate;
+
+    uint64_t window;
+    if (stats.state == State::PROBE_RTT)
+        window = MIN_WINDOW;
+    else if (bdp == 0)
+        window = INITIAL_WINDOW;
+    else
+        window = static_cast<uint64_t>(static_cast<double>(bdp) * windowGain) + ACK_AGGREGATION_ALLOWANCE;
+    if (stats.state == State::STARTUP)
+        window = std::max(window, INITIAL_WINDOW);
+    if (inflightHigh > 0)
+        window = std::min(window, inflightHigh);
+    stats.congestionWindow = std::max(window, MIN_WINDOW);
+}
+
+uint64_t CongestionController::bandwidthDelayProduct() const
+{
+    return stats.bandwidth * static_cast<uint64_t>(minRtt.count()) / 1000000;
+}
+
+void CongestionController::enterProbeBw(Clock::time_point now)
+{
+    stats.state = State::PROBE_BW;
+    windowGain = PROBE_WINDOW_GAIN;
+    // Start in a cruising phase, the probe comes around soon enough
+    cycleIndex = 2;
+    cycleStamp = now;
+    pacingGain = PROBE_GAINS[cycleIndex];
+}
@@ -0,0 +1,248 @@
+#include "CryptoWorkerPool.hpp"
+#include "logger.hpp"
+#include <algorithm>
+
+CryptoFlow::CryptoFlow(size_t capacity, CompletionCallback callback)
+    : slots(capacity)
+    , onComplete(std::move(callback))
+{
+}
+
+CryptoWorkerPool::CryptoWorkerPool(size_t workerCount)
+    : queue(QUEUE_CAPACITY)
+    , workerStats(std::make_unique<WorkerStats[]>(workerCount))
+    , lastStatsTime(std::chrono::steady_clock::now())
+{
+    workers.reserve(workerCount);
+    for (size_t i = 0; i < workerCount; i++)
+    {
+        workers.emplace_back([this, i]() { workerLoop(i); });
+    }
+    SYSTEM_LOG_INFO("[CryptoWorkerPool] Started {} crypto workers, {} ChaCha20 batch kernel",
+        workerCount, BatchChaCha20Poly1305::kernelName(batchCipher.getKernel()));
+}
+
+CryptoWorkerPool::~CryptoWorkerPool()
+{
+    stop();
+}
+
+size_t CryptoWorkerPool::autoWorkerCount()
+{
+    size_t cores = std::thread::hardware_concurrency();
+    if (cores <= 1)
+        return 0;
+    return std::min(cores - 1, MAX_WORKERS);
+}
+
+std::shared_ptr<CryptoFlow> CryptoWorkerPool::createFlow(CryptoFlow::CompletionCallback callback, size_t capacity)
+{
+    return std::make_shared<CryptoFlow>(capacity, std::move(callback));
+}
+
+bool CryptoWorkerPool::submit(const std::shared_ptr<CryptoFlow>& flow, CryptoJob&& job)
+{
+    // Flow first, then the queue, workers never hold both
+    std::lock_guard<std::mutex> flowLock(flow->flowMutex);
+    if (flow->count == flow->slots.size())
+    {
+        rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> queueLock(queueMutex);
+        if (stopping || queueCount == queue.size())
+        {
+            rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        CryptoFlow::Slot& slot = flow->slots[(flow->head + flow->count) % flow->slots.size()];
+        slot.job = std::move(job);
+        slot.done.store(false, std::memory_order_relaxed);
+        flow->count++;
+
+        QueueEntry& entry = queue[(queueHead + queueCount) % queue.size()];
+        entry.flow = flow;
+        entry.slot = &slot;
+        queueCount++;
+        queueHighWaterMark = std::max(queueHighWaterMark, queueCount);
+    }
+    queueCondition.notify_one();
+    return true;
+}
+
+void CryptoWorkerPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        if (stopping)
+            return;
+        stopping = true;
+    }
+    queueCondition.notify_all();
+
+    for (std::thread& worker : workers)
+    {
+        if (worker.joinable())
+            worker.join();
+    }
+
+    // Let go of the flows (and their packets) still queued
+    std::lock_guard<std::mutex> lock(queueMutex);
+    for (QueueEntry& entry : queue)
+    {
+        entry.flow.reset();
+        entry.slot = nullptr;
+    }
+    queueCount = 0;
+}
+
+CryptoWorkerPool::Stats CryptoWorkerPool::getStats()
+{
+    Stats stats;
+    stats.workers = workers.size();
+    stats.jobs = jobs.load(std::memory_order_relaxed);
+    stats.rejected = rejected.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stats.queueDepth = queueCount;
+        stats.queueHighWaterMark = queueHighWaterMark;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - lastStatsTime).count());
+    lastStatsTime = now;
+
+    stats.utilization.reserve(workers.size());
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        uint64_t busy = workerStats[i].busyNanoseconds.load(std::memory_order_relaxed);
+        uint64_t delta = busy - workerStats[i].lastBusyNanoseconds;
+        workerStats[i].lastBusyNanoseconds = busy;
+        stats.utilization.push_back(elapsed > 0 ? std::min(1.0, delta / elapsed) : 0.0);
+    }
+    return stats;
+}
+
+void CryptoWorkerPool::workerLoop(size_t index)
+{
+    QueueEntry entries[MAX_JOBS_PER_WAKE];
+    while (true)
+    {
+        size_t taken = 0;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this]() { return stopping || queueCount > 0; });
+            if (stopping)
+                return;
+
+            // Our share of the backlog, so one worker doesn't take the whole burst while the others idle
+            taken = std::min(MAX_JOBS_PER_WAKE, std::max<size_t>(1, queueCount / workers.size()));
+            for (size_t i = 0; i < taken; i++)
+            {
+                entries[i] = std::move(queue[queueHead]);
+                queueHead = (queueHead + 1) % queue.size();
+            }
+            queueCount -= taken;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        runJobs(entries, taken);
+        auto busy = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        workerStats[index].busyNanoseconds.fetch_add(busy.count(), std::memory_order_relaxed);
+        jobs.fetch_add(taken, std::memory_order_relaxed);
+
+        for (size_t i = 0; i < taken; i++)
+        {
+            entries[i].slot->done.store(true, std::memory_order_release);
+        }
+        for (size_t i = 0; i < taken; i++)
+        {
+            completeInOrder(*entries[i].flow);
+            entries[i].flow.reset();
+        }
+    }
+}
+
+void CryptoWorkerPool::runJobs(QueueEntry* entries, size_t count) const
+{
+    BatchCipherItem sealItems[MAX_JOBS_PER_WAKE];
+    BatchCipherItem openItems[MAX_JOBS_PER_WAKE];
+    CryptoJob* sealJobs[MAX_JOBS_PER_WAKE];
+    CryptoJob* openJobs[MAX_JOBS_PER_WAKE];
+    size_t sealCount = 0;
+    size_t openCount = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        CryptoJob& job = entries[i].slot->job;
+        if (job.suite != CipherSuite::CHACHA20_POLY1305)
+        {
+            runJob(job);
+            continue;
+        }
+
+        bool sealing = job.operation == CryptoJob::Operation::SEAL;
+        BatchCipherItem& item = sealing ? sealItems[sealCount] : openItems[openCount];
+        uint8_t* header = job.packet.data();
+        item.ad = header;
+        item.adSize = job.headerSize;
+        item.mac = header + job.headerSize;
+        item.data = item.mac + PeerCipher::MAC_SIZE;
+        item.size = job.packet.size() - job.headerSize - PeerCipher::MAC_SIZE;
+        item.key = job.cipher->getAeadKey(job.suite, sealing);
+        PeerCipher::buildAeadNonce(item.nonce, job.sessionId, job.counter);
+
+        if (sealing)
+            sealJobs[sealCount++] = &job;
+        else
+            openJobs[openCount++] = &job;
+    }
+
+    batchCipher.seal(sealItems, sealCount);
+    for (size_t i = 0; i < sealCount; i++)
+        sealJobs[i]->ok = true;
+
+    batchCipher.open(openItems, openCount);
+    for (size_t i = 0; i < openCount; i++)
+        openJobs[i]->ok = openItems[i].ok;
+}
+
+void CryptoWorkerPool::runJob(CryptoJob& job)
+{
+    uint8_t* header = job.packet.data();
+    uint8_t* mac = header + job.headerSize;
+    uint8_t* payload = mac + PeerCipher::MAC_SIZE;
+    size_t payloadSize = job.packet.size() - job.headerSize - PeerCipher::MAC_SIZE;
+
+    if (job.operation == CryptoJob::Operation::SEAL)
+    {
+        job.cipher->seal(job.suite, payload, payloadSize, mac, header, job.headerSize, job.sessionId, job.counter);
+        job.ok = true;
+    }
+    else
+    {
+        job.ok = job.cipher->open(job.suite, payload, payloadSize, mac, header, job.headerSize, job.sessionId, job.counter);
+    }
+}
+
+void CryptoWorkerPool::completeInOrder(CryptoFlow& flow)
+{
+    // Whoever finishes the job at the head drains every finished job behind it,
+    // a worker finishing out of order leaves its job for that one
+    std::lock_guard<std::mutex> lock(flow.flowMutex);
+    while (flow.count > 0)
+    {
+        CryptoFlow::Slot& slot = flow.slots[flow.head];
+        if (!slot.done.load(std::memory_order_acquire))
+            break;
+
+        flow.onComplete(slot.job);
+        slot.job = CryptoJob();
+        slot.done.store(false, std::memory_order_relaxed);
+        flow.head = (flow.head + 1) % flow.slots.size();
+        flow.count--;
+    }
+}
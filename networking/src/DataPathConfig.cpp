@@ -0,0 +1,139 @@
+#include "DataPathConfig.hpp"
+#include "logger.hpp"
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+bool readEnvBool(const char* name, bool fallback)
+{
+    const char* value = std::getenv(name);
+    if (!value)
+        return fallback;
+
+    std::string text(value);
+    if (text == "1" || text == "true" || text == "on")
+        return true;
+    if (text == "0" || text == "false" || text == "off")
+        return false;
+
+    SYSTEM_LOG_WARNING("[DataPathConfig] Ignoring invalid value for {}: {}", name, text);
+    return fallback;
+}
+
+long long readEnvInt(const char* name, long long fallback, long long minValue, long long maxValue)
+{
+    const char* value = std::getenv(name);
+    if (!value)
+        return fallback;
+
+    try
+    {
+        long long parsed = std::stoll(value);
+        if (parsed < minValue || parsed > maxValue)
+        {
+            SYSTEM_LOG_WARNING("[DataPathConfig] {}={} out of range [{}, {}], using {}", name, parsed, minValue, maxValue, fallback);
+            return fallback;
+        }
+        return parsed;
+    }
+    catch (const std::exception&)
+    {
+        SYSTEM_LOG_WARNING("[DataPathConfig] Ignoring invalid value for {}: {}", name, value);
+        return fallback;
+    }
+}
+}
+
+DataPathConfig DataPathConfig::loadConfig()
+{
+    DataPathConfig cfg;
+
+    cfg.batchedIo = readEnvBool("PEERBRIDGE_BATCHED_IO", cfg.batchedIo);
+    cfg.ioBatchSize = static_cast<size_t>(
+        readEnvInt("PEERBRIDGE_IO_BATCH_SIZE", static_cast<long long>(cfg.ioBatchSize), 1, 1024));
+    cfg.batchFlushDeadline = std::chrono::microseconds(
+        readEnvInt("PEERBRIDGE_BATCH_FLUSH_US", cfg.batchFlushDeadline.count(), 0, 10000));
+    cfg.ioUring = readEnvBool("PEERBRIDGE_IO_URING", cfg.ioUring);
+    cfg.socketShards = static_cast<size_t>(
+        readEnvInt("PEERBRIDGE_SOCKET_SHARDS", static_cast<long long>(cfg.socketShards), 1, 64));
+    cfg.pinShardThreads = readEnvBool("PEERBRIDGE_SHARD_PIN", cfg.pinShardThreads);
+    cfg.ioThreads = static_cast<size_t>(
+        readEnvInt("PEERBRIDGE_IO_THREADS", static_cast<long long>(cfg.ioThreads), 1, 64));
+    cfg.busyPollBudget = std::chrono::microseconds(
+        readEnvInt("PEERBRIDGE_BUSY_POLL_US", cfg.busyPollBudget.count(), 0, 10000));
+    cfg.maxProtocolVersion = static_cast<uint8_t>(
+        readEnvInt("PEERBRIDGE_PROTOCOL_VERSION", cfg.maxProtocolVersion, 1, 2));
+    if (const char* cipher = std::getenv("PEERBRIDGE_CIPHER"))
+    {
+        std::string name(cipher);
+        cfg.cipherSuite = PeerCipher::parseSuite(name);
+        if (!cfg.cipherSuite && name != "auto")
+            SYSTEM_LOG_WARNING("[DataPathConfig] Ignoring invalid value for PEERBRIDGE_CIPHER: {}", name);
+    }
+    cfg.cryptoWorkers = static_cast<int>(
+        readEnvInt("PEERBRIDGE_CRYPTO_WORKERS", cfg.cryptoWorkers, -1, 64));
+    cfg.ackDelay = std::chrono::milliseconds(
+        readEnvInt("PEERBRIDGE_ACK_DELAY_MS", cfg.ackDelay.count(), 1, 1000));
+    cfg.groupBroadcast = readEnvBool("PEERBRIDGE_GROUP_BROADCAST", cfg.groupBroadcast);
+    cfg.relayFanout = static_cast<size_t>(
+        readEnvInt("PEERBRIDGE_RELAY_FANOUT", static_cast<long long>(cfg.relayFanout), 0, 16));
+    cfg.multicastSnooping = readEnvBool("PEERBRIDGE_MULTICAST_SNOOPING", cfg.multicastSnooping);
+    cfg.broadcastCollapseWindow = std::chrono::milliseconds(
+        readEnvInt("PEERBRIDGE_BROADCAST_COLLAPSE_MS", cfg.broadcastCollapseWindow.count(), 0, 10000));
+    cfg.broadcastRateLimit = static_cast<size_t>(
+        readEnvInt("PEERBRIDGE_BROADCAST_RATE", static_cast<long long>(cfg.broadcastRateLimit), 0, 100000));
+    cfg.sendScheduler = readEnvBool("PEERBRIDGE_SEND_SCHEDULER", cfg.sendScheduler);
+    cfg.priorityPacketBytes = static_cast<size_t>(
+        readEnvInt("PEERBRIDGE_PRIORITY_PACKET_BYTES", static_cast<long long>(cfg.priorityPacketBytes), 0, 1500));
+    cfg.congestionControl = readEnvBool("PEERBRIDGE_CONGESTION_CONTROL", cfg.congestionControl);
+    cfg.tunBacklogLimit = static_cast<size_t>(
+        readEnvInt("PEERBRIDGE_TUN_BACKLOG", static_cast<long long>(cfg.tunBacklogLimit), 16, 65536));
+    if (const char* drop = std::getenv("PEERBRIDGE_TUN_BACKLOG_DROP"))
+    {
+        std::string policy(drop);
+        if (policy == "tail")
+            cfg.tunBacklogDrop = BoundedPacketQueue::DropPolicy::TAIL;
+        else if (policy == "head")
+            cfg.tunBacklogDrop = BoundedPacketQueue::DropPolicy::HEAD;
+        else
+            SYSTEM_LOG_WARNING("[DataPathConfig] Ignoring invalid value for PEERBRIDGE_TUN_BACKLOG_DROP: {}", policy);
+    }
+    cfg.tunBackpressure = std::chrono::microseconds(
+        readEnvInt("PEERBRIDGE_TUN_BACKPRESSURE_US", cfg.tunBackpressure.count(), 0, 1000000));
+    cfg.tunQueueCount = static_cast<size_t>(
+        readEnvInt("PEERBRIDGE_TUN_QUEUES", static_cast<long long>(cfg.tunQueueCount), 0, 64));
+    cfg.tunQueueLimit = static_cast<size_t>(
+        readEnvInt("PEERBRIDGE_TUN_QUEUE_LIMIT", static_cast<long long>(cfg.tunQueueLimit), 16, 65536));
+    cfg.tunCodelTarget = std::chrono::microseconds(
+        readEnvInt("PEERBRIDGE_TUN_CODEL_TARGET_US", cfg.tunCodelTarget.count(), 100, 1000000));
+    cfg.tunCodelInterval = std::chrono::milliseconds(
+        readEnvInt("PEERBRIDGE_TUN_CODEL_INTERVAL_MS", cfg.tunCodelInterval.count(), 1, 10000));
+
+    SYSTEM_LOG_INFO("[DataPathConfig] Batched I/O: {}, batch size: {}, flush deadline: {}us",
+        cfg.batchedIo, cfg.ioBatchSize, cfg.batchFlushDeadline.count());
+    SYSTEM_LOG_INFO("[DataPathConfig] io_uring: {}", cfg.ioUring);
+    SYSTEM_LOG_INFO("[DataPathConfig] Socket shards: {}, pinned: {}", cfg.socketShards, cfg.pinShardThreads);
+    SYSTEM_LOG_INFO("[DataPathConfig] IO threads: {}", cfg.ioThreads);
+    SYSTEM_LOG_INFO("[DataPathConfig] Busy poll: {}", cfg.busyPollBudget.count() > 0
+        ? std::to_string(cfg.busyPollBudget.count()) + "us" : std::string("off"));
+    SYSTEM_LOG_INFO("[DataPathConfig] Max protocol version: {}, cipher suite: {}",
+        cfg.maxProtocolVersion, cfg.cipherSuite ? PeerCipher::suiteName(*cfg.cipherSuite) : "auto");
+    SYSTEM_LOG_INFO("[DataPathConfig] Crypto workers: {}", cfg.cryptoWorkers < 0 ? std::string("auto") : std::to_string(cfg.cryptoWorkers));
+    SYSTEM_LOG_INFO("[DataPathConfig] Ack delay: {}ms", cfg.ackDelay.count());
+    SYSTEM_LOG_INFO("[DataPathConfig] Group-key broadcast: {}", cfg.groupBroadcast);
+    SYSTEM_LOG_INFO("[DataPathConfig] Broadcast relay fan-out: {}", cfg.relayFanout);
+    SYSTEM_LOG_INFO("[DataPathConfig] Multicast snooping: {}", cfg.multicastSnooping);
+    SYSTEM_LOG_INFO("[DataPathConfig] Broadcast collapse window: {}ms, rate limit per source: {}/s",
+        cfg.broadcastCollapseWindow.count(), cfg.broadcastRateLimit);
+    SYSTEM_LOG_INFO("[DataPathConfig] Send scheduler: {}, priority packets up to {}B, congestion control: {}",
+        cfg.sendScheduler, cfg.priorityPacketBytes, cfg.congestionControl && cfg.sendScheduler);
+    SYSTEM_LOG_INFO("[DataPathConfig] TUN backlog: {}, {}-drop after {}us of backpressure",
+        cfg.tunBacklogLimit, cfg.tunBacklogDrop == BoundedPacketQueue::DropPolicy::HEAD ? "head" : "tail",
+        cfg.tunBackpressure.count());
+    SYSTEM_LOG_INFO("[DataPathConfig] TUN queues: {}", cfg.tunQueueCount == 0 ? std::string("auto") : std::to_string(cfg.tunQueueCount));
+    SYSTEM_LOG_INFO("[DataPathConfig] TUN queue limit: {}, CoDel target: {}us, interval: {}ms",
+        cfg.tunQueueLimit, cfg.tunCodelTarget.count(), cfg.tunCodelInterval.count());
+
+    return cfg;
+}
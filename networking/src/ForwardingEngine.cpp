@@ -0,0 +1,85 @@
+#include "ForwardingEngine.hpp"
+
+namespace
+{
+constexpr uint32_t SUBNET_MASK = 0xFFFFFF00;
+constexpr uint32_t LIMITED_BROADCAST_IP = 0xFFFFFFFF;
+
+// Destination address of a well-formed IPv4 header, 0 (never routed) otherwise
+uint32_t destinationOf(const uint8_t* packet, size_t size)
+{
+    if (size < ForwardingEngine::IPV4_MIN_HEADER)
+        return 0;
+    size_t headerSize = static_cast<size_t>(packet[0] & 0x0F) * 4;
+    if ((packet[0] >> 4) != 4 || headerSize < ForwardingEngine::IPV4_MIN_HEADER || headerSize > size)
+        return 0;
+    return (static_cast<uint32_t>(packet[16]) << 24) | (static_cast<uint32_t>(packet[17]) << 16) |
+           (static_cast<uint32_t>(packet[18]) << 8) | packet[19];
+}
+}
+
+ForwardingEngine::ForwardingEngine()
+{
+    octetRoutes.fill(Route());
+}
+
+void ForwardingEngine::compile(uint32_t selfIp, uint32_t broadcastIp)
+{
+    subnet = broadcastIp & SUBNET_MASK;
+    selfVirtualIp = selfIp;
+    subnetBroadcastIp = broadcastIp;
+    clearPeers();
+}
+
+void ForwardingEngine::clearPeers()
+{
+    octetRoutes.fill(Route());
+    if (subnetBroadcastIp == 0)
+        return;
+    octetRoutes[subnetBroadcastIp & 0xFF].action = Action::BROADCAST;
+    if ((selfVirtualIp & SUBNET_MASK) == subnet)
+        octetRoutes[selfVirtualIp & 0xFF].action = Action::LOCAL;
+}
+
+void ForwardingEngine::setPeerSlot(uint32_t virtualIp, uint16_t slot)
+{
+    if ((virtualIp & SUBNET_MASK) != subnet)
+        return;
+    Route& route = octetRoutes[virtualIp & 0xFF];
+    if (route.action == Action::DROP || route.action == Action::UNICAST)
+    {
+        route.action = Action::UNICAST;
+        route.peerSlot = slot;
+    }
+}
+
+ForwardingEngine::Route ForwardingEngine::classify(const uint8_t* packet, size_t size) const
+{
+    return routeFor(destinationOf(packet, size));
+}
+
+void ForwardingEngine::classifyBatch(const PacketHandle* packets, size_t count, Route* routes) const
+{
+    // Headers first, then the lookups in one tight loop with no per-packet pointer chasing
+    constexpr size_t CHUNK = 64;
+    uint32_t dstIps[CHUNK];
+    for (size_t start = 0; start < count; start += CHUNK)
+    {
+        size_t chunk = count - start < CHUNK ? count - start : CHUNK;
+        for (size_t i = 0; i < chunk; i++)
+            dstIps[i] = packets[start + i] ? destinationOf(packets[start + i].data(), packets[start + i].size()) : 0;
+        for (size_t i = 0; i < chunk; i++)
+            routes[start + i] = routeFor(dstIps[i]);
+    }
+}
+
+ForwardingEngine::Route ForwardingEngine::routeFor(uint32_t dstIp) const
+{
+    // The table load happens either way, outside the subnet only broadcast and multicast are left
+    Route subnetRoute = octetRoutes[dstIp & 0xFF];
+    Route outside;
+    outside.action = dstIp == LIMITED_BROADCAST_IP ? Action::BROADCAST
+                   : (dstIp >> 28) == 14 ? Action::MULTICAST
+                   : Action::DROP;
+    return (dstIp & SUBNET_MASK) == subnet && dstIp != 0 ? subnetRoute : outside;
+}
@@ -1,7 +1,7 @@
 #include "IPCServer.hpp"
 #include "SystemStateManager.hpp"
 #include "Utils.hpp"
-#include "Logger.hpp"
+#include "logger.hpp"
 #include <iostream>
 #include <vector>
 #include <map>
@@ -195,7 +195,7 @@ grpc::Status IPCServer::StartConnection(
         }
     }
 
-    NetworkConfigManager::SetupConfig setupConfig = networkConfigManager->getSetupConfig();
+    INetworkConfigManager::SetupConfig setupConfig = networkConfigManager->getSetupConfig();
     auto peerMap = utils::parsePeerInfo(peerInfo, setupConfig.IP_SPACE, self_index);
 
     if (peerMap.empty())
@@ -275,6 +275,42 @@ grpc::Status IPCServer::GetConnectionStatus(
     return grpc::Status::OK;
 }
 
+grpc::Status IPCServer::SetPortPriorities(
+    grpc::ServerContext* context,
+    const peerbridge::SetPortPrioritiesRequest* request,
+    peerbridge::SetPortPrioritiesResponse* reply)
+{
+    SYSTEM_LOG_INFO("[IPCServer]: SetPortPriorities called with {} ports", request->ports_size());
+
+    PortPriorities priorities;
+    for (const peerbridge::PortPriorityEntry& entry : request->ports())
+    {
+        if (entry.port() <= 0 || entry.port() > 65535)
+        {
+            std::string errorMsg = "Invalid port " + std::to_string(entry.port());
+            reply->set_success(false);
+            reply->set_error_message(errorMsg);
+            SYSTEM_LOG_ERROR("[IPCServer]: Error: {}", errorMsg);
+            return grpc::Status::OK;
+        }
+
+        PortPriority priority = PortPriority::NORMAL;
+        switch (entry.priority())
+        {
+            case peerbridge::GAME: priority = PortPriority::GAME; break;
+            case peerbridge::BULK: priority = PortPriority::BULK; break;
+            default: break;
+        }
+        SYSTEM_LOG_INFO("[IPCServer] Port {}: {}", entry.port(), peerbridge::PortPriority_Name(entry.priority()));
+        priorities[static_cast<uint16_t>(entry.port())] = priority;
+    }
+
+    stateManager->queueEvent(NetworkEventData(NetworkEvent::SET_PORT_PRIORITIES, priorities));
+    reply->set_success(true);
+    reply->set_error_message("");
+    return grpc::Status::OK;
+}
+
 // Example RPC method implementation
 // grpc::Status IPCServer::SomeEvent(
 //      grpc::ServerContext* context, 
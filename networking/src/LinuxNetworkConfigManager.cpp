@@ -0,0 +1,261 @@
+#include "Utils.hpp"
+#include "LinuxNetworkConfigManager.hpp"
+#include "logger.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+namespace
+{
+// Accept rules for the virtual subnet, inserted on setup and deleted on reset
+std::vector<std::string> firewallRule(const std::string& action, const std::string& chain,
+    const std::string& interfaceFlag, const std::string& alias, const std::string& subnet)
+{
+    std::string addressFlag = chain == "INPUT" ? "-s" : "-d";
+    return {"iptables", action, chain, interfaceFlag, alias, addressFlag, subnet, "-j", "ACCEPT"};
+}
+}
+
+LinuxNetworkConfigManager::LinuxNetworkConfigManager() : setupConfig{SetupConfig::loadConfig()}
+{}
+
+bool LinuxNetworkConfigManager::configureInterface(const ConnectionConfig& connectionConfig)
+{
+    routeApproach = RouteConfigApproach::GENERIC_ROUTE;
+
+    if (!setupRouting(connectionConfig))
+    {
+        SYSTEM_LOG_ERROR("[Network Config Manager] Interface configuration failed, removing any routes that succeded");
+        removeRouting(connectionConfig.peerVirtualIps);
+        return false;
+    }
+    setupFirewall();
+    SYSTEM_LOG_INFO("[Network Config Manager] Interface configuration successful");
+    return true;
+}
+
+bool LinuxNetworkConfigManager::setupRouting(const ConnectionConfig& connectionConfig)
+{
+    std::string networkAddr = setupConfig.IP_SPACE + std::to_string(NetworkConstants::BASE_IP_INDEX);
+    std::string subnet = networkAddr + "/" + std::to_string(maskBits());
+    const std::string& selfVirtualIp = connectionConfig.selfVirtualIp;
+
+    SYSTEM_LOG_INFO("[Network Config Manager] Setting up routing on private IP Space: {}", networkAddr);
+    SYSTEM_LOG_INFO("[Network Config Manager] Setting self (static) ip as: {}", selfVirtualIp);
+
+    // The subnet route is added below, so the address must not bring its own
+    if (!executeCommand({"ip", "addr", "replace", selfVirtualIp + "/" + std::to_string(maskBits()),
+            "dev", narrowAlias, "noprefixroute"}))
+    {
+        SYSTEM_LOG_ERROR("[Network Config Manager] Failed to set up self ip, cancelling connection");
+        routeApproach = RouteConfigApproach::FAILED;
+        return false;
+    }
+
+    if (!executeCommand({"ip", "link", "set", "dev", narrowAlias, "up"}))
+    {
+        SYSTEM_LOG_ERROR("[Network Config Manager] Failed to bring {} up", narrowAlias);
+        routeApproach = RouteConfigApproach::FAILED;
+        return false;
+    }
+
+    if (!executeCommand({"ip", "route", "replace", subnet, "dev", narrowAlias, "metric", "1"}))
+    {
+        SYSTEM_LOG_WARNING("[Network Config Manager] Subnet route failed, trying to add direct routes...");
+        routeApproach = RouteConfigApproach::FALLBACK_ROUTE_ALL;
+
+        bool successAll = true;
+        for (const auto& peerIP : connectionConfig.peerVirtualIps)
+        {
+            if (!executeCommand({"ip", "route", "replace", peerIP + "/32", "dev", narrowAlias, "metric", "1"}))
+            {
+                SYSTEM_LOG_WARNING("[Network Config Manager] Failed to add route for peer: {}", peerIP);
+                successAll = false;
+            }
+        }
+
+        if (!successAll)
+        {
+            SYSTEM_LOG_WARNING("[Network Config Manager] Failed to peer specific routes for virtual network, connection may be limited");
+            routeApproach = RouteConfigApproach::FAILED;
+        }
+    }
+
+    if (!setForwarding(true))
+    {
+        SYSTEM_LOG_ERROR("[Network Config Manager] Failed to enable forwarding on interface");
+        return false;
+    }
+
+    // Multicast route, for discovery
+    if (!executeCommand({"ip", "route", "replace", NetworkConstants::MULTICAST_SUBNET_RANGE,
+            "dev", narrowAlias, "metric", "1"}))
+    {
+        SYSTEM_LOG_WARNING("[Network Config Manager] Failed to add route for multicast traffic, discovery may be limited.");
+    }
+
+    SYSTEM_LOG_INFO("[Network Config Manager] Routing configured for virtual network");
+    return true;
+}
+
+void LinuxNetworkConfigManager::setupFirewall()
+{
+    SYSTEM_LOG_INFO("[Network Config Manager] Setting up firewall rules");
+    std::string subnet = setupConfig.IP_SPACE + std::to_string(NetworkConstants::BASE_IP_INDEX) + "/" +
+        std::to_string(maskBits());
+
+    // Hosts without iptables usually have no filtering in the way either, so failures only warn
+    if (!executeCommand(firewallRule("-I", "INPUT", "-i", narrowAlias, subnet)))
+    {
+        SYSTEM_LOG_WARNING("[Network Config Manager] Failed to add inbound firewall rule. Connectivity may be limited.");
+    }
+
+    if (!executeCommand(firewallRule("-I", "OUTPUT", "-o", narrowAlias, subnet)))
+    {
+        SYSTEM_LOG_WARNING("[Network Config Manager] Failed to add outbound firewall rule. Connectivity may be limited.");
+    }
+}
+
+void LinuxNetworkConfigManager::resetInterfaceConfiguration(const std::vector<std::string>& peerVirtualIps)
+{
+    bool success = removeRouting(peerVirtualIps);
+    if (!success)
+        SYSTEM_LOG_INFO("[Network Config Manager] Failed to remove routing");
+    removeFirewall();
+}
+
+bool LinuxNetworkConfigManager::removeRouting(const std::vector<std::string>& peerVirtualIps)
+{
+    std::string networkAddr = setupConfig.IP_SPACE + std::to_string(NetworkConstants::BASE_IP_INDEX);
+    std::string subnet = networkAddr + "/" + std::to_string(maskBits());
+
+    SYSTEM_LOG_INFO("[Network Config Manager] Removing routing on private IP Space: {}", networkAddr);
+
+    bool success = true;
+
+    switch (routeApproach)
+    {
+        case RouteConfigApproach::GENERIC_ROUTE:
+        {
+            if (!executeCommand({"ip", "route", "del", subnet, "dev", narrowAlias}))
+            {
+                SYSTEM_LOG_INFO("[Network Config Manager] Failed to remove generic route");
+                success = false;
+            }
+            break;
+        }
+        case RouteConfigApproach::FALLBACK_ROUTE_ALL:
+        {
+            for (const auto& peerIP : peerVirtualIps)
+            {
+                if (!executeCommand({"ip", "route", "del", peerIP + "/32", "dev", narrowAlias}))
+                {
+                    SYSTEM_LOG_INFO("[Network Config Manager] Failed to remove per-peer specific routes");
+                    success = false;
+                }
+            }
+            break;
+        }
+        case RouteConfigApproach::FAILED:
+        default:
+            break;
+    }
+
+    if (!executeCommand({"ip", "route", "del", NetworkConstants::MULTICAST_SUBNET_RANGE, "dev", narrowAlias}))
+        SYSTEM_LOG_INFO("[Network Config Manager] Failed to remove multicast routing");
+
+    if (!executeCommand({"ip", "addr", "flush", "dev", narrowAlias}))
+    {
+        SYSTEM_LOG_INFO("[Network Config Manager] Failed to remove self (static) ip");
+        success = false;
+    }
+
+    if (!setForwarding(false))
+        SYSTEM_LOG_INFO("[Network Config Manager] Failed to disable forwarding on interface");
+
+    return success;
+}
+
+void LinuxNetworkConfigManager::removeFirewall()
+{
+    SYSTEM_LOG_INFO("[Network Config Manager] Removing firewall rules");
+    std::string subnet = setupConfig.IP_SPACE + std::to_string(NetworkConstants::BASE_IP_INDEX) + "/" +
+        std::to_string(maskBits());
+
+    if (!executeCommand(firewallRule("-D", "INPUT", "-i", narrowAlias, subnet)))
+    {
+        SYSTEM_LOG_WARNING("[Network Config Manager] Failed to remove inbound firewall rule");
+    }
+
+    if (!executeCommand(firewallRule("-D", "OUTPUT", "-o", narrowAlias, subnet)))
+    {
+        SYSTEM_LOG_WARNING("[Network Config Manager] Failed to remove outbound firewall rule");
+    }
+}
+
+int LinuxNetworkConfigManager::maskBits() const
+{
+    return __builtin_popcount(utils::ipToUint32(NetworkConstants::NET_MASK));
+}
+
+bool LinuxNetworkConfigManager::setForwarding(bool enabled)
+{
+    std::ofstream forwarding("/proc/sys/net/ipv4/conf/" + narrowAlias + "/forwarding");
+    forwarding << (enabled ? "1" : "0");
+    forwarding.close();
+    return !forwarding.fail();
+}
+
+bool LinuxNetworkConfigManager::executeCommand(const std::vector<std::string>& args)
+{
+    std::string fullCommand;
+    std::vector<char*> argv;
+    for (const auto& arg : args)
+    {
+        fullCommand += (fullCommand.empty() ? "" : " ") + arg;
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    SYSTEM_LOG_INFO("[Network Config Manager] Executing: {}", fullCommand);
+
+    pid_t pid;
+    int spawnError = ::posix_spawnp(&pid, argv[0], nullptr, nullptr, argv.data(), environ);
+    if (spawnError != 0)
+    {
+        SYSTEM_LOG_WARNING("[Network Config Manager] Failed to execute command: {}: {}", fullCommand,
+            std::strerror(spawnError));
+        return false;
+    }
+
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            SYSTEM_LOG_WARNING("[Network Config Manager] Failed to get process exit code: {}", std::strerror(errno));
+            return false;
+        }
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        SYSTEM_LOG_WARNING("[Network Config Manager] Command failed with status: {}", status);
+        return false;
+    }
+    return true;
+}
+
+void LinuxNetworkConfigManager::setNarrowAlias(const std::string& nAlias)
+{
+    narrowAlias = nAlias;
+}
+
+LinuxNetworkConfigManager::SetupConfig LinuxNetworkConfigManager::getSetupConfig()
+{
+    return setupConfig;
+}
@@ -0,0 +1,418 @@
+#include "LinuxTunInterface.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+LinuxTunInterface::LinuxTunInterface(size_t requestedQueues, std::shared_ptr<PacketBufferPool> packetPool,
+    CoDelQueue::Parameters queueParameters, std::chrono::microseconds busyPoll)
+    : queueParameters(queueParameters),
+      busyPoll(busyPoll),
+      packetPool(packetPool ? std::move(packetPool) : PacketBufferPool::create())
+{
+    if (requestedQueues == 0)
+    {
+        requestedQueues = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    queueCount = std::min(requestedQueues, MAX_QUEUES);
+}
+
+LinuxTunInterface::~LinuxTunInterface()
+{
+    close();
+}
+
+bool LinuxTunInterface::openQueue(Queue& queue, const std::string& deviceName)
+{
+    queue.fd = ::open("/dev/net/tun", O_RDWR | O_CLOEXEC);
+    if (queue.fd < 0)
+    {
+        SYSTEM_LOG_ERROR("[LinuxTunInterface] Failed to open /dev/net/tun: {}", std::strerror(errno));
+        return false;
+    }
+
+    ifreq ifr{};
+    // Raw IP packets, no extra packet info header, same as what Wintun hands us
+    ifr.ifr_flags = IFF_TUN | IFF_NO_PI;
+    if (queueCount > 1)
+        ifr.ifr_flags |= IFF_MULTI_QUEUE;
+    std::strncpy(ifr.ifr_name, deviceName.c_str(), IFNAMSIZ - 1);
+
+    if (::ioctl(queue.fd, TUNSETIFF, &ifr) < 0)
+    {
+        SYSTEM_LOG_ERROR("[LinuxTunInterface] TUNSETIFF failed for {}: {}; run as root or with CAP_NET_ADMIN",
+            deviceName, std::strerror(errno));
+        ::close(queue.fd);
+        queue.fd = -1;
+        return false;
+    }
+    interfaceName = ifr.ifr_name;
+
+    // Readers drain until EAGAIN, so the descriptor has to be non-blocking
+    int flags = ::fcntl(queue.fd, F_GETFL, 0);
+    ::fcntl(queue.fd, F_SETFL, flags | O_NONBLOCK);
+
+    queue.epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (queue.epollFd < 0)
+    {
+        SYSTEM_LOG_ERROR("[LinuxTunInterface] epoll_create1 failed: {}", std::strerror(errno));
+        return false;
+    }
+
+    epoll_event tunEvent{};
+    tunEvent.events = EPOLLIN;
+    tunEvent.data.fd = queue.fd;
+    epoll_event stopEvent{};
+    stopEvent.events = EPOLLIN;
+    stopEvent.data.fd = stopEventFd;
+
+    if (::epoll_ctl(queue.epollFd, EPOLL_CTL_ADD, queue.fd, &tunEvent) < 0 ||
+        ::epoll_ctl(queue.epollFd, EPOLL_CTL_ADD, stopEventFd, &stopEvent) < 0)
+    {
+        SYSTEM_LOG_ERROR("[LinuxTunInterface] epoll_ctl failed: {}", std::strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+bool LinuxTunInterface::setInterfaceUp()
+{
+    int controlSocket = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (controlSocket < 0)
+    {
+        SYSTEM_LOG_ERROR("[LinuxTunInterface] Failed to open control socket: {}", std::strerror(errno));
+        return false;
+    }
+
+    ifreq ifr{};
+    std::strncpy(ifr.ifr_name, interfaceName.c_str(), IFNAMSIZ - 1);
+
+    // A read into a buffer smaller than the packet silently truncates it, so size the buffers by the MTU
+    if (::ioctl(controlSocket, SIOCGIFMTU, &ifr) == 0 && ifr.ifr_mtu > 0)
+    {
+        maxPacketSize = static_cast<size_t>(ifr.ifr_mtu);
+    }
+
+    bool success = ::ioctl(controlSocket, SIOCGIFFLAGS, &ifr) == 0;
+    if (success)
+    {
+        ifr.ifr_flags |= IFF_UP | IFF_RUNNING;
+        success = ::ioctl(controlSocket, SIOCSIFFLAGS, &ifr) == 0;
+    }
+
+    if (!success)
+        SYSTEM_LOG_ERROR("[LinuxTunInterface] Failed to bring {} up: {}", interfaceName, std::strerror(errno));
+
+    ::close(controlSocket);
+    return success;
+}
+
+bool LinuxTunInterface::initialize(const std::string& deviceName)
+{
+    stopEventFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (stopEventFd < 0)
+    {
+        SYSTEM_LOG_ERROR("[LinuxTunInterface] eventfd failed: {}", std::strerror(errno));
+        return false;
+    }
+
+    // The first open creates the device, the rest attach extra queues to it
+    for (size_t i = 0; i < queueCount; i++)
+    {
+        auto queue = std::make_unique<Queue>(queueParameters, busyPoll);
+        if (!openQueue(*queue, deviceName))
+        {
+            queues.push_back(std::move(queue));
+            close();
+            return false;
+        }
+        queues.push_back(std::move(queue));
+    }
+
+    if (!setInterfaceUp())
+    {
+        close();
+        return false;
+    }
+
+    SYSTEM_LOG_INFO("[LinuxTunInterface] TUN device {} initialized with {} queue(s)", interfaceName, queueCount);
+    return true;
+}
+
+bool LinuxTunInterface::startPacketProcessing()
+{
+    if (queues.empty())
+    {
+        SYSTEM_LOG_ERROR("[LinuxTunInterface] Device not initialized");
+        return false;
+    }
+
+    if (running)
+    {
+        SYSTEM_LOG_ERROR("[LinuxTunInterface] Packet processing already running");
+        return false;
+    }
+
+    // Drain any leftover stop signal from a previous run
+    uint64_t drained;
+    while (::read(stopEventFd, &drained, sizeof(drained)) > 0) {}
+
+    running = true;
+
+    for (auto& queue : queues)
+    {
+        queue->outgoingPackets.start();
+        queue->readerThread = std::thread(&LinuxTunInterface::readerThreadFunc, this, std::ref(*queue));
+        queue->writerThread = std::thread(&LinuxTunInterface::writerThreadFunc, this, std::ref(*queue));
+    }
+
+    SYSTEM_LOG_INFO("[LinuxTunInterface] Packet processing started on {} queue(s)", queues.size());
+    return true;
+}
+
+void LinuxTunInterface::stopPacketProcessing()
+{
+    running = false;
+
+    // Wake the readers and writers
+    uint64_t one = 1;
+    if (stopEventFd >= 0)
+        ::write(stopEventFd, &one, sizeof(one));
+
+    for (auto& queue : queues)
+        queue->outgoingPackets.stop();
+
+    size_t discarded = 0;
+    for (auto& queue : queues)
+    {
+        if (queue->readerThread.joinable())
+            queue->readerThread.join();
+        if (queue->writerThread.joinable())
+            queue->writerThread.join();
+
+        discarded += queue->outgoingPackets.clear();
+    }
+
+    CoDelQueue::Stats stats = getQueueStats();
+    SYSTEM_LOG_INFO("[LinuxTunInterface] Packet processing stopped, {} queued packet(s) discarded; "
+        "{} written, {} CoDel drops, {} overflow drops, deepest queue {}",
+        discarded, stats.dequeued, stats.codelDrops, stats.overflowDrops, stats.maxDepth);
+    if (busyPoll.count() > 0)
+    {
+        BusyPoller::Stats spinning = getBusyPollStats();
+        SYSTEM_LOG_INFO("[LinuxTunInterface] Busy poll: {} wakeups avoided, {} spins gave up, {} skipped, {}ms spent spinning",
+            spinning.hits, spinning.misses, spinning.skipped, spinning.spinTime.count() / 1000);
+    }
+}
+
+void LinuxTunInterface::readerThreadFunc(Queue& queue)
+{
+    epoll_event events[2];
+
+    while (running)
+    {
+        // Busy-poll mode looks at the device for a while before sleeping in epoll
+        int ready = 0;
+        if (!queue.readerPoller.spin([&queue, &events, &ready]()
+            {
+                ready = ::epoll_wait(queue.epollFd, events, 2, 0);
+                return ready != 0;
+            }))
+        {
+            BusyPoller::Clock::time_point blockedAt = BusyPoller::Clock::now();
+            ready = ::epoll_wait(queue.epollFd, events, 2, -1);
+            queue.readerPoller.woke(blockedAt);
+        }
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (running)
+                SYSTEM_LOG_ERROR("[LinuxTunInterface] epoll_wait failed: {}", std::strerror(errno));
+            break;
+        }
+
+        if (!running)
+            break;
+
+        // Drain everything that's queued on the device before going back to sleep
+        while (running)
+        {
+            // Read lands behind the headroom, so the network side can build the datagram around it in place
+            PacketHandle packetData = packetPool->acquire(maxPacketSize, PacketBufferPool::DEFAULT_HEADROOM);
+            if (!packetData)
+                break;
+
+            ssize_t packetSize = ::read(queue.fd, packetData.data(), packetData.capacity());
+            if (packetSize < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    NETWORK_LOG_ERROR("[LinuxTunInterface] Read from {} failed: {}", interfaceName, std::strerror(errno));
+                break;
+            }
+            if (packetSize == 0)
+                break;
+
+            packetData.resize(static_cast<size_t>(packetSize));
+            if (packetCallback)
+            {
+                packetCallback(std::move(packetData));
+            }
+        }
+    }
+}
+
+void LinuxTunInterface::writerThreadFunc(Queue& queue)
+{
+    std::vector<PacketHandle> writeBatch;
+    writeBatch.reserve(WRITE_BATCH_RESERVE);
+    uint64_t reportedDrops = 0;
+    auto lastDropReport = CoDelQueue::Clock::time_point();
+
+    // Sleeps only when there's nothing to write, sendPacket and stopPacketProcessing both wake it
+    while (queue.outgoingPackets.takeBatch(writeBatch, WRITE_BATCH_RESERVE))
+    {
+        CoDelQueue::Stats stats = queue.outgoingPackets.getStats();
+        uint64_t drops = stats.codelDrops + stats.overflowDrops;
+        auto now = CoDelQueue::Clock::now();
+        if (drops != reportedDrops && now - lastDropReport >= DROP_REPORT_INTERVAL)
+        {
+            NETWORK_LOG_WARNING("[LinuxTunInterface] {} can't keep up: {} queued, {} CoDel drops, {} overflow drops",
+                interfaceName, stats.depth, stats.codelDrops, stats.overflowDrops);
+            reportedDrops = drops;
+            lastDropReport = now;
+        }
+
+        for (PacketHandle& packet : writeBatch)
+        {
+            ssize_t written = ::write(queue.fd, packet.data(), packet.size());
+            if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                // Device queue full, wait for room once and retry
+                pollfd writable{queue.fd, POLLOUT, 0};
+                if (::poll(&writable, 1, 10) > 0)
+                    written = ::write(queue.fd, packet.data(), packet.size());
+            }
+
+            if (written < 0)
+            {
+                NETWORK_LOG_ERROR("[LinuxTunInterface] Write to {} failed: {}", interfaceName, std::strerror(errno));
+            }
+        }
+        // Hands the receive buffers back to the pool, keeps the capacity
+        writeBatch.clear();
+    }
+}
+
+size_t LinuxTunInterface::selectQueue(const PacketHandle& packet) const
+{
+    if (queues.size() == 1 || packet.size() < 20)
+        return 0;
+
+    // Hash source / destination address and protocol of the IPv4 header
+    const uint8_t* ipHeader = packet.data();
+    uint32_t hash = 2166136261u;
+    const size_t fields[] = {9, 12, 13, 14, 15, 16, 17, 18, 19};
+    for (size_t offset : fields)
+    {
+        hash ^= ipHeader[offset];
+        hash *= 16777619u;
+    }
+    return hash % queues.size();
+}
+
+bool LinuxTunInterface::sendPacket(PacketHandle packet)
+{
+    if (!running)
+    {
+        SYSTEM_LOG_ERROR("[LinuxTunInterface] Packet processing not running");
+        return false;
+    }
+
+    queues[selectQueue(packet)]->outgoingPackets.push(std::move(packet));
+
+    return true;
+}
+
+void LinuxTunInterface::setPacketCallback(PacketCallback callback)
+{
+    packetCallback = std::move(callback);
+}
+
+bool LinuxTunInterface::isRunning() const
+{
+    return running;
+}
+
+CoDelQueue::Stats LinuxTunInterface::getQueueStats() const
+{
+    CoDelQueue::Stats total;
+    for (const auto& queue : queues)
+    {
+        CoDelQueue::Stats stats = queue->outgoingPackets.getStats();
+        total.enqueued += stats.enqueued;
+        total.dequeued += stats.dequeued;
+        total.codelDrops += stats.codelDrops;
+        total.overflowDrops += stats.overflowDrops;
+        total.droppedBytes += stats.droppedBytes;
+        total.depth += stats.depth;
+        total.maxDepth = std::max(total.maxDepth, stats.maxDepth);
+    }
+    return total;
+}
+
+BusyPoller::Stats LinuxTunInterface::getBusyPollStats() const
+{
+    BusyPoller::Stats total;
+    for (const auto& queue : queues)
+    {
+        total += queue->readerPoller.getStats();
+        total += queue->outgoingPackets.getBusyPollStats();
+    }
+    return total;
+}
+
+void LinuxTunInterface::close()
+{
+    if (running)
+    {
+        stopPacketProcessing();
+    }
+
+    for (auto& queue : queues)
+    {
+        if (queue->epollFd >= 0)
+            ::close(queue->epollFd);
+        if (queue->fd >= 0)
+            ::close(queue->fd);
+    }
+    queues.clear();
+
+    if (stopEventFd >= 0)
+    {
+        ::close(stopEventFd);
+        stopEventFd = -1;
+    }
+
+    SYSTEM_LOG_INFO("[LinuxTunInterface] TUN interface closed");
+}
+
+std::string LinuxTunInterface::getNarrowAlias() const
+{
+    return interfaceName;
+}
+
+size_t LinuxTunInterface::getQueueCount() const
+{
+    return queueCount;
+}
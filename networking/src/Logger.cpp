@@ -1,4 +1,4 @@
-#include "Logger.hpp"
+#include "logger.hpp"
 #include <chrono>
 #include <algorithm>
 #include <regex>
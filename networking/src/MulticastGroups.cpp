@@ -0,0 +1,194 @@
+#include "MulticastGroups.hpp"
+#include <cstring>
+
+namespace
+{
+constexpr uint8_t IPPROTO_IGMP_NUMBER = 2;
+constexpr size_t IPV4_MIN_HEADER = 20;
+
+constexpr uint8_t IGMP_QUERY = 0x11;
+constexpr uint8_t IGMP_V1_REPORT = 0x12;
+constexpr uint8_t IGMP_V2_REPORT = 0x16;
+constexpr uint8_t IGMP_V2_LEAVE = 0x17;
+constexpr uint8_t IGMP_V3_REPORT = 0x22;
+
+// IGMPv3 group record types (RFC 3376 4.2.12)
+constexpr uint8_t MODE_IS_INCLUDE = 1;
+constexpr uint8_t MODE_IS_EXCLUDE = 2;
+constexpr uint8_t CHANGE_TO_INCLUDE = 3;
+constexpr uint8_t CHANGE_TO_EXCLUDE = 4;
+constexpr uint8_t ALLOW_NEW_SOURCES = 5;
+
+uint32_t readAddress(const uint8_t* data)
+{
+    return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) |
+           (static_cast<uint32_t>(data[2]) << 8) | data[3];
+}
+
+bool isMulticast(uint32_t address)
+{
+    return (address >> 28) == 14;
+}
+
+// Internet checksum (RFC 1071)
+uint16_t checksum(const uint8_t* data, size_t size)
+{
+    uint32_t sum = 0;
+    for (size_t i = 0; i + 1 < size; i += 2)
+        sum += (static_cast<uint32_t>(data[i]) << 8) | data[i + 1];
+    if (size & 1)
+        sum += static_cast<uint32_t>(data[size - 1]) << 8;
+    while (sum >> 16)
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    return static_cast<uint16_t>(~sum);
+}
+
+// IGMP message of a well-formed IPv4 packet, null otherwise
+const uint8_t* igmpOf(const uint8_t* packet, size_t size, size_t& igmpSize)
+{
+    if (size < IPV4_MIN_HEADER || (packet[0] >> 4) != 4 || packet[9] != IPPROTO_IGMP_NUMBER)
+        return nullptr;
+    size_t headerSize = static_cast<size_t>(packet[0] & 0x0F) * 4;
+    size_t totalSize = (static_cast<size_t>(packet[2]) << 8) | packet[3];
+    if (totalSize < size)
+        size = totalSize;
+    if (headerSize < IPV4_MIN_HEADER || headerSize + 8 > size)
+        return nullptr;
+    igmpSize = size - headerSize;
+    return packet + headerSize;
+}
+}
+
+bool MulticastGroups::isIgmp(const uint8_t* packet, size_t size)
+{
+    return size >= IPV4_MIN_HEADER && (packet[0] >> 4) == 4 && packet[9] == IPPROTO_IGMP_NUMBER;
+}
+
+bool MulticastGroups::snoop(const uint8_t* packet, size_t size, uint8_t octet, Clock::time_point now)
+{
+    size_t igmpSize = 0;
+    const uint8_t* igmp = igmpOf(packet, size, igmpSize);
+    if (!igmp)
+        return false;
+
+    switch (igmp[0])
+    {
+        case IGMP_V1_REPORT:
+        case IGMP_V2_REPORT:
+        {
+            uint32_t group = readAddress(igmp + 4);
+            if (!isMulticast(group))
+                return false;
+            join(group, octet, now);
+            return true;
+        }
+        case IGMP_V2_LEAVE:
+        {
+            // The host is alone behind its TUN, nobody else there to keep the group, so it goes right away
+            leave(readAddress(igmp + 4), octet);
+            return true;
+        }
+        case IGMP_V3_REPORT:
+        {
+            size_t recordCount = (static_cast<size_t>(igmp[6]) << 8) | igmp[7];
+            size_t offset = 8;
+            for (size_t i = 0; i < recordCount; i++)
+            {
+                if (offset + 8 > igmpSize)
+                    return false;
+                const uint8_t* record = igmp + offset;
+                size_t sourceCount = (static_cast<size_t>(record[2]) << 8) | record[3];
+                uint32_t group = readAddress(record + 4);
+                offset += 8 + 4 * sourceCount + 4 * static_cast<size_t>(record[1]);
+                if (offset > igmpSize || !isMulticast(group))
+                    continue;
+
+                // Exclude mode is "everything but", include mode with sources is source-specific: both mean the
+                // host wants traffic for the group; include mode with no sources is a leave; BLOCK is left alone
+                uint8_t type = record[0];
+                if (type == MODE_IS_EXCLUDE || type == CHANGE_TO_EXCLUDE ||
+                    ((type == MODE_IS_INCLUDE || type == CHANGE_TO_INCLUDE || type == ALLOW_NEW_SOURCES) && sourceCount > 0))
+                {
+                    join(group, octet, now);
+                }
+                else if ((type == MODE_IS_INCLUDE || type == CHANGE_TO_INCLUDE) && sourceCount == 0)
+                {
+                    leave(group, octet);
+                }
+            }
+            return true;
+        }
+        default:
+            // Queries, and whatever else a host's multicast router may send
+            return igmp[0] == IGMP_QUERY;
+    }
+}
+
+void MulticastGroups::expire(Clock::time_point now)
+{
+    for (auto& [address, group] : groups)
+    {
+        for (size_t octet = 0; octet < group.members.size(); octet++)
+        {
+            if (group.members.test(octet) && group.expires[octet] <= now)
+                group.members.reset(octet);
+        }
+    }
+}
+
+void MulticastGroups::retainOnly(const Members& present)
+{
+    for (auto& [address, group] : groups)
+        group.members &= present;
+}
+
+void MulticastGroups::clear()
+{
+    groups.clear();
+}
+
+MulticastGroups::Group* MulticastGroups::find(uint32_t group)
+{
+    auto found = groups.find(group);
+    return found == groups.end() ? nullptr : &found->second;
+}
+
+void MulticastGroups::writeGeneralQuery(uint8_t* out)
+{
+    std::memset(out, 0, QUERY_SIZE);
+    // IPv4 with the router alert option (RFC 2113), TTL 1, to all-hosts 224.0.0.1
+    out[0] = 0x46;
+    out[1] = 0xC0;
+    out[3] = QUERY_SIZE;
+    out[8] = 1;
+    out[9] = IPPROTO_IGMP_NUMBER;
+    out[16] = 224; out[19] = 1;
+    out[20] = 0x94; out[21] = 0x04;
+    uint16_t headerChecksum = checksum(out, 24);
+    out[10] = static_cast<uint8_t>(headerChecksum >> 8);
+    out[11] = static_cast<uint8_t>(headerChecksum);
+
+    // Group 0 = general, max response time 10s
+    uint8_t* igmp = out + 24;
+    igmp[0] = IGMP_QUERY;
+    igmp[1] = 100;
+    uint16_t igmpChecksum = checksum(igmp, 8);
+    igmp[2] = static_cast<uint8_t>(igmpChecksum >> 8);
+    igmp[3] = static_cast<uint8_t>(igmpChecksum);
+}
+
+void MulticastGroups::join(uint32_t address, uint8_t octet, Clock::time_point now)
+{
+    if (groups.size() >= MAX_GROUPS && groups.find(address) == groups.end())
+        return;
+    Group& group = groups[address];
+    group.members.set(octet);
+    group.expires[octet] = now + MEMBERSHIP_TIMEOUT;
+}
+
+void MulticastGroups::leave(uint32_t address, uint8_t octet)
+{
+    auto found = groups.find(address);
+    if (found != groups.end())
+        found->second.members.reset(octet);
+}
@@ -1,6 +1,6 @@
 #include "Utils.hpp"
 #include "NetworkConfigManager.hpp"
-#include "Logger.hpp"
+#include "logger.hpp"
 
 #pragma comment(lib, "iphlpapi.lib")
 
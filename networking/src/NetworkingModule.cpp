@@ -1,11 +1,52 @@
 #include "NetworkingModule.hpp"
-#include "Logger.hpp"
+#include "logger.hpp"
 #include "Utils.hpp"
+#include <algorithm>
 #include <iostream>
 #include <chrono>
 #include <random>
 #include <cstring>
 #include <boost/asio/ip/address_v6.hpp>
+#ifdef __linux__
+#include <cerrno>
+#endif
+
+namespace
+{
+void writeUint32(uint8_t* out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        out[i] = (value >> (24 - 8 * i)) & 0xFF;
+}
+
+void writeUint64(uint8_t* out, uint64_t value)
+{
+    for (int i = 0; i < 8; i++)
+        out[i] = (value >> (56 - 8 * i)) & 0xFF;
+}
+
+uint32_t readUint32(const uint8_t* in)
+{
+    return (uint32_t(in[0]) << 24) | (uint32_t(in[1]) << 16) | (uint32_t(in[2]) << 8) | uint32_t(in[3]);
+}
+
+uint64_t readUint64(const uint8_t* in)
+{
+    return (uint64_t(readUint32(in)) << 32) | readUint32(in + 4);
+}
+
+const char* congestionStateName(CongestionController::State state)
+{
+    switch (state)
+    {
+    case CongestionController::State::STARTUP: return "startup";
+    case CongestionController::State::DRAIN: return "drain";
+    case CongestionController::State::PROBE_BW: return "probe bandwidth";
+    case CongestionController::State::PROBE_RTT: return "probe rtt";
+    }
+    return "unknown";
+}
+}
 
 // Not used anymore
 PeerConnectionInfo::PeerConnectionInfo() : connected(false)
@@ -68,6 +109,157 @@ const PeerConnectionInfo::SharedKey& PeerConnectionInfo::getSharedKey() const
     return sharedKey;
 }
 
+void PeerConnectionInfo::setProtocolVersion(uint8_t version)
+{
+    protocolVersion = version;
+}
+
+uint8_t PeerConnectionInfo::getProtocolVersion() const
+{
+    return protocolVersion;
+}
+
+void PeerConnectionInfo::confirmProtocolVersion()
+{
+    protocolVersionConfirmed = true;
+}
+
+bool PeerConnectionInfo::isProtocolVersionConfirmed() const
+{
+    return protocolVersionConfirmed;
+}
+
+void PeerConnectionInfo::setLocalIsLower(bool lower)
+{
+    localIsLower = lower;
+    auto newCipher = std::make_shared<PeerCipher>();
+    newCipher->setKeys(sharedKey, lower);
+    cipher = std::move(newCipher);
+}
+
+bool PeerConnectionInfo::isLocalLower() const
+{
+    return localIsLower;
+}
+
+const std::shared_ptr<const PeerCipher>& PeerConnectionInfo::getCipher() const
+{
+    return cipher;
+}
+
+void PeerConnectionInfo::setCipherSuite(CipherSuite suite)
+{
+    cipherSuite = suite;
+}
+
+CipherSuite PeerConnectionInfo::getCipherSuite() const
+{
+    return cipherSuite;
+}
+
+uint64_t PeerConnectionInfo::nextTxCounter()
+{
+    return txCounter++;
+}
+
+uint32_t PeerConnectionInfo::getPeerSessionId() const
+{
+    return peerSessionId;
+}
+
+void PeerConnectionInfo::setPeerSessionId(uint32_t sessionId)
+{
+    peerSessionId = sessionId;
+}
+
+ReplayWindow& PeerConnectionInfo::getReplayWindow()
+{
+    return replayWindow;
+}
+
+void PeerConnectionInfo::setCryptoFlows(std::shared_ptr<CryptoFlow> tx, std::shared_ptr<CryptoFlow> rx)
+{
+    txFlow = std::move(tx);
+    rxFlow = std::move(rx);
+}
+
+const std::shared_ptr<CryptoFlow>& PeerConnectionInfo::getTxFlow() const
+{
+    return txFlow;
+}
+
+const std::shared_ptr<CryptoFlow>& PeerConnectionInfo::getRxFlow() const
+{
+    return rxFlow;
+}
+
+void PeerConnectionInfo::setStrand(std::shared_ptr<Strand> peerStrand)
+{
+    strand = std::move(peerStrand);
+}
+
+PeerConnectionInfo::Strand* PeerConnectionInfo::getStrand() const
+{
+    return strand.get();
+}
+
+AckTracker& PeerConnectionInfo::getAckTracker()
+{
+    return ackTracker;
+}
+
+const AckTracker& PeerConnectionInfo::getAckTracker() const
+{
+    return ackTracker;
+}
+
+CongestionController& PeerConnectionInfo::getCongestionController()
+{
+    return congestionController;
+}
+
+const CongestionController& PeerConnectionInfo::getCongestionController() const
+{
+    return congestionController;
+}
+
+void PeerConnectionInfo::setPeerGroupKey(uint32_t keyId, const GroupCipher::Key& key)
+{
+    peerGroupKeyId = keyId;
+    peerGroupCipher.setKey(key);
+    groupReplayWindow.reset();
+}
+
+const GroupCipher* PeerConnectionInfo::getPeerGroupCipher(uint32_t keyId) const
+{
+    return keyId != 0 && keyId == peerGroupKeyId ? &peerGroupCipher : nullptr;
+}
+
+ReplayWindow& PeerConnectionInfo::getGroupReplayWindow()
+{
+    return groupReplayWindow;
+}
+
+void PeerConnectionInfo::setGroupKeyConfirmed(uint32_t keyId)
+{
+    confirmedGroupKeyId = keyId;
+}
+
+bool PeerConnectionInfo::hasConfirmedGroupKey(uint32_t keyId) const
+{
+    return keyId != 0 && keyId == confirmedGroupKeyId;
+}
+
+SendScheduler& PeerConnectionInfo::getSendScheduler()
+{
+    return sendScheduler;
+}
+
+const SendScheduler& PeerConnectionInfo::getSendScheduler() const
+{
+    return sendScheduler;
+}
+
 
 /* ====================================================================================================== */
 
@@ -76,16 +268,55 @@ UDPNetwork::UDPNetwork(
     std::unique_ptr<boost::asio::ip::udp::socket> socket,
     boost::asio::io_context& context,
     std::shared_ptr<ISystemStateManager> stateManager,
-    std::shared_ptr<INetworkConfigManager> networkConfigManager) 
+    std::shared_ptr<INetworkConfigManager> networkConfigManager,
+    std::shared_ptr<PacketBufferPool> packetPool,
+    const DataPathConfig& config) 
     : running(false)
     , localPort(0)
     , nextSeqNumber(0)
     , socket(std::move(socket))
     , ioContext(context)
+    , networkStrand(boost::asio::make_strand(context))
     , stateManager(stateManager)
     , networkConfigManager(networkConfigManager)
-    , keepAliveTimer(ioContext)
+    , keepAliveTimer(networkStrand)
+    , packetPool(packetPool ? std::move(packetPool) : PacketBufferPool::create())
+    , config(config)
+    , txFlushTimer(networkStrand)
+    , pacingTimer(networkStrand)
+    , ackTimer(networkStrand)
 {
+    txBatch.reserve(config.ioBatchSize);
+    for (size_t i = 0; i < config.ioThreads; i++)
+        ioPollers.push_back(std::make_unique<BusyPoller>(config.busyPollBudget));
+
+    if (config.cipherSuite && PeerCipher::isSupported(*config.cipherSuite))
+    {
+        preferredSuite = *config.cipherSuite;
+    }
+    else
+    {
+        if (config.cipherSuite)
+            NETWORK_LOG_WARNING("[Network] Cipher suite {} not available on this host", PeerCipher::suiteName(*config.cipherSuite));
+        preferredSuite = PeerCipher::fastestSuite();
+    }
+    NETWORK_LOG_INFO("[Network] Preferred cipher suite: {}", PeerCipher::suiteName(preferredSuite));
+
+    size_t cryptoWorkers = config.cryptoWorkers < 0
+        ? CryptoWorkerPool::autoWorkerCount()
+        : static_cast<size_t>(config.cryptoWorkers);
+    if (cryptoWorkers > 0)
+    {
+        cryptoPool = std::make_unique<CryptoWorkerPool>(cryptoWorkers);
+    }
+    else if (config.ioThreads > 1)
+    {
+        NETWORK_LOG_INFO("[Network] v2 crypto runs on per-peer strands over {} IO threads", config.ioThreads);
+    }
+    else
+    {
+        NETWORK_LOG_INFO("[Network] v2 crypto runs inline on the IO thread");
+    }
 }
 
 UDPNetwork::~UDPNetwork()
@@ -113,19 +344,70 @@ bool UDPNetwork::startListening(int port)
         socket->set_option(sendBufferOption);
         socket->set_option(recvBufferOption);
 
+        #ifdef __linux__
+        // Low-latency mode: the kernel polls the device queue on our reads instead of waiting for its interrupt
+        if (config.busyPollBudget.count() > 0 && !BusyPoller::enableSocketBusyPoll(socket->native_handle(), config.busyPollBudget))
+        {
+            NETWORK_LOG_WARNING("[Network] SO_BUSY_POLL refused (errno {}), needs CAP_NET_ADMIN above net.core.busy_read", errno);
+        }
+        #endif
+        lastBusyPollReport = std::chrono::steady_clock::now();
+
         // Set running flag to true
         running = true;
 
+        #ifdef __linux__
+        if (config.socketShards > 1 && !socketShards)
+            startSocketShards();
+        #endif
+
         // Start async receiving
         NETWORK_LOG_INFO("[Network] Starting async receive");
+        #ifdef __linux__
+        bool uringActive = false;
+        #ifdef PB_IO_URING
+        if (config.ioUring)
+            uringActive = startUring();
+        #endif
+        batchedIoActive = config.batchedIo && !uringActive;
+        if (uringActive)
+        {
+            NETWORK_LOG_INFO("[Network] io_uring transport started");
+        }
+        else if (batchedIoActive)
+        {
+            // We drive recvmmsg / sendmmsg on the native handle ourselves, asio only tells us when it's readable
+            socket->non_blocking(true);
+
+            size_t batchSize = config.ioBatchSize;
+            rxBuffers.resize(batchSize);
+            rxMessages.resize(batchSize);
+            rxIovecs.resize(batchSize);
+            rxAddresses.resize(batchSize);
+            txMessages.resize(batchSize);
+            txIovecs.resize(batchSize);
+
+            startBatchedReceive();
+            NETWORK_LOG_INFO("[Network] Batched receive started, batch size {}", batchSize);
+        }
+        else
+        {
+            startAsyncReceive();
+        }
+        #else
         startAsyncReceive();
+        #endif
         NETWORK_LOG_INFO("[Network] Async receive started");
         
-        // Start IO thread to handle asynchronous operations
-        if (!ioThread.joinable())
+        // Start IO threads to handle asynchronous operations, our own handlers are serialized on networkStrand
+        if (ioThreads.empty())
+        {
+            NETWORK_LOG_INFO("[Network] Starting {} IOContext thread(s)", config.ioThreads);
+        }
+        while (ioThreads.size() < config.ioThreads)
         {
-            NETWORK_LOG_INFO("[Network] Starting IOContext thread");
-            ioThread = std::thread([this]()
+            BusyPoller* poller = ioPollers[ioThreads.size() % ioPollers.size()].get();
+            ioThreads.emplace_back([this, poller]()
             {
                 // Set thread priority to time-critical
                 #ifdef _WIN32
@@ -135,7 +417,8 @@ bool UDPNetwork::startListening(int port)
                 {
                     NETWORK_LOG_INFO("[Network] IO thread started, running io context");
                     // This will keep running tasks until the work guard is reset / destroyed
-                    size_t handlers_run = ioContext.run();
+                    // Plain run() unless busy polling
+                    size_t handlers_run = poller->run(ioContext);
                     NETWORK_LOG_INFO("[Network] IO context finished running, {} handlers executed", handlers_run);
                 }
                 catch (const std::exception& e)
@@ -159,19 +442,25 @@ bool UDPNetwork::startConnection(
     const std::array<uint8_t, crypto_box_SECRETKEYBYTES>& selfSecretKey,
     std::map<uint32_t, std::pair<std::pair<std::uint32_t, int>, std::array<uint8_t, crypto_box_PUBLICKEYBYTES>>> virtualIpToPublicIpPortAndKey)
 {
-    for (const auto& [publicIp, connectionInfo] : publicIpToPeerConnection)
+    for (const auto& entry : peers)
     {
-        if (connectionInfo.isConnected())
+        if (entry.peer.isConnected())
         {
-            SYSTEM_LOG_ERROR("[Network] Already connected to a peer: {}", publicIp);
+            SYSTEM_LOG_ERROR("[Network] Already connected to a peer: {}", entry.peer.getPeerEndpoint().address().to_string());
             return false;
         }
     }
 
     selfVirtualIp = selfIp;
-
-    // construct virtualIpToPublicIp and publicIpToPeerConnection
-    std::map<uint32_t, std::pair<std::uint32_t, int>> _virtualIpToPublicIp;
+    // Fresh v2 session, never 0 (that means "no session yet" on the receiving side)
+    localSessionId = randombytes_uniform(0xFFFFFFFF) + 1;
+    // New group key with it, peers holding the old one have to confirm this one before they get broadcasts with it
+    groupCipher.generate();
+    groupTxCounter = 0;
+    // Computed once here, the data path only does a table lookup
+    forwarding.compile(selfIp, utils::ipToUint32(networkConfigManager->getSetupConfig().IP_SPACE + std::to_string(255)));
+
+    peers.clear();
     for (const auto& [virtualIp, publicIpPortAndKey] : virtualIpToPublicIpPortAndKey)
     {
         uint32_t publicIp = publicIpPortAndKey.first.first;
@@ -187,8 +476,21 @@ bool UDPNetwork::startConnection(
             SYSTEM_LOG_ERROR("[Network] Failed to construct shared key for peer {}", utils::uint32ToIp(publicIp));
             continue;
         }
-        _virtualIpToPublicIp[virtualIp] = publicIpPortAndKey.first;
-        publicIpToPeerConnection[publicIp] = PeerConnectionInfo(peerEndpoint, sharedKey);
+        PeerConnectionInfo* peer = peers.add(virtualIp, peerEndpoint, PeerConnectionInfo(peerEndpoint, sharedKey));
+        if (!peer)
+        {
+            SYSTEM_LOG_ERROR("[Network] Unusable endpoint for peer {}", utils::uint32ToIp(publicIp));
+            continue;
+        }
+        peer->setLocalIsLower(selfIp < virtualIp);
+        if (cryptoPool)
+        {
+            createCryptoFlows(PeerTable<PeerConnectionInfo>::endpointKey(peerEndpoint), *peer);
+        }
+        else if (config.ioThreads > 1)
+        {
+            peer->setStrand(std::make_shared<PeerConnectionInfo::Strand>(boost::asio::make_strand(ioContext)));
+        }
 
         SYSTEM_LOG_INFO(
             "[Network] Constructed shared key for peer {}: {:02X} {:02X} {:02X} {:02X} {:02X}",
@@ -199,7 +501,7 @@ bool UDPNetwork::startConnection(
             static_cast<unsigned>(sharedKey[3]),
             static_cast<unsigned>(sharedKey[4]));
     }
-    virtualIpToPublicIp = _virtualIpToPublicIp;
+    updateForwarding();
 
     // Start hole punching process
     startHolePunchingProcess();
@@ -215,9 +517,9 @@ void UDPNetwork::startHolePunchingProcess()
     // Send initial hole punching packets
     for (int i = 0; i < 5; i++)
     {
-        for (const auto& [publicIp, connectionInfo] : publicIpToPeerConnection)
+        for (const auto& entry : peers)
         {
-            sendHolePunchPacket(connectionInfo.getPeerEndpoint());
+            sendHolePunchPacket(entry.peer.getPeerEndpoint());
         }
         std::this_thread::sleep_for(std::chrono::milliseconds(20));
     }
@@ -228,15 +530,12 @@ void UDPNetwork::sendHolePunchPacket(const boost::asio::ip::udp::endpoint& peerE
     try
     {
         NETWORK_LOG_INFO("[Network] Sending hole-punch / keep-alive packet to peer: {}", peerEndpoint.address().to_string());
-        // Create hole-punch packet with shared ownership
-        auto packet = std::make_shared<std::vector<uint8_t>>(16);
-
-        // Attach custom header
-        attachCustomHeader(packet, PacketType::HOLE_PUNCH);
+        // Create hole-punch packet, the handle keeps it alive for the async operation
+        PacketHandle packet = makeControlPacket(PacketType::HOLE_PUNCH);
         
         // Send packet asynchronously
         socket->async_send_to(
-            boost::asio::buffer(*packet), peerEndpoint,
+            boost::asio::buffer(packet.data(), packet.size()), peerEndpoint,
             [packet](const boost::system::error_code& error, std::size_t bytesSent)
             {
                 if (error && error != boost::asio::error::operation_aborted && 
@@ -256,7 +555,7 @@ void UDPNetwork::sendHolePunchPacket(const boost::asio::ip::udp::endpoint& peerE
 
 void UDPNetwork::checkAllConnections()
 {
-    if (publicIpToPeerConnection.empty() || virtualIpToPublicIp.empty())
+    if (peers.empty())
     {
         SYSTEM_LOG_WARNING("[Network] No more connections active, closing connection...");
         NETWORK_LOG_WARNING("[Network] No more connections active, closing connection...");
@@ -264,8 +563,9 @@ void UDPNetwork::checkAllConnections()
         return;
     }
 
-    for (auto& [publicIp, connectionInfo] : publicIpToPeerConnection)
+    for (auto& entry : peers)
     {
+        PeerConnectionInfo& connectionInfo = entry.peer;
         if (!connectionInfo.isConnected())
         {
             continue;
@@ -285,49 +585,35 @@ void UDPNetwork::checkAllConnections()
             connectionInfo.setConnected(false);
 
             // Remove the peer after a couple of seconds
-            boost::asio::steady_timer timer(ioContext);
+            boost::asio::steady_timer timer(networkStrand);
             timer.expires_after(std::chrono::seconds(2));
-            timer.async_wait([this, publicIp](const boost::system::error_code& error)
+            timer.async_wait([this, peerEndpoint = connectionInfo.getPeerEndpoint(), virtualIp = entry.virtualIp](const boost::system::error_code& error)
             {
                 if (error != boost::asio::error::operation_aborted)
                 {
-                    auto it = publicIpToPeerConnection.find(publicIp);
-                    if (it != publicIpToPeerConnection.end() &&
-                        it->second.isConnected())
+                    PeerConnectionInfo* peer = peers.find(peerEndpoint);
+                    if (peer && peer->isConnected())
                     {
                         NETWORK_LOG_ERROR("[Network] Peer miraculously reconnected after timeout");
                         return;
                     }
-                    
-                    // Remove the peer
-                    uint32_t ipToRemove = 0;
-                    for (const auto& [virtualIp, publicIpAndPort] : virtualIpToPublicIp)
-                    {
-                        if (publicIpAndPort.first == publicIp)
-                        {
-                            ipToRemove = virtualIp;
-                            break;
-                        }
-                    }
 
-                    if (ipToRemove == selfVirtualIp)
+                    if (virtualIp == selfVirtualIp)
                     {
                         NETWORK_LOG_ERROR("[Network] How did we get here? Cannot remove self from peer list");
                         return;
                     }
 
-                    if (ipToRemove != 0)
-                    {
-                        publicIpToPeerConnection.erase(publicIp);
-                        virtualIpToPublicIp.erase(ipToRemove);
-                    }
+                    // Remove the peer
+                    peers.remove(peerEndpoint);
+                    updateForwarding();
                 }
             });
         }
     }
 }
 
-void UDPNetwork::processPacketFromTun(const std::vector<uint8_t>& packet)
+void UDPNetwork::processPacketFromTun(PacketHandle packet)
 {
     if (!running || !socket)
     {
@@ -335,220 +621,1145 @@ void UDPNetwork::processPacketFromTun(const std::vector<uint8_t>& packet)
         return;
     }
 
-    // Extract source and destination IPs for filtering
-    uint32_t srcIp = (packet[12] << 24) | (packet[13] << 16) | (packet[14] << 8) | packet[15];
-    uint32_t dstIp = (packet[16] << 24) | (packet[17] << 16) | (packet[18] << 8) | packet[19];
-
-    // Forward packets that are meant for peer OR are broadcast/multicast packets
-    uint32_t BROADCAST_IP = utils::ipToUint32(networkConfigManager->getSetupConfig().IP_SPACE + std::to_string(255));
-
-    const auto& virtualIpMapIter = virtualIpToPublicIp.find(dstIp);
-    bool isForPeer = (virtualIpMapIter != virtualIpToPublicIp.end());
-    bool isBroadcast = (dstIp == BROADCAST_IP) || (dstIp == NetworkConstants::BROADCAST_IP2);
-    bool isMulticast = (dstIp >> 28) == 14; // 224.0.0.0/4 (first octet 224-239)
+    ForwardingEngine::Route route = forwarding.classify(packet.data(), packet.size());
+    routeFromTun(std::move(packet), route);
+}
 
-    if (!isForPeer && !isBroadcast && !isMulticast)
+void UDPNetwork::processPacketsFromTun(PacketHandle* packets, size_t count)
+{
+    if (!running || !socket)
     {
-        // Drop packet not meant for peer
+        NETWORK_LOG_ERROR("[Network] Cannot process packets from tun: socket not available or system not running (disconnected)");
         return;
     }
 
-    // We know this exists in the map cause we checked it above
-    if (isForPeer)
+    // Every destination looked up before the first send, while the headers are still in cache
+    for (size_t start = 0; start < count; start += tunRoutes.size())
+    {
+        size_t chunk = std::min(count - start, tunRoutes.size());
+        forwarding.classifyBatch(packets + start, chunk, tunRoutes.data());
+        for (size_t i = 0; i < chunk; i++)
+            routeFromTun(std::move(packets[start + i]), tunRoutes[i]);
+    }
+}
+
+void UDPNetwork::routeFromTun(PacketHandle packet, const ForwardingEngine::Route& route)
+{
+    // Forward packets that are meant for peer OR are broadcast/multicast packets
+    if (route.action == ForwardingEngine::Action::UNICAST)
     {
-        uint32_t peerPublicIp = virtualIpMapIter->second.first;
-        if (publicIpToPeerConnection.find(peerPublicIp) == publicIpToPeerConnection.end())
-        {
-            NETWORK_LOG_ERROR(
-                "[Network] Critical error: Peer entry found in virtualIpToPublicIp but not found in connectionInfo map: {}", peerPublicIp);
-            return;
-        }
-        auto& peerConnection = publicIpToPeerConnection[peerPublicIp];
-        boost::asio::ip::udp::endpoint peerEndpoint = peerConnection.getPeerEndpoint();
         // Send the packet to the peer
-        sendMessage(
-            packet,
-            peerEndpoint,
-            peerConnection.getSharedKey());
+        auto& entry = peers[route.peerSlot];
+        if (config.sendScheduler)
+            queueToPeer(std::move(packet), entry.key, entry.peer);
+        else if (admitToTxBacklog())
+            sendToPeer(std::move(packet), entry.peer);
     }
-    else if (isBroadcast || isMulticast)
+    else if (route.action == ForwardingEngine::Action::BROADCAST || route.action == ForwardingEngine::Action::MULTICAST)
     {
-        for (const auto& [publicIp, connectionInfo] : publicIpToPeerConnection)
+        // Storms and back-to-back resends stop here, before any sealing; IGMP is left alone, hosts repeat reports on purpose
+        if (!MulticastGroups::isIgmp(packet.data(), packet.size()) &&
+            broadcastSuppressor.inspect(packet.data(), packet.size(), std::chrono::steady_clock::now(),
+                config.broadcastCollapseWindow, config.broadcastRateLimit) != BroadcastSuppressor::Verdict::PASS)
         {
-            sendMessage(
-                packet,
-                connectionInfo.getPeerEndpoint(),
-                connectionInfo.getSharedKey());
+            return;
         }
+
+        if (route.action == ForwardingEngine::Action::BROADCAST)
+            fanOutToPeers(std::move(packet));
+        else
+            forwardMulticast(std::move(packet));
     }
 }
 
-// TODO: REFACTOR FOR *1, FOR MULTIPLE PEERS
-bool UDPNetwork::sendMessage(
-    const std::vector<uint8_t>& dataToSend,
-    const boost::asio::ip::udp::endpoint& peerEndpoint,
-    const std::array<uint8_t, crypto_box_BEFORENMBYTES>& sharedKey)
-{ 
-    try
+void UDPNetwork::forwardMulticast(PacketHandle packet)
+{
+    // IGMP itself goes to everyone, it's how the peers learn what our host joined
+    const uint8_t* ip = packet.data();
+    uint32_t groupAddress = readUint32(ip + 16);
+    if (!config.multicastSnooping || MulticastGroups::isLinkLocal(groupAddress) || MulticastGroups::isIgmp(ip, packet.size()))
     {
-        constexpr size_t CUSTOM_HEADER_SIZE = 16;
-        constexpr size_t NONCE_LENGTH = crypto_box_NONCEBYTES;
-        constexpr size_t MAC_LENGTH = crypto_box_MACBYTES;
-        
-        // Calculate total packet size: header (16 bytes) + nonce (24 bytes) + mac (16 bytes) + message
-        size_t winTunPacketSize = dataToSend.size();
-        size_t wholePacketSize = CUSTOM_HEADER_SIZE + NONCE_LENGTH + MAC_LENGTH + winTunPacketSize;
+        fanOutToPeers(std::move(packet));
+        return;
+    }
 
-        if (wholePacketSize > MAX_PACKET_SIZE)
+    MulticastGroups::Group* group = multicastGroups.find(groupAddress);
+    size_t members = 0;
+    if (group)
+    {
+        for (const auto& entry : peers)
         {
-            NETWORK_LOG_ERROR("[Network] Message too large, max size is {}",
-                (MAX_PACKET_SIZE - CUSTOM_HEADER_SIZE - NONCE_LENGTH - MAC_LENGTH));
-            return false;
+            if (group->members.test(entry.virtualIp & 0xFF))
+                members++;
         }
+    }
+    if (members == 0)
+    {
+        fanoutStats.multicastUnjoined++;
+        return;
+    }
 
-        // Create packet with shared ownership for async operation
-        auto packet = std::make_shared<std::vector<uint8_t>>(wholePacketSize);
+    group->counters.packets++;
+    group->counters.bytes += packet.size();
+    group->counters.datagrams += members;
+    group->counters.skipped += peers.size() - members;
+    fanOutToPeers(std::move(packet), &group->members);
+}
 
-        // Attach custom header
-        uint32_t seq = attachCustomHeader(packet, PacketType::MESSAGE);
-        
-        // Set wintun packet length
-        (*packet)[12] = (winTunPacketSize >> 24) & 0xFF;
-        (*packet)[13] = (winTunPacketSize >> 16) & 0xFF;
-        (*packet)[14] = (winTunPacketSize >> 8) & 0xFF;
-        (*packet)[15] = winTunPacketSize & 0xFF;
+void UDPNetwork::fanOutToPeers(PacketHandle packet, const MulticastGroups::Members* members)
+{
+    auto wanted = [members](const PeerTable<PeerConnectionInfo>::Entry& entry)
+    {
+        return !members || members->test(entry.virtualIp & 0xFF);
+    };
 
-        // Packet pointer position helpers for encryption
-        uint8_t* basePos = packet->data();
-        uint8_t* noncePos = basePos + CUSTOM_HEADER_SIZE;
-        uint8_t* macPos = noncePos + NONCE_LENGTH;
-        uint8_t* encrPos = macPos + MAC_LENGTH;
+    // Admitted as a whole, a broadcast half sent is worse than one not sent
+    if (!admitToTxBacklog())
+        return;
 
-        // std::memcpy(packet->data() + 16, dataToSend.data(), dataToSend.size());
-        std::memcpy(encrPos, dataToSend.data(), winTunPacketSize);
+    fanoutStats.packets++;
+    size_t wantedPeers = 0;
+    size_t groupPeers = 0;
+    for (const auto& entry : peers)
+    {
+        if (!wanted(entry))
+            continue;
+        wantedPeers++;
+        if (usesGroupKey(entry.peer))
+            groupPeers++;
+    }
 
-        // Encrypt
-        randombytes_buf(noncePos, NONCE_LENGTH);
-        crypto_box_easy_afternm(
-            macPos, // dest
-            encrPos, // source
-            winTunPacketSize, // message len
-            noncePos, // nonce
-            sharedKey.data()); // shared key
+    // Peers without our group key get their own ciphertext, so each needs a copy of the plaintext,
+    // the last one takes the original when no group datagram needs it
+    size_t remaining = wantedPeers - groupPeers;
+    for (auto& entry : peers)
+    {
+        if (!wanted(entry) || usesGroupKey(entry.peer))
+            continue;
 
-        // Track for acknowledgment
+        PacketHandle peerPacket;
+        if (--remaining == 0 && groupPeers == 0)
+        {
+            peerPacket = std::move(packet);
+        }
+        else
         {
-            std::lock_guard<std::mutex> ack_lock(pendingAcksMutex);
-            pendingAcks[seq] = std::chrono::steady_clock::now();
+            peerPacket = packetPool->acquire(packet.size(), PacketBufferPool::DEFAULT_HEADROOM);
+            if (!peerPacket)
+                continue;
+            std::memcpy(peerPacket.data(), packet.data(), packet.size());
+            fanoutStats.copies++;
         }
 
-        /*
-        * PACKET STRUCTURE: CUSTOM HEADER (16 bytes) + NONCE (24 bytes) then (MAC (16 bytes) + MESSAGE)
-        */
-        
-        // Send packet asynchronously
-        socket->async_send_to(
-            boost::asio::buffer(*packet), peerEndpoint,
-            [this, packet, seq, peerEndpoint](const boost::system::error_code& error, std::size_t bytesSent)
-            {
-                this->handleSendComplete(error, bytesSent, seq, peerEndpoint);
-            });
-        
-        return true;
+        fanoutStats.datagrams++;
+        fanoutStats.pairwiseSeals++;
+        sendToPeer(std::move(peerPacket), entry.peer);
     }
-    catch (const std::exception& e)
+
+    if (groupPeers == 0)
+        return;
+
+    // Past the fan-out the peers relay it between themselves, we only send to the top of the tree
+    // Multicast gets a tree over just the group's members, built per packet; it's rare next to broadcast
+    bool relayed = config.relayFanout > 0 && groupPeers > config.relayFanout;
+    RelayTree memberTree;
+    const RelayTree& tree = members ? memberTree : relayTree;
+    if (relayed && members)
     {
-        SYSTEM_LOG_ERROR("[Network] Send preparation error: {}", e.what());
-        NETWORK_LOG_ERROR("[Network] Send preparation error: {}", e.what());
-        return false;
+        memberTree.build(groupKeyHolders(members), config.relayFanout);
     }
-}
-
-void UDPNetwork::handleSendComplete(
-    const boost::system::error_code& error,
-    std::size_t bytesSent,
-    uint32_t seq,
-    const boost::asio::ip::udp::endpoint& peerEndpoint)
-{
-    if (error)
+    else if (relayed && (relayTreeStale || relayTree.size() != groupPeers))
     {
-        if (error == boost::asio::error::would_block || 
-            error == boost::asio::error::try_again ||
-            error.value() == 10035) // WSAEWOULDBLOCK
-        {
+        relayTree.build(groupKeyHolders(nullptr), config.relayFanout);
+        relayTreeStale = false;
+    }
 
-            NETWORK_LOG_INFO("[Network] Send buffer full");
+    size_t headerSize = V2_HEADER_SIZE + (relayed ? tree.encodedSize() : 0);
+    size_t overhead = headerSize + GroupCipher::MAC_SIZE;
+    if (overhead + packet.size() > MAX_PACKET_SIZE)
+    {
+        NETWORK_LOG_ERROR("[Network] Message too large, max size is {}", (MAX_PACKET_SIZE - overhead));
+        return;
+    }
+    if (!prepareForFraming(packet, overhead))
+        return;
+    packet.prepend(overhead);
 
-            boost::asio::post(ioContext, [this, seq]()
+    /*
+    * PACKET STRUCTURE: V2 HEADER (14 bytes) + [RELAY TREE] then (MAC (16 bytes) + MESSAGE), key id in place of the session id
+    */
+    uint64_t counter = groupTxCounter++;
+    uint8_t* header = packet.data();
+    header[0] = (PROTOCOL_VERSION_V2 << 4) | static_cast<uint8_t>(PacketType::GROUP_MESSAGE);
+    header[1] = static_cast<uint8_t>(GroupCipher::SUITE) | (relayed ? V2_RELAY_FLAG : 0);
+    writeUint32(header + 2, localSessionId);
+    writeUint64(header + 6, counter);
+    if (relayed)
+        tree.encode(header + V2_HEADER_SIZE);
+    uint8_t* macPos = header + headerSize;
+    groupCipher.seal(macPos + GroupCipher::MAC_SIZE, packet.size() - overhead, macPos,
+        header, headerSize, localSessionId, counter);
+    fanoutStats.groupSeals++;
+
+    // One sealed buffer, every datagram we send holds a reference to it
+    if (relayed)
+    {
+        uint8_t children[RelayTree::MAX_FANOUT];
+        size_t childCount = tree.rootChildren(children);
+        for (size_t i = 0; i < childCount; i++)
+        {
+            if (PeerConnectionInfo* child = peers.findByVirtualIp((selfVirtualIp & 0xFFFFFF00) | children[i]))
             {
-                // No resend, just log that we're dropping the packet
-                NETWORK_LOG_INFO("[Network] Dropping packet due to send buffer limits: seq={}", seq);
-                
-                // Remove from pending acks
-                std::lock_guard<std::mutex> lock(pendingAcksMutex);
-                pendingAcks.erase(seq);
-            });
+                fanoutStats.datagrams++;
+                transmitDatagram(packet, child->getPeerEndpoint(), static_cast<uint32_t>(counter));
+            }
+        }
+        return;
+    }
+
+    for (const auto& entry : peers)
+    {
+        if (!wanted(entry) || !usesGroupKey(entry.peer))
+            continue;
+        fanoutStats.datagrams++;
+        transmitDatagram(packet, entry.peer.getPeerEndpoint(), static_cast<uint32_t>(counter));
+    }
+}
+
+std::vector<RelayTree::Member> UDPNetwork::groupKeyHolders(const MulticastGroups::Members* members) const
+{
+    std::vector<RelayTree::Member> holders;
+    for (const auto& entry : peers)
+    {
+        uint8_t octet = static_cast<uint8_t>(entry.virtualIp & 0xFF);
+        if ((!members || members->test(octet)) && usesGroupKey(entry.peer))
+            holders.push_back({octet, entry.peer.getAckTracker().getStats().smoothedRtt});
+    }
+    return holders;
+}
+
+void UDPNetwork::queryLocalMemberships()
+{
+    lastMulticastQuery = std::chrono::steady_clock::now();
+    PacketHandle query = packetPool->acquire(MulticastGroups::QUERY_SIZE);
+    if (!query || !onMessageCallback)
+        return;
+    MulticastGroups::writeGeneralQuery(query.data());
+    onMessageCallback(std::move(query));
+}
+
+bool UDPNetwork::usesGroupKey(const PeerConnectionInfo& peerConnection) const
+{
+    return config.groupBroadcast &&
+        peerConnection.getProtocolVersion() >= PROTOCOL_VERSION_V2 &&
+        peerConnection.hasConfirmedGroupKey(localSessionId);
+}
+
+void UDPNetwork::sendGroupKey(PeerConnectionInfo& peerConnection, uint8_t kind, uint32_t keyId)
+{
+    PacketHandle packet = packetPool->acquire(GROUP_KEY_PAYLOAD_SIZE, PacketBufferPool::DEFAULT_HEADROOM);
+    if (!packet)
+    {
+        NETWORK_LOG_ERROR("[Network] Failed to acquire group key buffer");
+        return;
+    }
+
+    // Confirmations only name the key, the key itself never goes back
+    uint8_t* payload = packet.data();
+    std::memset(payload, 0, GROUP_KEY_PAYLOAD_SIZE);
+    payload[0] = kind;
+    writeUint32(payload + 1, keyId);
+    if (kind == GROUP_KEY_OFFER)
+        std::memcpy(payload + 5, groupCipher.getKey().data(), sizeof(GroupCipher::Key));
+
+    // Pairwise v2 message, so the replay window covers the key exchange like any other packet
+    sendMessageV2(std::move(packet), peerConnection, PacketType::GROUP_KEY);
+}
+
+void UDPNetwork::sendSuites(PeerConnectionInfo& peerConnection, uint8_t kind)
+{
+    PacketHandle packet = packetPool->acquire(SUITES_PAYLOAD_SIZE, PacketBufferPool::DEFAULT_HEADROOM);
+    if (!packet)
+    {
+        NETWORK_LOG_ERROR("[Network] Failed to acquire suites buffer");
+        return;
+    }
+
+    uint8_t* payload = packet.data();
+    payload[0] = kind;
+    payload[1] = PeerCipher::supportedSuites();
+    payload[2] = static_cast<uint8_t>(preferredSuite);
+    sendMessageV2(std::move(packet), peerConnection, PacketType::SUITES);
+}
+
+void UDPNetwork::handleSuites(const uint8_t* payload, std::size_t size, PeerConnectionInfo& peerConnection)
+{
+    if (size < SUITES_PAYLOAD_SIZE)
+    {
+        NETWORK_LOG_WARNING("[Network] Dropping short suites packet: {} bytes", size);
+        return;
+    }
+
+    CipherSuite suite = PeerCipher::chooseSuite(preferredSuite, payload[1], payload[2]);
+    if (suite != peerConnection.getCipherSuite())
+    {
+        NETWORK_LOG_INFO("[Network] Sealing messages to peer {} with {}", peerConnection.getPeerEndpoint().address().to_string(),
+            PeerCipher::suiteName(suite));
+        peerConnection.setCipherSuite(suite);
+    }
+
+    // Answers don't get answered, or the two of us would go back and forth
+    if (payload[0] == SUITES_OFFER)
+        sendSuites(peerConnection, SUITES_ANSWER);
+}
+
+void UDPNetwork::handleGroupKey(const uint8_t* payload, std::size_t size, PeerConnectionInfo& peerConnection)
+{
+    if (size < GROUP_KEY_PAYLOAD_SIZE)
+    {
+        NETWORK_LOG_WARNING("[Network] Dropping short group key packet: {} bytes", size);
+        return;
+    }
+
+    uint32_t keyId = readUint32(payload + 1);
+    if (payload[0] == GROUP_KEY_OFFER && keyId != 0)
+    {
+        // The key belongs to the session that sent it, anything else is an offer from an earlier session
+        if (keyId != peerConnection.getPeerSessionId())
+        {
+            NETWORK_LOG_WARNING("[Network] Ignoring group key {} offered in session {} by {}", keyId,
+                peerConnection.getPeerSessionId(), peerConnection.getPeerEndpoint().address().to_string());
+            return;
+        }
+        // Offers repeat until we confirm, only a new key id replaces the key (and its replay window)
+        if (!peerConnection.getPeerGroupCipher(keyId))
+        {
+            GroupCipher::Key key;
+            std::memcpy(key.data(), payload + 5, key.size());
+            peerConnection.setPeerGroupKey(keyId, key);
+            NETWORK_LOG_INFO("[Network] Peer {} group key {}", peerConnection.getPeerEndpoint().address().to_string(), keyId);
+        }
+        sendGroupKey(peerConnection, GROUP_KEY_CONFIRM, keyId);
+    }
+    else if (payload[0] == GROUP_KEY_CONFIRM && keyId == localSessionId)
+    {
+        if (!peerConnection.hasConfirmedGroupKey(keyId))
+        {
+            NETWORK_LOG_INFO("[Network] Peer {} holds our group key", peerConnection.getPeerEndpoint().address().to_string());
+            relayTreeStale = true;
+        }
+        peerConnection.setGroupKeyConfirmed(keyId);
+    }
+}
+
+bool UDPNetwork::sendMessage(
+    PacketHandle packet,
+    const boost::asio::ip::udp::endpoint& peerEndpoint,
+    const std::array<uint8_t, crypto_box_BEFORENMBYTES>& sharedKey)
+{
+    if (PeerConnectionInfo* peerConnection = peers.find(peerEndpoint))
+    {
+        return sendToPeer(std::move(packet), *peerConnection);
+    }
+    return sendMessageV1(std::move(packet), peerEndpoint, sharedKey);
+}
+
+bool UDPNetwork::sendToPeer(PacketHandle packet, PeerConnectionInfo& peerConnection)
+{
+    if (peerConnection.getProtocolVersion() >= PROTOCOL_VERSION_V2)
+    {
+        return sendMessageV2(std::move(packet), peerConnection);
+    }
+    return sendMessageV1(std::move(packet), peerConnection.getPeerEndpoint(), peerConnection.getSharedKey());
+}
+
+void UDPNetwork::queueToPeer(PacketHandle packet, PeerTable<PeerConnectionInfo>::Key peerKey, PeerConnectionInfo& peerConnection)
+{
+    SendScheduler& scheduler = peerConnection.getSendScheduler();
+    if (scheduler.empty())
+        backloggedPeers.push_back(peerKey);
+    scheduler.enqueue(std::move(packet), portPriorities, config.priorityPacketBytes);
+    scheduleSendDrain();
+}
+
+void UDPNetwork::scheduleSendDrain()
+{
+    if (sendDrainScheduled || txBacklog >= SEND_BACKLOG_LIMIT)
+        return;
+    sendDrainScheduled = true;
+
+    // Like the TX flush, after the handlers already queued, so a whole TUN burst is in the schedulers to pick from
+    boost::asio::post(networkStrand, makeAllocHandler(handlerMemory, [this]() { drainSendQueues(); }));
+}
+
+void UDPNetwork::drainSendQueues()
+{
+    sendDrainScheduled = false;
+    auto now = std::chrono::steady_clock::now();
+    auto wakeAt = std::chrono::steady_clock::time_point::max();
+
+    // One packet per peer per round; past the limit the rest waits for sends to complete
+    // Peers their pacer or window holds back go to the back, once a whole round sent nothing we're done
+    size_t heldBack = 0;
+    while (!backloggedPeers.empty() && heldBack < backloggedPeers.size() && txBacklog < SEND_BACKLOG_LIMIT)
+    {
+        PeerTable<PeerConnectionInfo>::Key peerKey = backloggedPeers.front();
+        backloggedPeers.pop_front();
+        PeerConnectionInfo* peerConnection = peers.find(peerKey);
+        if (!peerConnection)
+            continue;
+
+        // v1 has no acks to pace by
+        bool paced = config.congestionControl && peerConnection->getProtocolVersion() >= PROTOCOL_VERSION_V2;
+        CongestionController& congestionController = peerConnection->getCongestionController();
+        const AckTracker::Stats& linkStats = peerConnection->getAckTracker().getStats();
+        if (paced && !congestionController.canSend(linkStats.bytesInFlight, now))
+        {
+            congestionController.onBlocked(linkStats.bytesInFlight);
+            wakeAt = std::min(wakeAt, congestionController.nextSendTime(linkStats.bytesInFlight));
+            backloggedPeers.push_back(peerKey);
+            heldBack++;
+            continue;
+        }
+        heldBack = 0;
+
+        SendScheduler& scheduler = peerConnection->getSendScheduler();
+        PacketHandle packet = scheduler.dequeue();
+        if (!scheduler.empty())
+            backloggedPeers.push_back(peerKey);
+        if (!packet)
+            continue;
+
+        // Only what actually went out is charged to the pacer, against the flight it joined
+        size_t wireSize = packet.size() + V2_MESSAGE_OVERHEAD;
+        uint64_t priorInFlight = linkStats.bytesInFlight;
+        if (sendToPeer(std::move(packet), *peerConnection) && paced)
+        {
+            congestionController.onPacketSent(wireSize, priorInFlight, now);
+            if (scheduler.empty())
+                congestionController.onAppLimited(linkStats);
+        }
+    }
+
+    if (wakeAt != std::chrono::steady_clock::time_point::max())
+        schedulePacingTimer(wakeAt);
+}
+
+void UDPNetwork::schedulePacingTimer(std::chrono::steady_clock::time_point at)
+{
+    if (pacingTimerScheduled && pacingTimerAt <= at)
+        return;
+    pacingTimerScheduled = true;
+    pacingTimerAt = at;
+
+    // Re-arming cancels the later wait, whose handler then sees operation_aborted and leaves the flag alone
+    pacingTimer.expires_at(at);
+    pacingTimer.async_wait(makeAllocHandler(handlerMemory, [this](const boost::system::error_code& error)
+    {
+        if (error)
+            return;
+        pacingTimerScheduled = false;
+        drainSendQueues();
+    }));
+}
+
+void UDPNetwork::releaseTxBacklog()
+{
+    if (txBacklog > 0)
+        txBacklog--;
+    if (!backloggedPeers.empty())
+        scheduleSendDrain();
+}
+
+bool UDPNetwork::admitToTxBacklog()
+{
+    if (txBacklog < SEND_BACKLOG_LIMIT)
+        return true;
+    txBacklogDrops++;
+    return false;
+}
+
+void UDPNetwork::setPortPriorities(const PortPriorities& priorities)
+{
+    portPriorities = priorities;
+    NETWORK_LOG_INFO("[Network] Port priorities set for {} ports", portPriorities.size());
+}
+
+bool UDPNetwork::prepareForFraming(PacketHandle& packet, size_t overhead)
+{
+    // Steady state the TUN hands us a buffer nobody else references with room for the framing in front
+    // Anything else (shared buffer, no headroom) gets copied once into a fresh pooled buffer
+    if (packet.unique() && packet.headroom() >= overhead)
+        return true;
+
+    size_t payloadSize = packet.size();
+    PacketHandle copy = packetPool->acquire(payloadSize, std::max(overhead, PacketBufferPool::DEFAULT_HEADROOM));
+    if (!copy)
+    {
+        NETWORK_LOG_ERROR("[Network] Failed to acquire send buffer of {} bytes", payloadSize + overhead);
+        return false;
+    }
+    std::memcpy(copy.data(), packet.data(), payloadSize);
+    packet = std::move(copy);
+    txCopies++;
+    return true;
+}
+
+// TODO: REFACTOR FOR *1, FOR MULTIPLE PEERS
+bool UDPNetwork::sendMessageV1(
+    PacketHandle packet,
+    const boost::asio::ip::udp::endpoint& peerEndpoint,
+    const std::array<uint8_t, crypto_box_BEFORENMBYTES>& sharedKey)
+{ 
+    try
+    {
+        constexpr size_t CUSTOM_HEADER_SIZE = 16;
+        constexpr size_t NONCE_LENGTH = crypto_box_NONCEBYTES;
+        constexpr size_t MAC_LENGTH = crypto_box_MACBYTES;
+        
+        // Calculate total packet size: header (16 bytes) + nonce (24 bytes) + mac (16 bytes) + message
+        size_t winTunPacketSize = packet.size();
+        size_t wholePacketSize = MESSAGE_OVERHEAD + winTunPacketSize;
+
+        if (wholePacketSize > MAX_PACKET_SIZE)
+        {
+            NETWORK_LOG_ERROR("[Network] Message too large, max size is {}", (MAX_PACKET_SIZE - MESSAGE_OVERHEAD));
+            return false;
+        }
+
+        if (!prepareForFraming(packet, MESSAGE_OVERHEAD))
+            return false;
+        packet.prepend(MESSAGE_OVERHEAD);
+
+        // Attach custom header
+        uint32_t seq = attachCustomHeader(packet.data(), PacketType::MESSAGE);
+        
+        // Packet pointer position helpers for encryption
+        uint8_t* basePos = packet.data();
+
+        // Set wintun packet length
+        basePos[12] = (winTunPacketSize >> 24) & 0xFF;
+        basePos[13] = (winTunPacketSize >> 16) & 0xFF;
+        basePos[14] = (winTunPacketSize >> 8) & 0xFF;
+        basePos[15] = winTunPacketSize & 0xFF;
+
+        uint8_t* noncePos = basePos + CUSTOM_HEADER_SIZE;
+        uint8_t* macPos = noncePos + NONCE_LENGTH;
+        uint8_t* encrPos = macPos + MAC_LENGTH;
+
+        // Encrypt in place, detached so the ciphertext overwrites the plaintext where it is
+        // (the easy variant would memmove the whole payload to make room for the MAC), same bytes on the wire
+        randombytes_buf(noncePos, NONCE_LENGTH);
+        crypto_box_detached_afternm(
+            encrPos, // dest
+            macPos, // mac
+            encrPos, // source
+            winTunPacketSize, // message len
+            noncePos, // nonce
+            sharedKey.data()); // shared key
+
+        /*
+        * PACKET STRUCTURE: CUSTOM HEADER (16 bytes) + NONCE (24 bytes) then (MAC (16 bytes) + MESSAGE)
+        */
+        
+        transmitDatagram(std::move(packet), peerEndpoint, seq);
+        
+        return true;
+    }
+    catch (const std::exception& e)
+    {
+        SYSTEM_LOG_ERROR("[Network] Send preparation error: {}", e.what());
+        NETWORK_LOG_ERROR("[Network] Send preparation error: {}", e.what());
+        return false;
+    }
+}
+
+bool UDPNetwork::sendMessageV2(PacketHandle packet, PeerConnectionInfo& peerConnection, PacketType type)
+{
+    // Piggyback an ack when one is due, the ack timer covers peers we have nothing to send to
+    auto now = std::chrono::steady_clock::now();
+    AckTracker& ackTracker = peerConnection.getAckTracker();
+    bool withAck = ackTracker.isAckDue(now, config.ackDelay);
+    size_t overhead = V2_MESSAGE_OVERHEAD + (withAck ? AckBlock::SIZE : 0);
+
+    if (overhead + packet.size() > MAX_PACKET_SIZE)
+    {
+        NETWORK_LOG_ERROR("[Network] Message too large, max size is {}", (MAX_PACKET_SIZE - overhead));
+        return false;
+    }
+
+    if (!prepareForFraming(packet, overhead))
+        return false;
+    packet.prepend(overhead);
+
+    /*
+    * PACKET STRUCTURE: V2 HEADER (14 bytes) then (MAC (16 bytes) + [ACK BLOCK (32 bytes)] + MESSAGE)
+    */
+    uint64_t counter = peerConnection.nextTxCounter();
+    uint8_t* header = packet.data();
+    header[0] = (PROTOCOL_VERSION_V2 << 4) | static_cast<uint8_t>(type);
+    CipherSuite suite = peerConnection.getCipherSuite();
+    header[1] = static_cast<uint8_t>(suite) | (withAck ? V2_ACK_FLAG : 0);
+    writeUint32(header + 2, localSessionId);
+    writeUint64(header + 6, counter);
+
+    uint8_t* macPos = header + V2_HEADER_SIZE;
+    uint8_t* encrPos = macPos + PeerCipher::MAC_SIZE;
+    size_t payloadSize = packet.size() - V2_MESSAGE_OVERHEAD;
+    if (withAck)
+    {
+        ackTracker.makeAck(peerConnection.getPeerSessionId(), peerConnection.getReplayWindow(), now).write(encrPos);
+    }
+    // Recorded once the packet is really on its way, a rejected job must not stay in flight
+    // Its counter is spent regardless, the peer's replay window takes the gap
+    size_t datagramSize = packet.size();
+
+    // Nonce derived from session id + counter, not random: unique per key as long as the counter doesn't repeat
+    const auto& txFlow = peerConnection.getTxFlow();
+    PeerConnectionInfo::Strand* peerStrand = peerConnection.getStrand();
+    if (txFlow || peerStrand)
+    {
+        // Sealed on a worker or another IO thread, handed back to transmitDatagram in counter order
+        CryptoJob job;
+        job.operation = CryptoJob::Operation::SEAL;
+        job.suite = suite;
+        job.cipher = peerConnection.getCipher();
+        job.packet = std::move(packet);
+        job.headerSize = V2_HEADER_SIZE;
+        job.sessionId = localSessionId;
+        job.counter = counter;
+        if (txFlow && !cryptoPool->submit(txFlow, std::move(job)))
+        {
+            cryptoDrops++;
+            return false;
+        }
+        ackTracker.onPacketSent(counter, datagramSize, now);
+        if (peerStrand)
+        {
+            boost::asio::post(*peerStrand, makeAllocHandler(handlerMemory,
+                [this, job = std::move(job), peerEndpoint = peerConnection.getPeerEndpoint()]() mutable
+                {
+                    CryptoWorkerPool::runJob(job);
+                    handleSealed(job, peerEndpoint);
+                }));
+        }
+        txBacklog++;
+        return true;
+    }
+
+    peerConnection.getCipher()->seal(suite, encrPos, payloadSize, macPos, header, V2_HEADER_SIZE, localSessionId, counter);
+    ackTracker.onPacketSent(counter, datagramSize, now);
+
+    // The counter only identifies the datagram in send error logs
+    transmitDatagram(std::move(packet), peerConnection.getPeerEndpoint(), static_cast<uint32_t>(counter));
+    return true;
+}
+
+void UDPNetwork::sendAckV2(PeerConnectionInfo& peerConnection)
+{
+    PacketHandle packet = packetPool->acquire(V2_MESSAGE_OVERHEAD + AckBlock::SIZE);
+    if (!packet)
+    {
+        NETWORK_LOG_ERROR("[Network] Failed to acquire ack buffer");
+        return;
+    }
+
+    // Sealed like a message so the ack is authenticated, but small enough to skip the crypto workers
+    // Its counter may overtake messages still being sealed, the peer's replay window takes that
+    uint64_t counter = peerConnection.nextTxCounter();
+    uint8_t* header = packet.data();
+    header[0] = (PROTOCOL_VERSION_V2 << 4) | static_cast<uint8_t>(PacketType::ACK);
+    CipherSuite suite = peerConnection.getCipherSuite();
+    header[1] = static_cast<uint8_t>(suite) | V2_ACK_FLAG;
+    writeUint32(header + 2, localSessionId);
+    writeUint64(header + 6, counter);
+
+    uint8_t* macPos = header + V2_HEADER_SIZE;
+    uint8_t* ackPos = macPos + PeerCipher::MAC_SIZE;
+    auto now = std::chrono::steady_clock::now();
+    peerConnection.getAckTracker().makeAck(peerConnection.getPeerSessionId(), peerConnection.getReplayWindow(), now).write(ackPos);
+    peerConnection.getCipher()->seal(suite, ackPos, AckBlock::SIZE, macPos, header, V2_HEADER_SIZE, localSessionId, counter);
+
+    transmitDatagram(std::move(packet), peerConnection.getPeerEndpoint(), static_cast<uint32_t>(counter));
+}
+
+void UDPNetwork::scheduleAckTimer()
+{
+    if (ackTimerScheduled)
+        return;
+    ackTimerScheduled = true;
+
+    ackTimer.expires_after(config.ackDelay);
+    ackTimer.async_wait(makeAllocHandler(handlerMemory, [this](const boost::system::error_code& error)
+    {
+        ackTimerScheduled = false;
+        if (error != boost::asio::error::operation_aborted)
+            handleAckTimer();
+    }));
+}
+
+void UDPNetwork::handleAckTimer()
+{
+    if (!running)
+        return;
+
+    // Whatever outgoing data didn't pick up in time goes on its own
+    auto now = std::chrono::steady_clock::now();
+    bool stillPending = false;
+    for (auto& entry : peers)
+    {
+        AckTracker& ackTracker = entry.peer.getAckTracker();
+        if (ackTracker.isAckDue(now, config.ackDelay))
+            sendAckV2(entry.peer);
+        else if (ackTracker.isAckPending())
+            stillPending = true;
+    }
+
+    if (stillPending)
+        scheduleAckTimer();
+}
+
+void UDPNetwork::transmitDatagram(
+    PacketHandle packet,
+    const boost::asio::ip::udp::endpoint& peerEndpoint,
+    uint32_t seq)
+{
+    #ifdef PB_IO_URING
+    if (uring)
+    {
+        // A full slot table or ring falls back to asio for this one
+        if (!uring->queueSend(packet, peerEndpoint, seq))
+        {
+            sendDatagramAsync(std::move(packet), peerEndpoint, seq);
+            return;
+        }
+        txBacklog++;
+        if (uring->queuedSends() >= config.ioBatchSize)
+            flushTxBatch();
+        else
+            scheduleTxFlush();
+        return;
+    }
+    #endif
+
+    if (!batchedIoActive)
+    {
+        sendDatagramAsync(std::move(packet), peerEndpoint, seq);
+        return;
+    }
+
+    txBatch.push_back({std::move(packet), peerEndpoint, seq});
+    if (txBatch.size() >= config.ioBatchSize)
+    {
+        flushTxBatch();
+        return;
+    }
+    scheduleTxFlush();
+}
+
+void UDPNetwork::sendDatagramAsync(
+    PacketHandle packet,
+    const boost::asio::ip::udp::endpoint& peerEndpoint,
+    uint32_t seq)
+{
+    boost::asio::const_buffer buffer(packet.data(), packet.size());
+    txBacklog++;
+    socket->async_send_to(
+        buffer, peerEndpoint,
+        boost::asio::bind_executor(networkStrand, makeAllocHandler(handlerMemory,
+            [this, packet = std::move(packet), seq, peerEndpoint](const boost::system::error_code& error, std::size_t bytesSent)
+            {
+                releaseTxBacklog();
+                this->handleSendComplete(error, bytesSent, seq, peerEndpoint);
+            })));
+}
+
+void UDPNetwork::scheduleTxFlush()
+{
+    if (txFlushScheduled)
+        return;
+    txFlushScheduled = true;
+
+    if (config.batchFlushDeadline.count() == 0)
+    {
+        // Runs after the handlers already queued (e.g. the rest of a TUN burst), which coalesces them
+        boost::asio::post(networkStrand, makeAllocHandler(handlerMemory, [this]() { flushTxBatch(); }));
+        return;
+    }
+
+    txFlushTimer.expires_after(config.batchFlushDeadline);
+    txFlushTimer.async_wait(makeAllocHandler(handlerMemory, [this](const boost::system::error_code& error)
+    {
+        if (error != boost::asio::error::operation_aborted)
+            flushTxBatch();
+    }));
+}
+
+void UDPNetwork::flushTxBatch()
+{
+    txFlushScheduled = false;
+    #ifdef PB_IO_URING
+    if (uring)
+    {
+        size_t submitted = uring->flush();
+        if (submitted > 0)
+            txBatchSizes.record(submitted);
+        return;
+    }
+    #endif
+    if (txBatch.empty() || !socket || !socket->is_open())
+    {
+        txBatch.clear();
+        return;
+    }
+
+    size_t sentCount = 0;
+    #ifdef __linux__
+    size_t batchCount = txBatch.size();
+    for (size_t i = 0; i < batchCount; i++)
+    {
+        PendingDatagram& datagram = txBatch[i];
+        txIovecs[i].iov_base = datagram.packet.data();
+        txIovecs[i].iov_len = datagram.packet.size();
+
+        msghdr& header = txMessages[i].msg_hdr;
+        header = {};
+        header.msg_name = datagram.endpoint.data();
+        header.msg_namelen = static_cast<socklen_t>(datagram.endpoint.size());
+        header.msg_iov = &txIovecs[i];
+        header.msg_iovlen = 1;
+    }
+
+    int result = ::sendmmsg(socket->native_handle(), txMessages.data(), static_cast<unsigned int>(batchCount), MSG_DONTWAIT);
+    if (result > 0)
+    {
+        sentCount = static_cast<size_t>(result);
+        txBatchSizes.record(sentCount);
+    }
+    else if (errno != EAGAIN && errno != EWOULDBLOCK)
+    {
+        NETWORK_LOG_WARNING("[Network] sendmmsg failed (errno {}), falling back to single sends", errno);
+    }
+    #endif
+
+    // Whatever the kernel didn't take (full send buffer or an error on one datagram) goes through asio,
+    // which waits for the socket and reports errors through handleSendComplete as usual
+    for (size_t i = sentCount; i < txBatch.size(); i++)
+    {
+        PendingDatagram& datagram = txBatch[i];
+        sendDatagramAsync(std::move(datagram.packet), datagram.endpoint, datagram.seq);
+    }
+    txBatch.clear();
+}
+
+void UDPNetwork::handleSendComplete(
+    const boost::system::error_code& error,
+    std::size_t bytesSent,
+    uint32_t seq,
+    const boost::asio::ip::udp::endpoint& peerEndpoint)
+{
+    if (error)
+    {
+        if (error == boost::asio::error::would_block || 
+            error == boost::asio::error::try_again ||
+            error.value() == 10035) // WSAEWOULDBLOCK
+        {
+
+            NETWORK_LOG_INFO("[Network] Send buffer full");
+
+            // No resend, just log that we're dropping the packet
+            NETWORK_LOG_INFO("[Network] Dropping packet due to send buffer limits: seq={}", seq);
         }
         else
         {
-            SYSTEM_LOG_ERROR("[Network] Send error: {}, with error code: {}", error.message(), error.value());
-            NETWORK_LOG_ERROR("[Network] Send error: {}, with error code: {}", error.message(), error.value());
-            
-            // Disconnect on fatal errors, not temporary ones
-            if (error != boost::asio::error::operation_aborted)
+            SYSTEM_LOG_ERROR("[Network] Send error: {}, with error code: {}", error.message(), error.value());
+            NETWORK_LOG_ERROR("[Network] Send error: {}, with error code: {}", error.message(), error.value());
+            
+            // Disconnect on fatal errors, not temporary ones
+            if (error != boost::asio::error::operation_aborted)
+            {
+                boost::asio::post(networkStrand, [this, peerEndpoint]() {this->handleDisconnect(peerEndpoint); });
+            }
+        }
+    }
+}
+
+void UDPNetwork::setMessageCallback(MessageCallback callback)
+{
+    onMessageCallback = std::move(callback);
+}
+
+// int UDPNetwork::getLocalPort() const
+// {
+//     return localPort;
+// }
+
+// std::string UDPNetwork::getLocalAddress() const
+// {
+//     return localAddress;
+// }
+
+void UDPNetwork::startAsyncReceive()
+{
+    if (!socket) {
+        NETWORK_LOG_ERROR("[Network] startAsyncReceive: socket is null!");
+        return;
+    }
+    
+    if (!socket->is_open()) {
+        NETWORK_LOG_ERROR("[Network] startAsyncReceive: socket is not open!");
+        return;
+    }
+    
+    // Grab a pooled slab for each receive operation, no zero-fill and no allocation in steady state
+    PacketHandle receiveBuffer = packetPool->acquire(PacketBufferPool::SLAB_SIZE);
+    
+    socket->async_receive_from(
+        boost::asio::buffer(receiveBuffer.data(), receiveBuffer.capacity()), receiveEndpoint,
+        boost::asio::bind_executor(networkStrand, makeAllocHandler(handlerMemory,
+            [this, receiveBuffer](const boost::system::error_code& error, std::size_t bytesTransferred) mutable
+            {
+                this->handleReceiveFrom(error, bytesTransferred, std::move(receiveBuffer));
+            }))
+    );
+}
+
+#ifdef __linux__
+void UDPNetwork::startBatchedReceive()
+{
+    if (!socket || !socket->is_open())
+    {
+        NETWORK_LOG_ERROR("[Network] startBatchedReceive: socket is not open!");
+        return;
+    }
+
+    socket->async_wait(
+        boost::asio::ip::udp::socket::wait_read,
+        boost::asio::bind_executor(networkStrand, makeAllocHandler(handlerMemory, [this](const boost::system::error_code& error)
+        {
+            this->handleBatchedReceive(error);
+        })));
+}
+
+void UDPNetwork::handleBatchedReceive(const boost::system::error_code& error)
+{
+    if (error)
+    {
+        if (error != boost::asio::error::operation_aborted)
+        {
+            NETWORK_LOG_ERROR("[Network] Batched receive wait error: {} (code: {})", error.message(), error.value());
+            startBatchedReceive();
+        }
+        return;
+    }
+
+    size_t batchSize = rxBuffers.size();
+    for (size_t i = 0; i < batchSize; i++)
+    {
+        // Slabs handed off to processing last round get replaced, the rest are reused as-is
+        if (!rxBuffers[i])
+            rxBuffers[i] = packetPool->acquire(PacketBufferPool::SLAB_SIZE);
+
+        rxIovecs[i].iov_base = rxBuffers[i].data();
+        rxIovecs[i].iov_len = rxBuffers[i].capacity();
+
+        msghdr& header = rxMessages[i].msg_hdr;
+        header = {};
+        header.msg_name = &rxAddresses[i];
+        header.msg_namelen = sizeof(sockaddr_storage);
+        header.msg_iov = &rxIovecs[i];
+        header.msg_iovlen = 1;
+    }
+
+    int received = ::recvmmsg(socket->native_handle(), rxMessages.data(), static_cast<unsigned int>(batchSize), MSG_DONTWAIT, nullptr);
+    if (received < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            NETWORK_LOG_ERROR("[Network] recvmmsg failed (errno {})", errno);
+        }
+        startBatchedReceive();
+        return;
+    }
+
+    rxBatchSizes.record(static_cast<uint64_t>(received));
+
+    // Re-arm before processing, same as the single-datagram path
+    startBatchedReceive();
+
+    for (int i = 0; i < received; i++)
+    {
+        const msghdr& header = rxMessages[i].msg_hdr;
+        boost::asio::ip::udp::endpoint senderEndpoint;
+        std::memcpy(senderEndpoint.data(), &rxAddresses[i], header.msg_namelen);
+        senderEndpoint.resize(header.msg_namelen);
+
+        if (header.msg_flags & MSG_TRUNC)
+        {
+            rxTruncated++;
+            if (logLimiter().tryLog())
+                NETWORK_LOG_WARNING("[Network] Dropping datagram larger than {} bytes from {}",
+                    PacketBufferPool::SLAB_SIZE, senderEndpoint.address().to_string());
+            continue;
+        }
+
+        size_t bytesTransferred = rxMessages[i].msg_len;
+        rxBuffers[i].resize(bytesTransferred);
+        processReceivedData(bytesTransferred, std::move(rxBuffers[i]), senderEndpoint);
+    }
+}
+#endif
+
+#ifdef __linux__
+bool UDPNetwork::startSocketShards()
+{
+    SocketShards::Parameters parameters;
+    parameters.shards = config.socketShards;
+    parameters.batchSize = config.ioBatchSize;
+    parameters.pinThreads = config.pinShardThreads;
+    parameters.busyPoll = config.busyPollBudget;
+    socketShards = SocketShards::create(*socket, packetPool, parameters);
+    if (!socketShards)
+    {
+        NETWORK_LOG_WARNING("[Network] Can't shard the socket, receiving on the IO thread only");
+        return false;
+    }
+
+    shardPeers.clear();
+    for (size_t i = 0; i < socketShards->getShardCount(); i++)
+        shardPeers.push_back(std::make_unique<ShardPeers>());
+    publishShardPeers();
+
+    socketShards->start([this](size_t shard, std::vector<SocketShards::Datagram>& batch)
+    {
+        openOnShard(shard, batch);
+    });
+    NETWORK_LOG_INFO("[Network] Receiving on {} socket shards", socketShards->getShardCount());
+    return true;
+}
+
+void UDPNetwork::openOnShard(size_t shard, std::vector<SocketShards::Datagram>& batch)
+{
+    std::shared_ptr<const ShardCiphers> ciphers;
+    {
+        std::lock_guard<std::mutex> lock(shardPeers[shard]->mutex);
+        ciphers = shardPeers[shard]->ciphers;
+    }
+
+    struct Received
+    {
+        PacketHandle packet;
+        boost::asio::ip::udp::endpoint sender;
+        bool authenticated;
+    };
+    std::vector<Received> received;
+    received.reserve(batch.size());
+    for (SocketShards::Datagram& datagram : batch)
+    {
+        // v2 data and acks from the shard's peers are opened here, the rest goes over as it came in
+        uint8_t* basePos = datagram.packet.data();
+        size_t size = datagram.packet.size();
+        bool openHere = false;
+        if (size >= V2_MESSAGE_OVERHEAD && (basePos[0] >> 4) == PROTOCOL_VERSION_V2)
+        {
+            PacketType packetType = static_cast<PacketType>(basePos[0] & 0x0F);
+            CipherSuite suite = static_cast<CipherSuite>(basePos[1] & V2_SUITE_MASK);
+            auto peer = ciphers->find(PeerTable<PeerConnectionInfo>::endpointKey(datagram.sender));
+            openHere = peer != ciphers->end()
+                && (packetType == PacketType::MESSAGE || packetType == PacketType::ACK)
+                && PeerCipher::isSupported(suite);
+            if (openHere)
             {
-                boost::asio::post(ioContext, [this, peerEndpoint]() {this->handleDisconnect(peerEndpoint); });
+                uint8_t* macPos = basePos + V2_HEADER_SIZE;
+                if (!peer->second->open(suite, macPos + PeerCipher::MAC_SIZE, size - V2_MESSAGE_OVERHEAD, macPos,
+                    basePos, V2_HEADER_SIZE, readUint32(basePos + 2), readUint64(basePos + 6)))
+                {
+                    NETWORK_LOG_ERROR("[Network] Failed to decrypt v2 message from peer: {}", datagram.sender.address().to_string());
+                    continue;
+                }
             }
         }
+        received.push_back({std::move(datagram.packet), datagram.sender, openHere});
     }
+
+    boost::asio::post(networkStrand, makeAllocHandler(handlerMemory, [this, received = std::move(received)]() mutable
+    {
+        for (Received& datagram : received)
+        {
+            size_t size = datagram.packet.size();
+            processReceivedData(size, std::move(datagram.packet), datagram.sender, datagram.authenticated);
+        }
+    }));
 }
 
-void UDPNetwork::setMessageCallback(MessageCallback callback)
+void UDPNetwork::publishShardPeers()
 {
-    onMessageCallback = std::move(callback);
-}
+    if (!socketShards)
+        return;
 
-// int UDPNetwork::getLocalPort() const
-// {
-//     return localPort;
-// }
+    size_t shardCount = socketShards->getShardCount();
+    std::vector<std::shared_ptr<ShardCiphers>> ciphers(shardCount);
+    for (auto& shardCiphers : ciphers)
+        shardCiphers = std::make_shared<ShardCiphers>();
+    for (const auto& entry : peers)
+    {
+        // Unsteered, any shard may get any peer's datagrams
+        size_t steeredTo = SocketShards::shardFor(entry.peer.getPeerEndpoint(), shardCount);
+        for (size_t i = 1; i < shardCount; i++)
+        {
+            if (i == steeredTo || !socketShards->isSteered())
+                (*ciphers[i])[entry.key] = entry.peer.getCipher();
+        }
+    }
 
-// std::string UDPNetwork::getLocalAddress() const
-// {
-//     return localAddress;
-// }
+    for (size_t i = 1; i < shardCount; i++)
+    {
+        std::lock_guard<std::mutex> lock(shardPeers[i]->mutex);
+        shardPeers[i]->ciphers = std::move(ciphers[i]);
+    }
+}
+#endif
 
-void UDPNetwork::startAsyncReceive()
+#ifdef PB_IO_URING
+bool UDPNetwork::startUring()
 {
-    if (!socket) {
-        NETWORK_LOG_ERROR("[Network] startAsyncReceive: socket is null!");
-        return;
-    }
-    
-    if (!socket->is_open()) {
-        NETWORK_LOG_ERROR("[Network] startAsyncReceive: socket is not open!");
-        return;
+    UringTransport::Parameters parameters;
+    uring = UringTransport::create(socket->native_handle(), networkStrand, packetPool, parameters);
+    if (!uring)
+    {
+        NETWORK_LOG_WARNING("[Network] io_uring not available, staying on asio");
+        return false;
     }
-    
-    // Create buffer for each receive operation
-    auto receiveBuffer = std::make_shared<std::vector<uint8_t>>(MAX_PACKET_SIZE);
-    auto senderEndpoint = std::make_shared<boost::asio::ip::udp::endpoint>();
-    
-    socket->async_receive_from(
-        boost::asio::buffer(*receiveBuffer), *senderEndpoint,
-        [this, receiveBuffer, senderEndpoint](const boost::system::error_code& error, std::size_t bytesTransferred)
+
+    bool started = uring->start(
+        [this](PacketHandle packet, const boost::asio::ip::udp::endpoint& sender)
         {
-            this->handleReceiveFrom(error, bytesTransferred, receiveBuffer, senderEndpoint);
-        }
-    );
+            size_t size = packet.size();
+            processReceivedData(size, std::move(packet), sender);
+        },
+        [this](const boost::system::error_code& error, std::size_t bytesSent, uint32_t seq, const boost::asio::ip::udp::endpoint& peerEndpoint)
+        {
+            releaseTxBacklog();
+            handleSendComplete(error, bytesSent, seq, peerEndpoint);
+        });
+    if (!started)
+    {
+        NETWORK_LOG_WARNING("[Network] io_uring can't receive on this kernel, staying on asio");
+        uring.reset();
+        return false;
+    }
+    return true;
 }
+#endif
 
 void UDPNetwork::handleReceiveFrom(
     const boost::system::error_code& error,
     std::size_t bytesTransferred,
-    std::shared_ptr<std::vector<uint8_t>> receiveBuffer,
-    std::shared_ptr<boost::asio::ip::udp::endpoint> senderEndpoint)
+    PacketHandle receiveBuffer)
 {
+    // Copy the sender out before the next receive reuses the endpoint
+    boost::asio::ip::udp::endpoint senderEndpoint = receiveEndpoint;
+
     if (socket && socket->is_open() && error != boost::asio::error::operation_aborted)
     {
         startAsyncReceive(); // Continuously queue up another startAsyncReceive
@@ -556,7 +1767,8 @@ void UDPNetwork::handleReceiveFrom(
 
     if (!error)
     {
-        processReceivedData(bytesTransferred, receiveBuffer, senderEndpoint);
+        receiveBuffer.resize(bytesTransferred);
+        processReceivedData(bytesTransferred, std::move(receiveBuffer), senderEndpoint);
     }
     else if (error != boost::asio::error::operation_aborted)
     {
@@ -570,197 +1782,641 @@ void UDPNetwork::handleReceiveFrom(
             // Recoverable errors
             NETWORK_LOG_WARNING("[Network] Recoverable receive error: {} (code: {}), continuing", error.message(), error.value());
         }
+        else if (error == boost::asio::error::message_size)
+        {
+            // Datagram didn't fit in a slab (WSAEMSGSIZE), drop it but keep the peer
+            NETWORK_LOG_WARNING("[Network] Dropping datagram larger than {} bytes from {}",
+                PacketBufferPool::SLAB_SIZE, senderEndpoint.address().to_string());
+        }
         else
         {
             // Fatal errors
             NETWORK_LOG_ERROR("[Network] Fatal receive error: {} (code: {}), disconnecting", error.message(), error.value());
-            handleDisconnect(*senderEndpoint);
+            handleDisconnect(senderEndpoint);
+        }
+    }
+}
+
+void UDPNetwork::processReceivedData(
+    std::size_t bytesTransferred,
+    PacketHandle receiveBuffer,
+    const boost::asio::ip::udp::endpoint& senderEndpoint,
+    bool authenticated)
+{
+    constexpr size_t CUSTOM_HEADER_SIZE = 16;
+    constexpr size_t NONCE_LENGTH = crypto_box_NONCEBYTES;
+    constexpr size_t MAC_LENGTH = crypto_box_MACBYTES;
+
+    if (bytesTransferred == 0)
+    {
+        return;
+    }
+
+    const uint8_t* buffer = receiveBuffer.data();
+    PacketType packetType;
+
+    // v2 packets carry the version in the top nibble of the first byte, v1 packets start with the magic number
+    bool isV2 = (buffer[0] >> 4) == PROTOCOL_VERSION_V2;
+    if (isV2)
+    {
+        if (bytesTransferred < V2_MESSAGE_OVERHEAD)
+        {
+            NETWORK_LOG_ERROR("[Network] Received v2 packet too small: {} bytes", bytesTransferred);
+            return;
+        }
+
+        // Only data, acks, group keys, suites and group-sealed broadcasts are framed as v2
+        packetType = static_cast<PacketType>(buffer[0] & 0x0F);
+        if (packetType != PacketType::MESSAGE && packetType != PacketType::ACK && packetType != PacketType::GROUP_KEY &&
+            packetType != PacketType::GROUP_MESSAGE && packetType != PacketType::SUITES)
+        {
+            NETWORK_LOG_WARNING("[Network] Received v2 packet with unexpected type: {}", static_cast<int>(packetType));
+            return;
+        }
+    }
+    else
+    {
+        // Skip if we don't have enough data for header
+        if (bytesTransferred < CUSTOM_HEADER_SIZE)
+        {
+            NETWORK_LOG_ERROR("[Network] Received packet too small: {} bytes", bytesTransferred);
+            return;
+        }
+
+        /*
+        * SMALL CUSTOM PROTOCOL HEADER
+        */
+
+        // Validate magic number
+        uint32_t magic = (buffer[0] << 24) | (buffer[1] << 16) | (buffer[2] << 8) | buffer[3];
+        if (magic != MAGIC_NUMBER)
+        {
+            NETWORK_LOG_WARNING("[Network] Received packet with invalid magic number: {}", magic);
+            return;
+        }
+        
+        // Validate protocol version
+        uint16_t version = (buffer[4] << 8) | buffer[5];
+        if (version != PROTOCOL_VERSION)
+        {
+            NETWORK_LOG_ERROR("[Network] Unsupported protocol version: {}", version);
+            return;
+        }
+        
+        // Get packet type
+        packetType = static_cast<PacketType>(buffer[6]);
+    }
+
+    PeerConnectionInfo* peer = peers.find(senderEndpoint);
+    if (!peer)
+    {
+        NETWORK_LOG_ERROR("[Network] Received packet from unknown peer: {}", senderEndpoint.address().to_string());
+        return;
+    }
+    
+    // Update peer activity time
+    PeerConnectionInfo& peerConnection = *peer;
+    peerConnection.updateActivity();
+
+    if (packetType == PacketType::DISCONNECT)
+    {
+        SYSTEM_LOG_INFO("[Network] Received disconnect notification from peer");
+        NETWORK_LOG_INFO("[Network] Received disconnect notification from peer");
+        handleDisconnect(senderEndpoint);
+        return;
+    }
+
+    // Consume packet if network not running
+    if (!running)
+    {
+        NETWORK_LOG_ERROR("[Network] Received packet, but network not running");
+        return;
+    }
+
+    // Store peer endpoint if not already connected
+    if (!peerConnection.isConnected())
+    {
+        NETWORK_LOG_INFO("[Network] First valid packet received from peer, establishing connection");
+        peerConnection.setConnected(true);
+        
+        // Notify peer connected event
+        notifyConnectionEvent(NetworkEvent::PEER_CONNECTED, peerConnection.getPeerEndpoint().address().to_string());
+
+        // The new peer missed the reports our host sent when it joined its groups, have it send them again
+        if (config.multicastSnooping)
+            queryLocalMemberships();
+    }
+
+    // Process packet based on type
+    switch (packetType)
+    {
+        case PacketType::HOLE_PUNCH:
+        {
+            NETWORK_LOG_INFO("[Network] Received hole-punch packet from peer");
+            // Activity time was already updated above
+
+            // Byte 7 advertises the highest protocol version the peer speaks, 0 from peers that predate v2
+            // Hole punches aren't authenticated, so it's only a hint: we follow it either way until a v2 packet
+            // from the peer authenticates, a spoofed one is undone by the peer's next keep-alive; after that
+            // nothing talks us back down to v1 framing, which has no replay protection
+            uint8_t negotiated = std::min<uint8_t>(std::max<uint8_t>(buffer[7], PROTOCOL_VERSION), config.maxProtocolVersion);
+            if (peerConnection.isProtocolVersionConfirmed())
+                negotiated = peerConnection.getProtocolVersion();
+            if (negotiated != peerConnection.getProtocolVersion())
+            {
+                NETWORK_LOG_INFO("[Network] Using protocol v{} with peer {}", negotiated, senderEndpoint.address().to_string());
+                peerConnection.setProtocolVersion(negotiated);
+            }
+
+            // Bytes 12 / 13: suites the peer can open and the one it prefers, both 0 from peers without the choice
+            // Unauthenticated as well, so they only tell us whether it's worth asking: the suite changes once the
+            // peer's own SUITES packet says the same, until then we stay on XSalsa20, which every v2 peer opens
+            if (negotiated >= PROTOCOL_VERSION_V2)
+            {
+                if (PeerCipher::chooseSuite(preferredSuite, buffer[12], buffer[13]) != peerConnection.getCipherSuite())
+                {
+                    sendSuites(peerConnection, SUITES_OFFER);
+                }
+
+                // Hole punches repeat with every keep-alive, so does the offer until the peer confirms it
+                if (config.groupBroadcast && !peerConnection.hasConfirmedGroupKey(localSessionId))
+                {
+                    sendGroupKey(peerConnection, GROUP_KEY_OFFER, localSessionId);
+                }
+            }
+            break;
+        }
+            
+        case PacketType::HEARTBEAT:
+            NETWORK_LOG_INFO("[Network] Received heartbeat packet from peer");
+            // Activity time was already updated above
+            break;
+            
+        case PacketType::MESSAGE:
+        case PacketType::GROUP_KEY:
+        case PacketType::SUITES:
+        {
+            if (isV2)
+            {
+                processMessageV2(std::move(receiveBuffer), bytesTransferred, peerConnection, senderEndpoint, authenticated);
+                break;
+            }
+
+            if (packetType != PacketType::MESSAGE)
+            {
+                NETWORK_LOG_WARNING("[Network] Dropping v2 control packet without v2 framing");
+                break;
+            }
+
+            // A peer whose v2 packets authenticated frames its data as v2, a v1 message from it can only be a replay
+            // slipping past the replay window; until then it may still be a v1 peer, whatever its hole punch said
+            if (peerConnection.isProtocolVersionConfirmed())
+            {
+                NETWORK_LOG_WARNING("[Network] Dropping v1 message from v2 peer {}", senderEndpoint.address().to_string());
+                return;
+            }
+
+            if (bytesTransferred < CUSTOM_HEADER_SIZE + NONCE_LENGTH + MAC_LENGTH)
+            {
+                NETWORK_LOG_ERROR("[Network] Received WinTun packet too small: {} bytes", bytesTransferred);
+                return;
+            }
+            uint32_t winTunPacketSize = (buffer[12] << 24) | (buffer[13] << 16) | (buffer[14] << 8) | buffer[15];
+            size_t wholePacketSize = CUSTOM_HEADER_SIZE + NONCE_LENGTH + MAC_LENGTH + winTunPacketSize;
+            // Validate message length
+            if (wholePacketSize > bytesTransferred)
+            {
+                NETWORK_LOG_ERROR("[Network] Message length exceeds packet size");
+                return;
+            }
+            
+            // No ACK for v1 messages, they are only ever logged by the sender
+
+            // Packet pointer position helpers for decryption
+            uint8_t* basePos = receiveBuffer.data();
+            uint8_t* noncePos = basePos + CUSTOM_HEADER_SIZE;
+            uint8_t* macPos = noncePos + NONCE_LENGTH;
+            uint8_t* encrPos = macPos + MAC_LENGTH;
+
+            // Decrypt in place, detached so the plaintext stays where the ciphertext was
+            size_t encrSize = bytesTransferred - MESSAGE_OVERHEAD;
+            if (crypto_box_open_detached_afternm(
+                encrPos, // dest
+                encrPos, // source
+                macPos, // mac
+                encrSize,
+                noncePos, // nonce
+                peerConnection.getSharedKey().data()) != 0)
+            {
+                NETWORK_LOG_ERROR("[Network] Failed to decrypt message from peer: {}", senderEndpoint.address().to_string());
+                return;
+            }
+            
+            // Process message, send to wintun interface
+            // The receive buffer itself goes on, narrowed down to the IP packet
+            receiveBuffer.trimFront(MESSAGE_OVERHEAD);
+            receiveBuffer.resize(winTunPacketSize);
+            deliverPacketToTun(std::move(receiveBuffer), peerConnection);
+            break;
+        }
+        case PacketType::ACK:
+        {
+            if (isV2)
+            {
+                processMessageV2(std::move(receiveBuffer), bytesTransferred, peerConnection, senderEndpoint, authenticated);
+                break;
+            }
+            // Older peers still ACK every v1 message, there's nothing to match them against
+            break;
+        }
+        case PacketType::GROUP_MESSAGE:
+        {
+            if (!isV2)
+            {
+                NETWORK_LOG_WARNING("[Network] Dropping group message without v2 framing");
+                break;
+            }
+            processGroupMessage(std::move(receiveBuffer), bytesTransferred, peerConnection, senderEndpoint);
+            break;
+        }
+        default:
+            NETWORK_LOG_ERROR("[Network] Unknown packet type: {}", static_cast<int>(packetType));
+            break;
+    }
+}
+
+void UDPNetwork::processMessageV2(
+    PacketHandle receiveBuffer,
+    std::size_t bytesTransferred,
+    PeerConnectionInfo& peerConnection,
+    const boost::asio::ip::udp::endpoint& senderEndpoint,
+    bool authenticated)
+{
+    receiveBuffer.resize(bytesTransferred);
+    uint8_t* basePos = receiveBuffer.data();
+    uint32_t sessionId = readUint32(basePos + 2);
+    uint64_t counter = readUint64(basePos + 6);
+
+    // Early out before paying for decryption, acceptMessageV2 checks again once it authenticated
+    bool newSession = sessionId != peerConnection.getPeerSessionId();
+    if (newSession ? isPastPeerSession(peerConnection, sessionId) : !peerConnection.getReplayWindow().check(counter))
+    {
+        replayDrops++;
+        return;
+    }
+
+    // The peer picks the suite per packet, anything we support is fine
+    CipherSuite suite = static_cast<CipherSuite>(basePos[1] & V2_SUITE_MASK);
+    if (!PeerCipher::isSupported(suite))
+    {
+        NETWORK_LOG_WARNING("[Network] Dropping v2 message with unsupported cipher suite {}", basePos[1] & V2_SUITE_MASK);
+        return;
+    }
+
+    bool hasAck = (basePos[1] & V2_ACK_FLAG) != 0;
+    bool ackOnly = static_cast<PacketType>(basePos[0] & 0x0F) == PacketType::ACK;
+    if ((hasAck && bytesTransferred < V2_MESSAGE_OVERHEAD + AckBlock::SIZE) || (ackOnly && !hasAck))
+    {
+        NETWORK_LOG_WARNING("[Network] Dropping malformed v2 ack from {}", senderEndpoint.address().to_string());
+        return;
+    }
+
+    if (authenticated)
+    {
+        acceptMessageV2(std::move(receiveBuffer), peerConnection, sessionId, counter);
+        return;
+    }
+
+    uint8_t* macPos = basePos + V2_HEADER_SIZE;
+    uint8_t* encrPos = macPos + PeerCipher::MAC_SIZE;
+    size_t encrSize = bytesTransferred - V2_MESSAGE_OVERHEAD;
+
+    const auto& rxFlow = peerConnection.getRxFlow();
+    PeerConnectionInfo::Strand* peerStrand = peerConnection.getStrand();
+    if (rxFlow || peerStrand)
+    {
+        CryptoJob job;
+        job.operation = CryptoJob::Operation::OPEN;
+        job.suite = suite;
+        job.cipher = peerConnection.getCipher();
+        job.packet = std::move(receiveBuffer);
+        job.headerSize = V2_HEADER_SIZE;
+        job.sessionId = sessionId;
+        job.counter = counter;
+        if (rxFlow)
+        {
+            if (!cryptoPool->submit(rxFlow, std::move(job)))
+                cryptoDrops++;
+            return;
         }
+        boost::asio::post(*peerStrand, makeAllocHandler(handlerMemory,
+            [this, job = std::move(job), peerKey = PeerTable<PeerConnectionInfo>::endpointKey(peerConnection.getPeerEndpoint())]() mutable
+            {
+                CryptoWorkerPool::runJob(job);
+                handleOpened(job, peerKey);
+            }));
+        return;
+    }
+
+    if (!peerConnection.getCipher()->open(suite, encrPos, encrSize, macPos, basePos, V2_HEADER_SIZE, sessionId, counter))
+    {
+        NETWORK_LOG_ERROR("[Network] Failed to decrypt v2 message from peer: {}", senderEndpoint.address().to_string());
+        return;
     }
+
+    acceptMessageV2(std::move(receiveBuffer), peerConnection, sessionId, counter);
 }
 
-void UDPNetwork::processReceivedData(
+void UDPNetwork::processGroupMessage(
+    PacketHandle receiveBuffer,
     std::size_t bytesTransferred,
-    std::shared_ptr<std::vector<uint8_t>> receiveBuffer,
-    std::shared_ptr<boost::asio::ip::udp::endpoint> senderEndpoint)
+    PeerConnectionInfo& peerConnection,
+    const boost::asio::ip::udp::endpoint& senderEndpoint)
 {
-    constexpr size_t CUSTOM_HEADER_SIZE = 16;
-    constexpr size_t NONCE_LENGTH = crypto_box_NONCEBYTES;
-    constexpr size_t MAC_LENGTH = crypto_box_MACBYTES;
-    
-    // Skip if we don't have enough data for header
-    if (bytesTransferred < CUSTOM_HEADER_SIZE)
+    receiveBuffer.resize(bytesTransferred);
+    uint8_t* basePos = receiveBuffer.data();
+    uint32_t keyId = readUint32(basePos + 2);
+    uint64_t counter = readUint64(basePos + 6);
+
+    bool relayed = (basePos[1] & V2_RELAY_FLAG) != 0;
+    if ((basePos[1] & ~V2_RELAY_FLAG) != static_cast<uint8_t>(GroupCipher::SUITE))
     {
-        NETWORK_LOG_ERROR("[Network] Received packet too small: {} bytes", bytesTransferred);
+        NETWORK_LOG_WARNING("[Network] Dropping group message with unexpected suite / flags {}", basePos[1]);
         return;
     }
-    
-    const std::vector<uint8_t>& buffer = *receiveBuffer;
 
-    /*
-    * SMALL CUSTOM PROTOCOL HEADER
-    */
+    size_t headerSize = V2_HEADER_SIZE;
+    if (relayed)
+    {
+        size_t treeSize = RelayTree::parse(basePos + V2_HEADER_SIZE, bytesTransferred - V2_MESSAGE_OVERHEAD);
+        if (treeSize == 0)
+        {
+            NETWORK_LOG_WARNING("[Network] Dropping group message with malformed relay tree from {}", senderEndpoint.address().to_string());
+            return;
+        }
+        headerSize += treeSize;
+    }
 
-    // Validate magic number
-    uint32_t magic = (buffer[0] << 24) | (buffer[1] << 16) | (buffer[2] << 8) | buffer[3];
-    if (magic != MAGIC_NUMBER)
+    // Sent by the key's owner, or relayed for it by another peer, then the key id says whose it is
+    PeerConnectionInfo* source = &peerConnection;
+    const GroupCipher* cipher = peerConnection.getPeerGroupCipher(keyId);
+    for (auto entry = peers.begin(); !cipher && relayed && entry != peers.end(); ++entry)
     {
-        NETWORK_LOG_WARNING("[Network] Received packet with invalid magic number: {}", magic);
-        return;
+        source = &entry->peer;
+        cipher = source->getPeerGroupCipher(keyId);
     }
-    
-    // Validate protocol version
-    uint16_t version = (buffer[4] << 8) | buffer[5];
-    if (version != PROTOCOL_VERSION)
+    // Nothing to open it with until the owner's offer for this key id arrived
+    if (!cipher)
     {
-        NETWORK_LOG_ERROR("[Network] Unsupported protocol version: {}", version);
+        NETWORK_LOG_WARNING("[Network] Dropping group message with unknown key {} from {}", keyId, senderEndpoint.address().to_string());
         return;
     }
-    
-    // Get packet type
-    PacketType packetType = static_cast<PacketType>(buffer[6]);
-    
-    // Get sequence number
-    uint32_t seq = (buffer[8] << 24) | (buffer[9] << 16) | (buffer[10] << 8) | buffer[11];
 
-    uint32_t senderIp = utils::ipToUint32(senderEndpoint->address().to_string());
-    if (publicIpToPeerConnection.find(senderIp) == publicIpToPeerConnection.end())
+    // Own window per source: group and pairwise counters are separate sequences, and a relayed copy
+    // that also reaches us another way is a duplicate; no acks, broadcasts aren't retransmitted
+    ReplayWindow& replayWindow = source->getGroupReplayWindow();
+    if (!replayWindow.check(counter))
     {
-        NETWORK_LOG_ERROR("[Network] Received packet from unknown peer: {}", senderEndpoint->address().to_string());
+        replayDrops++;
         return;
     }
-    
-    // Update peer activity time
-    auto& peerConnection = publicIpToPeerConnection[senderIp];
-    peerConnection.updateActivity();
 
-    if (packetType == PacketType::DISCONNECT)
+    // Once per datagram and small next to the pairwise bursts, so opened inline rather than on the crypto workers
+    uint8_t* macPos = basePos + headerSize;
+    uint8_t* encrPos = macPos + GroupCipher::MAC_SIZE;
+    if (bytesTransferred < headerSize + GroupCipher::MAC_SIZE)
     {
-        SYSTEM_LOG_INFO("[Network] Received disconnect notification from peer");
-        NETWORK_LOG_INFO("[Network] Received disconnect notification from peer");
-        handleDisconnect(*senderEndpoint);
+        NETWORK_LOG_ERROR("[Network] Dropping truncated group message from peer: {}", senderEndpoint.address().to_string());
         return;
     }
-
-    // Consume packet if network not running
-    if (!running)
+    size_t encrSize = bytesTransferred - headerSize - GroupCipher::MAC_SIZE;
+
+    // The peers below us in the tree get the datagram as it arrived, but opening decrypts in place: authenticate
+    // first and take the copy only then, so junk costs neither a buffer nor a memcpy
+    uint8_t children[RelayTree::MAX_FANOUT];
+    size_t childCount = relayed ? RelayTree::childrenOf(basePos + V2_HEADER_SIZE, static_cast<uint8_t>(selfVirtualIp & 0xFF), children) : 0;
+    bool authentic = childCount > 0
+        ? cipher->verify(encrPos, encrSize, macPos, basePos, headerSize, keyId, counter)
+        : cipher->open(encrPos, encrSize, macPos, basePos, headerSize, keyId, counter);
+    if (!authentic)
     {
-        NETWORK_LOG_ERROR("[Network] Received packet, but network not running");
+        NETWORK_LOG_ERROR("[Network] Failed to decrypt group message from peer: {}", senderEndpoint.address().to_string());
         return;
     }
-
-    // Store peer endpoint if not already connected
-    if (!peerConnection.isConnected())
+    PacketHandle forward;
+    if (childCount > 0)
     {
-        NETWORK_LOG_INFO("[Network] First valid packet received from peer, establishing connection");
-        peerConnection.setConnected(true);
-        
-        // Notify peer connected event
-        notifyConnectionEvent(NetworkEvent::PEER_CONNECTED, peerConnection.getPeerEndpoint().address().to_string());
+        // Relaying waits on our send backlog like our own broadcasts, we still take the payload either way
+        if (admitToTxBacklog())
+            forward = packetPool->acquire(bytesTransferred);
+        if (forward)
+            std::memcpy(forward.data(), basePos, bytesTransferred);
+        cipher->decrypt(encrPos, encrSize, keyId, counter);
     }
+    replayWindow.update(counter);
 
-    // Process packet based on type
-    switch (packetType)
+    // Only forwarded once it authenticated, nobody outside the lobby can make us amplify traffic
+    for (size_t i = 0; forward && i < childCount; i++)
     {
-        case PacketType::HOLE_PUNCH:
-            NETWORK_LOG_INFO("[Network] Received hole-punch packet from peer");
-            // Activity time was already updated above
-            break;
-            
-        case PacketType::HEARTBEAT:
-            NETWORK_LOG_INFO("[Network] Received heartbeat packet from peer");
-            // Activity time was already updated above
-            break;
-            
-        case PacketType::MESSAGE:
-        {
-            if (bytesTransferred < CUSTOM_HEADER_SIZE + NONCE_LENGTH + MAC_LENGTH)
-            {
-                NETWORK_LOG_ERROR("[Network] Received WinTun packet too small: {} bytes", bytesTransferred);
-                return;
-            }
-            uint32_t winTunPacketSize = (buffer[12] << 24) | (buffer[13] << 16) | (buffer[14] << 8) | buffer[15];
-            size_t wholePacketSize = CUSTOM_HEADER_SIZE + NONCE_LENGTH + MAC_LENGTH + winTunPacketSize;
-            // Validate message length
-            if (wholePacketSize > bytesTransferred)
-            {
-                NETWORK_LOG_ERROR("[Network] Message length exceeds packet size");
-                return;
-            }
-            
-            // Create ACK packet
-            auto ack = std::make_shared<std::vector<uint8_t>>(16);
+        PeerConnectionInfo* child = peers.findByVirtualIp((selfVirtualIp & 0xFFFFFF00) | children[i]);
+        if (!child || child == source)
+            continue;
+        fanoutStats.relayed++;
+        transmitDatagram(forward, child->getPeerEndpoint(), static_cast<uint32_t>(counter));
+    }
 
-            // Attach custom header
-            attachCustomHeader(ack, PacketType::ACK, std::make_optional(seq));
-            
-            // Send ACK
-            socket->async_send_to(
-                boost::asio::buffer(*ack), *senderEndpoint,
-                [this, ack](const boost::system::error_code& error, std::size_t sent)
-                {
-                    if (error && error != boost::asio::error::operation_aborted)
-                    {
-                        NETWORK_LOG_ERROR("[Network] Error sending ACK: {} (code: {})", error.message(), error.value());
-                    }
-                });
+    receiveBuffer.trimFront(headerSize + GroupCipher::MAC_SIZE);
+    deliverPacketToTun(std::move(receiveBuffer), *source);
+}
 
-            // Packet pointer position helpers for decryption
-            uint8_t* basePos = receiveBuffer->data();
-            uint8_t* noncePos = basePos + CUSTOM_HEADER_SIZE;
-            uint8_t* macPos = noncePos + NONCE_LENGTH;
-            uint8_t* encrPos = macPos + MAC_LENGTH;
+void UDPNetwork::acceptMessageV2(PacketHandle packet, PeerConnectionInfo& peerConnection, uint32_t sessionId, uint64_t counter)
+{
+    // A new session id means the peer restarted its counters, its window only replaces ours once a packet authenticates;
+    // going back to a session it already left would reopen every counter of the current one
+    bool newSession = sessionId != peerConnection.getPeerSessionId();
+    ReplayWindow& replayWindow = peerConnection.getReplayWindow();
+    if (newSession ? isPastPeerSession(peerConnection, sessionId) : !replayWindow.check(counter))
+    {
+        // Duplicates can both pass the early check while in the crypto workers
+        replayDrops++;
+        return;
+    }
 
-            // Decrypt
-            size_t encrSize = bytesTransferred - CUSTOM_HEADER_SIZE - NONCE_LENGTH;
-            if (crypto_box_open_easy_afternm(
-                macPos, // dest
-                macPos, // source,
-                encrSize,
-                noncePos, // nonce
-                peerConnection.getSharedKey().data()) != 0)
-            {
-                NETWORK_LOG_ERROR("[Network] Failed to decrypt message from peer: {}", senderEndpoint->address().to_string());
-                return;
-            }
-            
-            // Process message, send to wintun interface
-            std::uint8_t* wintTunPacketPos = macPos;
-            deliverPacketToTun({wintTunPacketPos, wintTunPacketPos + winTunPacketSize});
-            break;
+    AckTracker& ackTracker = peerConnection.getAckTracker();
+    if (newSession)
+    {
+        NETWORK_LOG_INFO("[Network] Peer {} started v2 session {}", peerConnection.getPeerEndpoint().address().to_string(), sessionId);
+        replayWindow.reset();
+        ackTracker.resetReceiveSide();
+        bool restarted = peerConnection.getPeerSessionId() != 0;
+        peerConnection.setPeerSessionId(sessionId);
+        peerSessionHistory[peerConnection.getSharedKey()].push_back(sessionId);
+        // A restarted peer may not open what it did before, back to XSalsa20 until its next SUITES packet
+        if (restarted)
+            peerConnection.setCipherSuite(CipherSuite::XSALSA20_POLY1305);
+        // A restarted peer lost our group key, pairwise until it confirms the offer again
+        if (restarted && peerConnection.hasConfirmedGroupKey(localSessionId))
+        {
+            peerConnection.setGroupKeyConfirmed(0);
+            relayTreeStale = true;
+            if (config.groupBroadcast)
+                sendGroupKey(peerConnection, GROUP_KEY_OFFER, localSessionId);
         }
-        case PacketType::ACK:
+    }
+    replayWindow.update(counter);
+
+    if (!peerConnection.isProtocolVersionConfirmed() && config.maxProtocolVersion >= PROTOCOL_VERSION_V2)
+    {
+        NETWORK_LOG_INFO("[Network] Peer {} confirmed protocol v2", peerConnection.getPeerEndpoint().address().to_string());
+        peerConnection.setProtocolVersion(PROTOCOL_VERSION_V2);
+        peerConnection.confirmProtocolVersion();
+    }
+
+    const uint8_t* header = packet.data();
+    PacketType packetType = static_cast<PacketType>(header[0] & 0x0F);
+    bool ackOnly = packetType == PacketType::ACK;
+    size_t overhead = V2_MESSAGE_OVERHEAD;
+    auto now = std::chrono::steady_clock::now();
+    ackTracker.onPacketReceived(counter, !ackOnly, now);
+    if (header[1] & V2_ACK_FLAG)
+    {
+        // Acks for an earlier session of ours (we restarted since) say nothing about the current one
+        AckBlock ack = AckBlock::read(header + V2_MESSAGE_OVERHEAD);
+        if (ack.sessionId == localSessionId)
         {
-            // Remove from pending acks
-            std::lock_guard<std::mutex> lock(pendingAcksMutex);
-            pendingAcks.erase(seq);
-            break;
+            AckTracker::RateSample sample = ackTracker.onAckReceived(ack, now);
+            peerConnection.getCongestionController().onAck(sample, ackTracker.getStats(), now);
+            // The window may have room again
+            if (!peerConnection.getSendScheduler().empty())
+                scheduleSendDrain();
         }
-        default:
-            NETWORK_LOG_ERROR("[Network] Unknown packet type: {}", static_cast<int>(packetType));
-            break;
+        overhead += AckBlock::SIZE;
+    }
+
+    if (ackOnly)
+        return;
+
+    if (ackTracker.mustAckNow())
+        sendAckV2(peerConnection);
+    else
+        scheduleAckTimer();
+
+    size_t payloadSize = packet.size() - overhead;
+    if (packetType == PacketType::GROUP_KEY)
+    {
+        handleGroupKey(packet.data() + overhead, payloadSize, peerConnection);
+        return;
+    }
+    if (packetType == PacketType::SUITES)
+    {
+        handleSuites(packet.data() + overhead, payloadSize, peerConnection);
+        return;
     }
+    packet.trimFront(overhead);
+    packet.resize(payloadSize);
+    deliverPacketToTun(std::move(packet), peerConnection);
 }
 
-void UDPNetwork::deliverPacketToTun(const std::vector<uint8_t> packet)
+bool UDPNetwork::isPastPeerSession(const PeerConnectionInfo& peerConnection, uint32_t sessionId) const
 {
-    // Extract source and destination IPs for filtering
-    uint32_t srcIp = (packet[12] << 24) | (packet[13] << 16) | (packet[14] << 8) | packet[15];
-    uint32_t dstIp = (packet[16] << 24) | (packet[17] << 16) | (packet[18] << 8) | packet[19];
+    // Only sessions that authenticated get in here, a handful per peer and lobby
+    auto history = peerSessionHistory.find(peerConnection.getSharedKey());
+    return history != peerSessionHistory.end() &&
+        std::find(history->second.begin(), history->second.end(), sessionId) != history->second.end();
+}
 
-    // Only deliver packets that are meant for us OR are broadcast/multicast packets
-    uint32_t BROADCAST_IP = utils::ipToUint32(networkConfigManager->getSetupConfig().IP_SPACE + std::to_string(255));
+void UDPNetwork::updateForwarding()
+{
+    relayTreeStale = true;
+    forwarding.clearPeers();
+    MulticastGroups::Members present;
+    uint16_t slot = 0;
+    for (const auto& entry : peers)
+    {
+        forwarding.setPeerSlot(entry.virtualIp, slot++);
+        present.set(entry.virtualIp & 0xFF);
+    }
+    multicastGroups.retainOnly(present);
+    #ifdef __linux__
+    publishShardPeers();
+    #endif
+}
+
+void UDPNetwork::createCryptoFlows(PeerTable<PeerConnectionInfo>::Key peerKey, PeerConnectionInfo& peerConnection)
+{
+    // Completions run on the workers, in order per flow
+    boost::asio::ip::udp::endpoint peerEndpoint = peerConnection.getPeerEndpoint();
+    auto txFlow = cryptoPool->createFlow([this, peerEndpoint](CryptoJob& job)
+    {
+        handleSealed(job, peerEndpoint);
+    });
+
+    auto rxFlow = cryptoPool->createFlow([this, peerKey](CryptoJob& job)
+    {
+        handleOpened(job, peerKey);
+    });
+
+    peerConnection.setCryptoFlows(std::move(txFlow), std::move(rxFlow));
+}
+
+void UDPNetwork::handleSealed(CryptoJob& job, const boost::asio::ip::udp::endpoint& peerEndpoint)
+{
+    // Posting keeps the order the jobs finished in
+    boost::asio::post(networkStrand, makeAllocHandler(handlerMemory,
+        [this, peerEndpoint, packet = std::move(job.packet), counter = job.counter]() mutable
+        {
+            releaseTxBacklog();
+            transmitDatagram(std::move(packet), peerEndpoint, static_cast<uint32_t>(counter));
+        }));
+}
+
+void UDPNetwork::handleOpened(CryptoJob& job, PeerTable<PeerConnectionInfo>::Key peerKey)
+{
+    boost::asio::post(networkStrand, makeAllocHandler(handlerMemory,
+        [this, peerKey, packet = std::move(job.packet), ok = job.ok, sessionId = job.sessionId, counter = job.counter]() mutable
+        {
+            PeerConnectionInfo* peer = peers.find(peerKey);
+            if (!peer)
+                return;
 
-    bool isForUs = (dstIp == selfVirtualIp);
-    bool isBroadcast = (dstIp == BROADCAST_IP) || (dstIp == NetworkConstants::BROADCAST_IP2);
-    bool isMulticast = (dstIp >> 28) == 14; // 224.0.0.0/4 (first octet 224-239)
+            if (!ok)
+            {
+                NETWORK_LOG_ERROR("[Network] Failed to decrypt v2 message from peer: {}", peer->getPeerEndpoint().address().to_string());
+                return;
+            }
+            acceptMessageV2(std::move(packet), *peer, sessionId, counter);
+        }));
+}
 
-    if (!isForUs && !isBroadcast && !isMulticast)
+void UDPNetwork::deliverPacketToTun(PacketHandle packet, const PeerConnectionInfo& sender)
+{
+    // Only deliver packets that are meant for us OR are broadcast/multicast packets
+    ForwardingEngine::Action action = forwarding.classify(packet.data(), packet.size()).action;
+    if (action != ForwardingEngine::Action::LOCAL &&
+        action != ForwardingEngine::Action::BROADCAST &&
+        action != ForwardingEngine::Action::MULTICAST)
     {
         // Drop packet not meant for us
         return;
     }
 
+    // Reports and leaves from the peers' hosts stay with us: our host would hold back its own reports for groups
+    // it hears someone else report (IGMPv2 suppression), and then no peer would learn it joined them
+    // The membership is the sending peer's, the source address in the report is whatever its host put there
+    if (action == ForwardingEngine::Action::MULTICAST && config.multicastSnooping && MulticastGroups::isIgmp(packet.data(), packet.size()))
+    {
+        for (const auto& entry : peers)
+        {
+            if (&entry.peer == &sender)
+            {
+                multicastGroups.snoop(packet.data(), packet.size(), static_cast<uint8_t>(entry.virtualIp & 0xFF),
+                    std::chrono::steady_clock::now());
+                break;
+            }
+        }
+        return;
+    }
+
     // Send the packet to the TUN interface
     onMessageCallback(std::move(packet));
 }
@@ -787,21 +2443,14 @@ void UDPNetwork::handleDisconnect(
     boost::asio::ip::udp::endpoint peerEndpoint,
     bool isCausedByError)
 {
-    uint32_t ipToRemove = utils::ipToUint32(peerEndpoint.address().to_string());
-    if (ipToRemove == selfVirtualIp)
-    {
-        NETWORK_LOG_ERROR("[Network] How did we get here? Cannot remove self from peer list");
-        return;
-    }
-
     if (isCausedByError)
     {
         NETWORK_LOG_ERROR("[Network] Peer disconnected due to error: {}", peerEndpoint.address().to_string());
         sendDisconnectNotification(peerEndpoint);
     }
 
-    virtualIpToPublicIp.erase(ipToRemove);
-    publicIpToPeerConnection.erase(ipToRemove);
+    peers.remove(peerEndpoint);
+    updateForwarding();
     notifyConnectionEvent(NetworkEvent::PEER_DISCONNECTED, peerEndpoint.address().to_string());
 }
 
@@ -809,16 +2458,8 @@ void UDPNetwork::sendDisconnectNotification(const boost::asio::ip::udp::endpoint
 {
     try
     {
-        // Inneficient, but it is what it is :)
-        bool connected;
-        for (const auto& [publicIp, connectionInfo] : publicIpToPeerConnection)
-        {
-            if (connectionInfo.getPeerEndpoint() == peerEndpoint)
-            {
-                connected = connectionInfo.isConnected();
-                break;
-            }
-        }
+        const PeerConnectionInfo* peer = peers.find(peerEndpoint);
+        bool connected = peer && peer->isConnected();
 
         if (!connected || !socket)
         {
@@ -829,16 +2470,13 @@ void UDPNetwork::sendDisconnectNotification(const boost::asio::ip::udp::endpoint
         NETWORK_LOG_INFO("[Network] Sending disconnect notification to peer");
         
         // Create disconnect packet
-        auto packet = std::make_shared<std::vector<uint8_t>>(16);
-        
-        // Attach custom header
-        attachCustomHeader(packet, PacketType::DISCONNECT);
+        PacketHandle packet = makeControlPacket(PacketType::DISCONNECT);
         
         // Send packet - try multiple times to increase chance of delivery
         for (int i = 0; i < 3; i++)
         {
             socket->async_send_to(
-                boost::asio::buffer(*packet), peerEndpoint,
+                boost::asio::buffer(packet.data(), packet.size()), peerEndpoint,
                 [packet](const boost::system::error_code& error, std::size_t bytesSent)
                 {
                     // Ignore errors since we're disconnecting
@@ -855,8 +2493,9 @@ void UDPNetwork::sendDisconnectNotification(const boost::asio::ip::udp::endpoint
 
 void UDPNetwork::stopConnection()
 {
-    for (auto& [publicIp, connectionInfo] : publicIpToPeerConnection)
+    for (auto& entry : peers)
     {
+        PeerConnectionInfo& connectionInfo = entry.peer;
         if (connectionInfo.isConnected())
         {
             NETWORK_LOG_INFO("[Network] Sending disconnect notification to peer: {}",
@@ -866,12 +2505,26 @@ void UDPNetwork::stopConnection()
         }
     }
 
-    virtualIpToPublicIp.clear();
-    publicIpToPeerConnection.clear();
+    peers.clear();
+    forwarding.clearPeers();
+    #ifdef __linux__
+    publishShardPeers();
+    #endif
+    multicastGroups.clear();
+    broadcastSuppressor.clear();
+    backloggedPeers.clear();
 
     running = false;
 
     stopKeepAliveTimer();
+
+    // Drop whatever was still waiting for a batch to fill up
+    txFlushTimer.cancel();
+    ackTimer.cancel();
+    pacingTimer.cancel();
+    pacingTimerScheduled = false;
+    txFlushScheduled = false;
+    txBatch.clear();
     
     stateManager->setState(SystemState::IDLE);
     
@@ -882,16 +2535,33 @@ void UDPNetwork::stopConnection()
 void UDPNetwork::shutdown()
 {
     // Stop any active connection
-    if (!publicIpToPeerConnection.empty() && !virtualIpToPublicIp.empty())
+    if (!peers.empty())
     {
         stopConnection();
     }
     
     // Then shut down the network stack
     running = false;
+    #ifdef __linux__
+    // Shard threads post into the io_context, they go first
+    if (socketShards)
+    {
+        socketShards->stop();
+        socketShards.reset();
+    }
+    #endif
+    if (cryptoPool)
+    {
+        cryptoPool->stop();
+    }
     stateManager->setState(SystemState::SHUTTING_DOWN);
 
     stopKeepAliveTimer();
+    txFlushTimer.cancel();
+    ackTimer.cancel();
+    pacingTimer.cancel();
+    pacingTimerScheduled = false;
+    txBatch.clear();
 
     if (socket)
     {
@@ -903,8 +2573,21 @@ void UDPNetwork::shutdown()
     // Stop io_context 
     ioContext.stop();
 
-    if (ioThread.joinable())
-        ioThread.join();
+    // Posted onto the pool, shutdown() can't join the thread it runs on; the destructor's call does
+    ioThreads.erase(std::remove_if(ioThreads.begin(), ioThreads.end(), [](std::thread& thread)
+    {
+        if (thread.get_id() == std::this_thread::get_id())
+            return false;
+        if (thread.joinable())
+            thread.join();
+        return true;
+    }), ioThreads.end());
+
+    #ifdef PB_IO_URING
+    // With the IO thread gone: the ring still holds the socket and our buffers until it's told to let go
+    if (uring)
+        uring->stop();
+    #endif
     
     SYSTEM_LOG_INFO("[Network] Network subsystem shut down");
 }
@@ -949,19 +2632,149 @@ void UDPNetwork::handleKeepAlive(const boost::system::error_code& error)
 
     // TODO: REFACTOR FOR *1, FOR MULTIPLE PEERS
     NETWORK_LOG_INFO("[Network] Running keep-alive functionality");
-    for (const auto& [publicIp, connectionInfo] : publicIpToPeerConnection)
+    for (const auto& entry : peers)
     {
-        sendHolePunchPacket(connectionInfo.getPeerEndpoint());
+        sendHolePunchPacket(entry.peer.getPeerEndpoint());
     }
 
     checkAllConnections();
 
+    PacketBufferPool::Stats poolStats = packetPool->getStats();
+    NETWORK_LOG_INFO(
+        "[Network] Packet pool: slabs {}/{} in use (high-water {}, misses {}), jumbo {}/{} in use (high-water {}, misses {})",
+        poolStats.slabsInUse, poolStats.slabsAllocated, poolStats.slabsHighWaterMark, poolStats.misses,
+        poolStats.jumboInUse, poolStats.jumboAllocated, poolStats.jumboHighWaterMark, poolStats.jumboMisses);
+
+    NETWORK_LOG_INFO("[Network] TX payload copies: {}, v2 replay drops: {}, crypto queue drops: {}, send backlog drops: {}",
+        txCopies, replayDrops, cryptoDrops, txBacklogDrops);
+    if (fanoutStats.packets > 0 || fanoutStats.relayed > 0)
+    {
+        NETWORK_LOG_INFO("[Network] Broadcast fan-out: {} packets, {} datagrams, {} seals ({} group, {} per-peer), {} copies, {} relayed for others",
+            fanoutStats.packets, fanoutStats.datagrams, fanoutStats.groupSeals + fanoutStats.pairwiseSeals,
+            fanoutStats.groupSeals, fanoutStats.pairwiseSeals, fanoutStats.copies, fanoutStats.relayed);
+    }
+    // RTTs moved since the last keep-alive, the best-connected peers get to relay
+    relayTreeStale = true;
+
+    auto now = std::chrono::steady_clock::now();
+    if (config.multicastSnooping)
+    {
+        multicastGroups.expire(now);
+        if (now - lastMulticastQuery >= MulticastGroups::QUERY_INTERVAL)
+            queryLocalMemberships();
+        for (const auto& [address, group] : multicastGroups.getGroups())
+        {
+            NETWORK_LOG_INFO("[Network] Multicast {}: {} members, {} packets / {}B, {} datagrams, {} peers skipped",
+                utils::uint32ToIp(address), group.members.count(), group.counters.packets, group.counters.bytes,
+                group.counters.datagrams, group.counters.skipped);
+        }
+        if (fanoutStats.multicastUnjoined > 0)
+            NETWORK_LOG_INFO("[Network] Multicast to groups nobody joined: {} packets", fanoutStats.multicastUnjoined);
+    }
+    const BroadcastSuppressor::Stats& suppression = broadcastSuppressor.getStats();
+    if (suppression.duplicates > 0 || suppression.rateLimited > 0)
+    {
+        NETWORK_LOG_INFO("[Network] Broadcast suppression: {} passed, {} duplicates ({}B) collapsed, {} rate-limited ({}B)",
+            suppression.passed, suppression.duplicates, suppression.duplicateBytes,
+            suppression.rateLimited, suppression.rateLimitedBytes);
+    }
+
+    for (const auto& entry : peers)
+    {
+        const AckTracker::Stats& linkStats = entry.peer.getAckTracker().getStats();
+        if (linkStats.acksReceived == 0)
+            continue;
+        NETWORK_LOG_INFO("[Network] Peer {}: rtt {}us (min {}us, var {}us), loss {:.2f}% ({} of {} lost), in flight {}B, acks {} sent / {} received",
+            utils::uint32ToIp(entry.virtualIp), linkStats.smoothedRtt.count(), linkStats.minRtt.count(), linkStats.rttVariation.count(),
+            linkStats.lossRate * 100, linkStats.packetsLost, linkStats.packetsSent, linkStats.bytesInFlight,
+            linkStats.acksSent, linkStats.acksReceived);
+    }
+    for (const auto& entry : peers)
+    {
+        const CongestionController::Stats& pacing = entry.peer.getCongestionController().getStats();
+        if (pacing.bandwidth == 0)
+            continue;
+        NETWORK_LOG_INFO("[Network] Peer {}: {} at {}kbit/s (pacing {}kbit/s), window {}B, rtt floor {}us, "
+            "{} pacer / {} window waits, {} lossy rounds",
+            utils::uint32ToIp(entry.virtualIp), congestionStateName(pacing.state), pacing.bandwidth * 8 / 1000,
+            pacing.pacingRate * 8 / 1000, pacing.congestionWindow, pacing.minRtt.count(),
+            pacing.pacingDelays, pacing.windowLimited, pacing.lossRounds);
+    }
+    for (const auto& entry : peers)
+    {
+        const SendScheduler& scheduler = entry.peer.getSendScheduler();
+        const SendScheduler::Stats& queueStats = scheduler.getStats();
+        if (queueStats.enqueued == 0)
+            continue;
+        NETWORK_LOG_INFO("[Network] Peer {}: send queue {} packets / {}B, {} of {} sent as priority, {} dropped ({}B)",
+            utils::uint32ToIp(entry.virtualIp), scheduler.size(), scheduler.bytes(), queueStats.priority,
+            queueStats.enqueued, queueStats.dropped, queueStats.droppedBytes);
+    }
+
+    if (cryptoPool)
+    {
+        CryptoWorkerPool::Stats cryptoStats = cryptoPool->getStats();
+        std::string utilization;
+        for (double busy : cryptoStats.utilization)
+        {
+            utilization += (utilization.empty() ? "" : " ") + std::to_string(static_cast<int>(busy * 100)) + "%";
+        }
+        NETWORK_LOG_INFO("[Network] Crypto workers: {} (utilization {}), queue depth {} (high-water {}), jobs {}, rejected {}",
+            cryptoStats.workers, utilization, cryptoStats.queueDepth, cryptoStats.queueHighWaterMark, cryptoStats.jobs, cryptoStats.rejected);
+    }
+
+    if (batchedIoActive)
+    {
+        NETWORK_LOG_INFO("[Network] recvmmsg batch sizes: {} ({} truncated) | sendmmsg batch sizes: {}",
+            rxBatchSizes.toString(), rxTruncated, txBatchSizes.toString());
+    }
+    #ifdef __linux__
+    if (socketShards)
+    {
+        std::vector<uint64_t> shardCounts = socketShards->getReceiveCounts();
+        std::string counts;
+        for (size_t i = 1; i < shardCounts.size(); i++)
+            counts += (i > 1 ? " / " : "") + std::to_string(shardCounts[i]);
+        NETWORK_LOG_INFO("[Network] Socket shards 1-{} received {} ({} truncated)", shardCounts.size() - 1, counts,
+            socketShards->getTruncatedCount());
+    }
+    #endif
+    if (config.busyPollBudget.count() > 0)
+    {
+        BusyPoller::Stats busyPoll;
+        for (const auto& poller : ioPollers)
+            busyPoll += poller->getStats();
+        #ifdef __linux__
+        if (socketShards)
+            busyPoll += socketShards->getBusyPollStats();
+        #endif
+        // What spinning cost since the last report, as a share of one core
+        auto spun = busyPoll.spinTime - reportedBusyPoll.spinTime;
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(now - lastBusyPollReport);
+        NETWORK_LOG_INFO("[Network] Busy poll: {} wakeups avoided, {} spins gave up, {} skipped, {}ms spinning ({:.1f}% of a core)",
+            busyPoll.hits - reportedBusyPoll.hits, busyPoll.misses - reportedBusyPoll.misses,
+            busyPoll.skipped - reportedBusyPoll.skipped, spun.count() / 1000,
+            elapsed.count() > 0 ? 100.0 * static_cast<double>(spun.count()) / static_cast<double>(elapsed.count()) : 0.0);
+        reportedBusyPoll = busyPoll;
+        lastBusyPollReport = now;
+    }
+
+    #ifdef PB_IO_URING
+    if (uring)
+    {
+        const UringTransport::Stats& uringStats = uring->getStats();
+        NETWORK_LOG_INFO("[Network] io_uring: {} received ({} truncated) in {} wakeups, {} sent ({} errors) in {} enters, {} receive re-arms, submit batch sizes: {}",
+            uringStats.received, uringStats.truncated, uringStats.wakeups, uringStats.sent, uringStats.sendErrors, uringStats.enters,
+            uringStats.receiveRearms, txBatchSizes.toString());
+    }
+    #endif
+
     startKeepAliveTimer(); // Restart timer
 }
 
 // ! EXPECTS AN EMPTY PACKET / SPACE FOR THE HEADER
 uint32_t UDPNetwork::attachCustomHeader(
-    const std::shared_ptr<std::vector<uint8_t>>& packet,
+    uint8_t* packet,
     PacketType packetType,
     std::optional<uint32_t> seqOpt)
 {
@@ -970,30 +2783,123 @@ uint32_t UDPNetwork::attachCustomHeader(
     */
 
     // Set magic number
-    (*packet)[0] = (MAGIC_NUMBER >> 24) & 0xFF;
-    (*packet)[1] = (MAGIC_NUMBER >> 16) & 0xFF;
-    (*packet)[2] = (MAGIC_NUMBER >> 8) & 0xFF;
-    (*packet)[3] = MAGIC_NUMBER & 0xFF;
+    packet[0] = (MAGIC_NUMBER >> 24) & 0xFF;
+    packet[1] = (MAGIC_NUMBER >> 16) & 0xFF;
+    packet[2] = (MAGIC_NUMBER >> 8) & 0xFF;
+    packet[3] = MAGIC_NUMBER & 0xFF;
     
     // Set protocol version
-    (*packet)[4] = (PROTOCOL_VERSION >> 8) & 0xFF;
-    (*packet)[5] = PROTOCOL_VERSION & 0xFF;
+    packet[4] = (PROTOCOL_VERSION >> 8) & 0xFF;
+    packet[5] = PROTOCOL_VERSION & 0xFF;
     
     // Set packet type
-    (*packet)[6] = static_cast<uint8_t>(packetType);
-    (*packet)[7] = 0;
+    packet[6] = static_cast<uint8_t>(packetType);
+    // Hole-punch packets advertise the highest protocol version we speak, reserved otherwise
+    packet[7] = (packetType == PacketType::HOLE_PUNCH) ? config.maxProtocolVersion : 0;
     
     // Set sequence number
     uint32_t seq = seqOpt.value_or(nextSeqNumber++);
-    (*packet)[8] = (seq >> 24) & 0xFF;
-    (*packet)[9] = (seq >> 16) & 0xFF;
-    (*packet)[10] = (seq >> 8) & 0xFF;
-    (*packet)[11] = seq & 0xFF;
+    packet[8] = (seq >> 24) & 0xFF;
+    packet[9] = (seq >> 16) & 0xFF;
+    packet[10] = (seq >> 8) & 0xFF;
+    packet[11] = seq & 0xFF;
 
     return seq;
 }
 
-boost::asio::io_context& UDPNetwork::getIOContext()
+PacketHandle UDPNetwork::makeControlPacket(PacketType packetType, std::optional<uint32_t> seq)
+{
+    PacketHandle packet = packetPool->acquire(16);
+    // Pooled buffers aren't zeroed, don't let old packet bytes end up in the unused fields
+    std::memset(packet.data(), 0, packet.size());
+    attachCustomHeader(packet.data(), packetType, seq);
+    if (packetType == PacketType::HOLE_PUNCH)
+    {
+        packet.data()[12] = PeerCipher::supportedSuites();
+        packet.data()[13] = static_cast<uint8_t>(preferredSuite);
+    }
+    return packet;
+}
+
+boost::asio::any_io_executor UDPNetwork::getExecutor()
+{
+    return networkStrand;
+}
+
+std::shared_ptr<PacketBufferPool> UDPNetwork::getPacketPool() const
+{
+    return packetPool;
+}
+
+const Log2Histogram& UDPNetwork::getRxBatchHistogram() const
+{
+    return rxBatchSizes;
+}
+
+const Log2Histogram& UDPNetwork::getTxBatchHistogram() const
+{
+    return txBatchSizes;
+}
+
+uint64_t UDPNetwork::getTxCopyCount() const
+{
+    return txCopies;
+}
+
+uint64_t UDPNetwork::getReplayDropCount() const
+{
+    return replayDrops;
+}
+
+uint64_t UDPNetwork::getCryptoDropCount() const
+{
+    return cryptoDrops;
+}
+
+uint64_t UDPNetwork::getTxBacklogDropCount() const
+{
+    return txBacklogDrops;
+}
+
+uint64_t UDPNetwork::getTruncatedDropCount() const
 {
-    return ioContext;
-}
\ No newline at end of file
+    uint64_t truncated = rxTruncated;
+    #ifdef __linux__
+    if (socketShards)
+        truncated += socketShards->getTruncatedCount();
+    #endif
+    #ifdef PB_IO_URING
+    if (uring)
+        truncated += uring->getStats().truncated;
+    #endif
+    return truncated;
+}
+
+size_t UDPNetwork::getCryptoWorkerCount() const
+{
+    return cryptoPool ? cryptoPool->getWorkerCount() : 0;
+}
+
+const UDPNetwork::FanoutStats& UDPNetwork::getFanoutStats() const
+{
+    return fanoutStats;
+}
+
+const MulticastGroups& UDPNetwork::getMulticastGroups() const
+{
+    return multicastGroups;
+}
+
+const BroadcastSuppressor::Stats& UDPNetwork::getBroadcastSuppressionStats() const
+{
+    return broadcastSuppressor.getStats();
+}
+
+size_t UDPNetwork::getSocketShardCount() const
+{
+    #ifdef __linux__
+    if (socketShards)
+        return socketShards->getShardCount();
+    #endif
+    return 1;
+}
@@ -1,6 +1,6 @@
 #include "Utils.hpp"
 #include "P2PSystem.hpp"
-#include "Logger.hpp"
+#include "logger.hpp"
 #include <iostream>
 #include <vector>
 #include <sstream>
@@ -58,7 +58,21 @@ P2PSystem::P2PSystem()
     , peerPort(0)
 {
     stateManager = std::make_shared<SystemStateManager>();
+    #ifdef _WIN32
     networkConfigManager = std::make_shared<NetworkConfigManager>();
+    #else
+    networkConfigManager = std::make_shared<LinuxNetworkConfigManager>();
+    #endif
+    dataPathConfig = DataPathConfig::loadConfig();
+    packetPool = PacketBufferPool::create();
+    tunHandlerMemory = std::make_shared<HandlerMemory>();
+
+    BoundedPacketQueue::Parameters backlog;
+    backlog.limit = dataPathConfig.tunBacklogLimit;
+    backlog.dropPolicy = dataPathConfig.tunBacklogDrop;
+    backlog.maxStall = dataPathConfig.tunBackpressure;
+    tunBacklog = std::make_unique<BoundedPacketQueue>(backlog);
+    tunDrainBatch.reserve(TUN_DRAIN_BATCH);
 }
 
 P2PSystem::~P2PSystem()
@@ -164,7 +178,18 @@ bool P2PSystem::initialize(int localPort)
 
     // Initialize TUN interface
     if (!tunInterface)
-        tunInterface = std::make_unique<TunInterface>();
+    {
+        CoDelQueue::Parameters tunQueue;
+        tunQueue.limit = dataPathConfig.tunQueueLimit;
+        tunQueue.target = dataPathConfig.tunCodelTarget;
+        tunQueue.interval = dataPathConfig.tunCodelInterval;
+        #ifdef _WIN32
+        tunInterface = std::make_unique<TunInterface>(packetPool, tunQueue, dataPathConfig.busyPollBudget);
+        #else
+        tunInterface = std::make_unique<LinuxTunInterface>(dataPathConfig.tunQueueCount, packetPool, tunQueue,
+            dataPathConfig.busyPollBudget);
+        #endif
+    }
     if (!tunInterface->initialize("PeerBridge"))
     {
         SYSTEM_LOG_ERROR("[System] Failed to initialize TUN interface");
@@ -172,12 +197,12 @@ bool P2PSystem::initialize(int localPort)
     }
     
     // Register packet callback from TUN interface
-    tunInterface->setPacketCallback([this](const std::vector<uint8_t>& packet)
+    // Runs on the reader threads, a full backlog blocks them here for a while
+    tunInterface->setPacketCallback([this](PacketHandle packet)
     {
-        boost::asio::post(networkModule->getIOContext(), [this, packet = std::move(packet)]()
-        {
-            networkModule->processPacketFromTun(packet);
-        });
+        // Moved all the way through, the network module only encrypts in place if it holds the last reference
+        if (tunBacklog->push(std::move(packet)))
+            postTunDrain();
     });
 
     networkConfigManager->setNarrowAlias(tunInterface->getNarrowAlias());
@@ -192,10 +217,12 @@ bool P2PSystem::initialize(int localPort)
             std::move(stunService->getSocket()),
             stunService->getContext(),
             stateManager,
-            networkConfigManager);
+            networkConfigManager,
+            packetPool,
+            dataPathConfig);
     
     // Set up network callbacks for P2P connection
-    networkModule->setMessageCallback([this](std::vector<uint8_t> packet)
+    networkModule->setMessageCallback([this](PacketHandle packet)
     {
         if (tunInterface && tunInterface->isRunning())
             tunInterface->sendPacket(std::move(packet));
@@ -264,6 +291,35 @@ bool P2PSystem::initialize(int localPort)
     return true;
 }
 
+void P2PSystem::postTunDrain()
+{
+    boost::asio::post(networkModule->getExecutor(), makeAllocHandler(tunHandlerMemory, [this]()
+    {
+        drainTunBacklog();
+    }));
+}
+
+void P2PSystem::drainTunBacklog()
+{
+    bool more = tunBacklog->popBatch(tunDrainBatch, TUN_DRAIN_BATCH);
+    networkModule->processPacketsFromTun(tunDrainBatch.data(), tunDrainBatch.size());
+    tunDrainBatch.clear();
+
+    BoundedPacketQueue::Stats stats = tunBacklog->getStats();
+    auto now = std::chrono::steady_clock::now();
+    if (stats.drops != reportedBacklogDrops && now - lastBacklogReport >= BACKLOG_REPORT_INTERVAL)
+    {
+        SYSTEM_LOG_WARNING("[System] TUN backlog full: {} queued, {} dropped, readers stalled {} times for {}ms",
+            stats.depth, stats.drops, stats.stalls, stats.stallTime.count() / 1000);
+        reportedBacklogDrops = stats.drops;
+        lastBacklogReport = now;
+    }
+
+    // Give socket completions and timers a turn between batches
+    if (more)
+        postTunDrain();
+}
+
 void P2PSystem::monitorLoop()
 {
     // Process all pending events
@@ -344,6 +400,23 @@ void P2PSystem::handleNetworkEvent(const NetworkEventData& event)
             break;
         }
 
+        case NetworkEvent::SET_PORT_PRIORITIES:
+        {
+            SYSTEM_LOG_INFO("[SYSTEM] Received set port priorities event");
+            auto variantPtr = std::get_if<PortPriorities>(&event.data);
+            if (!variantPtr)
+            {
+                SYSTEM_LOG_ERROR("[System] Invalid port priorities, received type {}", event.data.index());
+                break;
+            }
+            // Any state, the table outlives connections
+            boost::asio::post(networkModule->getExecutor(), [this, priorities = *variantPtr]()
+            {
+                networkModule->setPortPriorities(priorities);
+            });
+            break;
+        }
+
         case NetworkEvent::SHUTDOWN_REQUESTED:
         {
             if (currentState != SystemState::SHUTTING_DOWN)
@@ -378,7 +451,7 @@ void P2PSystem::initializeConnectionData(
     stateManager->setState(SystemState::CONNECTING);
 
     // Call startConnection from networkModule with post
-    boost::asio::post(networkModule->getIOContext(), [this, selfIp, selfIndexAndPeerMap]()
+    boost::asio::post(networkModule->getExecutor(), [this, selfIp, selfIndexAndPeerMap]()
     {
         networkModule->startConnection(selfIp, this->secretKey, selfIndexAndPeerMap.second);
     });
@@ -387,7 +460,7 @@ void P2PSystem::initializeConnectionData(
 bool P2PSystem::discoverPublicAddress()
 {
     if (!stunService)
-        stunService = std::make_unique<StunClient>();
+        stunService = std::make_unique<StunClient>("stun.l.google.com", "19302", dataPathConfig.socketShards > 1);
     
     stunService->setStunServer("stun.l.google.com", "19302");
     auto publicAddr = stunService->discoverPublicAddress();
@@ -439,6 +512,10 @@ void P2PSystem::stopNetworkInterface()
     if (tunInterface && tunInterface->isRunning())
     {
         tunInterface->stopPacketProcessing();
+        size_t discarded = tunBacklog->clear();
+        BoundedPacketQueue::Stats stats = tunBacklog->getStats();
+        SYSTEM_LOG_INFO("[System] TUN backlog: {} packets in, {} dropped, {} discarded, high water {}, readers stalled {} times for {}ms",
+            stats.enqueued, stats.drops, discarded, stats.maxDepth, stats.stalls, stats.stallTime.count() / 1000);
         networkConfigManager->resetInterfaceConfiguration(currentConnectionConfig.peerVirtualIps);
         currentConnectionConfig = {};
         SYSTEM_LOG_INFO("[System] Network interface stopped and configuration reset");
@@ -451,7 +528,7 @@ void P2PSystem::stopConnection()
     // Stop the network connection, queue handler to IOContext
     if (networkModule)
     {
-        boost::asio::post(networkModule->getIOContext(), [this]()
+        boost::asio::post(networkModule->getExecutor(), [this]()
         {
             networkModule->stopConnection();
         });
@@ -479,7 +556,7 @@ void P2PSystem::shutdown()
     // First stop any active connections
     if (networkModule)
     {
-        boost::asio::post(networkModule->getIOContext(), [this]()
+        boost::asio::post(networkModule->getExecutor(), [this]()
         {
             networkModule->shutdown();
         });
@@ -0,0 +1,211 @@
+#include "PacketBufferPool.hpp"
+#include "logger.hpp"
+#include <algorithm>
+
+PacketHandle::PacketHandle(PacketBuffer* buffer) noexcept : buffer(buffer)
+{
+    if (buffer)
+        buffer->refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+PacketHandle::PacketHandle(const PacketHandle& other) noexcept : buffer(other.buffer)
+{
+    if (buffer)
+        buffer->refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+PacketHandle::PacketHandle(PacketHandle&& other) noexcept : buffer(other.buffer)
+{
+    other.buffer = nullptr;
+}
+
+PacketHandle& PacketHandle::operator=(const PacketHandle& other) noexcept
+{
+    if (this != &other)
+    {
+        PacketHandle copy(other);
+        std::swap(buffer, copy.buffer);
+    }
+    return *this;
+}
+
+PacketHandle& PacketHandle::operator=(PacketHandle&& other) noexcept
+{
+    if (this != &other)
+    {
+        reset();
+        buffer = other.buffer;
+        other.buffer = nullptr;
+    }
+    return *this;
+}
+
+PacketHandle::~PacketHandle()
+{
+    reset();
+}
+
+void PacketHandle::resize(size_t newSize) noexcept
+{
+    buffer->length = std::min(newSize, buffer->capacity - buffer->offset);
+}
+
+bool PacketHandle::prepend(size_t bytes) noexcept
+{
+    if (!buffer || bytes > buffer->offset)
+        return false;
+
+    buffer->offset -= bytes;
+    buffer->length += bytes;
+    return true;
+}
+
+void PacketHandle::trimFront(size_t bytes) noexcept
+{
+    bytes = std::min(bytes, buffer->length);
+    buffer->offset += bytes;
+    buffer->length -= bytes;
+}
+
+void PacketHandle::reset() noexcept
+{
+    if (!buffer)
+        return;
+
+    if (buffer->refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        // Last reference, hold on to the pool until the slab is back in the free list
+        std::shared_ptr<PacketBufferPool> pool = std::move(buffer->owner);
+        pool->release(buffer);
+    }
+    buffer = nullptr;
+}
+
+
+/* ====================================================================================================== */
+
+
+std::shared_ptr<PacketBufferPool> PacketBufferPool::create(size_t preallocatedSlabs, size_t preallocatedJumbo)
+{
+    return std::shared_ptr<PacketBufferPool>(new PacketBufferPool(preallocatedSlabs, preallocatedJumbo));
+}
+
+PacketBufferPool::PacketBufferPool(size_t preallocatedSlabs, size_t preallocatedJumbo)
+    : maxCachedJumbo(std::max<size_t>(preallocatedJumbo, 1))
+{
+    freeSlabs.reserve(preallocatedSlabs);
+    for (size_t i = 0; i < preallocatedSlabs; i++)
+    {
+        freeSlabs.push_back(allocateSlab(SLAB_SIZE, false));
+    }
+
+    freeJumbo.reserve(maxCachedJumbo);
+    for (size_t i = 0; i < preallocatedJumbo; i++)
+    {
+        freeJumbo.push_back(allocateSlab(JUMBO_SIZE, true));
+    }
+}
+
+PacketBufferPool::~PacketBufferPool()
+{
+    // Slabs still in flight keep the pool alive, so everything left is in the free lists
+    for (PacketBuffer* slab : freeSlabs)
+        delete slab;
+    for (PacketBuffer* slab : freeJumbo)
+        delete slab;
+}
+
+PacketBuffer* PacketBufferPool::allocateSlab(size_t capacity, bool jumbo)
+{
+    auto* slab = new PacketBuffer();
+    // Default-initialized on purpose, we don't want to pay for zero-filling
+    slab->storage.reset(new uint8_t[capacity]);
+    slab->capacity = capacity;
+    slab->jumbo = jumbo;
+
+    if (jumbo)
+        stats.jumboAllocated++;
+    else
+        stats.slabsAllocated++;
+
+    return slab;
+}
+
+PacketHandle PacketBufferPool::acquire(size_t size, size_t headroom)
+{
+    PacketBuffer* slab = nullptr;
+    size_t requested = size + headroom;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        stats.acquisitions++;
+
+        if (requested <= SLAB_SIZE)
+        {
+            if (!freeSlabs.empty())
+            {
+                slab = freeSlabs.back();
+                freeSlabs.pop_back();
+            }
+            else
+            {
+                stats.misses++;
+                slab = allocateSlab(SLAB_SIZE, false);
+            }
+            stats.slabsInUse++;
+            stats.slabsHighWaterMark = std::max(stats.slabsHighWaterMark, stats.slabsInUse);
+        }
+        else if (requested <= JUMBO_SIZE)
+        {
+            if (!freeJumbo.empty())
+            {
+                slab = freeJumbo.back();
+                freeJumbo.pop_back();
+            }
+            else
+            {
+                stats.jumboMisses++;
+                slab = allocateSlab(JUMBO_SIZE, true);
+            }
+            stats.jumboInUse++;
+            stats.jumboHighWaterMark = std::max(stats.jumboHighWaterMark, stats.jumboInUse);
+        }
+        else
+        {
+            stats.oversizeRequests++;
+            NETWORK_LOG_ERROR("[PacketBufferPool] Requested buffer of {} bytes, max is {}", requested, JUMBO_SIZE);
+            return PacketHandle();
+        }
+    }
+
+    slab->owner = shared_from_this();
+    slab->offset = headroom;
+    slab->length = size;
+    return PacketHandle(slab);
+}
+
+void PacketBufferPool::release(PacketBuffer* slab)
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (slab->jumbo)
+    {
+        stats.jumboInUse--;
+        if (freeJumbo.size() >= maxCachedJumbo)
+        {
+            stats.jumboAllocated--;
+            delete slab;
+            return;
+        }
+        freeJumbo.push_back(slab);
+    }
+    else
+    {
+        stats.slabsInUse--;
+        freeSlabs.push_back(slab);
+    }
+}
+
+PacketBufferPool::Stats PacketBufferPool::getStats() const
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return stats;
+}
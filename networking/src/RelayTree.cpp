@@ -0,0 +1,85 @@
+#include "RelayTree.hpp"
+#include <algorithm>
+#include <cstring>
+
+void RelayTree::build(std::vector<Member> members, size_t newFanout)
+{
+    std::sort(members.begin(), members.end(), [](const Member& a, const Member& b)
+    {
+        bool aMeasured = a.rtt.count() > 0;
+        bool bMeasured = b.rtt.count() > 0;
+        if (aMeasured != bMeasured)
+            return aMeasured;
+        if (a.rtt != b.rtt)
+            return a.rtt < b.rtt;
+        return a.octet < b.octet;
+    });
+    if (members.size() > MAX_MEMBERS)
+        members.resize(MAX_MEMBERS);
+
+    fanout = std::min(std::max<size_t>(newFanout, 1), MAX_FANOUT);
+    order.clear();
+    for (const Member& member : members)
+        order.push_back(member.octet);
+}
+
+void RelayTree::clear()
+{
+    order.clear();
+}
+
+void RelayTree::encode(uint8_t* out) const
+{
+    out[0] = static_cast<uint8_t>(fanout);
+    out[1] = static_cast<uint8_t>(order.size());
+    if (!order.empty())
+        std::memcpy(out + HEADER_SIZE, order.data(), order.size());
+}
+
+size_t RelayTree::rootChildren(uint8_t* children) const
+{
+    return childrenAt(order.data(), order.size(), fanout, 0, children);
+}
+
+size_t RelayTree::parse(const uint8_t* data, size_t available)
+{
+    if (available < HEADER_SIZE)
+        return 0;
+    size_t treeFanout = data[0];
+    size_t count = data[1];
+    if (treeFanout == 0 || treeFanout > MAX_FANOUT || count == 0 || available < HEADER_SIZE + count)
+        return 0;
+    return HEADER_SIZE + count;
+}
+
+size_t RelayTree::childrenOf(const uint8_t* tree, uint8_t selfOctet, uint8_t* children)
+{
+    const uint8_t* octets = tree + HEADER_SIZE;
+    size_t count = tree[1];
+    const uint8_t* self = std::find(octets, octets + count, selfOctet);
+    if (self == octets + count)
+        return 0;
+    return childrenAt(octets, count, tree[0], static_cast<size_t>(self - octets) + 1, children);
+}
+
+size_t RelayTree::depth(size_t members, size_t treeFanout)
+{
+    size_t hops = 0;
+    size_t reached = 0;
+    for (size_t level = 1; reached < members; hops++)
+    {
+        level *= std::max<size_t>(treeFanout, 1);
+        reached += level;
+    }
+    return hops;
+}
+
+size_t RelayTree::childrenAt(const uint8_t* octets, size_t count, size_t treeFanout, size_t position, uint8_t* children)
+{
+    size_t first = treeFanout * position;
+    if (first >= count)
+        return 0;
+    size_t childCount = std::min(treeFanout, count - first);
+    std::memcpy(children, octets + first, childCount);
+    return childCount;
+}
@@ -0,0 +1,61 @@
+#include "ReplayWindow.hpp"
+#include <algorithm>
+
+bool ReplayWindow::check(uint64_t counter) const
+{
+    if (!initialized || counter > highest)
+        return true;
+
+    if (highest - counter >= MAX_REORDER)
+        return false;
+
+    uint64_t block = (counter / BLOCK_BITS) % BLOCKS;
+    uint64_t bit = 1ull << (counter % BLOCK_BITS);
+    return (bitmap[block] & bit) == 0;
+}
+
+void ReplayWindow::update(uint64_t counter)
+{
+    if (!initialized)
+    {
+        bitmap = {};
+        highest = counter;
+        initialized = true;
+    }
+    else if (counter > highest)
+    {
+        // Clear the blocks the window slides over, all of them if it jumps past the whole window
+        uint64_t currentBlock = highest / BLOCK_BITS;
+        uint64_t newBlock = counter / BLOCK_BITS;
+        uint64_t toClear = std::min<uint64_t>(newBlock - currentBlock, BLOCKS);
+        for (uint64_t i = 1; i <= toClear; i++)
+        {
+            bitmap[(currentBlock + i) % BLOCKS] = 0;
+        }
+        highest = counter;
+    }
+
+    bitmap[(counter / BLOCK_BITS) % BLOCKS] |= 1ull << (counter % BLOCK_BITS);
+}
+
+uint64_t ReplayWindow::getRecentBitmap() const
+{
+    uint64_t recent = 0;
+    if (!initialized)
+        return recent;
+
+    for (uint64_t i = 0; i < 64 && i < highest; i++)
+    {
+        uint64_t counter = highest - 1 - i;
+        if (bitmap[(counter / BLOCK_BITS) % BLOCKS] & (1ull << (counter % BLOCK_BITS)))
+            recent |= 1ull << i;
+    }
+    return recent;
+}
+
+void ReplayWindow::reset()
+{
+    bitmap = {};
+    highest = 0;
+    initialized = false;
+}
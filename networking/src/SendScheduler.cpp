@@ -0,0 +1,229 @@
+#include "SendScheduler.hpp"
+
+namespace
+{
+constexpr size_t IPV4_MIN_HEADER = 20;
+constexpr uint8_t IPPROTO_TCP_NUMBER = 6;
+constexpr uint8_t IPPROTO_UDP_NUMBER = 17;
+// CS4 and up: real-time interactive, broadcast video, voice (EF), signalling and network control
+constexpr uint8_t PRIORITY_DSCP = 32;
+
+struct Classification
+{
+    uint32_t flow = 0;
+    bool priority = false;
+    bool bulk = false;
+};
+
+PortPriority lookup(const PortPriorities& ports, uint16_t port)
+{
+    auto found = ports.find(port);
+    return found == ports.end() ? PortPriority::NORMAL : found->second;
+}
+
+Classification classify(const uint8_t* packet, size_t size, const PortPriorities& ports, size_t smallPacketBytes)
+{
+    Classification result;
+    if (size < IPV4_MIN_HEADER || (packet[0] >> 4) != 4)
+        return result;
+    size_t headerSize = static_cast<size_t>(packet[0] & 0x0F) * 4;
+    size_t totalSize = (static_cast<size_t>(packet[2]) << 8) | packet[3];
+    size_t ipSize = totalSize >= headerSize && totalSize < size ? totalSize : size;
+    uint8_t protocol = packet[9];
+
+    uint32_t source = (static_cast<uint32_t>(packet[12]) << 24) | (static_cast<uint32_t>(packet[13]) << 16) |
+                      (static_cast<uint32_t>(packet[14]) << 8) | packet[15];
+    uint32_t destination = (static_cast<uint32_t>(packet[16]) << 24) | (static_cast<uint32_t>(packet[17]) << 16) |
+                           (static_cast<uint32_t>(packet[18]) << 8) | packet[19];
+    uint16_t sourcePort = 0;
+    uint16_t destinationPort = 0;
+    bool firstFragment = ((packet[6] & 0x1F) | packet[7]) == 0;
+    bool hasPorts = (protocol == IPPROTO_UDP_NUMBER || protocol == IPPROTO_TCP_NUMBER) && firstFragment &&
+                    headerSize >= IPV4_MIN_HEADER && headerSize + 4 <= ipSize;
+    if (hasPorts)
+    {
+        sourcePort = static_cast<uint16_t>((packet[headerSize] << 8) | packet[headerSize + 1]);
+        destinationPort = static_cast<uint16_t>((packet[headerSize + 2] << 8) | packet[headerSize + 3]);
+    }
+
+    // Both directions of a flow don't meet here, the hash only has to spread ours
+    uint64_t key = (static_cast<uint64_t>(source) << 32 | destination) ^
+                   (static_cast<uint64_t>(sourcePort) << 24 | static_cast<uint64_t>(destinationPort) << 8 | protocol);
+    result.flow = static_cast<uint32_t>((key * 0x9E3779B97F4A7C15ULL) >> 32);
+
+    PortPriority portPriority = PortPriority::NORMAL;
+    if (hasPorts && !ports.empty())
+    {
+        PortPriority sourcePriority = lookup(ports, sourcePort);
+        portPriority = sourcePriority != PortPriority::NORMAL ? sourcePriority : lookup(ports, destinationPort);
+    }
+    if (portPriority == PortPriority::BULK)
+    {
+        result.bulk = true;
+        return result;
+    }
+
+    bool small = false;
+    if (smallPacketBytes > 0 && hasPorts && protocol == IPPROTO_UDP_NUMBER)
+    {
+        small = ipSize <= smallPacketBytes;
+    }
+    else if (hasPorts && protocol == IPPROTO_TCP_NUMBER && headerSize + 13 <= ipSize)
+    {
+        // Bare acks only, a short data segment jumping its own flow would look like loss to the receiver
+        small = headerSize + static_cast<size_t>(packet[headerSize + 12] >> 4) * 4 >= ipSize;
+    }
+    result.priority = portPriority == PortPriority::GAME || (packet[1] >> 2) >= PRIORITY_DSCP || small;
+    return result;
+}
+}
+
+void SendScheduler::enqueue(PacketHandle packet, const PortPriorities& ports, size_t smallPacketBytes)
+{
+    if (!packet)
+        return;
+    if (packetCount >= MAX_PACKETS)
+        dropFromFattestFlow();
+
+    Classification classification = classify(packet.data(), packet.size(), ports, smallPacketBytes);
+    stats.enqueued++;
+    if (classification.priority && priorityQueue.packets < PRIORITY_LIMIT)
+    {
+        push(priorityQueue, std::move(packet));
+        return;
+    }
+
+    size_t slot = classification.flow % FLOW_SLOTS;
+    Flow& flow = flows[slot];
+    flow.quantum = classification.bulk ? QUANTUM / 4 : QUANTUM;
+    push(flow.queue, std::move(packet));
+    if (!flow.active)
+    {
+        // New flows start with a full quantum at the back of the round
+        flow.active = true;
+        flow.deficit = flow.quantum;
+        activeRing[(activeHead + activeCount) % FLOW_SLOTS] = static_cast<uint8_t>(slot);
+        activeCount++;
+    }
+}
+
+PacketHandle SendScheduler::dequeue()
+{
+    if (priorityQueue.packets > 0 && (priorityStreak < PRIORITY_BURST || activeCount == 0))
+    {
+        priorityStreak++;
+        stats.priority++;
+        return pop(priorityQueue);
+    }
+    priorityStreak = 0;
+
+    while (activeCount > 0)
+    {
+        Flow& flow = flows[activeRing[activeHead]];
+        if (flow.queue.packets == 0)
+        {
+            // Emptied by a drop since its last turn
+            flow.active = false;
+            activeHead = (activeHead + 1) % FLOW_SLOTS;
+            activeCount--;
+            continue;
+        }
+        if (flow.deficit <= 0)
+        {
+            // Its turn is over, to the back with the next quantum
+            flow.deficit += flow.quantum;
+            activeRing[(activeHead + activeCount) % FLOW_SLOTS] = activeRing[activeHead];
+            activeHead = (activeHead + 1) % FLOW_SLOTS;
+            continue;
+        }
+
+        PacketHandle packet = pop(flow.queue);
+        flow.deficit -= static_cast<int32_t>(packet.size());
+        if (flow.queue.packets == 0)
+        {
+            flow.active = false;
+            activeHead = (activeHead + 1) % FLOW_SLOTS;
+            activeCount--;
+        }
+        return packet;
+    }
+    // Only flows emptied by drops were left in the ring
+    if (priorityQueue.packets > 0)
+    {
+        stats.priority++;
+        return pop(priorityQueue);
+    }
+    return PacketHandle();
+}
+
+void SendScheduler::clear()
+{
+    nodes.clear();
+    freeNodes.clear();
+    priorityQueue = Queue();
+    flows.fill(Flow());
+    activeHead = 0;
+    activeCount = 0;
+    priorityStreak = 0;
+    packetCount = 0;
+    byteCount = 0;
+}
+
+void SendScheduler::push(Queue& queue, PacketHandle packet)
+{
+    uint32_t index;
+    if (!freeNodes.empty())
+    {
+        index = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else
+    {
+        index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    size_t size = packet.size();
+    nodes[index].packet = std::move(packet);
+    nodes[index].next = NONE;
+    if (queue.tail == NONE)
+        queue.head = index;
+    else
+        nodes[queue.tail].next = index;
+    queue.tail = index;
+    queue.packets++;
+    queue.bytes += size;
+    packetCount++;
+    byteCount += size;
+}
+
+PacketHandle SendScheduler::pop(Queue& queue)
+{
+    uint32_t index = queue.head;
+    PacketHandle packet = std::move(nodes[index].packet);
+    queue.head = nodes[index].next;
+    if (queue.head == NONE)
+        queue.tail = NONE;
+    freeNodes.push_back(index);
+
+    queue.packets--;
+    queue.bytes -= packet.size();
+    packetCount--;
+    byteCount -= packet.size();
+    return packet;
+}
+
+void SendScheduler::dropFromFattestFlow()
+{
+    Flow* fattest = nullptr;
+    for (Flow& flow : flows)
+    {
+        if (flow.queue.bytes > 0 && (!fattest || flow.queue.bytes > fattest->queue.bytes))
+            fattest = &flow;
+    }
+    // Priority queue can't be past PRIORITY_LIMIT, so some flow holds packets when we're full
+    Queue& victim = fattest ? fattest->queue : priorityQueue;
+    PacketHandle dropped = pop(victim);
+    stats.dropped++;
+    stats.droppedBytes += dropped.size();
+}
@@ -0,0 +1,291 @@
+#include "SocketShards.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/filter.h>
+#include <pthread.h>
+#include <sched.h>
+
+namespace
+{
+// Mixes the sender's address and port, then shard = hash % count; the steering program computes the same in cBPF
+constexpr uint32_t SHARD_HASH_MULTIPLIER = 0x9E3779B1;
+
+uint32_t shardHash(uint32_t address, uint16_t port)
+{
+    return ((address ^ port) * SHARD_HASH_MULTIPLIER) >> 16;
+}
+
+using ReusePort = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+}
+
+std::unique_ptr<SocketShards> SocketShards::create(boost::asio::ip::udp::socket& primary,
+    std::shared_ptr<PacketBufferPool> packetPool, Parameters parameters)
+{
+    if (parameters.shards < 2 || parameters.shards > MAX_SHARDS)
+    {
+        NETWORK_LOG_ERROR("[SocketShards] Shard count {} must be between 2 and {}", parameters.shards, MAX_SHARDS);
+        return nullptr;
+    }
+
+    boost::system::error_code error;
+    boost::asio::ip::udp::endpoint local = primary.local_endpoint(error);
+    if (error || local.port() == 0)
+    {
+        NETWORK_LOG_WARNING("[SocketShards] Socket isn't bound, can't share its port");
+        return nullptr;
+    }
+
+    std::unique_ptr<SocketShards> socketShards(new SocketShards(std::move(packetPool), parameters));
+    for (size_t i = 1; i < parameters.shards; i++)
+    {
+        auto shard = std::make_unique<Shard>(i, parameters.busyPoll);
+        shard->socket.open(local.protocol(), error);
+        if (!error)
+            shard->socket.set_option(ReusePort(true), error);
+        if (!error)
+            shard->socket.set_option(boost::asio::socket_base::receive_buffer_size(parameters.receiveBufferBytes), error);
+        if (!error)
+            shard->socket.bind(local, error);
+        if (!error)
+            shard->socket.non_blocking(true, error);
+        if (error)
+        {
+            // EADDRINUSE: the existing socket was bound without SO_REUSEPORT
+            NETWORK_LOG_WARNING("[SocketShards] Can't open shard {} on port {}: {}", i, local.port(), error.message());
+            return nullptr;
+        }
+        if (parameters.busyPoll.count() > 0 && !BusyPoller::enableSocketBusyPoll(shard->socket.native_handle(), parameters.busyPoll))
+            NETWORK_LOG_WARNING("[SocketShards] SO_BUSY_POLL refused on shard {} (errno {})", i, errno);
+        socketShards->shards.push_back(std::move(shard));
+    }
+
+    // The program reads IPv4 headers, v6 sockets are left to the kernel's hash
+    if (local.protocol() == boost::asio::ip::udp::v4())
+        socketShards->steered = socketShards->attachSteering(socketShards->shards.front()->socket.native_handle());
+
+    NETWORK_LOG_INFO("[SocketShards] {} shards on port {}, {}", parameters.shards, local.port(),
+        socketShards->steered ? "steered by sender" : "kernel hashed");
+    return socketShards;
+}
+
+SocketShards::SocketShards(std::shared_ptr<PacketBufferPool> packetPool, Parameters parameters)
+    : packetPool(std::move(packetPool)),
+      parameters(parameters),
+      shardCount(parameters.shards)
+{
+}
+
+SocketShards::~SocketShards()
+{
+    stop();
+}
+
+SocketShards::Shard::Shard(size_t index, std::chrono::microseconds busyPoll)
+    : index(index),
+      socket(context),
+      poller(busyPoll)
+{
+}
+
+bool SocketShards::attachSteering(int socketFd)
+{
+    // Runs on the UDP payload, the IP and UDP headers sit at SKF_NET_OFF; returns the index of the socket in the
+    // port's group, which is the order they bound in, so the existing socket is 0 and shard i is i
+    sock_filter code[] = {
+        // X = IP header length, A = UDP source port
+        BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, static_cast<uint32_t>(SKF_NET_OFF)),
+        BPF_STMT(BPF_LD | BPF_H | BPF_IND, static_cast<uint32_t>(SKF_NET_OFF)),
+        BPF_STMT(BPF_MISC | BPF_TAX, 0),
+        // A = source address ^ port, then shardHash()
+        BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<uint32_t>(SKF_NET_OFF + 12)),
+        BPF_STMT(BPF_ALU | BPF_XOR | BPF_X, 0),
+        BPF_STMT(BPF_ALU | BPF_MUL | BPF_K, SHARD_HASH_MULTIPLIER),
+        BPF_STMT(BPF_ALU | BPF_RSH | BPF_K, 16),
+        BPF_STMT(BPF_ALU | BPF_MOD | BPF_K, static_cast<uint32_t>(shardCount)),
+        BPF_STMT(BPF_RET | BPF_A, 0),
+    };
+    sock_fprog program{static_cast<unsigned short>(sizeof(code) / sizeof(code[0])), code};
+    if (::setsockopt(socketFd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program, sizeof(program)) != 0)
+    {
+        NETWORK_LOG_WARNING("[SocketShards] Steering program refused (errno {}), the kernel picks shards", errno);
+        return false;
+    }
+    return true;
+}
+
+size_t SocketShards::shardFor(const boost::asio::ip::udp::endpoint& sender, size_t shardCount)
+{
+    if (shardCount < 2 || !sender.address().is_v4())
+        return 0;
+    return shardHash(sender.address().to_v4().to_uint(), sender.port()) % shardCount;
+}
+
+void SocketShards::start(BatchHandler handler)
+{
+    if (running)
+        return;
+    onBatch = std::move(handler);
+    running = true;
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for (auto& shardPointer : shards)
+    {
+        Shard& shard = *shardPointer;
+        shard.buffers.resize(parameters.batchSize);
+        shard.messages.resize(parameters.batchSize);
+        shard.vectors.resize(parameters.batchSize);
+        shard.addresses.resize(parameters.batchSize);
+        shard.batch.reserve(parameters.batchSize);
+
+        shard.context.restart();
+        startReceive(shard);
+        shard.thread = std::thread([&shard]()
+        {
+            try
+            {
+                // Plain run() unless busy polling
+                shard.poller.run(shard.context);
+            }
+            catch (const std::exception& e)
+            {
+                NETWORK_LOG_ERROR("[SocketShards] Shard {} thread error: {}", shard.index, e.what());
+            }
+        });
+
+        if (parameters.pinThreads)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(shard.index % cores, &cpus);
+            int result = pthread_setaffinity_np(shard.thread.native_handle(), sizeof(cpus), &cpus);
+            if (result != 0)
+                NETWORK_LOG_WARNING("[SocketShards] Can't pin shard {} to core {} (errno {})", shard.index, shard.index % cores, result);
+        }
+    }
+}
+
+void SocketShards::stop()
+{
+    if (!running)
+        return;
+    running = false;
+
+    for (auto& shard : shards)
+        shard->context.stop();
+    for (auto& shard : shards)
+    {
+        if (shard->thread.joinable())
+            shard->thread.join();
+        // Drops the pending wait and with it the slabs of the next batch
+        boost::system::error_code ignored;
+        shard->socket.cancel(ignored);
+        shard->context.restart();
+        shard->context.poll();
+        shard->buffers.assign(shard->buffers.size(), PacketHandle());
+    }
+    onBatch = nullptr;
+}
+
+std::vector<uint64_t> SocketShards::getReceiveCounts() const
+{
+    std::vector<uint64_t> counts(shardCount, 0);
+    for (const auto& shard : shards)
+        counts[shard->index] = shard->received.load(std::memory_order_relaxed);
+    return counts;
+}
+
+uint64_t SocketShards::getTruncatedCount() const
+{
+    uint64_t total = 0;
+    for (const auto& shard : shards)
+        total += shard->truncated.load(std::memory_order_relaxed);
+    return total;
+}
+
+BusyPoller::Stats SocketShards::getBusyPollStats() const
+{
+    BusyPoller::Stats total;
+    for (const auto& shard : shards)
+        total += shard->poller.getStats();
+    return total;
+}
+
+void SocketShards::startReceive(Shard& shard)
+{
+    shard.socket.async_wait(boost::asio::ip::udp::socket::wait_read,
+        [this, &shard](const boost::system::error_code& error)
+        {
+            handleReceive(shard, error);
+        });
+}
+
+void SocketShards::handleReceive(Shard& shard, const boost::system::error_code& error)
+{
+    if (error)
+    {
+        if (error != boost::asio::error::operation_aborted)
+        {
+            NETWORK_LOG_ERROR("[SocketShards] Shard {} wait error: {}", shard.index, error.message());
+            startReceive(shard);
+        }
+        return;
+    }
+
+    size_t batchSize = shard.buffers.size();
+    for (size_t i = 0; i < batchSize; i++)
+    {
+        // Same as UDPNetwork's batched receive: only slabs handed off last round are replaced
+        if (!shard.buffers[i])
+            shard.buffers[i] = packetPool->acquire(PacketBufferPool::SLAB_SIZE);
+
+        shard.vectors[i].iov_base = shard.buffers[i].data();
+        shard.vectors[i].iov_len = shard.buffers[i].capacity();
+
+        msghdr& header = shard.messages[i].msg_hdr;
+        header = {};
+        header.msg_name = &shard.addresses[i];
+        header.msg_namelen = sizeof(sockaddr_storage);
+        header.msg_iov = &shard.vectors[i];
+        header.msg_iovlen = 1;
+    }
+
+    int received = ::recvmmsg(shard.socket.native_handle(), shard.messages.data(), static_cast<unsigned int>(batchSize), MSG_DONTWAIT, nullptr);
+    if (received < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            NETWORK_LOG_ERROR("[SocketShards] Shard {} recvmmsg failed (errno {})", shard.index, errno);
+        startReceive(shard);
+        return;
+    }
+
+    startReceive(shard);
+
+    shard.batch.clear();
+    for (int i = 0; i < received; i++)
+    {
+        const msghdr& header = shard.messages[i].msg_hdr;
+        Datagram datagram;
+        std::memcpy(datagram.sender.data(), &shard.addresses[i], header.msg_namelen);
+        datagram.sender.resize(header.msg_namelen);
+        if (header.msg_flags & MSG_TRUNC)
+        {
+            // The slab keeps its place for the next round, the rest of the datagram is gone anyway
+            shard.truncated.fetch_add(1, std::memory_order_relaxed);
+            if (logLimiter().tryLog())
+                NETWORK_LOG_WARNING("[SocketShards] Shard {} dropping datagram larger than {} bytes from {}",
+                    shard.index, shard.buffers[i].capacity(), datagram.sender.address().to_string());
+            continue;
+        }
+
+        shard.buffers[i].resize(shard.messages[i].msg_len);
+        datagram.packet = std::move(shard.buffers[i]);
+        shard.batch.push_back(std::move(datagram));
+    }
+    shard.received.fetch_add(static_cast<uint64_t>(received), std::memory_order_relaxed);
+
+    if (!shard.batch.empty())
+        onBatch(shard.index, shard.batch);
+    shard.batch.clear();
+}
@@ -1,5 +1,5 @@
 #include "SystemStateManager.hpp"
-#include "Logger.hpp"
+#include "logger.hpp"
 #include <boost/asio/ip/udp.hpp>
 
 SystemStateManager::SystemStateManager() : currentState(SystemState::IDLE) {}
@@ -1,5 +1,5 @@
 #include "TUNInterface.hpp"
-#include "Logger.hpp"
+#include "logger.hpp"
 #include <Windows.h>
 #include <iostream>
 #include <string>
@@ -11,7 +11,13 @@
 
 #pragma comment(lib, "iphlpapi.lib")
 
-TunInterface::TunInterface() {}
+TunInterface::TunInterface(std::shared_ptr<PacketBufferPool> packetPool, CoDelQueue::Parameters queueParameters,
+    std::chrono::microseconds busyPoll)
+    : outgoingPackets(queueParameters, busyPoll),
+      receivePoller(busyPoll),
+      packetPool(packetPool ? std::move(packetPool) : PacketBufferPool::create())
+{
+}
 
 TunInterface::~TunInterface()
 {
@@ -127,6 +133,7 @@ bool TunInterface::startPacketProcessing()
     }
     
     running = true;
+    outgoingPackets.start();
     
     // Start receive thread
     receiveThread = std::thread(&TunInterface::receiveThreadFunc, this);
@@ -139,6 +146,7 @@ bool TunInterface::startPacketProcessing()
 void TunInterface::stopPacketProcessing()
 {
     running = false;
+    outgoingPackets.stop();
     
     // Wait for threads to finish
     if (receiveThread.joinable())
@@ -151,11 +159,18 @@ void TunInterface::stopPacketProcessing()
         sendThread.join();
     }
 
-    // In theory, it's possible this could cause problems :)
-    // Classic race condition moment
-    outgoingPackets = {};
-    
-    SYSTEM_LOG_INFO("[TunInterface] Packet processing stopped");
+    size_t discarded = outgoingPackets.clear();
+
+    CoDelQueue::Stats stats = getQueueStats();
+    SYSTEM_LOG_INFO("[TunInterface] Packet processing stopped, {} queued packet(s) discarded; "
+        "{} written, {} CoDel drops, {} overflow drops, deepest queue {}",
+        discarded, stats.dequeued, stats.codelDrops, stats.overflowDrops, stats.maxDepth);
+    if (receivePoller.isEnabled())
+    {
+        BusyPoller::Stats spinning = getBusyPollStats();
+        SYSTEM_LOG_INFO("[TunInterface] Busy poll: {} wakeups avoided, {} spins gave up, {} skipped, {}ms spent spinning",
+            spinning.hits, spinning.misses, spinning.skipped, spinning.spinTime.count() / 1000);
+    }
 }
 
 void TunInterface::receiveThreadFunc() {
@@ -171,20 +186,33 @@ void TunInterface::receiveThreadFunc() {
     {
         DWORD packetSize;
         WINTUN_PACKET* packet = pWintunReceivePacket(session, &packetSize);
+        // Busy-poll mode keeps asking the ring for a while before waiting on the event
+        if (!packet)
+        {
+            receivePoller.spin([this, &packet, &packetSize]()
+            {
+                packet = pWintunReceivePacket(session, &packetSize);
+                return packet != nullptr;
+            });
+        }
         
         if (packet)
         {
-            // Copy packet data, cast to uint8_t* to copy to vector
-            const uint8_t* packetDataPtr = reinterpret_cast<const uint8_t*>(packet);
-            std::vector<uint8_t> packetData(packetDataPtr, packetDataPtr + packetSize);
+            // The ring slot has to be released right away, so this is the one copy on the way out:
+            // straight into a pooled buffer with room for our header in front
+            PacketHandle packetData = packetPool->acquire(packetSize, PacketBufferPool::DEFAULT_HEADROOM);
+            if (packetData)
+            {
+                memcpy(packetData.data(), reinterpret_cast<const void*>(packet), packetSize);
+            }
             
             // Release the packet
             pWintunReleaseReceivePacket(session, packet);
             
             // Process the packet
-            if (packetCallback)
+            if (packetData && packetCallback)
             {
-                packetCallback(packetData);
+                packetCallback(std::move(packetData));
             }
 
             continue;
@@ -192,7 +220,9 @@ void TunInterface::receiveThreadFunc() {
         
         // Wait for "packet ready" event signal from wintun or timeout via Windows API
         // In high-level terms, this is like waiting on a kernel-level condition variable / signal
+        BusyPoller::Clock::time_point blockedAt = BusyPoller::Clock::now();
         DWORD waitResult = WaitForSingleObject(readWaitEvent, 5); // 5ms timeout for gaming responsiveness
+        receivePoller.woke(blockedAt);
         
         if (waitResult == WAIT_TIMEOUT)
         {
@@ -211,34 +241,32 @@ void TunInterface::receiveThreadFunc() {
 
 void TunInterface::sendThreadFunc()
 {
-    while (running)
+    std::vector<PacketHandle> sendBatch;
+    sendBatch.reserve(SEND_BATCH);
+    uint64_t reportedDrops = 0;
+    auto lastDropReport = CoDelQueue::Clock::time_point();
+
+    // Sleeps only when there's nothing to send, sendPacket and stopPacketProcessing both wake it
+    while (outgoingPackets.takeBatch(sendBatch, SEND_BATCH))
     {
-        std::vector<uint8_t> packetData;
-        
-        // Wait for packet or timeout
+        CoDelQueue::Stats stats = outgoingPackets.getStats();
+        uint64_t drops = stats.codelDrops + stats.overflowDrops;
+        auto now = CoDelQueue::Clock::now();
+        if (drops != reportedDrops && now - lastDropReport >= DROP_REPORT_INTERVAL)
         {
-            std::unique_lock<std::mutex> lock(packetQueueMutex);
-            
-            if (packetConditionVariable.wait_for(lock, std::chrono::milliseconds(1), 
-                [this] { return !outgoingPackets.empty() || !running; })) 
-            {
-                // Got signaled - packet available or shutting down
-                if (!running) break;
-                
-                if (!outgoingPackets.empty()) {
-                    packetData = std::move(outgoingPackets.front());
-                    outgoingPackets.pop();
-                }
-            }
+            NETWORK_LOG_WARNING("[TunInterface] Adapter can't keep up: {} queued, {} CoDel drops, {} overflow drops",
+                stats.depth, stats.codelDrops, stats.overflowDrops);
+            reportedDrops = drops;
+            lastDropReport = now;
         }
         
-        if (!packetData.empty())
+        for (PacketHandle& packetData : sendBatch)
         {
             // Allocate a packet
             WINTUN_PACKET* packet = pWintunAllocateSendPacket(session, packetData.size());
             
             if (packet) {
-                // Copy the data, cast to void* to copy to packet
+                // Copy straight from the receive buffer into the ring
                 memcpy(reinterpret_cast<void*>(packet), 
                        reinterpret_cast<const void*>(packetData.data()), 
                        packetData.size());
@@ -247,10 +275,12 @@ void TunInterface::sendThreadFunc()
                 pWintunSendPacket(session, packet);
             }
         }
+        // Hands the receive buffers back to the pool, keeps the capacity
+        sendBatch.clear();
     }
 }
 
-bool TunInterface::sendPacket(std::vector<uint8_t> packet)
+bool TunInterface::sendPacket(PacketHandle packet)
 {
     if (!running)
     {
@@ -258,12 +288,8 @@ bool TunInterface::sendPacket(std::vector<uint8_t> packet)
         return false;
     }
     
-    // Add the packet to the queue and notify the send thread
-    {
-        std::lock_guard<std::mutex> lock(packetQueueMutex);
-        outgoingPackets.push(std::move(packet));
-    }
-    packetConditionVariable.notify_one();
+    // Add the packet to the queue, wakes the send thread if it's idle
+    outgoingPackets.push(std::move(packet));
     
     return true;
 }
@@ -278,6 +304,18 @@ bool TunInterface::isRunning() const
     return running;
 }
 
+CoDelQueue::Stats TunInterface::getQueueStats() const
+{
+    return outgoingPackets.getStats();
+}
+
+BusyPoller::Stats TunInterface::getBusyPollStats() const
+{
+    BusyPoller::Stats total = receivePoller.getStats();
+    total += outgoingPackets.getBusyPollStats();
+    return total;
+}
+
 void TunInterface::close()
 {
     // Stop packet processing
@@ -0,0 +1,167 @@
+#include "TunWriteQueue.hpp"
+#include <algorithm>
+
+TunWriteQueue::TunWriteQueue(CoDelQueue::Parameters parameters, std::chrono::microseconds busyPoll)
+    : ring(std::max<size_t>(1, parameters.limit)),
+      limit(std::max<size_t>(1, parameters.limit)),
+      outgoingPackets(parameters),
+      poller(busyPoll)
+{
+    arrivals.reserve(DRAIN_BATCH);
+}
+
+void TunWriteQueue::push(PacketHandle packet)
+{
+    if (!packet)
+        return;
+
+    enqueued.fetch_add(1, std::memory_order_relaxed);
+    Entry entry{std::move(packet), Clock::now()};
+    if (queued.fetch_add(1, std::memory_order_acq_rel) >= limit)
+    {
+        // Writer is behind: make room by dropping the oldest we can still reach
+        Entry oldest;
+        bool evicted = ring.tryPop(oldest);
+        countDrop(evicted ? oldest.packet : entry.packet);
+        queued.fetch_sub(1, std::memory_order_acq_rel);
+        if (!evicted)
+            return;
+    }
+    while (!ring.tryPush(entry))
+    {
+        // Racing senders can still find the ring full for a moment
+        Entry oldest;
+        if (ring.tryPop(oldest))
+        {
+            countDrop(oldest.packet);
+            queued.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    // Pairs with the fence in takeBatch(), either the writer sees the packet or we see it parked
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writerIdle.load(std::memory_order_relaxed) && writerIdle.exchange(false))
+    {
+        // Once we hold the mutex the writer is asleep or will see the flag; notify after letting go,
+        // so it doesn't wake up straight into our lock
+        {
+            std::lock_guard<std::mutex> lock(waitMutex);
+        }
+        packetsReady.notify_one();
+    }
+}
+
+bool TunWriteQueue::takeBatch(std::vector<PacketHandle>& out, size_t maxPackets)
+{
+    while (!stopped.load(std::memory_order_acquire))
+    {
+        size_t arrived = drainRing();
+
+        // What stays behind keeps aging so CoDel sees how long the device makes it wait
+        auto now = Clock::now();
+        size_t taken = 0;
+        while (taken < maxPackets)
+        {
+            PacketHandle packet = outgoingPackets.pop(now);
+            if (!packet)
+                break;
+            out.push_back(std::move(packet));
+            taken++;
+        }
+        // Taken or dropped by CoDel, either way out of the queue
+        size_t held = outgoingPackets.size();
+        queued.fetch_sub(writerHeld + arrived - held, std::memory_order_acq_rel);
+        writerHeld = held;
+        publishStats();
+        if (taken > 0)
+            return true;
+
+        if (poller.spin([this]() { return ring.hasReady() || stopped.load(std::memory_order_relaxed); }))
+            continue;
+
+        BusyPoller::Clock::time_point blockedAt = BusyPoller::Clock::now();
+        std::unique_lock<std::mutex> lock(waitMutex);
+        writerIdle.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // A push that came in before we parked didn't wake us
+        if (ring.hasReady())
+        {
+            writerIdle.store(false);
+            continue;
+        }
+        packetsReady.wait(lock, [this] { return !writerIdle.load() || stopped.load(); });
+        writerIdle.store(false);
+        poller.woke(blockedAt);
+    }
+    return false;
+}
+
+void TunWriteQueue::start()
+{
+    stopped = false;
+}
+
+void TunWriteQueue::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(waitMutex);
+        stopped = true;
+    }
+    packetsReady.notify_all();
+}
+
+size_t TunWriteQueue::clear()
+{
+    size_t discarded = 0;
+    Entry entry;
+    while (ring.tryPop(entry))
+    {
+        entry.packet = PacketHandle();
+        discarded++;
+    }
+    discarded += outgoingPackets.clear();
+    writerHeld = 0;
+    queued.fetch_sub(discarded, std::memory_order_acq_rel);
+    publishStats();
+    return discarded;
+}
+
+CoDelQueue::Stats TunWriteQueue::getStats() const
+{
+    CoDelQueue::Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(statsMutex);
+        stats = writerStats;
+    }
+    stats.enqueued = enqueued.load(std::memory_order_relaxed);
+    stats.overflowDrops += ringDrops.load(std::memory_order_relaxed);
+    stats.droppedBytes += ringDroppedBytes.load(std::memory_order_relaxed);
+    stats.depth += ring.size();
+    stats.maxDepth = std::max(stats.maxDepth, stats.depth);
+    return stats;
+}
+
+size_t TunWriteQueue::drainRing()
+{
+    size_t drained = 0;
+    while (size_t count = ring.tryPopBatch(arrivals, DRAIN_BATCH))
+    {
+        for (Entry& arrival : arrivals)
+            outgoingPackets.push(std::move(arrival.packet), arrival.enqueuedAt);
+        arrivals.clear();
+        drained += count;
+    }
+    return drained;
+}
+
+void TunWriteQueue::countDrop(const PacketHandle& packet)
+{
+    ringDrops.fetch_add(1, std::memory_order_relaxed);
+    ringDroppedBytes.fetch_add(packet.size(), std::memory_order_relaxed);
+}
+
+void TunWriteQueue::publishStats()
+{
+    std::lock_guard<std::mutex> lock(statsMutex);
+    writerStats = outgoingPackets.getStats();
+}
@@ -0,0 +1,492 @@
+#include "UringTransport.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+// user_data of the entries that aren't sends, sends carry their slot index
+constexpr uint64_t RECEIVE_TAG = 1ull << 32;
+constexpr uint64_t CANCEL_TAG = 2ull << 32;
+constexpr uint16_t BUFFER_GROUP = 0;
+// Bounds how long stop() waits for the kernel, per round and in rounds
+constexpr long long STOP_WAIT_NS = 100 * 1000 * 1000;
+constexpr int STOP_WAIT_ROUNDS = 20;
+
+uint32_t loadAcquire(const uint32_t* value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+void storeRelease(uint32_t* target, uint32_t value)
+{
+    __atomic_store_n(target, value, __ATOMIC_RELEASE);
+}
+
+template <typename T>
+T* at(void* base, uint32_t offset)
+{
+    return reinterpret_cast<T*>(static_cast<uint8_t*>(base) + offset);
+}
+}
+
+std::unique_ptr<UringTransport> UringTransport::create(int socketFd, const boost::asio::any_io_executor& executor,
+    std::shared_ptr<PacketBufferPool> packetPool, Parameters parameters)
+{
+    if ((parameters.receiveBuffers & (parameters.receiveBuffers - 1)) != 0 || parameters.receiveBuffers > 32768)
+    {
+        NETWORK_LOG_ERROR("[UringTransport] Receive buffer count {} must be a power of two up to 32768", parameters.receiveBuffers);
+        return nullptr;
+    }
+
+    std::unique_ptr<UringTransport> transport(new UringTransport(socketFd, executor, std::move(packetPool), parameters));
+    if (!transport->setupRing() || !transport->setupBufferRing())
+        return nullptr;
+    return transport;
+}
+
+UringTransport::UringTransport(int socketFd, const boost::asio::any_io_executor& executor,
+    std::shared_ptr<PacketBufferPool> packetPool, Parameters parameters)
+    : socketFd(socketFd),
+      packetPool(std::move(packetPool)),
+      parameters(parameters),
+      sendSlots(parameters.sendSlots),
+      eventDescriptor(executor)
+{
+    freeSendSlots.reserve(sendSlots.size());
+    for (size_t i = sendSlots.size(); i > 0; i--)
+        freeSendSlots.push_back(static_cast<uint32_t>(i - 1));
+}
+
+UringTransport::~UringTransport()
+{
+    stop();
+    // The eventfd goes with its descriptor, the ring with its fd, then nothing points into our memory any more
+    if (ringFd >= 0)
+        ::close(ringFd);
+    if (sqes)
+        ::munmap(sqes, sqesSize);
+    if (ringMemory)
+        ::munmap(ringMemory, ringMemorySize);
+    if (bufferRing)
+        ::munmap(bufferRing, bufferRingSize);
+}
+
+bool UringTransport::setupRing()
+{
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = parameters.ringEntries * 4;
+    ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, parameters.ringEntries, &params));
+    if (ringFd < 0)
+    {
+        NETWORK_LOG_WARNING("[UringTransport] io_uring_setup failed (errno {})", errno);
+        return false;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP) ||
+        !(params.features & IORING_FEAT_EXT_ARG))
+    {
+        NETWORK_LOG_WARNING("[UringTransport] Kernel io_uring lacks needed features (0x{:x})", params.features);
+        return false;
+    }
+
+    // One mapping for both rings, the entries on their own
+    size_t sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    size_t cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ringMemorySize = std::max(sqRingSize, cqRingSize);
+    void* memory = ::mmap(nullptr, ringMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    if (memory == MAP_FAILED)
+    {
+        NETWORK_LOG_WARNING("[UringTransport] Mapping the rings failed (errno {})", errno);
+        return false;
+    }
+    ringMemory = memory;
+
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    memory = ::mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+    if (memory == MAP_FAILED)
+    {
+        NETWORK_LOG_WARNING("[UringTransport] Mapping the submission entries failed (errno {})", errno);
+        return false;
+    }
+    sqes = static_cast<io_uring_sqe*>(memory);
+
+    sqHead = at<uint32_t>(ringMemory, params.sq_off.head);
+    sqTail = at<uint32_t>(ringMemory, params.sq_off.tail);
+    sqFlags = at<uint32_t>(ringMemory, params.sq_off.flags);
+    sqMask = *at<uint32_t>(ringMemory, params.sq_off.ring_mask);
+    sqEntries = params.sq_entries;
+    sqArray = at<uint32_t>(ringMemory, params.sq_off.array);
+    sqLocalTail = *sqTail;
+    cqHead = at<uint32_t>(ringMemory, params.cq_off.head);
+    cqTail = at<uint32_t>(ringMemory, params.cq_off.tail);
+    cqMask = *at<uint32_t>(ringMemory, params.cq_off.ring_mask);
+    cqes = at<io_uring_cqe>(ringMemory, params.cq_off.cqes);
+
+    eventFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (eventFd < 0)
+    {
+        NETWORK_LOG_WARNING("[UringTransport] eventfd failed (errno {})", errno);
+        return false;
+    }
+    boost::system::error_code error;
+    eventDescriptor.assign(eventFd, error);
+    if (error)
+    {
+        ::close(eventFd);
+        NETWORK_LOG_WARNING("[UringTransport] Can't watch the eventfd: {}", error.message());
+        return false;
+    }
+    if (::syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_EVENTFD, &eventFd, 1) < 0)
+    {
+        NETWORK_LOG_WARNING("[UringTransport] Registering the eventfd failed (errno {})", errno);
+        return false;
+    }
+    return true;
+}
+
+bool UringTransport::setupBufferRing()
+{
+    bufferRingSize = parameters.receiveBuffers * sizeof(io_uring_buf);
+    void* memory = ::mmap(nullptr, bufferRingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        NETWORK_LOG_WARNING("[UringTransport] Allocating the buffer ring failed (errno {})", errno);
+        return false;
+    }
+    bufferRing = static_cast<io_uring_buf*>(memory);
+
+    io_uring_buf_reg registration{};
+    registration.ring_addr = reinterpret_cast<uint64_t>(bufferRing);
+    registration.ring_entries = parameters.receiveBuffers;
+    registration.bgid = BUFFER_GROUP;
+    if (::syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PBUF_RING, &registration, 1) < 0)
+    {
+        // Provided buffer rings came with 5.19
+        NETWORK_LOG_WARNING("[UringTransport] Registering the buffer ring failed (errno {})", errno);
+        return false;
+    }
+
+    bufferSlabs.resize(parameters.receiveBuffers);
+    for (unsigned i = 0; i < parameters.receiveBuffers; i++)
+        recycleBuffer(static_cast<uint16_t>(i));
+
+    // The kernel lays every datagram out as io_uring_recvmsg_out, a name of this size, then the payload
+    receiveHeader.msg_namelen = sizeof(sockaddr_in6);
+    receiveHeader.msg_controllen = 0;
+    return true;
+}
+
+bool UringTransport::start(ReceiveHandler receiveHandler, SendHandler sendHandler)
+{
+    onReceive = std::move(receiveHandler);
+    onSend = std::move(sendHandler);
+    running = true;
+
+    armReceive();
+    flush();
+    // A kernel without multishot receives rejects the entry right away, nothing else can have completed yet
+    reapCompletions();
+    if (!receiveArmed)
+    {
+        NETWORK_LOG_WARNING("[UringTransport] Kernel rejected the multishot receive");
+        running = false;
+        return false;
+    }
+
+    waitForCompletions();
+    return true;
+}
+
+void UringTransport::stop()
+{
+    if (ringFd < 0 || (!running && !receiveArmed && sendsInFlight() == 0))
+        return;
+    running = false;
+    boost::system::error_code ignored;
+    eventDescriptor.cancel(ignored);
+
+    io_uring_sqe* sqe = nextSqe();
+    if (!sqe)
+    {
+        flush();
+        sqe = nextSqe();
+    }
+    if (sqe)
+    {
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+        sqe->user_data = CANCEL_TAG;
+        unsubmitted++;
+    }
+    flush();
+
+    // Completions from here on only hand the memory back, no handlers run
+    __kernel_timespec timeout{0, STOP_WAIT_NS};
+    io_uring_getevents_arg waitArgument{};
+    waitArgument.ts = reinterpret_cast<uint64_t>(&timeout);
+    for (int round = 0; round < STOP_WAIT_ROUNDS && (receiveArmed || sendsInFlight() > 0); round++)
+    {
+        ::syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+            &waitArgument, sizeof(waitArgument));
+        stats.enters++;
+        reapCompletions();
+    }
+    if (receiveArmed || sendsInFlight() > 0)
+        NETWORK_LOG_WARNING("[UringTransport] Kernel still holds {} sends and the receive after stopping", sendsInFlight());
+}
+
+bool UringTransport::queueSend(PacketHandle& packet, const boost::asio::ip::udp::endpoint& endpoint, uint32_t tag)
+{
+    if (freeSendSlots.empty())
+        return false;
+    io_uring_sqe* sqe = nextSqe();
+    if (!sqe)
+        return false;
+
+    uint32_t index = freeSendSlots.back();
+    freeSendSlots.pop_back();
+    SendSlot& slot = sendSlots[index];
+    slot.packet = std::move(packet);
+    slot.endpoint = endpoint;
+    slot.tag = tag;
+    slot.vector.iov_base = slot.packet.data();
+    slot.vector.iov_len = slot.packet.size();
+    slot.header = {};
+    slot.header.msg_name = slot.endpoint.data();
+    slot.header.msg_namelen = static_cast<socklen_t>(slot.endpoint.size());
+    slot.header.msg_iov = &slot.vector;
+    slot.header.msg_iovlen = 1;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = socketFd;
+    sqe->addr = reinterpret_cast<uint64_t>(&slot.header);
+    sqe->len = 1;
+    sqe->user_data = index;
+    unsubmitted++;
+    return true;
+}
+
+size_t UringTransport::flush()
+{
+    if (unsubmitted == 0)
+        return 0;
+
+    storeRelease(sqTail, sqLocalTail);
+    int submitted = enter(unsubmitted, 0, 0);
+    if (submitted < 0)
+    {
+        // Busy with completions we haven't reaped, the entries stay queued for the next flush
+        if (submitted != -EAGAIN && submitted != -EBUSY)
+            NETWORK_LOG_ERROR("[UringTransport] io_uring_enter failed (errno {})", -submitted);
+        return 0;
+    }
+    unsubmitted -= static_cast<unsigned>(submitted);
+    return static_cast<size_t>(submitted);
+}
+
+io_uring_sqe* UringTransport::nextSqe()
+{
+    if (sqLocalTail - loadAcquire(sqHead) >= sqEntries)
+        return nullptr;
+
+    uint32_t index = sqLocalTail & sqMask;
+    sqArray[index] = index;
+    sqLocalTail++;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+int UringTransport::enter(unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    long result;
+    do
+    {
+        result = ::syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0);
+        stats.enters++;
+    } while (result < 0 && errno == EINTR);
+    return result < 0 ? -errno : static_cast<int>(result);
+}
+
+void UringTransport::armReceive()
+{
+    io_uring_sqe* sqe = nextSqe();
+    if (!sqe)
+    {
+        flush();
+        sqe = nextSqe();
+        if (!sqe)
+        {
+            NETWORK_LOG_ERROR("[UringTransport] Submission queue full, can't arm the receive");
+            return;
+        }
+    }
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = socketFd;
+    sqe->addr = reinterpret_cast<uint64_t>(&receiveHeader);
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUFFER_GROUP;
+    sqe->user_data = RECEIVE_TAG;
+    unsubmitted++;
+    receiveArmed = true;
+}
+
+void UringTransport::waitForCompletions()
+{
+    eventDescriptor.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+        [this](const boost::system::error_code& error)
+        {
+            // Aborted by stop(), the transport may be gone already
+            if (error)
+                return;
+
+            // Only the wakeup matters, the ring says what completed
+            uint64_t count;
+            [[maybe_unused]] ssize_t ignored = ::read(eventFd, &count, sizeof(count));
+            stats.wakeups++;
+            reapCompletions();
+            if (running)
+                waitForCompletions();
+        });
+}
+
+void UringTransport::reapCompletions()
+{
+    for (;;)
+    {
+        uint32_t head = *cqHead;
+        uint32_t tail = loadAcquire(cqTail);
+        if (head == tail)
+        {
+            // Completions that didn't fit are held by the kernel until we ask for them
+            if (!(loadAcquire(sqFlags) & IORING_SQ_CQ_OVERFLOW))
+                break;
+            enter(0, 0, IORING_ENTER_GETEVENTS);
+            if (loadAcquire(cqTail) == head)
+                break;
+            continue;
+        }
+
+        while (head != tail)
+        {
+            // Copied out and released first, the handlers may well queue more work
+            io_uring_cqe cqe = cqes[head & cqMask];
+            head++;
+            storeRelease(cqHead, head);
+            stats.completions++;
+            handleCompletion(cqe);
+        }
+    }
+}
+
+void UringTransport::handleCompletion(const io_uring_cqe& cqe)
+{
+    if (cqe.user_data == RECEIVE_TAG)
+        handleReceive(cqe);
+    else if (cqe.user_data < sendSlots.size())
+        handleSend(cqe);
+}
+
+void UringTransport::handleReceive(const io_uring_cqe& cqe)
+{
+    if (!(cqe.flags & IORING_CQE_F_MORE))
+        receiveArmed = false;
+
+    if (cqe.res < 0)
+    {
+        // Out of buffers ends the multishot quietly, it's armed again below
+        if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP || cqe.res == -ECANCELED)
+            return;
+        if (cqe.res != -ENOBUFS)
+            NETWORK_LOG_ERROR("[UringTransport] Receive failed (errno {})", -cqe.res);
+    }
+    else if (cqe.flags & IORING_CQE_F_BUFFER)
+    {
+        uint16_t bufferId = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        PacketHandle packet = std::move(bufferSlabs[bufferId]);
+        io_uring_recvmsg_out header;
+        std::memcpy(&header, packet.data(), sizeof(header));
+        const uint8_t* name = packet.data() + sizeof(header);
+        size_t payloadOffset = sizeof(header) + receiveHeader.msg_namelen + receiveHeader.msg_controllen;
+
+        boost::asio::ip::udp::endpoint sender;
+        size_t nameLength = std::min<size_t>(header.namelen, receiveHeader.msg_namelen);
+        std::memcpy(sender.data(), name, nameLength);
+        sender.resize(nameLength);
+
+        if (header.flags & MSG_TRUNC)
+        {
+            stats.truncated++;
+            NETWORK_LOG_WARNING("[UringTransport] Dropping datagram larger than {} bytes from {}",
+                packet.capacity() - payloadOffset, sender.address().to_string());
+            bufferSlabs[bufferId] = std::move(packet);
+            recycleBuffer(bufferId);
+        }
+        else
+        {
+            // The payload stays where the kernel put it, what's in front of it becomes headroom
+            packet.resize(payloadOffset + header.payloadlen);
+            packet.trimFront(payloadOffset);
+            recycleBuffer(bufferId);
+            stats.received++;
+            if (running && onReceive)
+                onReceive(std::move(packet), sender);
+        }
+    }
+
+    if (!receiveArmed && running)
+    {
+        stats.receiveRearms++;
+        armReceive();
+        flush();
+    }
+}
+
+void UringTransport::handleSend(const io_uring_cqe& cqe)
+{
+    uint32_t index = static_cast<uint32_t>(cqe.user_data);
+    SendSlot& slot = sendSlots[index];
+    slot.packet.reset();
+    uint32_t tag = slot.tag;
+    boost::asio::ip::udp::endpoint endpoint = slot.endpoint;
+    // Free before the handler runs, it may send again
+    freeSendSlots.push_back(index);
+
+    boost::system::error_code error;
+    if (cqe.res < 0)
+    {
+        error.assign(-cqe.res, boost::system::system_category());
+        stats.sendErrors++;
+    }
+    else
+    {
+        stats.sent++;
+    }
+    if (running && onSend)
+        onSend(error, cqe.res < 0 ? 0 : static_cast<size_t>(cqe.res), tag, endpoint);
+}
+
+void UringTransport::recycleBuffer(uint16_t bufferId)
+{
+    PacketHandle& slab = bufferSlabs[bufferId];
+    if (!slab)
+        slab = packetPool->acquire(PacketBufferPool::SLAB_SIZE);
+
+    io_uring_buf& buffer = bufferRing[bufferRingTail & (parameters.receiveBuffers - 1)];
+    buffer.addr = reinterpret_cast<uint64_t>(slab.data());
+    buffer.len = static_cast<uint32_t>(slab.capacity());
+    buffer.bid = bufferId;
+    bufferRingTail++;
+    // The tail lives in the first entry's reserved field
+    __atomic_store_n(&reinterpret_cast<io_uring_buf_ring*>(bufferRing)->tail, bufferRingTail, __ATOMIC_RELEASE);
+}
@@ -1,5 +1,5 @@
 #include "P2PSystem.hpp"
-#include "Logger.hpp"
+#include "logger.hpp"
 #include <iostream>
 #include <string>
 #include <thread>
@@ -1,10 +1,10 @@
-#include "Stun.hpp"
-#include "Logger.hpp"
+#include "stun.hpp"
+#include "logger.hpp"
 #include <iostream>
 #include <sodium/randombytes.h>
 
-StunClient::StunClient(const std::string& server, const std::string& port)
-    : stunServer(server), stunPort(port)
+StunClient::StunClient(const std::string& server, const std::string& port, bool reusePort)
+    : stunServer(server), stunPort(port), reusePort(reusePort)
     , ioContext()
 {
 }
@@ -26,6 +26,13 @@ std::optional<PublicAddress> StunClient::discoverPublicAddress()
         udp::resolver resolver(ioContext);
         udp::endpoint stun_endpoint = *resolver.resolve(stunServer, stunPort).begin();
         scoket->open(udp::v4());
+        #ifdef SO_REUSEPORT
+        // UDPNetwork opens more sockets on this port later (socket shards), they share the NAT binding
+        // Only then: with the option set any other process running as our user can bind the port and take its traffic
+        if (reusePort)
+            scoket->set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+        #endif
+        scoket->bind(udp::endpoint(udp::v4(), 0));
 
         // Build STUN binding request according to RFC 5389 protocol
         std::array<uint8_t, 20> request{};
@@ -0,0 +1,178 @@
+#include <gtest/gtest.h>
+#include "AckTracker.hpp"
+
+using namespace std::chrono_literals;
+
+class AckTrackerTest : public ::testing::Test
+{
+protected:
+    void sendPackets(uint64_t from, uint64_t to, AckTracker::Clock::time_point at)
+    {
+        for (uint64_t counter = from; counter < to; counter++)
+            tracker.onPacketSent(counter, PACKET_BYTES, at);
+    }
+
+    static AckBlock makeAck(uint64_t largest, uint64_t receivedCount, uint64_t bitmap, uint32_t delayMicroseconds = 0)
+    {
+        AckBlock ack;
+        ack.sessionId = 1;
+        ack.largest = largest;
+        ack.receivedCount = receivedCount;
+        ack.bitmap = bitmap;
+        ack.delayMicroseconds = delayMicroseconds;
+        return ack;
+    }
+
+    static constexpr size_t PACKET_BYTES = 1000;
+
+    AckTracker tracker;
+    AckTracker::Clock::time_point start = AckTracker::Clock::now();
+};
+
+TEST_F(AckTrackerTest, TestAckBlockRoundTrip)
+{
+    AckBlock ack = makeAck(0x0102030405060708ull, 77, 0xF0F0F0F0F0F0F0F0ull, 1234);
+    ack.sessionId = 0xDEADBEEF;
+    uint8_t wire[AckBlock::SIZE];
+    ack.write(wire);
+
+    AckBlock read = AckBlock::read(wire);
+    EXPECT_EQ(read.sessionId, ack.sessionId);
+    EXPECT_EQ(read.delayMicroseconds, ack.delayMicroseconds);
+    EXPECT_EQ(read.largest, ack.largest);
+    EXPECT_EQ(read.receivedCount, ack.receivedCount);
+    EXPECT_EQ(read.bitmap, ack.bitmap);
+}
+
+TEST_F(AckTrackerTest, TestAckSettlesFlightAndSamplesRtt)
+{
+    sendPackets(0, 10, start);
+    EXPECT_EQ(tracker.getStats().bytesInFlight, 10 * PACKET_BYTES);
+
+    tracker.onAckReceived(makeAck(9, 10, 0x1FF), start + 50ms);
+    const AckTracker::Stats& stats = tracker.getStats();
+    EXPECT_EQ(stats.packetsAcked, 10u);
+    EXPECT_EQ(stats.bytesInFlight, 0u);
+    EXPECT_EQ(stats.bytesDelivered, 10 * PACKET_BYTES);
+    EXPECT_EQ(stats.packetsLost, 0u);
+    EXPECT_EQ(stats.latestRtt, 50ms);
+    EXPECT_EQ(stats.smoothedRtt, 50ms);
+    EXPECT_EQ(stats.minRtt, 50ms);
+
+    // The peer's ack delay comes out of later samples
+    sendPackets(10, 11, start + 100ms);
+    tracker.onAckReceived(makeAck(10, 11, 0x3FF, 20000), start + 170ms);
+    EXPECT_EQ(stats.latestRtt, 70ms);
+    EXPECT_EQ(stats.smoothedRtt, (7 * 50ms + 50ms) / 8);
+}
+
+TEST_F(AckTrackerTest, TestRateSampleCoversTheAckedFlight)
+{
+    // Ten packets a millisecond apart per round, each acked 50ms after its last packet went out
+    for (uint64_t counter = 0; counter < 10; counter++)
+        tracker.onPacketSent(counter, PACKET_BYTES, start + std::chrono::milliseconds(counter));
+    AckTracker::RateSample first = tracker.onAckReceived(makeAck(9, 10, 0x1FF), start + 59ms);
+    // Started from idle, so the whole 59ms count
+    EXPECT_EQ(first.deliveredBytes, 10 * PACKET_BYTES);
+    EXPECT_EQ(first.interval, 59ms);
+    EXPECT_EQ(first.priorDelivered, 0u);
+
+    for (uint64_t counter = 10; counter < 20; counter++)
+        tracker.onPacketSent(counter, PACKET_BYTES, start + 59ms + std::chrono::milliseconds(counter - 10));
+    AckTracker::RateSample second = tracker.onAckReceived(makeAck(19, 20, ~0ull), start + 118ms);
+    EXPECT_EQ(second.deliveredBytes, 10 * PACKET_BYTES);
+    EXPECT_EQ(second.interval, 59ms);
+    EXPECT_EQ(second.priorDelivered, 10 * PACKET_BYTES);
+    EXPECT_EQ(second.rate(), 10 * PACKET_BYTES * 1000 / 59);
+
+    // Nothing new in a repeated ack
+    EXPECT_FALSE(tracker.onAckReceived(makeAck(19, 20, ~0ull), start + 120ms).valid());
+}
+
+TEST_F(AckTrackerTest, TestLossComesFromCumulativeCount)
+{
+    sendPackets(0, 100, start);
+
+    // 10 never arrived, the bitmap only covers the last 64 but the count covers everything
+    tracker.onAckReceived(makeAck(99, 90, ~0ull), start + 10ms);
+    EXPECT_EQ(tracker.getStats().packetsLost, 10u);
+    EXPECT_GT(tracker.getStats().lossRate, 0.0);
+    EXPECT_EQ(tracker.getStats().bytesInFlight, 0u);
+
+    // A clean interval pulls the rate back down
+    double lossRate = tracker.getStats().lossRate;
+    sendPackets(100, 200, start + 20ms);
+    tracker.onAckReceived(makeAck(199, 190, ~0ull), start + 30ms);
+    EXPECT_EQ(tracker.getStats().packetsLost, 10u);
+    EXPECT_LT(tracker.getStats().lossRate, lossRate);
+}
+
+TEST_F(AckTrackerTest, TestRecentHoleStaysInFlight)
+{
+    sendPackets(0, 5, start);
+
+    // 3 is just behind the largest, could still be on its way
+    tracker.onAckReceived(makeAck(4, 4, 0b1110), start + 10ms);
+    EXPECT_EQ(tracker.getStats().bytesInFlight, PACKET_BYTES);
+    EXPECT_EQ(tracker.getStats().packetsAcked, 4u);
+
+    tracker.onAckReceived(makeAck(4, 5, 0b1111), start + 12ms);
+    EXPECT_EQ(tracker.getStats().bytesInFlight, 0u);
+    EXPECT_EQ(tracker.getStats().packetsAcked, 5u);
+}
+
+TEST_F(AckTrackerTest, TestStaleAckIgnored)
+{
+    sendPackets(0, 20, start);
+    tracker.onAckReceived(makeAck(19, 20, 0x7FFFF), start + 10ms);
+    tracker.onAckReceived(makeAck(5, 3, 0x1F), start + 11ms);
+
+    EXPECT_EQ(tracker.getStats().packetsLost, 0u);
+    EXPECT_EQ(tracker.getStats().acksReceived, 2u);
+    EXPECT_EQ(tracker.getStats().latestRtt, 10ms);
+}
+
+TEST_F(AckTrackerTest, TestRingForgetsUnackedPackets)
+{
+    // Nothing acked for more than a ring's worth, the oldest are dropped from the flight
+    sendPackets(0, AckTracker::RING_SIZE + 10, start);
+    EXPECT_EQ(tracker.getStats().bytesInFlight, AckTracker::RING_SIZE * PACKET_BYTES);
+    EXPECT_EQ(tracker.getStats().packetsSent, AckTracker::RING_SIZE + 10);
+}
+
+TEST_F(AckTrackerTest, TestAckDueAfterDelayOrEnoughPackets)
+{
+    ReplayWindow window;
+    auto receive = [&](uint64_t counter, bool ackEliciting, AckTracker::Clock::time_point at)
+    {
+        window.update(counter);
+        tracker.onPacketReceived(counter, ackEliciting, at);
+    };
+
+    // Ack-only packets are counted but don't ask for an ack
+    receive(0, false, start);
+    EXPECT_FALSE(tracker.isAckPending());
+
+    receive(1, true, start);
+    receive(3, true, start + 1ms);
+    EXPECT_TRUE(tracker.isAckPending());
+    EXPECT_FALSE(tracker.isAckDue(start + 5ms, 20ms));
+    EXPECT_TRUE(tracker.isAckDue(start + 20ms, 20ms));
+
+    AckBlock ack = tracker.makeAck(42, window, start + 21ms);
+    EXPECT_EQ(ack.sessionId, 42u);
+    EXPECT_EQ(ack.largest, 3u);
+    EXPECT_EQ(ack.receivedCount, 3u);
+    EXPECT_EQ(ack.bitmap, 0b110u);
+    EXPECT_EQ(ack.delayMicroseconds, 20000u);
+    EXPECT_FALSE(tracker.isAckPending());
+
+    for (uint64_t counter = 4; counter < 4 + AckTracker::ACK_EVERY; counter++)
+        receive(counter, true, start + 22ms);
+    EXPECT_TRUE(tracker.mustAckNow());
+    EXPECT_TRUE(tracker.isAckDue(start + 22ms, 20ms));
+
+    // New peer session, its counts start over
+    tracker.resetReceiveSide();
+    EXPECT_FALSE(tracker.isAckPending());
+}
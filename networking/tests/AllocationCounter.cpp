@@ -0,0 +1,99 @@
+#include "AllocationCounter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Kept out of the test sources: with the replacements in the same file the compiler pairs the inlined
+// malloc / free against the new / delete expressions and warns about every one of them
+
+namespace
+{
+std::atomic<bool> countAllocations{false};
+std::atomic<size_t> allocationCount{0};
+
+void count()
+{
+    if (countAllocations.load(std::memory_order_relaxed))
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void* allocate(std::size_t size)
+{
+    count();
+    return std::malloc(size ? size : 1);
+}
+
+void* allocateAligned(std::size_t size, std::align_val_t alignment)
+{
+    count();
+    std::size_t align = static_cast<std::size_t>(alignment);
+    #ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, align);
+    #else
+    // aligned_alloc wants the size to be a multiple of the alignment
+    return std::aligned_alloc(align, ((size ? size : 1) + align - 1) / align * align);
+    #endif
+}
+
+void freeAligned(void* memory)
+{
+    #ifdef _WIN32
+    _aligned_free(memory);
+    #else
+    std::free(memory);
+    #endif
+}
+
+void* orThrow(void* memory)
+{
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+}
+
+void AllocationCounter::setArmed(bool armed)
+{
+    countAllocations.store(armed, std::memory_order_relaxed);
+}
+
+void AllocationCounter::reset()
+{
+    allocationCount.store(0, std::memory_order_relaxed);
+}
+
+size_t AllocationCounter::getCount()
+{
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) { return orThrow(allocate(size)); }
+void* operator new[](std::size_t size) { return orThrow(allocate(size)); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return orThrow(allocateAligned(size, alignment)); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return orThrow(allocateAligned(size, alignment)); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+    return allocateAligned(size, alignment);
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept { freeAligned(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { freeAligned(memory); }
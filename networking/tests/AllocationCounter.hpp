@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+// Counts global allocations while armed, for the tests checking a path doesn't allocate per packet
+// Replaces the global operator new / delete, so it's linked into its own test executable only
+// (PeerBridgeNet_alloc_tests) and leaves the allocator of every other test alone
+class AllocationCounter
+{
+public:
+    static void setArmed(bool);
+    static void reset();
+    static size_t getCount();
+};
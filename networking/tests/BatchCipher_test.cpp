@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+#include "BatchCipher.hpp"
+#include <array>
+#include <sodium.h>
+#include <vector>
+
+class BatchCipherTest : public ::testing::TestWithParam<BatchChaCha20Poly1305::Kernel>
+{
+protected:
+    void SetUp() override
+    {
+        if (!BatchChaCha20Poly1305::isKernelAvailable(GetParam()))
+            GTEST_SKIP() << BatchChaCha20Poly1305::kernelName(GetParam()) << " kernel not available on this host";
+        ASSERT_NE(sodium_init(), -1);
+        randombytes_buf(header, sizeof(header));
+    }
+
+    // Packets of mixed sizes (empty, sub-block, odd tails, full MTU), each with its own key and nonce
+    void makePackets(size_t count)
+    {
+        packets.assign(count, {});
+        expected.assign(count, {});
+        keys.assign(count, {});
+        macs.assign(count, {});
+        expectedMacs.assign(count, {});
+        items.assign(count, {});
+
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t size = (i * 397 + count * 13) % 1500;
+            packets[i].resize(size);
+            randombytes_buf(packets[i].data(), size);
+            randombytes_buf(keys[i].data(), keys[i].size());
+
+            BatchCipherItem& item = items[i];
+            item.data = packets[i].data();
+            item.size = size;
+            item.mac = macs[i].data();
+            item.ad = header;
+            item.adSize = sizeof(header);
+            item.key = keys[i].data();
+            randombytes_buf(item.nonce, sizeof(item.nonce));
+
+            expected[i] = packets[i];
+            crypto_aead_chacha20poly1305_ietf_encrypt_detached(expected[i].data(), expectedMacs[i].data(), nullptr,
+                expected[i].data(), size, header, sizeof(header), nullptr, item.nonce, item.key);
+        }
+    }
+
+    uint8_t header[14];
+    std::vector<std::vector<uint8_t>> packets;
+    std::vector<std::vector<uint8_t>> expected;
+    std::vector<std::array<uint8_t, 32>> keys;
+    std::vector<std::array<uint8_t, 16>> macs;
+    std::vector<std::array<uint8_t, 16>> expectedMacs;
+    std::vector<BatchCipherItem> items;
+};
+
+TEST_P(BatchCipherTest, TestSealMatchesLibsodium)
+{
+    BatchChaCha20Poly1305 cipher(GetParam());
+    ASSERT_EQ(cipher.getKernel(), GetParam());
+
+    // Partial groups and more than one batch
+    for (size_t count : {1, 3, 8, 11, 16, 21})
+    {
+        makePackets(count);
+        cipher.seal(items.data(), count);
+        for (size_t i = 0; i < count; i++)
+        {
+            EXPECT_TRUE(items[i].ok);
+            EXPECT_EQ(packets[i], expected[i]) << "count " << count << " packet " << i;
+            EXPECT_EQ(macs[i], expectedMacs[i]) << "count " << count << " packet " << i;
+        }
+    }
+}
+
+TEST_P(BatchCipherTest, TestOpensLibsodiumPackets)
+{
+    BatchChaCha20Poly1305 cipher(GetParam());
+    makePackets(13);
+    std::vector<std::vector<uint8_t>> plaintext = packets;
+
+    packets = expected;
+    macs = expectedMacs;
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        items[i].data = packets[i].data();
+        items[i].mac = macs[i].data();
+    }
+
+    cipher.open(items.data(), items.size());
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        EXPECT_TRUE(items[i].ok);
+        EXPECT_EQ(packets[i], plaintext[i]) << "packet " << i;
+    }
+}
+
+TEST_P(BatchCipherTest, TestTamperedPacketFailsAlone)
+{
+    BatchChaCha20Poly1305 cipher(GetParam());
+    makePackets(9);
+    std::vector<std::vector<uint8_t>> plaintext = packets;
+    cipher.seal(items.data(), items.size());
+
+    macs[1][0] ^= 1;
+    packets[4][0] ^= 1;
+    cipher.open(items.data(), items.size());
+
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        bool tampered = i == 1 || i == 4;
+        EXPECT_EQ(items[i].ok, !tampered) << "packet " << i;
+        if (!tampered)
+        {
+            EXPECT_EQ(packets[i], plaintext[i]) << "packet " << i;
+        }
+    }
+    // A packet that doesn't authenticate is left as it came in
+    EXPECT_EQ(packets[1], expected[1]);
+}
+
+INSTANTIATE_TEST_SUITE_P(Kernels, BatchCipherTest,
+    ::testing::Values(BatchChaCha20Poly1305::Kernel::SCALAR, BatchChaCha20Poly1305::Kernel::AVX2, BatchChaCha20Poly1305::Kernel::AVX512),
+    [](const ::testing::TestParamInfo<BatchChaCha20Poly1305::Kernel>& info)
+    {
+        return std::string(BatchChaCha20Poly1305::kernelName(info.param));
+    });
+
+TEST(BatchCipherKernelTest, TestUnavailableKernelFallsBackToScalar)
+{
+    BatchChaCha20Poly1305 detected;
+    EXPECT_TRUE(BatchChaCha20Poly1305::isKernelAvailable(detected.getKernel()));
+    for (auto kernel : {BatchChaCha20Poly1305::Kernel::AVX2, BatchChaCha20Poly1305::Kernel::AVX512})
+    {
+        BatchChaCha20Poly1305 cipher(kernel);
+        if (!BatchChaCha20Poly1305::isKernelAvailable(kernel))
+        {
+            EXPECT_EQ(cipher.getKernel(), BatchChaCha20Poly1305::Kernel::SCALAR);
+        }
+    }
+}
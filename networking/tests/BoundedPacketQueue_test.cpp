@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+#include "BoundedPacketQueue.hpp"
+#include "TestPackets.hpp"
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+BoundedPacketQueue::Parameters smallQueue(BoundedPacketQueue::DropPolicy policy, std::chrono::microseconds maxStall)
+{
+    BoundedPacketQueue::Parameters parameters;
+    parameters.limit = 4;
+    parameters.dropPolicy = policy;
+    parameters.maxStall = maxStall;
+    return parameters;
+}
+}
+
+TEST(BoundedPacketQueueTest, TestConsumerScheduledOncePerBurst)
+{
+    auto pool = PacketBufferPool::create();
+    BoundedPacketQueue queue;
+
+    EXPECT_TRUE(queue.push(makePacket(*pool, 0)));
+    for (uint32_t i = 1; i < 10; i++)
+        EXPECT_FALSE(queue.push(makePacket(*pool, i)));
+
+    // Leftovers keep the consumer scheduled, an empty queue hands scheduling back to the producers
+    std::vector<PacketHandle> batch;
+    EXPECT_TRUE(queue.popBatch(batch, 6));
+    EXPECT_FALSE(queue.push(makePacket(*pool, 10)));
+    EXPECT_FALSE(queue.popBatch(batch, 6));
+    ASSERT_EQ(batch.size(), 11u);
+    for (uint32_t i = 0; i < 11; i++)
+        EXPECT_EQ(idOf(batch[i]), i);
+
+    EXPECT_TRUE(queue.push(makePacket(*pool, 11)));
+    EXPECT_EQ(queue.getStats().enqueued, 12u);
+    EXPECT_EQ(queue.getStats().dequeued, 11u);
+}
+
+TEST(BoundedPacketQueueTest, TestDropPolicies)
+{
+    auto pool = PacketBufferPool::create();
+    BoundedPacketQueue tail(smallQueue(BoundedPacketQueue::DropPolicy::TAIL, 0us));
+    BoundedPacketQueue head(smallQueue(BoundedPacketQueue::DropPolicy::HEAD, 0us));
+    for (uint32_t i = 0; i < 6; i++)
+    {
+        tail.push(makePacket(*pool, i));
+        head.push(makePacket(*pool, i));
+    }
+
+    std::vector<PacketHandle> batch;
+    tail.popBatch(batch, 10);
+    ASSERT_EQ(batch.size(), 4u);
+    EXPECT_EQ(idOf(batch.front()), 0u);
+    EXPECT_EQ(idOf(batch.back()), 3u);
+
+    batch.clear();
+    head.popBatch(batch, 10);
+    ASSERT_EQ(batch.size(), 4u);
+    EXPECT_EQ(idOf(batch.front()), 2u);
+    EXPECT_EQ(idOf(batch.back()), 5u);
+
+    for (BoundedPacketQueue* queue : {&tail, &head})
+    {
+        BoundedPacketQueue::Stats stats = queue->getStats();
+        EXPECT_EQ(stats.drops, 2u);
+        EXPECT_EQ(stats.droppedBytes, 200u);
+        EXPECT_EQ(stats.stalls, 0u);
+        EXPECT_EQ(stats.maxDepth, 4u);
+    }
+}
+
+TEST(BoundedPacketQueueTest, TestFullQueueHoldsProducerUntilRoom)
+{
+    auto pool = PacketBufferPool::create();
+    BoundedPacketQueue queue(smallQueue(BoundedPacketQueue::DropPolicy::TAIL, 5s));
+    for (uint32_t i = 0; i < 4; i++)
+        queue.push(makePacket(*pool, i));
+
+    std::thread producer([&]()
+    {
+        queue.push(makePacket(*pool, 4));
+    });
+    std::this_thread::sleep_for(20ms);
+    EXPECT_EQ(queue.size(), 4u);
+
+    std::vector<PacketHandle> batch;
+    queue.popBatch(batch, 1);
+    producer.join();
+
+    // Nothing lost, the reader just waited
+    queue.popBatch(batch, 10);
+    ASSERT_EQ(batch.size(), 5u);
+    EXPECT_EQ(idOf(batch.back()), 4u);
+    BoundedPacketQueue::Stats stats = queue.getStats();
+    EXPECT_EQ(stats.drops, 0u);
+    EXPECT_EQ(stats.stalls, 1u);
+    EXPECT_GE(stats.stallTime, 15ms);
+}
+
+TEST(BoundedPacketQueueTest, TestStallIsBoundedThenDrops)
+{
+    auto pool = PacketBufferPool::create();
+    BoundedPacketQueue queue(smallQueue(BoundedPacketQueue::DropPolicy::HEAD, 10ms));
+    for (uint32_t i = 0; i < 4; i++)
+        queue.push(makePacket(*pool, i));
+
+    // Nobody consumes: the push gives up after maxStall and drops the oldest
+    queue.push(makePacket(*pool, 4));
+    BoundedPacketQueue::Stats stats = queue.getStats();
+    EXPECT_EQ(stats.stalls, 1u);
+    EXPECT_GE(stats.stallTime, 10ms);
+    EXPECT_EQ(stats.drops, 1u);
+
+    EXPECT_EQ(queue.clear(), 4u);
+    EXPECT_EQ(queue.getStats().depth, 0u);
+    // Clearing unschedules the consumer, the next push has to post it
+    EXPECT_TRUE(queue.push(makePacket(*pool, 5)));
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include "BoundedRing.hpp"
+#include <set>
+#include <thread>
+
+TEST(BoundedRingTest, TestFifoUpToCapacity)
+{
+    BoundedRing<int> ring(4);
+    for (int i = 0; i < 4; i++)
+    {
+        int value = i;
+        EXPECT_TRUE(ring.tryPush(value));
+    }
+    // Full: the value stays with the caller
+    int extra = 99;
+    EXPECT_FALSE(ring.tryPush(extra));
+    EXPECT_EQ(extra, 99);
+    EXPECT_EQ(ring.size(), 4u);
+
+    // Round the ring a few times
+    for (int i = 0; i < 20; i++)
+    {
+        int value = -1;
+        ASSERT_TRUE(ring.tryPop(value));
+        EXPECT_EQ(value, i);
+        int next = i + 4;
+        EXPECT_TRUE(ring.tryPush(next));
+    }
+    EXPECT_TRUE(ring.hasReady());
+}
+
+TEST(BoundedRingTest, TestBatchesTakeWhatFits)
+{
+    BoundedRing<int, true> ring(5);
+    int values[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+    EXPECT_EQ(ring.tryPushBatch(values, 3), 3u);
+    EXPECT_EQ(ring.tryPushBatch(values + 3, 5), 2u);
+    EXPECT_EQ(ring.tryPushBatch(values + 5, 3), 0u);
+
+    std::vector<int> out;
+    EXPECT_EQ(ring.tryPopBatch(out, 2), 2u);
+    EXPECT_EQ(ring.tryPushBatch(values + 5, 3), 2u);
+    EXPECT_EQ(ring.tryPopBatch(out, 100), 5u);
+    EXPECT_EQ(ring.tryPopBatch(out, 100), 0u);
+    EXPECT_FALSE(ring.hasReady());
+    EXPECT_EQ(out, std::vector<int>({0, 1, 2, 3, 4, 5, 6}));
+}
+
+TEST(BoundedRingTest, TestProducersKeepTheirOrderAndNothingIsLost)
+{
+    constexpr uint64_t PRODUCERS = 4;
+    constexpr uint64_t PER_PRODUCER = 20000;
+    BoundedRing<uint64_t> ring(64);
+
+    std::vector<std::thread> producers;
+    for (uint64_t producer = 0; producer < PRODUCERS; producer++)
+    {
+        producers.emplace_back([&ring, producer]()
+        {
+            // Producer in the top bits, sequence below; odd rounds go in batches
+            for (uint64_t i = 0; i < PER_PRODUCER;)
+            {
+                uint64_t batch[3];
+                size_t count = (i % 2 == 0) ? 1 : std::min<uint64_t>(3, PER_PRODUCER - i);
+                for (size_t j = 0; j < count; j++)
+                    batch[j] = (producer << 32) | (i + j);
+                size_t pushed = ring.tryPushBatch(batch, count);
+                if (pushed == 0)
+                    std::this_thread::yield();
+                i += pushed;
+            }
+        });
+    }
+
+    // Two consumers, each checks that every producer's items reach it in order
+    std::vector<std::vector<uint64_t>> received(2);
+    std::atomic<uint64_t> total{0};
+    std::vector<std::thread> consumers;
+    for (size_t consumer = 0; consumer < 2; consumer++)
+    {
+        consumers.emplace_back([&, consumer]()
+        {
+            std::vector<int64_t> last(PRODUCERS, -1);
+            std::vector<uint64_t> batch;
+            while (total.load() < PRODUCERS * PER_PRODUCER)
+            {
+                batch.clear();
+                size_t taken = ring.tryPopBatch(batch, 8);
+                if (taken == 0)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (uint64_t item : batch)
+                {
+                    uint64_t producer = item >> 32;
+                    int64_t sequence = static_cast<int64_t>(item & 0xffffffff);
+                    EXPECT_GT(sequence, last[producer]);
+                    last[producer] = sequence;
+                    received[consumer].push_back(item);
+                }
+                total.fetch_add(taken);
+            }
+        });
+    }
+
+    for (auto& producer : producers)
+        producer.join();
+    for (auto& consumer : consumers)
+        consumer.join();
+
+    std::set<uint64_t> unique(received[0].begin(), received[0].end());
+    unique.insert(received[1].begin(), received[1].end());
+    EXPECT_EQ(received[0].size() + received[1].size(), PRODUCERS * PER_PRODUCER);
+    EXPECT_EQ(unique.size(), PRODUCERS * PER_PRODUCER);
+}
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include "BroadcastSuppressor.hpp"
+#include <vector>
+
+namespace
+{
+using Verdict = BroadcastSuppressor::Verdict;
+constexpr std::chrono::milliseconds WINDOW{50};
+
+// UDP from 10.0.0.1:srcPort to 10.0.0.255:4000, `tag` as the first payload byte
+std::vector<uint8_t> udpBroadcast(uint16_t srcPort, uint8_t tag)
+{
+    std::vector<uint8_t> packet(60);
+    packet[0] = 0x45;
+    packet[3] = 60;
+    packet[8] = 64;
+    packet[9] = 17;
+    packet[12] = 10; packet[15] = 1;
+    packet[16] = 10; packet[19] = 255;
+    packet[20] = static_cast<uint8_t>(srcPort >> 8); packet[21] = static_cast<uint8_t>(srcPort);
+    packet[22] = 0x0F; packet[23] = 0xA0;
+    packet[28] = tag;
+    return packet;
+}
+}
+
+TEST(BroadcastSuppressorTest, TestResendsCollapsedWithinWindow)
+{
+    BroadcastSuppressor suppressor;
+    auto now = BroadcastSuppressor::Clock::now();
+    std::vector<uint8_t> packet = udpBroadcast(5000, 1);
+    EXPECT_EQ(suppressor.inspect(packet.data(), packet.size(), now, WINDOW, 0), Verdict::PASS);
+
+    // The resend gets a new IP id, TTL and checksum, it's still the same packet
+    std::vector<uint8_t> resend = packet;
+    resend[5] = 0x42; resend[8] = 63; resend[10] = 0xAB; resend[11] = 0xCD;
+    EXPECT_EQ(suppressor.inspect(resend.data(), resend.size(), now + std::chrono::milliseconds(10), WINDOW, 0), Verdict::DUPLICATE);
+    EXPECT_EQ(suppressor.inspect(resend.data(), resend.size(), now + std::chrono::milliseconds(49), WINDOW, 0), Verdict::DUPLICATE);
+
+    // Different payload, and the same one once the window passed
+    std::vector<uint8_t> other = udpBroadcast(5000, 2);
+    EXPECT_EQ(suppressor.inspect(other.data(), other.size(), now + std::chrono::milliseconds(20), WINDOW, 0), Verdict::PASS);
+    EXPECT_EQ(suppressor.inspect(packet.data(), packet.size(), now + WINDOW, WINDOW, 0), Verdict::PASS);
+
+    const BroadcastSuppressor::Stats& stats = suppressor.getStats();
+    EXPECT_EQ(stats.passed, 3u);
+    EXPECT_EQ(stats.duplicates, 2u);
+    EXPECT_EQ(stats.duplicateBytes, 120u);
+    EXPECT_EQ(stats.rateLimited, 0u);
+
+    // After clear() nothing counts as seen
+    suppressor.clear();
+    EXPECT_EQ(suppressor.inspect(packet.data(), packet.size(), now + WINDOW, WINDOW, 0), Verdict::PASS);
+}
+
+TEST(BroadcastSuppressorTest, TestRateLimitedPerSourceSocket)
+{
+    BroadcastSuppressor suppressor;
+    auto now = BroadcastSuppressor::Clock::now();
+    for (uint8_t tag = 0; tag < 10; tag++)
+    {
+        std::vector<uint8_t> packet = udpBroadcast(5000, tag);
+        EXPECT_EQ(suppressor.inspect(packet.data(), packet.size(), now, WINDOW, 10), Verdict::PASS);
+    }
+    std::vector<uint8_t> flood = udpBroadcast(5000, 10);
+    EXPECT_EQ(suppressor.inspect(flood.data(), flood.size(), now, WINDOW, 10), Verdict::RATE_LIMITED);
+
+    // Another socket on the same host has its own bucket
+    std::vector<uint8_t> otherSocket = udpBroadcast(5001, 10);
+    EXPECT_EQ(suppressor.inspect(otherSocket.data(), otherSocket.size(), now, WINDOW, 10), Verdict::PASS);
+
+    // A tenth of a second refills one token, and the packet that was dropped wasn't remembered as sent
+    EXPECT_EQ(suppressor.inspect(flood.data(), flood.size(), now + std::chrono::milliseconds(100), WINDOW, 10), Verdict::PASS);
+    EXPECT_EQ(suppressor.inspect(flood.data(), flood.size(), now + std::chrono::milliseconds(100), WINDOW, 10), Verdict::DUPLICATE);
+
+    const BroadcastSuppressor::Stats& stats = suppressor.getStats();
+    EXPECT_EQ(stats.rateLimited, 1u);
+    EXPECT_EQ(stats.rateLimitedBytes, 60u);
+    EXPECT_EQ(stats.passed, 12u);
+}
+
+TEST(BroadcastSuppressorTest, TestSourcesNeverShareABucket)
+{
+    BroadcastSuppressor suppressor;
+    auto now = BroadcastSuppressor::Clock::now();
+
+    // Two sockets alternating can't reset each other's bucket, however their keys hash
+    size_t passed = 0;
+    for (uint8_t tag = 0; tag < 20; tag++)
+    {
+        std::vector<uint8_t> packet = udpBroadcast(tag % 2 ? 5000 : 5000 + BroadcastSuppressor::SOURCE_SLOTS, tag);
+        if (suppressor.inspect(packet.data(), packet.size(), now, std::chrono::milliseconds(0), 5) == Verdict::PASS)
+            passed++;
+    }
+    EXPECT_EQ(passed, 10u);
+
+    // The other slots busy too: newcomers get limited together instead of each starting full
+    for (uint16_t port = 6000; port < 6000 + BroadcastSuppressor::SOURCE_SLOTS - 2; port++)
+    {
+        std::vector<uint8_t> packet = udpBroadcast(port, 0);
+        suppressor.inspect(packet.data(), packet.size(), now, std::chrono::milliseconds(0), 5);
+    }
+    passed = 0;
+    for (uint8_t tag = 0; tag < 20; tag++)
+    {
+        std::vector<uint8_t> packet = udpBroadcast(7000 + tag, tag);
+        if (suppressor.inspect(packet.data(), packet.size(), now, std::chrono::milliseconds(0), 5) == Verdict::PASS)
+            passed++;
+    }
+    EXPECT_EQ(passed, 5u);
+
+    // A second later the idle buckets are free again
+    std::vector<uint8_t> later = udpBroadcast(8000, 0);
+    EXPECT_EQ(suppressor.inspect(later.data(), later.size(), now + std::chrono::seconds(1), std::chrono::milliseconds(0), 5),
+        Verdict::PASS);
+}
+
+TEST(BroadcastSuppressorTest, TestDisabledAndNonIpv4Pass)
+{
+    BroadcastSuppressor suppressor;
+    auto now = BroadcastSuppressor::Clock::now();
+    std::vector<uint8_t> packet = udpBroadcast(5000, 1);
+    for (int i = 0; i < 3; i++)
+        EXPECT_EQ(suppressor.inspect(packet.data(), packet.size(), now, std::chrono::milliseconds(0), 0), Verdict::PASS);
+
+    std::vector<uint8_t> ipv6(60);
+    ipv6[0] = 0x60;
+    for (int i = 0; i < 3; i++)
+        EXPECT_EQ(suppressor.inspect(ipv6.data(), ipv6.size(), now, WINDOW, 1), Verdict::PASS);
+    // Header length past the end of the packet
+    packet[0] = 0x4F;
+    EXPECT_EQ(suppressor.inspect(packet.data(), 40, now, WINDOW, 1), Verdict::PASS);
+    EXPECT_EQ(suppressor.getStats().passed, 7u);
+}
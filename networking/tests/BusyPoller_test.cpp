@@ -0,0 +1,84 @@
+#include <gtest/gtest.h>
+#include "BusyPoller.hpp"
+#include <boost/asio.hpp>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+TEST(BusyPollerTest, TestDisabledNeverSpins)
+{
+    BusyPoller poller;
+    EXPECT_FALSE(poller.isEnabled());
+    int calls = 0;
+    EXPECT_FALSE(poller.spin([&calls]() { calls++; return true; }));
+    EXPECT_EQ(calls, 0);
+
+    BusyPoller::Stats stats = poller.getStats();
+    EXPECT_EQ(stats.hits + stats.misses + stats.skipped, 0u);
+}
+
+TEST(BusyPollerTest, TestSpinFindsWorkWithinBudget)
+{
+    BusyPoller poller(100ms);
+    int calls = 0;
+    EXPECT_TRUE(poller.spin([&calls]() { return ++calls == 50; }));
+    EXPECT_EQ(calls, 50);
+
+    BusyPoller::Stats stats = poller.getStats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 0u);
+    EXPECT_LT(stats.spinTime, 100ms);
+}
+
+TEST(BusyPollerTest, TestQuietTrafficBacksOffUntilItReturns)
+{
+    BusyPoller poller(64us);
+    auto never = []() { return false; };
+
+    // 64 -> 32 -> 16 -> 8 -> 4 -> 2 -> 1us, then below the floor: no more spinning
+    for (int i = 0; i < 7; i++)
+        EXPECT_FALSE(poller.spin(never));
+    EXPECT_EQ(poller.getStats().misses, 7u);
+    EXPECT_FALSE(poller.spin(never));
+    EXPECT_EQ(poller.getStats().skipped, 1u);
+
+    // A long sleep leaves it off, a short one means spinning would have caught the packet
+    poller.woke(BusyPoller::Clock::now() - 10ms);
+    EXPECT_FALSE(poller.spin(never));
+    EXPECT_EQ(poller.getStats().skipped, 2u);
+    poller.woke(BusyPoller::Clock::now());
+    EXPECT_FALSE(poller.spin(never));
+    EXPECT_EQ(poller.getStats().misses, 8u);
+
+    // A hit restores the whole budget
+    int calls = 0;
+    EXPECT_TRUE(poller.spin([&calls]() { return ++calls == 2; }));
+    EXPECT_FALSE(poller.spin(never));
+    EXPECT_EQ(poller.getStats().misses, 9u);
+    EXPECT_GE(poller.getStats().spinTime, 64us);
+}
+
+TEST(BusyPollerTest, TestRunServesHandlersUntilStopped)
+{
+    boost::asio::io_context context;
+    auto work = boost::asio::make_work_guard(context);
+    BusyPoller poller(200us);
+    std::atomic<int> handled{0};
+    std::thread runner([&]() { poller.run(context); });
+
+    for (int i = 0; i < 20; i++)
+    {
+        boost::asio::post(context, [&handled]() { handled++; });
+        // Some land while it spins, some after it backed off and blocked
+        std::this_thread::sleep_for(i % 2 == 0 ? 0us : 2ms);
+    }
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (handled < 20 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(1ms);
+    context.stop();
+    runner.join();
+
+    EXPECT_EQ(handled.load(), 20);
+    BusyPoller::Stats stats = poller.getStats();
+    EXPECT_GT(stats.hits + stats.misses, 0u);
+}
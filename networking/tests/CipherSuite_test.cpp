@@ -0,0 +1,142 @@
+#include <gtest/gtest.h>
+#include "CipherSuite.hpp"
+#include <cstring>
+#include <vector>
+
+class CipherSuiteTest : public ::testing::TestWithParam<CipherSuite>
+{
+protected:
+    void SetUp() override
+    {
+        if (!PeerCipher::isSupported(GetParam()))
+            GTEST_SKIP() << PeerCipher::suiteName(GetParam()) << " not available on this host";
+
+        PeerCipher::SharedKey sharedKey;
+        randombytes_buf(sharedKey.data(), sharedKey.size());
+        lower.setKeys(sharedKey, true);
+        higher.setKeys(sharedKey, false);
+    }
+
+    PeerCipher lower;
+    PeerCipher higher;
+    uint8_t header[14] = {0x21, 0, 0, 0, 0, 7};
+    uint8_t mac[PeerCipher::MAC_SIZE];
+};
+
+TEST_P(CipherSuiteTest, TestSealedByOneSideOpensOnTheOther)
+{
+    std::vector<uint8_t> packet(1400, 0x42);
+    lower.seal(GetParam(), packet.data(), packet.size(), mac, header, sizeof(header), 7, 1);
+    EXPECT_NE(packet[0], 0x42);
+
+    ASSERT_TRUE(higher.open(GetParam(), packet.data(), packet.size(), mac, header, sizeof(header), 7, 1));
+    EXPECT_EQ(packet, std::vector<uint8_t>(1400, 0x42));
+}
+
+TEST_P(CipherSuiteTest, TestReflectedPacketDoesNotOpen)
+{
+    // Our own packet sent back at us must not authenticate, each direction has its own key / nonce space
+    std::vector<uint8_t> packet(100, 0x42);
+    lower.seal(GetParam(), packet.data(), packet.size(), mac, header, sizeof(header), 7, 1);
+    EXPECT_FALSE(lower.open(GetParam(), packet.data(), packet.size(), mac, header, sizeof(header), 7, 1));
+}
+
+TEST_P(CipherSuiteTest, TestWrongCounterDoesNotOpen)
+{
+    std::vector<uint8_t> packet(100, 0x42);
+    lower.seal(GetParam(), packet.data(), packet.size(), mac, header, sizeof(header), 7, 1);
+    EXPECT_FALSE(higher.open(GetParam(), packet.data(), packet.size(), mac, header, sizeof(header), 7, 2));
+}
+
+TEST_P(CipherSuiteTest, TestTamperedHeaderDoesNotOpen)
+{
+    // Type, flags, session and counter travel in the clear, every suite has to authenticate them
+    std::vector<uint8_t> packet(100, 0x42);
+    lower.seal(GetParam(), packet.data(), packet.size(), mac, header, sizeof(header), 7, 1);
+    header[1] = 0x80;
+    EXPECT_FALSE(higher.open(GetParam(), packet.data(), packet.size(), mac, header, sizeof(header), 7, 1));
+}
+
+INSTANTIATE_TEST_SUITE_P(AllSuites, CipherSuiteTest, ::testing::Values(
+    CipherSuite::XSALSA20_POLY1305, CipherSuite::CHACHA20_POLY1305, CipherSuite::AES256_GCM));
+
+TEST(CipherSuiteSelectionTest, TestChooseSuite)
+{
+    constexpr uint8_t XSALSA = 1u << 0;
+    constexpr uint8_t CHACHA = 1u << 1;
+
+    // Our pick if the peer has it
+    EXPECT_EQ(PeerCipher::chooseSuite(CipherSuite::CHACHA20_POLY1305, XSALSA | CHACHA, 0), CipherSuite::CHACHA20_POLY1305);
+    // Otherwise the peer's pick
+    EXPECT_EQ(PeerCipher::chooseSuite(CipherSuite::XSALSA20_POLY1305, CHACHA, 1), CipherSuite::CHACHA20_POLY1305);
+    // Peers that predate the choice advertise nothing
+    EXPECT_EQ(PeerCipher::chooseSuite(CipherSuite::CHACHA20_POLY1305, 0, 0), CipherSuite::XSALSA20_POLY1305);
+    // Garbage preference
+    EXPECT_EQ(PeerCipher::chooseSuite(CipherSuite::CHACHA20_POLY1305, 0, 200), CipherSuite::XSALSA20_POLY1305);
+}
+
+TEST(CipherSuiteSelectionTest, TestFastestSuiteIsSupported)
+{
+    EXPECT_TRUE(PeerCipher::isSupported(PeerCipher::fastestSuite()));
+    EXPECT_TRUE(PeerCipher::isSupported(CipherSuite::XSALSA20_POLY1305));
+    EXPECT_TRUE(PeerCipher::isSupported(CipherSuite::CHACHA20_POLY1305));
+    EXPECT_FALSE(PeerCipher::isSupported(CipherSuite::COUNT));
+}
+
+TEST(CipherSuiteSelectionTest, TestParseSuite)
+{
+    EXPECT_EQ(PeerCipher::parseSuite("chacha20"), CipherSuite::CHACHA20_POLY1305);
+    EXPECT_EQ(PeerCipher::parseSuite("aes256gcm"), CipherSuite::AES256_GCM);
+    EXPECT_EQ(PeerCipher::parseSuite("auto"), std::nullopt);
+}
+
+TEST(GroupCipherTest, TestEveryHolderOpensOneSeal)
+{
+    GroupCipher sender, holder, stranger;
+    sender.generate();
+    holder.setKey(sender.getKey());
+    stranger.generate();
+
+    uint8_t header[14] = {0x27, static_cast<uint8_t>(GroupCipher::SUITE)};
+    uint8_t mac[GroupCipher::MAC_SIZE];
+    std::vector<uint8_t> packet(100, 0x42);
+    sender.seal(packet.data(), packet.size(), mac, header, sizeof(header), 7, 1);
+
+    std::vector<uint8_t> copy = packet;
+    EXPECT_FALSE(stranger.open(copy.data(), copy.size(), mac, header, sizeof(header), 7, 1));
+    copy = packet;
+    EXPECT_FALSE(holder.open(copy.data(), copy.size(), mac, header, sizeof(header), 8, 1));
+    copy = packet;
+    EXPECT_FALSE(holder.open(copy.data(), copy.size(), mac, header, sizeof(header), 7, 2));
+
+    ASSERT_TRUE(holder.open(packet.data(), packet.size(), mac, header, sizeof(header), 7, 1));
+    EXPECT_EQ(packet, std::vector<uint8_t>(100, 0x42));
+}
+
+TEST(GroupCipherTest, TestVerifyThenDecryptMatchesOpen)
+{
+    GroupCipher sender, holder;
+    sender.generate();
+    holder.setKey(sender.getKey());
+
+    uint8_t header[14] = {0x27, static_cast<uint8_t>(GroupCipher::SUITE)};
+    uint8_t mac[GroupCipher::MAC_SIZE];
+    std::vector<uint8_t> packet(100);
+    for (size_t i = 0; i < packet.size(); i++)
+        packet[i] = static_cast<uint8_t>(i);
+    sender.seal(packet.data(), packet.size(), mac, header, sizeof(header), 7, 1);
+
+    // Checking leaves the ciphertext alone, a tampered one fails
+    std::vector<uint8_t> sealed = packet;
+    ASSERT_TRUE(holder.verify(packet.data(), packet.size(), mac, header, sizeof(header), 7, 1));
+    EXPECT_EQ(packet, sealed);
+    std::vector<uint8_t> tampered = packet;
+    tampered[50] ^= 1;
+    EXPECT_FALSE(holder.verify(tampered.data(), tampered.size(), mac, header, sizeof(header), 7, 1));
+    EXPECT_FALSE(holder.verify(packet.data(), packet.size(), mac, header, sizeof(header), 7, 2));
+
+    holder.decrypt(packet.data(), packet.size(), 7, 1);
+    ASSERT_TRUE(holder.open(sealed.data(), sealed.size(), mac, header, sizeof(header), 7, 1));
+    EXPECT_EQ(packet, sealed);
+    EXPECT_EQ(packet[99], 99);
+}
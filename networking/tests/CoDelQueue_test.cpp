@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include "CoDelQueue.hpp"
+#include "TestPackets.hpp"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+// Over the MTU as soon as two are queued, so CoDel has something to drop; ids are the millisecond queued at
+constexpr size_t PACKET_SIZE = 1000;
+}
+
+TEST(CoDelQueueTest, TestShortBurstPassesUntouched)
+{
+    auto pool = PacketBufferPool::create();
+    CoDelQueue queue;
+    auto start = CoDelQueue::Clock::now();
+
+    // 50 packets at once, drained one per millisecond: well above the target, but for less than an interval
+    for (uint32_t i = 0; i < 50; i++)
+        queue.push(makePacket(*pool, i, PACKET_SIZE), start);
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        PacketHandle packet = queue.pop(start + std::chrono::milliseconds(i + 1));
+        ASSERT_TRUE(packet);
+        EXPECT_EQ(idOf(packet), i);
+    }
+
+    EXPECT_TRUE(queue.empty());
+    CoDelQueue::Stats stats = queue.getStats();
+    EXPECT_EQ(stats.codelDrops, 0u);
+    EXPECT_EQ(stats.dequeued, 50u);
+    EXPECT_EQ(stats.maxDepth, 50u);
+}
+
+TEST(CoDelQueueTest, TestStandingQueueIsDrainedByDrops)
+{
+    auto pool = PacketBufferPool::create();
+    CoDelQueue queue;
+    auto start = CoDelQueue::Clock::now();
+
+    // A 100ms backlog, then one packet in and one out every millisecond: a plain FIFO would keep the delay forever
+    for (uint32_t i = 0; i < 100; i++)
+        queue.push(makePacket(*pool, 0, PACKET_SIZE), start);
+
+    uint32_t lastSojournMs = 0;
+    for (uint32_t ms = 1; ms <= 5000; ms++)
+    {
+        auto now = start + std::chrono::milliseconds(ms);
+        queue.push(makePacket(*pool, ms, PACKET_SIZE), now);
+        if (PacketHandle packet = queue.pop(now))
+            lastSojournMs = ms - idOf(packet);
+    }
+
+    CoDelQueue::Stats stats = queue.getStats();
+    EXPECT_GT(stats.codelDrops, 50u);
+    EXPECT_EQ(stats.overflowDrops, 0u);
+    EXPECT_LE(lastSojournMs, 10u);
+    EXPECT_LE(queue.size(), 10u);
+    EXPECT_FALSE(queue.isDropping());
+}
+
+TEST(CoDelQueueTest, TestFullQueueDropsOldest)
+{
+    auto pool = PacketBufferPool::create();
+    CoDelQueue::Parameters parameters;
+    parameters.limit = 4;
+    CoDelQueue queue(parameters);
+    auto now = CoDelQueue::Clock::now();
+
+    for (uint32_t i = 0; i < 6; i++)
+        queue.push(makePacket(*pool, i, PACKET_SIZE), now);
+    EXPECT_EQ(queue.size(), 4u);
+    EXPECT_EQ(queue.bytes(), 4000u);
+    EXPECT_EQ(queue.getStats().overflowDrops, 2u);
+    EXPECT_EQ(queue.getStats().droppedBytes, 2000u);
+
+    for (uint32_t i = 2; i < 6; i++)
+        EXPECT_EQ(idOf(queue.pop(now)), i);
+    EXPECT_FALSE(queue.pop(now));
+}
+
+TEST(CoDelQueueTest, TestClearReportsDiscarded)
+{
+    auto pool = PacketBufferPool::create();
+    CoDelQueue queue;
+    auto now = CoDelQueue::Clock::now();
+    for (uint32_t i = 0; i < 3; i++)
+        queue.push(makePacket(*pool, i, PACKET_SIZE), now);
+
+    EXPECT_EQ(queue.getStats().depth, 3u);
+    EXPECT_EQ(queue.clear(), 3u);
+    EXPECT_TRUE(queue.empty());
+    EXPECT_EQ(queue.bytes(), 0u);
+    EXPECT_EQ(queue.getStats().depth, 0u);
+
+    // Still usable afterwards
+    queue.push(makePacket(*pool, 7, PACKET_SIZE), now);
+    EXPECT_EQ(idOf(queue.pop(now)), 7u);
+}
@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+#include "CongestionController.hpp"
+#include <deque>
+#include <set>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+using Clock = CongestionController::Clock;
+
+// A bulk sender behind one bottleneck, in virtual time: FIFO buffer of bufferPackets, serialised at linkRate,
+// oneWayDelay each way, and a receiver acking every packet the way the v2 path does with ACK_EVERY = 1
+class PathSimulation
+{
+public:
+    PathSimulation(uint64_t linkRate, std::chrono::microseconds oneWayDelay, size_t bufferPackets)
+        : linkRate(linkRate), oneWayDelay(oneWayDelay), bufferPackets(bufferPackets)
+    {
+    }
+
+    void run(Clock::duration duration)
+    {
+        Clock::time_point end = now + duration;
+        for (; now < end; now += STEP)
+        {
+            deliverAcks();
+            send();
+            serveBottleneck();
+            receive();
+        }
+    }
+
+    // Counters start over on every call
+    void resetCounters()
+    {
+        deliveredBytes = 0;
+        queueDelayTotal = 0us;
+        queueDelaySamples = 0;
+        sent = 0;
+        droppedAtBottleneck = 0;
+    }
+
+    double utilisation(Clock::duration over) const
+    {
+        return static_cast<double>(deliveredBytes) / (static_cast<double>(linkRate) * std::chrono::duration<double>(over).count());
+    }
+    std::chrono::microseconds averageQueueDelay() const
+    {
+        return queueDelaySamples ? queueDelayTotal / static_cast<int64_t>(queueDelaySamples) : 0us;
+    }
+    double lossRate() const { return sent ? static_cast<double>(droppedAtBottleneck) / sent : 0; }
+
+    AckTracker tracker;
+    CongestionController controller;
+
+private:
+    static constexpr size_t PACKET_BYTES = 1400;
+    static constexpr Clock::duration STEP = std::chrono::microseconds(50);
+
+    struct InTransit
+    {
+        uint64_t counter;
+        Clock::time_point at;
+    };
+
+    void deliverAcks()
+    {
+        while (!acks.empty() && acks.front().second <= now)
+        {
+            AckTracker::RateSample sample = tracker.onAckReceived(acks.front().first, now);
+            controller.onAck(sample, tracker.getStats(), now);
+            acks.pop_front();
+        }
+    }
+
+    void send()
+    {
+        // Always something to send
+        while (controller.canSend(tracker.getStats().bytesInFlight, now))
+        {
+            uint64_t inFlight = tracker.getStats().bytesInFlight;
+            tracker.onPacketSent(nextCounter, PACKET_BYTES, now);
+            controller.onPacketSent(PACKET_BYTES, inFlight, now);
+            sent++;
+            if (bottleneck.size() >= bufferPackets)
+                droppedAtBottleneck++;
+            else
+                bottleneck.push_back({nextCounter, now});
+            nextCounter++;
+        }
+    }
+
+    void serveBottleneck()
+    {
+        while (!bottleneck.empty())
+        {
+            Clock::time_point start = std::max(linkFreeAt, bottleneck.front().at);
+            if (start > now)
+                break;
+            linkFreeAt = start + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(static_cast<double>(PACKET_BYTES) / static_cast<double>(linkRate)));
+            queueDelayTotal += std::chrono::duration_cast<std::chrono::microseconds>(start - bottleneck.front().at);
+            queueDelaySamples++;
+            deliveredBytes += PACKET_BYTES;
+            arrivals.push_back({bottleneck.front().counter, linkFreeAt + oneWayDelay});
+            bottleneck.pop_front();
+        }
+    }
+
+    void receive()
+    {
+        while (!arrivals.empty() && arrivals.front().at <= now)
+        {
+            uint64_t counter = arrivals.front().counter;
+            arrivals.pop_front();
+            received.insert(counter);
+            receivedCount++;
+            largest = std::max(largest, counter);
+            while (!received.empty() && *received.begin() + 64 < largest)
+                received.erase(received.begin());
+
+            AckBlock ack;
+            ack.sessionId = 1;
+            ack.largest = largest;
+            ack.receivedCount = receivedCount;
+            for (uint64_t below : received)
+            {
+                if (below < largest)
+                    ack.bitmap |= 1ull << (largest - 1 - below);
+            }
+            acks.push_back({ack, now + oneWayDelay});
+        }
+    }
+
+    uint64_t linkRate;
+    std::chrono::microseconds oneWayDelay;
+    size_t bufferPackets;
+
+    Clock::time_point now = Clock::now();
+    Clock::time_point linkFreeAt;
+    uint64_t nextCounter = 0;
+    std::deque<InTransit> bottleneck;
+    std::deque<InTransit> arrivals;
+    std::deque<std::pair<AckBlock, Clock::time_point>> acks;
+    std::set<uint64_t> received;
+    uint64_t receivedCount = 0;
+    uint64_t largest = 0;
+
+    uint64_t deliveredBytes = 0;
+    std::chrono::microseconds queueDelayTotal{0};
+    uint64_t queueDelaySamples = 0;
+    uint64_t sent = 0;
+    uint64_t droppedAtBottleneck = 0;
+};
+}
+
+TEST(CongestionControllerTest, TestFillsLinkWithoutStandingQueue)
+{
+    // 10 Mbit/s uplink, 40ms RTT, a modem buffer of a quarter second
+    PathSimulation path(1250000, 20ms, 200);
+    path.run(5s);
+    path.resetCounters();
+    path.run(5s);
+
+    const CongestionController::Stats& stats = path.controller.getStats();
+    EXPECT_EQ(stats.state, CongestionController::State::PROBE_BW);
+    EXPECT_NEAR(static_cast<double>(stats.bandwidth), 1250000.0, 125000.0);
+    EXPECT_GT(path.utilisation(5s), 0.85);
+    // Unpaced, a sender would keep the modem buffer full: 220ms
+    EXPECT_LT(path.averageQueueDelay(), 20ms);
+    EXPECT_EQ(path.lossRate(), 0.0);
+}
+
+TEST(CongestionControllerTest, TestShallowBufferLossCapsFlight)
+{
+    // 2 Mbit/s uplink with a buffer of only 8 packets, startup overshoots it
+    PathSimulation path(250000, 15ms, 8);
+    path.run(5s);
+    EXPECT_GT(path.controller.getStats().lossRounds, 0u);
+
+    path.resetCounters();
+    path.run(10s);
+    EXPECT_GT(path.utilisation(10s), 0.75);
+    EXPECT_LT(path.lossRate(), 0.02);
+}
+
+TEST(CongestionControllerTest, TestWindowLimitedPeerProbesWhenAcksStop)
+{
+    CongestionController controller;
+    auto start = Clock::now();
+    uint64_t inFlight = 0;
+    while (controller.canSend(inFlight, start))
+    {
+        controller.onPacketSent(1500, inFlight, start);
+        inFlight += 1500;
+    }
+    EXPECT_EQ(inFlight, CongestionController::INITIAL_WINDOW);
+    EXPECT_EQ(controller.nextSendTime(inFlight), start + CongestionController::PROBE_TIMEOUT);
+
+    // Nothing came back: one packet per probe timeout
+    EXPECT_FALSE(controller.canSend(inFlight, start + 199ms));
+    EXPECT_TRUE(controller.canSend(inFlight, start + 200ms));
+    controller.onPacketSent(1500, inFlight, start + 200ms);
+    inFlight += 1500;
+    EXPECT_FALSE(controller.canSend(inFlight, start + 300ms));
+    EXPECT_TRUE(controller.canSend(inFlight, start + 400ms));
+}
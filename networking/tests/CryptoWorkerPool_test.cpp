@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+#include "CryptoWorkerPool.hpp"
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CryptoWorkerPoolTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        PeerCipher::SharedKey sharedKey;
+        randombytes_buf(sharedKey.data(), sharedKey.size());
+        auto sealing = std::make_shared<PeerCipher>();
+        sealing->setKeys(sharedKey, true);
+        cipher = sealing;
+        auto opening = std::make_shared<PeerCipher>();
+        opening->setKeys(sharedKey, false);
+        peerCipher = opening;
+    }
+
+    CryptoJob makeJob(CryptoJob::Operation operation, uint64_t counter, size_t payloadSize = 1000)
+    {
+        CryptoJob job;
+        job.operation = operation;
+        job.suite = CipherSuite::CHACHA20_POLY1305;
+        job.cipher = operation == CryptoJob::Operation::SEAL ? cipher : peerCipher;
+        job.packet = packetPool->acquire(HEADER_SIZE + PeerCipher::MAC_SIZE + payloadSize);
+        std::memset(job.packet.data(), static_cast<int>(counter & 0xFF), job.packet.size());
+        job.headerSize = HEADER_SIZE;
+        job.sessionId = 1;
+        job.counter = counter;
+        return job;
+    }
+
+    template <typename Condition>
+    static bool waitFor(Condition condition)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (!condition())
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    static constexpr size_t HEADER_SIZE = 14;
+
+    std::shared_ptr<PacketBufferPool> packetPool = PacketBufferPool::create();
+    std::shared_ptr<const PeerCipher> cipher;
+    std::shared_ptr<const PeerCipher> peerCipher;
+};
+
+TEST_F(CryptoWorkerPoolTest, TestCompletionsKeepSubmissionOrderPerFlow)
+{
+    CryptoWorkerPool pool(4);
+
+    constexpr size_t FLOWS = 3;
+    constexpr uint64_t JOBS = 500;
+    std::mutex resultsMutex;
+    std::vector<std::vector<uint64_t>> results(FLOWS);
+    std::vector<std::shared_ptr<CryptoFlow>> flows;
+    for (size_t f = 0; f < FLOWS; f++)
+    {
+        flows.push_back(pool.createFlow([&, f](CryptoJob& job)
+        {
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            results[f].push_back(job.counter);
+        }));
+    }
+
+    for (uint64_t i = 0; i < JOBS; i++)
+    {
+        for (size_t f = 0; f < FLOWS; f++)
+        {
+            // Varying sizes so workers finish out of order
+            CryptoJob job = makeJob(CryptoJob::Operation::SEAL, i, (i % 7) * 200 + 16);
+            while (!pool.submit(flows[f], std::move(job)))
+            {
+                std::this_thread::yield();
+                job = makeJob(CryptoJob::Operation::SEAL, i, (i % 7) * 200 + 16);
+            }
+        }
+    }
+
+    ASSERT_TRUE(waitFor([&]()
+    {
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        for (const auto& flowResults : results)
+            if (flowResults.size() < JOBS)
+                return false;
+        return true;
+    }));
+
+    for (const auto& flowResults : results)
+    {
+        for (uint64_t i = 0; i < JOBS; i++)
+            ASSERT_EQ(flowResults[i], i);
+    }
+
+    CryptoWorkerPool::Stats stats = pool.getStats();
+    EXPECT_EQ(stats.workers, 4u);
+    EXPECT_EQ(stats.jobs, JOBS * FLOWS);
+    EXPECT_EQ(stats.queueDepth, 0u);
+    EXPECT_GT(stats.queueHighWaterMark, 0u);
+    ASSERT_EQ(stats.utilization.size(), 4u);
+}
+
+TEST_F(CryptoWorkerPoolTest, TestSealedJobOpensOnTheOtherSide)
+{
+    CryptoWorkerPool pool(2);
+
+    std::mutex resultsMutex;
+    std::vector<CryptoJob> sealed;
+    auto sealFlow = pool.createFlow([&](CryptoJob& job)
+    {
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        sealed.push_back(std::move(job));
+    });
+    ASSERT_TRUE(pool.submit(sealFlow, makeJob(CryptoJob::Operation::SEAL, 9)));
+    ASSERT_TRUE(waitFor([&]() { std::lock_guard<std::mutex> lock(resultsMutex); return sealed.size() == 1; }));
+    EXPECT_TRUE(sealed[0].ok);
+
+    std::vector<CryptoJob> opened;
+    auto openFlow = pool.createFlow([&](CryptoJob& job)
+    {
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        opened.push_back(std::move(job));
+    });
+
+    CryptoJob openJob = std::move(sealed[0]);
+    openJob.operation = CryptoJob::Operation::OPEN;
+    openJob.cipher = peerCipher;
+    PacketHandle tampered = packetPool->acquire(openJob.packet.size());
+    std::memcpy(tampered.data(), openJob.packet.data(), tampered.size());
+    tampered.data()[tampered.size() - 1] ^= 1;
+
+    CryptoJob tamperedJob = makeJob(CryptoJob::Operation::OPEN, 9);
+    tamperedJob.packet = tampered;
+
+    ASSERT_TRUE(pool.submit(openFlow, std::move(openJob)));
+    ASSERT_TRUE(pool.submit(openFlow, std::move(tamperedJob)));
+    ASSERT_TRUE(waitFor([&]() { std::lock_guard<std::mutex> lock(resultsMutex); return opened.size() == 2; }));
+
+    EXPECT_TRUE(opened[0].ok);
+    EXPECT_EQ(opened[0].packet.data()[HEADER_SIZE + PeerCipher::MAC_SIZE], 9);
+    EXPECT_FALSE(opened[1].ok);
+}
+
+TEST_F(CryptoWorkerPoolTest, TestBurstSealsLikeSinglePackets)
+{
+    // A burst gets taken off the queue several jobs at a time and sealed as one batch
+    CryptoWorkerPool pool(1);
+
+    constexpr uint64_t JOBS = 64;
+    std::mutex resultsMutex;
+    std::vector<CryptoJob> sealed;
+    auto flow = pool.createFlow([&](CryptoJob& job)
+    {
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        sealed.push_back(std::move(job));
+    });
+    for (uint64_t i = 0; i < JOBS; i++)
+        ASSERT_TRUE(pool.submit(flow, makeJob(CryptoJob::Operation::SEAL, i, (i % 5) * 333)));
+    ASSERT_TRUE(waitFor([&]() { std::lock_guard<std::mutex> lock(resultsMutex); return sealed.size() == JOBS; }));
+
+    for (CryptoJob& job : sealed)
+    {
+        ASSERT_TRUE(job.ok);
+        uint8_t* header = job.packet.data();
+        uint8_t* mac = header + HEADER_SIZE;
+        size_t payloadSize = job.packet.size() - HEADER_SIZE - PeerCipher::MAC_SIZE;
+        ASSERT_TRUE(peerCipher->open(job.suite, mac + PeerCipher::MAC_SIZE, payloadSize, mac, header, HEADER_SIZE,
+            job.sessionId, job.counter)) << "counter " << job.counter;
+        EXPECT_EQ(std::vector<uint8_t>(mac + PeerCipher::MAC_SIZE, mac + PeerCipher::MAC_SIZE + payloadSize),
+            std::vector<uint8_t>(payloadSize, static_cast<uint8_t>(job.counter & 0xFF)));
+    }
+}
+
+TEST_F(CryptoWorkerPoolTest, TestFullFlowRejects)
+{
+    // No workers, nothing completes, so the flow fills up
+    CryptoWorkerPool pool(0);
+    auto flow = pool.createFlow([](CryptoJob&) {}, 4);
+
+    for (uint64_t i = 0; i < 4; i++)
+        EXPECT_TRUE(pool.submit(flow, makeJob(CryptoJob::Operation::SEAL, i)));
+    EXPECT_FALSE(pool.submit(flow, makeJob(CryptoJob::Operation::SEAL, 4)));
+
+    CryptoWorkerPool::Stats stats = pool.getStats();
+    EXPECT_EQ(stats.queueDepth, 4u);
+    EXPECT_EQ(stats.rejected, 1u);
+
+    // Queued packets go back to the pool once the pool stops and the flow is gone
+    pool.stop();
+    flow.reset();
+    EXPECT_EQ(packetPool->getStats().slabsInUse, 0u);
+}
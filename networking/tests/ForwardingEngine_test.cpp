@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+#include "ForwardingEngine.hpp"
+#include "Utils.hpp"
+#include <cstring>
+#include <vector>
+
+class ForwardingEngineTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        engine.compile(utils::ipToUint32("10.0.0.1"), utils::ipToUint32("10.0.0.255"));
+        engine.setPeerSlot(utils::ipToUint32("10.0.0.2"), 0);
+        engine.setPeerSlot(utils::ipToUint32("10.0.0.7"), 1);
+    }
+
+    static std::vector<uint8_t> makePacket(const char* dstIp, size_t size = 60)
+    {
+        std::vector<uint8_t> packet(60);
+        packet[0] = 0x45;
+        uint32_t dst = utils::ipToUint32(dstIp);
+        for (int i = 0; i < 4; i++)
+            packet[16 + i] = (dst >> (24 - 8 * i)) & 0xFF;
+        // Truncated packets keep what they had of the header
+        packet.resize(size);
+        return packet;
+    }
+
+    ForwardingEngine::Route classify(const std::vector<uint8_t>& packet) const
+    {
+        return engine.classify(packet.data(), packet.size());
+    }
+
+    ForwardingEngine engine;
+};
+
+TEST_F(ForwardingEngineTest, TestClassifiesByDestination)
+{
+    ForwardingEngine::Route route = classify(makePacket("10.0.0.7"));
+    EXPECT_EQ(route.action, ForwardingEngine::Action::UNICAST);
+    EXPECT_EQ(route.peerSlot, 1);
+    EXPECT_EQ(classify(makePacket("10.0.0.2")).peerSlot, 0);
+
+    EXPECT_EQ(classify(makePacket("10.0.0.1")).action, ForwardingEngine::Action::LOCAL);
+    EXPECT_EQ(classify(makePacket("10.0.0.255")).action, ForwardingEngine::Action::BROADCAST);
+    EXPECT_EQ(classify(makePacket("255.255.255.255")).action, ForwardingEngine::Action::BROADCAST);
+    EXPECT_EQ(classify(makePacket("224.0.0.251")).action, ForwardingEngine::Action::MULTICAST);
+    EXPECT_EQ(classify(makePacket("239.255.255.250")).action, ForwardingEngine::Action::MULTICAST);
+
+    // No peer there, or not our subnet at all
+    EXPECT_EQ(classify(makePacket("10.0.0.3")).action, ForwardingEngine::Action::DROP);
+    EXPECT_EQ(classify(makePacket("10.0.1.2")).action, ForwardingEngine::Action::DROP);
+    EXPECT_EQ(classify(makePacket("8.8.8.8")).action, ForwardingEngine::Action::DROP);
+}
+
+TEST_F(ForwardingEngineTest, TestMalformedHeadersDropped)
+{
+    EXPECT_EQ(engine.classify(nullptr, 0).action, ForwardingEngine::Action::DROP);
+    EXPECT_EQ(classify(makePacket("10.0.0.2", 19)).action, ForwardingEngine::Action::DROP);
+
+    std::vector<uint8_t> ipv6 = makePacket("10.0.0.2");
+    ipv6[0] = 0x60;
+    EXPECT_EQ(classify(ipv6).action, ForwardingEngine::Action::DROP);
+
+    // Header length below the minimum, or past the end of the packet
+    std::vector<uint8_t> shortHeader = makePacket("10.0.0.2");
+    shortHeader[0] = 0x44;
+    EXPECT_EQ(classify(shortHeader).action, ForwardingEngine::Action::DROP);
+    std::vector<uint8_t> longHeader = makePacket("10.0.0.2", 40);
+    longHeader[0] = 0x4F;
+    EXPECT_EQ(classify(longHeader).action, ForwardingEngine::Action::DROP);
+
+    std::vector<uint8_t> withOptions = makePacket("10.0.0.2", 60);
+    withOptions[0] = 0x4F;
+    EXPECT_EQ(classify(withOptions).action, ForwardingEngine::Action::UNICAST);
+}
+
+TEST_F(ForwardingEngineTest, TestClearPeersKeepsSelfAndBroadcast)
+{
+    engine.clearPeers();
+    EXPECT_EQ(classify(makePacket("10.0.0.2")).action, ForwardingEngine::Action::DROP);
+    EXPECT_EQ(classify(makePacket("10.0.0.1")).action, ForwardingEngine::Action::LOCAL);
+    EXPECT_EQ(classify(makePacket("10.0.0.255")).action, ForwardingEngine::Action::BROADCAST);
+
+    // A peer can't take over our own address or the broadcast one
+    engine.setPeerSlot(utils::ipToUint32("10.0.0.1"), 3);
+    engine.setPeerSlot(utils::ipToUint32("10.0.0.255"), 4);
+    EXPECT_EQ(classify(makePacket("10.0.0.1")).action, ForwardingEngine::Action::LOCAL);
+    EXPECT_EQ(classify(makePacket("10.0.0.255")).action, ForwardingEngine::Action::BROADCAST);
+}
+
+TEST_F(ForwardingEngineTest, TestBatchMatchesSinglePackets)
+{
+    auto pool = PacketBufferPool::create();
+    const char* destinations[] = {"10.0.0.2", "10.0.0.7", "10.0.0.9", "10.0.0.255", "224.0.0.1", "1.2.3.4", "10.0.0.1"};
+    std::vector<PacketHandle> packets;
+    std::vector<ForwardingEngine::Route> expected;
+    // More than one chunk, plus an empty handle and a truncated packet
+    for (size_t i = 0; i < 150; i++)
+    {
+        std::vector<uint8_t> bytes = makePacket(destinations[i % 7], i % 11 == 0 ? 12 : 60);
+        expected.push_back(classify(bytes));
+        PacketHandle packet = pool->acquire(bytes.size());
+        std::memcpy(packet.data(), bytes.data(), bytes.size());
+        packets.push_back(std::move(packet));
+    }
+    packets.emplace_back();
+    expected.emplace_back();
+
+    std::vector<ForwardingEngine::Route> routes(packets.size());
+    engine.classifyBatch(packets.data(), packets.size(), routes.data());
+    for (size_t i = 0; i < packets.size(); i++)
+    {
+        EXPECT_EQ(routes[i].action, expected[i].action) << "packet " << i;
+        if (expected[i].action == ForwardingEngine::Action::UNICAST)
+        {
+            EXPECT_EQ(routes[i].peerSlot, expected[i].peerSlot) << "packet " << i;
+        }
+    }
+}
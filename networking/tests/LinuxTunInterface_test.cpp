@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include "LinuxTunInterface.hpp"
+#include "LinuxNetworkConfigManager.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+constexpr const char* DEVICE_NAME = "pbtest0";
+constexpr uint16_t TEST_PORT = 47001;
+
+class LinuxTunInterfaceTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        tun = std::make_unique<LinuxTunInterface>(2);
+        // Creating the device needs /dev/net/tun and CAP_NET_ADMIN, neither is a given on a build machine
+        if (!tun->initialize(DEVICE_NAME))
+            GTEST_SKIP() << "can't create a TUN device here";
+
+        configManager.setNarrowAlias(tun->getNarrowAlias());
+        std::string ipSpace = configManager.getSetupConfig().IP_SPACE;
+        selfIp = ipSpace + "1";
+        peerIp = ipSpace + "2";
+        connectionConfig = {selfIp, {peerIp}};
+        ASSERT_TRUE(configManager.configureInterface(connectionConfig));
+        configured = true;
+    }
+
+    void TearDown() override
+    {
+        if (configured)
+            configManager.resetInterfaceConfiguration(connectionConfig.peerVirtualIps);
+        if (tun)
+            tun->close();
+    }
+
+    // UDP datagram from the peer to us, the way the network side hands it to the device
+    PacketHandle makeDatagram(PacketBufferPool& pool, const std::string& payload)
+    {
+        PacketHandle packet = pool.acquire(28 + payload.size());
+        uint8_t* ip = packet.data();
+        std::memset(ip, 0, 28);
+        ip[0] = 0x45;
+        ip[2] = static_cast<uint8_t>(packet.size() >> 8);
+        ip[3] = static_cast<uint8_t>(packet.size());
+        ip[8] = 64;
+        ip[9] = IPPROTO_UDP;
+        inet_pton(AF_INET, peerIp.c_str(), ip + 12);
+        inet_pton(AF_INET, selfIp.c_str(), ip + 16);
+
+        uint32_t sum = 0;
+        for (size_t i = 0; i < 20; i += 2)
+            sum += (ip[i] << 8) | ip[i + 1];
+        while (sum >> 16)
+            sum = (sum & 0xFFFF) + (sum >> 16);
+        ip[10] = static_cast<uint8_t>(~sum >> 8);
+        ip[11] = static_cast<uint8_t>(~sum);
+
+        // Checksum left at zero, which UDP over IPv4 allows
+        uint8_t* udp = ip + 20;
+        udp[0] = static_cast<uint8_t>(TEST_PORT >> 8);
+        udp[1] = static_cast<uint8_t>(TEST_PORT);
+        udp[2] = static_cast<uint8_t>(TEST_PORT >> 8);
+        udp[3] = static_cast<uint8_t>(TEST_PORT);
+        udp[4] = static_cast<uint8_t>((8 + payload.size()) >> 8);
+        udp[5] = static_cast<uint8_t>(8 + payload.size());
+        std::memcpy(udp + 8, payload.data(), payload.size());
+        return packet;
+    }
+
+    std::unique_ptr<LinuxTunInterface> tun;
+    LinuxNetworkConfigManager configManager;
+    INetworkConfigManager::ConnectionConfig connectionConfig;
+    std::string selfIp;
+    std::string peerIp;
+    bool configured = false;
+};
+}
+
+TEST(LinuxTunInterfaceQueueTest, TestQueueCountIsCapped)
+{
+    EXPECT_EQ(LinuxTunInterface(LinuxTunInterface::MAX_QUEUES * 4).getQueueCount(), LinuxTunInterface::MAX_QUEUES);
+    EXPECT_EQ(LinuxTunInterface(3).getQueueCount(), 3u);
+    EXPECT_GE(LinuxTunInterface(0).getQueueCount(), 1u);
+}
+
+TEST(LinuxTunInterfaceQueueTest, TestSendBeforeStartIsRefused)
+{
+    auto pool = PacketBufferPool::create();
+    LinuxTunInterface tun(1, pool);
+    EXPECT_FALSE(tun.sendPacket(pool->acquire(64)));
+}
+
+TEST_F(LinuxTunInterfaceTest, TestConfiguredDeviceDeliversOutgoingTraffic)
+{
+    std::atomic<size_t> received{0};
+    uint8_t peerAddress[4];
+    inet_pton(AF_INET, peerIp.c_str(), peerAddress);
+    tun->setPacketCallback([&received, &peerAddress](PacketHandle packet)
+    {
+        // The kernel sends its own chatter down the device too, only count ours
+        if (packet.size() >= 20 && std::memcmp(packet.data() + 16, peerAddress, 4) == 0)
+            received++;
+    });
+    ASSERT_TRUE(tun->startPacketProcessing());
+
+    // The route the config manager set up is what takes these to the device
+    int sender = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    ASSERT_GE(sender, 0);
+    sockaddr_in destination{};
+    destination.sin_family = AF_INET;
+    destination.sin_port = htons(TEST_PORT);
+    inet_pton(AF_INET, peerIp.c_str(), &destination.sin_addr);
+    for (int i = 0; i < 10; i++)
+        ::sendto(sender, "hello", 5, 0, reinterpret_cast<sockaddr*>(&destination), sizeof(destination));
+    ::close(sender);
+
+    for (int i = 0; i < 200 && received < 10; i++)
+        std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(received.load(), 10u);
+}
+
+TEST_F(LinuxTunInterfaceTest, TestInjectedPacketReachesLocalSocket)
+{
+    int receiver = ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    ASSERT_GE(receiver, 0);
+    sockaddr_in local{};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(TEST_PORT);
+    inet_pton(AF_INET, selfIp.c_str(), &local.sin_addr);
+    ASSERT_EQ(::bind(receiver, reinterpret_cast<sockaddr*>(&local), sizeof(local)), 0);
+    timeval timeout{1, 0};
+    ::setsockopt(receiver, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    ASSERT_TRUE(tun->startPacketProcessing());
+    auto pool = PacketBufferPool::create();
+    ASSERT_TRUE(tun->sendPacket(makeDatagram(*pool, "from peer")));
+
+    char buffer[64] = {};
+    ssize_t length = ::recv(receiver, buffer, sizeof(buffer), 0);
+    ::close(receiver);
+    ASSERT_EQ(length, 9);
+    EXPECT_EQ(std::string(buffer, length), "from peer");
+}
@@ -0,0 +1,187 @@
+#include <gtest/gtest.h>
+#include "MulticastGroups.hpp"
+#include "Utils.hpp"
+#include <vector>
+
+namespace
+{
+struct Record
+{
+    uint8_t type;
+    const char* group;
+    uint16_t sources;
+};
+
+std::vector<uint8_t> ipv4(uint8_t srcOctet, const char* dst, std::vector<uint8_t> igmp)
+{
+    std::vector<uint8_t> packet(20);
+    packet[0] = 0x45;
+    packet[2] = static_cast<uint8_t>((20 + igmp.size()) >> 8);
+    packet[3] = static_cast<uint8_t>(20 + igmp.size());
+    packet[8] = 1;
+    packet[9] = 2;
+    packet[12] = 10; packet[15] = srcOctet;
+    uint32_t dstIp = utils::ipToUint32(dst);
+    for (int i = 0; i < 4; i++)
+        packet[16 + i] = (dstIp >> (24 - 8 * i)) & 0xFF;
+    packet.insert(packet.end(), igmp.begin(), igmp.end());
+    return packet;
+}
+
+void putAddress(uint8_t* out, const char* address)
+{
+    uint32_t ip = utils::ipToUint32(address);
+    for (int i = 0; i < 4; i++)
+        out[i] = (ip >> (24 - 8 * i)) & 0xFF;
+}
+
+// IGMPv2 report (0x16) / leave (0x17)
+std::vector<uint8_t> v2Message(uint8_t srcOctet, uint8_t type, const char* group)
+{
+    std::vector<uint8_t> igmp(8);
+    igmp[0] = type;
+    putAddress(igmp.data() + 4, group);
+    return ipv4(srcOctet, type == 0x17 ? "224.0.0.2" : group, igmp);
+}
+
+std::vector<uint8_t> v3Report(uint8_t srcOctet, std::vector<Record> records)
+{
+    std::vector<uint8_t> igmp(8);
+    igmp[0] = 0x22;
+    igmp[7] = static_cast<uint8_t>(records.size());
+    for (const Record& record : records)
+    {
+        std::vector<uint8_t> bytes(8 + 4 * record.sources);
+        bytes[0] = record.type;
+        bytes[3] = static_cast<uint8_t>(record.sources);
+        putAddress(bytes.data() + 4, record.group);
+        igmp.insert(igmp.end(), bytes.begin(), bytes.end());
+    }
+    return ipv4(srcOctet, "224.0.0.22", igmp);
+}
+
+const MulticastGroups::Members* membersOf(MulticastGroups& groups, const char* group)
+{
+    MulticastGroups::Group* found = groups.find(utils::ipToUint32(group));
+    return found ? &found->members : nullptr;
+}
+}
+
+TEST(MulticastGroupsTest, TestV2JoinAndLeave)
+{
+    MulticastGroups groups;
+    auto now = MulticastGroups::Clock::now();
+    std::vector<uint8_t> join = v2Message(2, 0x16, "239.255.255.250");
+    ASSERT_TRUE(groups.snoop(join.data(), join.size(), 2, now));
+    join = v2Message(5, 0x16, "239.255.255.250");
+    ASSERT_TRUE(groups.snoop(join.data(), join.size(), 5, now));
+
+    const MulticastGroups::Members* members = membersOf(groups, "239.255.255.250");
+    ASSERT_NE(members, nullptr);
+    EXPECT_EQ(members->count(), 2u);
+    EXPECT_TRUE(members->test(5));
+    EXPECT_EQ(membersOf(groups, "239.1.2.3"), nullptr);
+
+    std::vector<uint8_t> leave = v2Message(2, 0x17, "239.255.255.250");
+    ASSERT_TRUE(groups.snoop(leave.data(), leave.size(), 2, now));
+    EXPECT_FALSE(members->test(2));
+    EXPECT_TRUE(members->test(5));
+}
+
+TEST(MulticastGroupsTest, TestV3Records)
+{
+    MulticastGroups groups;
+    auto now = MulticastGroups::Clock::now();
+    // Exclude-mode join, source-specific join, a BLOCK that changes nothing, a record for a unicast address
+    std::vector<uint8_t> report = v3Report(3, {
+        {4, "239.0.0.1", 0},
+        {5, "232.1.1.1", 2},
+        {6, "239.0.0.1", 1},
+        {2, "10.0.0.9", 0}});
+    ASSERT_TRUE(groups.snoop(report.data(), report.size(), 3, now));
+    EXPECT_TRUE(membersOf(groups, "239.0.0.1")->test(3));
+    EXPECT_TRUE(membersOf(groups, "232.1.1.1")->test(3));
+    EXPECT_EQ(groups.getGroups().size(), 2u);
+
+    // TO_IN with no sources is a leave
+    report = v3Report(3, {{3, "239.0.0.1", 0}});
+    ASSERT_TRUE(groups.snoop(report.data(), report.size(), 3, now));
+    EXPECT_FALSE(membersOf(groups, "239.0.0.1")->test(3));
+}
+
+TEST(MulticastGroupsTest, TestMalformedAndOtherTrafficIgnored)
+{
+    MulticastGroups groups;
+    auto now = MulticastGroups::Clock::now();
+
+    std::vector<uint8_t> udp = v2Message(2, 0x16, "239.0.0.1");
+    udp[9] = 17;
+    EXPECT_FALSE(groups.snoop(udp.data(), udp.size(), 2, now));
+
+    std::vector<uint8_t> truncated = v2Message(2, 0x16, "239.0.0.1");
+    EXPECT_FALSE(groups.snoop(truncated.data(), 24, 2, now));
+
+    // Claims more records than it carries
+    std::vector<uint8_t> report = v3Report(2, {{2, "239.0.0.1", 0}});
+    report[20 + 7] = 3;
+    groups.snoop(report.data(), report.size(), 2, now);
+    report = v3Report(2, {{2, "239.0.0.2", 40}});
+    report.resize(report.size() - 100);
+    groups.snoop(report.data(), report.size(), 2, now);
+    EXPECT_EQ(membersOf(groups, "239.0.0.2"), nullptr);
+}
+
+TEST(MulticastGroupsTest, TestMembershipsExpireAndFollowPeers)
+{
+    MulticastGroups groups;
+    auto now = MulticastGroups::Clock::now();
+    std::vector<uint8_t> join = v2Message(2, 0x16, "239.0.0.1");
+    groups.snoop(join.data(), join.size(), 2, now);
+    join = v2Message(3, 0x16, "239.0.0.1");
+    groups.snoop(join.data(), join.size(), 3, now + std::chrono::seconds(100));
+    join = v2Message(4, 0x16, "239.0.0.1");
+    groups.snoop(join.data(), join.size(), 4, now + std::chrono::seconds(100));
+
+    groups.expire(now + MulticastGroups::MEMBERSHIP_TIMEOUT);
+    const MulticastGroups::Members* members = membersOf(groups, "239.0.0.1");
+    EXPECT_FALSE(members->test(2));
+    EXPECT_TRUE(members->test(3));
+
+    // .4 left the lobby
+    MulticastGroups::Members present;
+    present.set(2);
+    present.set(3);
+    groups.retainOnly(present);
+    EXPECT_TRUE(members->test(3));
+    EXPECT_FALSE(members->test(4));
+}
+
+TEST(MulticastGroupsTest, TestGeneralQueryIsValid)
+{
+    std::vector<uint8_t> query(MulticastGroups::QUERY_SIZE);
+    MulticastGroups::writeGeneralQuery(query.data());
+    EXPECT_TRUE(MulticastGroups::isIgmp(query.data(), query.size()));
+    EXPECT_EQ(query[0], 0x46);
+    EXPECT_EQ(query[8], 1);
+    EXPECT_EQ(query[16], 224);
+    EXPECT_EQ(query[19], 1);
+    EXPECT_EQ(query[24], 0x11);
+
+    // Both checksums come out right: the one's complement sum over each part is all ones
+    auto sum = [&query](size_t start, size_t size)
+    {
+        uint32_t total = 0;
+        for (size_t i = start; i < start + size; i += 2)
+            total += (query[i] << 8) | query[i + 1];
+        while (total >> 16)
+            total = (total & 0xFFFF) + (total >> 16);
+        return total;
+    };
+    EXPECT_EQ(sum(0, 24), 0xFFFFu);
+    EXPECT_EQ(sum(24, 8), 0xFFFFu);
+
+    // A query is IGMP we recognise, but nobody joins anything from it
+    MulticastGroups groups;
+    EXPECT_TRUE(groups.snoop(query.data(), query.size(), 2, MulticastGroups::Clock::now()));
+    EXPECT_TRUE(groups.getGroups().empty());
+}
@@ -38,8 +38,8 @@ protected:
         workGuard = std::make_unique<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>>(
             ioContext->get_executor());
 
-        ON_CALL(*udpNetworkMock, getIOContext())
-            .WillByDefault(::testing::ReturnRef(*ioContext));
+        ON_CALL(*udpNetworkMock, getExecutor())
+            .WillByDefault(::testing::Return(ioContext->get_executor()));
     }
 
     void TearDown() override
@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+#include "PacketBufferPool.hpp"
+#include <thread>
+#include <vector>
+
+class PacketBufferPoolTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        pool = PacketBufferPool::create(4, 1);
+    }
+
+    std::shared_ptr<PacketBufferPool> pool;
+};
+
+TEST_F(PacketBufferPoolTest, TestAcquireSmallPacketUsesSlab)
+{
+    PacketHandle packet = pool->acquire(100);
+    ASSERT_TRUE(packet);
+    EXPECT_EQ(packet.size(), 100u);
+    EXPECT_EQ(packet.capacity(), PacketBufferPool::SLAB_SIZE);
+
+    auto stats = pool->getStats();
+    EXPECT_EQ(stats.slabsInUse, 1u);
+    EXPECT_EQ(stats.misses, 0u);
+}
+
+TEST_F(PacketBufferPoolTest, TestSlabReturnedWhenLastHandleReleased)
+{
+    PacketHandle packet = pool->acquire(100);
+    uint8_t* slabData = packet.data();
+    {
+        PacketHandle copy = packet;
+        packet.reset();
+        EXPECT_EQ(pool->getStats().slabsInUse, 1u);
+    }
+    EXPECT_EQ(pool->getStats().slabsInUse, 0u);
+
+    // LIFO free list, the same slab comes back out
+    PacketHandle again = pool->acquire(10);
+    EXPECT_EQ(again.data(), slabData);
+}
+
+TEST_F(PacketBufferPoolTest, TestMissAllocatesAndHighWaterMarkTracks)
+{
+    std::vector<PacketHandle> packets;
+    for (int i = 0; i < 6; i++)
+    {
+        packets.push_back(pool->acquire(64));
+    }
+
+    auto stats = pool->getStats();
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.slabsAllocated, 6u);
+    EXPECT_EQ(stats.slabsHighWaterMark, 6u);
+
+    packets.clear();
+    stats = pool->getStats();
+    EXPECT_EQ(stats.slabsInUse, 0u);
+    EXPECT_EQ(stats.slabsHighWaterMark, 6u);
+}
+
+TEST_F(PacketBufferPoolTest, TestJumboFallbackAndOversize)
+{
+    PacketHandle jumbo = pool->acquire(PacketBufferPool::SLAB_SIZE + 1);
+    ASSERT_TRUE(jumbo);
+    EXPECT_EQ(jumbo.capacity(), PacketBufferPool::JUMBO_SIZE);
+
+    PacketHandle secondJumbo = pool->acquire(9000);
+    ASSERT_TRUE(secondJumbo);
+    EXPECT_EQ(pool->getStats().jumboMisses, 1u);
+
+    PacketHandle oversize = pool->acquire(PacketBufferPool::JUMBO_SIZE + 1);
+    EXPECT_FALSE(oversize);
+    EXPECT_EQ(pool->getStats().oversizeRequests, 1u);
+
+    // Only one jumbo slab is cached, the extra one is freed
+    jumbo.reset();
+    secondJumbo.reset();
+    EXPECT_EQ(pool->getStats().jumboAllocated, 1u);
+}
+
+TEST_F(PacketBufferPoolTest, TestHandleOutlivesPool)
+{
+    PacketHandle packet = pool->acquire(32);
+    std::weak_ptr<PacketBufferPool> weakPool = pool;
+    pool.reset();
+
+    // The in-flight slab keeps the pool alive
+    EXPECT_FALSE(weakPool.expired());
+    packet.data()[0] = 0xAB;
+    packet.reset();
+    EXPECT_TRUE(weakPool.expired());
+}
+
+TEST_F(PacketBufferPoolTest, TestConcurrentAcquireRelease)
+{
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([this]()
+        {
+            for (int i = 0; i < 10000; i++)
+            {
+                PacketHandle packet = pool->acquire(512);
+                PacketHandle copy = packet;
+                copy.data()[0] = static_cast<uint8_t>(i);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(pool->getStats().slabsInUse, 0u);
+}
+
+TEST_F(PacketBufferPoolTest, TestHeadroomPrependAndTrim)
+{
+    PacketHandle packet = pool->acquire(100, PacketBufferPool::DEFAULT_HEADROOM);
+    ASSERT_TRUE(packet);
+    EXPECT_EQ(packet.size(), 100u);
+    EXPECT_EQ(packet.headroom(), PacketBufferPool::DEFAULT_HEADROOM);
+    EXPECT_EQ(packet.capacity(), PacketBufferPool::SLAB_SIZE - PacketBufferPool::DEFAULT_HEADROOM);
+
+    uint8_t* payload = packet.data();
+    payload[0] = 0x45;
+
+    // Header goes in front, payload doesn't move
+    ASSERT_TRUE(packet.prepend(56));
+    EXPECT_EQ(packet.size(), 156u);
+    EXPECT_EQ(packet.data() + 56, payload);
+    EXPECT_EQ(packet.data()[56], 0x45);
+
+    EXPECT_FALSE(packet.prepend(PacketBufferPool::DEFAULT_HEADROOM));
+    EXPECT_EQ(packet.size(), 156u);
+
+    packet.trimFront(56);
+    EXPECT_EQ(packet.data(), payload);
+    EXPECT_EQ(packet.size(), 100u);
+}
+
+TEST_F(PacketBufferPoolTest, TestHeadroomCountsTowardsSlabSize)
+{
+    // Fits in a slab on its own, but not together with the headroom
+    PacketHandle packet = pool->acquire(PacketBufferPool::SLAB_SIZE - 16, PacketBufferPool::DEFAULT_HEADROOM);
+    ASSERT_TRUE(packet);
+    EXPECT_EQ(pool->getStats().jumboInUse, 1u);
+
+    // Recycled slabs start with the requested headroom again
+    PacketHandle small = pool->acquire(64, 32);
+    small.reset();
+    small = pool->acquire(64);
+    EXPECT_EQ(small.headroom(), 0u);
+}
+
+TEST_F(PacketBufferPoolTest, TestUniqueOwnership)
+{
+    PacketHandle packet = pool->acquire(64);
+    EXPECT_TRUE(packet.unique());
+
+    PacketHandle copy = packet;
+    EXPECT_FALSE(packet.unique());
+    copy.reset();
+    EXPECT_TRUE(packet.unique());
+}
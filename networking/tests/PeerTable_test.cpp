@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include "PeerTable.hpp"
+#include "Utils.hpp"
+#include <set>
+
+namespace
+{
+boost::asio::ip::udp::endpoint makeEndpoint(const char* address, unsigned short port)
+{
+    return {boost::asio::ip::make_address(address), port};
+}
+}
+
+class PeerTableTest : public ::testing::Test
+{
+protected:
+    PeerTable<int> table;
+};
+
+TEST_F(PeerTableTest, TestFindByEndpointAndVirtualIp)
+{
+    ASSERT_NE(table.add(utils::ipToUint32("10.0.0.2"), makeEndpoint("192.168.1.100", 4000), 2), nullptr);
+    ASSERT_NE(table.add(utils::ipToUint32("10.0.0.3"), makeEndpoint("192.168.1.101", 4000), 3), nullptr);
+    EXPECT_EQ(table.size(), 2u);
+
+    ASSERT_NE(table.find(makeEndpoint("192.168.1.101", 4000)), nullptr);
+    EXPECT_EQ(*table.find(makeEndpoint("192.168.1.101", 4000)), 3);
+    ASSERT_NE(table.findByVirtualIp(utils::ipToUint32("10.0.0.2")), nullptr);
+    EXPECT_EQ(*table.findByVirtualIp(utils::ipToUint32("10.0.0.2")), 2);
+
+    EXPECT_EQ(table.find(makeEndpoint("192.168.1.100", 4001)), nullptr);
+    EXPECT_EQ(table.find(makeEndpoint("192.168.1.102", 4000)), nullptr);
+    EXPECT_EQ(table.findByVirtualIp(utils::ipToUint32("10.0.0.4")), nullptr);
+    // Same last octet, other subnet
+    EXPECT_EQ(table.findByVirtualIp(utils::ipToUint32("10.0.1.2")), nullptr);
+}
+
+TEST_F(PeerTableTest, TestSameAddressDifferentPortsKeptApart)
+{
+    table.add(utils::ipToUint32("10.0.0.2"), makeEndpoint("192.168.1.100", 4000), 2);
+    table.add(utils::ipToUint32("10.0.0.3"), makeEndpoint("192.168.1.100", 4001), 3);
+    ASSERT_EQ(table.size(), 2u);
+    EXPECT_EQ(*table.find(makeEndpoint("192.168.1.100", 4000)), 2);
+    EXPECT_EQ(*table.find(makeEndpoint("192.168.1.100", 4001)), 3);
+}
+
+TEST_F(PeerTableTest, TestAddReplacesVirtualIpOrEndpoint)
+{
+    table.add(utils::ipToUint32("10.0.0.2"), makeEndpoint("192.168.1.100", 4000), 2);
+    table.add(utils::ipToUint32("10.0.0.2"), makeEndpoint("192.168.1.100", 5000), 20);
+    ASSERT_EQ(table.size(), 1u);
+    EXPECT_EQ(table.find(makeEndpoint("192.168.1.100", 4000)), nullptr);
+    EXPECT_EQ(*table.findByVirtualIp(utils::ipToUint32("10.0.0.2")), 20);
+
+    table.add(utils::ipToUint32("10.0.0.3"), makeEndpoint("192.168.1.100", 5000), 3);
+    ASSERT_EQ(table.size(), 1u);
+    EXPECT_EQ(table.findByVirtualIp(utils::ipToUint32("10.0.0.2")), nullptr);
+    EXPECT_EQ(*table.find(makeEndpoint("192.168.1.100", 5000)), 3);
+}
+
+TEST_F(PeerTableTest, TestIpv6EndpointRejected)
+{
+    EXPECT_EQ(table.add(utils::ipToUint32("10.0.0.2"), makeEndpoint("::1", 4000), 2), nullptr);
+    EXPECT_TRUE(table.empty());
+    EXPECT_EQ(table.find(makeEndpoint("::1", 4000)), nullptr);
+}
+
+TEST_F(PeerTableTest, TestRemoveKeepsTheOthersFindable)
+{
+    // Full /24, removing from the middle moves the last entry and rebuilds the endpoint index
+    for (int octet = 0; octet < 256; octet++)
+    {
+        std::string virtualIp = "10.0.0." + std::to_string(octet);
+        ASSERT_NE(table.add(utils::ipToUint32(virtualIp), makeEndpoint("203.0.113.7", 20000 + octet), octet), nullptr);
+    }
+    ASSERT_EQ(table.size(), 256u);
+
+    for (int octet = 0; octet < 256; octet += 3)
+        EXPECT_TRUE(table.remove(makeEndpoint("203.0.113.7", 20000 + octet)));
+    EXPECT_FALSE(table.remove(makeEndpoint("203.0.113.7", 20000)));
+
+    std::set<int> iterated;
+    for (const auto& entry : table)
+        iterated.insert(entry.peer);
+    EXPECT_EQ(iterated.size(), table.size());
+
+    for (int octet = 0; octet < 256; octet++)
+    {
+        std::string virtualIp = "10.0.0." + std::to_string(octet);
+        const int* byEndpoint = table.find(makeEndpoint("203.0.113.7", 20000 + octet));
+        const int* byVirtualIp = table.findByVirtualIp(utils::ipToUint32(virtualIp));
+        if (octet % 3 == 0)
+        {
+            EXPECT_EQ(byEndpoint, nullptr) << octet;
+            EXPECT_EQ(byVirtualIp, nullptr) << octet;
+        }
+        else
+        {
+            ASSERT_NE(byEndpoint, nullptr) << octet;
+            EXPECT_EQ(*byEndpoint, octet);
+            EXPECT_EQ(byVirtualIp, byEndpoint);
+        }
+    }
+}
+
+TEST_F(PeerTableTest, TestClear)
+{
+    table.add(utils::ipToUint32("10.0.0.2"), makeEndpoint("192.168.1.100", 4000), 2);
+    table.clear();
+    EXPECT_TRUE(table.empty());
+    EXPECT_EQ(table.find(makeEndpoint("192.168.1.100", 4000)), nullptr);
+    EXPECT_EQ(table.findByVirtualIp(utils::ipToUint32("10.0.0.2")), nullptr);
+}
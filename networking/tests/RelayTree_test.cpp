@@ -0,0 +1,104 @@
+#include <gtest/gtest.h>
+#include "RelayTree.hpp"
+#include <map>
+#include <vector>
+
+namespace
+{
+std::vector<RelayTree::Member> makeMembers(size_t count)
+{
+    std::vector<RelayTree::Member> members;
+    for (size_t i = 0; i < count; i++)
+        members.push_back({static_cast<uint8_t>(i + 2), std::chrono::microseconds(0)});
+    return members;
+}
+
+// Walks the encoded tree from the source, counting how often and at what depth each member is reached
+void walk(const RelayTree& tree, std::map<uint8_t, int>& reached, std::map<uint8_t, size_t>& depth)
+{
+    std::vector<uint8_t> encoded(tree.encodedSize());
+    tree.encode(encoded.data());
+    ASSERT_EQ(RelayTree::parse(encoded.data(), encoded.size()), encoded.size());
+
+    uint8_t children[RelayTree::MAX_FANOUT];
+    std::vector<std::pair<uint8_t, size_t>> pending;
+    size_t count = tree.rootChildren(children);
+    for (size_t i = 0; i < count; i++)
+        pending.push_back({children[i], 1});
+    while (!pending.empty())
+    {
+        auto [octet, hops] = pending.back();
+        pending.pop_back();
+        reached[octet]++;
+        depth[octet] = hops;
+        count = RelayTree::childrenOf(encoded.data(), octet, children);
+        for (size_t i = 0; i < count; i++)
+            pending.push_back({children[i], hops + 1});
+    }
+}
+}
+
+TEST(RelayTreeTest, TestEveryMemberReachedOnce)
+{
+    for (size_t members : {1, 3, 8, 32, 64, 255})
+    {
+        for (size_t fanout : {1, 2, 4, 16})
+        {
+            RelayTree tree;
+            tree.build(makeMembers(members), fanout);
+            std::map<uint8_t, int> reached;
+            std::map<uint8_t, size_t> depth;
+            walk(tree, reached, depth);
+
+            ASSERT_EQ(reached.size(), members) << members << " members, fan-out " << fanout;
+            size_t deepest = 0;
+            for (const auto& [octet, times] : reached)
+            {
+                EXPECT_EQ(times, 1) << "octet " << static_cast<int>(octet);
+                deepest = std::max(deepest, depth[octet]);
+            }
+            EXPECT_EQ(deepest, RelayTree::depth(members, fanout));
+        }
+    }
+}
+
+TEST(RelayTreeTest, TestLowRttPeersRelay)
+{
+    // .5 and .3 are close, .2 is far, .4 hasn't been measured yet
+    std::vector<RelayTree::Member> members = {
+        {2, std::chrono::microseconds(90000)},
+        {3, std::chrono::microseconds(2000)},
+        {4, std::chrono::microseconds(0)},
+        {5, std::chrono::microseconds(1000)}};
+    RelayTree tree;
+    tree.build(members, 1);
+
+    uint8_t children[RelayTree::MAX_FANOUT];
+    ASSERT_EQ(tree.rootChildren(children), 1u);
+    EXPECT_EQ(children[0], 5);
+
+    std::vector<uint8_t> encoded(tree.encodedSize());
+    tree.encode(encoded.data());
+    EXPECT_EQ(encoded, (std::vector<uint8_t>{1, 4, 5, 3, 2, 4}));
+    ASSERT_EQ(RelayTree::childrenOf(encoded.data(), 5, children), 1u);
+    EXPECT_EQ(children[0], 3);
+    EXPECT_EQ(RelayTree::childrenOf(encoded.data(), 4, children), 0u);
+    // Not in the tree at all
+    EXPECT_EQ(RelayTree::childrenOf(encoded.data(), 9, children), 0u);
+}
+
+TEST(RelayTreeTest, TestMalformedTreesRejected)
+{
+    uint8_t noFanout[] = {0, 2, 3, 4};
+    uint8_t fanoutTooWide[] = {17, 2, 3, 4};
+    uint8_t empty[] = {2, 0};
+    uint8_t truncated[] = {2, 3, 3, 4};
+    EXPECT_EQ(RelayTree::parse(noFanout, sizeof(noFanout)), 0u);
+    EXPECT_EQ(RelayTree::parse(fanoutTooWide, sizeof(fanoutTooWide)), 0u);
+    EXPECT_EQ(RelayTree::parse(empty, sizeof(empty)), 0u);
+    EXPECT_EQ(RelayTree::parse(truncated, sizeof(truncated)), 0u);
+    EXPECT_EQ(RelayTree::parse(truncated, 1), 0u);
+
+    uint8_t valid[] = {2, 2, 3, 4, 0xAA};
+    EXPECT_EQ(RelayTree::parse(valid, sizeof(valid)), 4u);
+}
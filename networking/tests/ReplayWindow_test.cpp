@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include "ReplayWindow.hpp"
+
+class ReplayWindowTest : public ::testing::Test
+{
+protected:
+    // What the receive path does: check, authenticate, update
+    bool accept(uint64_t counter)
+    {
+        if (!window.check(counter))
+            return false;
+        window.update(counter);
+        return true;
+    }
+
+    ReplayWindow window;
+};
+
+TEST_F(ReplayWindowTest, TestInOrderAcceptedOnce)
+{
+    for (uint64_t counter = 0; counter < 5000; counter++)
+    {
+        EXPECT_TRUE(accept(counter));
+        EXPECT_FALSE(accept(counter));
+    }
+    EXPECT_EQ(window.getHighest(), 4999u);
+}
+
+TEST_F(ReplayWindowTest, TestReorderedWithinWindowAccepted)
+{
+    EXPECT_TRUE(accept(100));
+    EXPECT_TRUE(accept(98));
+    EXPECT_TRUE(accept(99));
+    EXPECT_TRUE(accept(97));
+    EXPECT_FALSE(accept(98));
+    EXPECT_FALSE(accept(100));
+    EXPECT_EQ(window.getHighest(), 100u);
+}
+
+TEST_F(ReplayWindowTest, TestTooOldRejected)
+{
+    EXPECT_TRUE(accept(10000));
+    EXPECT_TRUE(accept(10000 - ReplayWindow::MAX_REORDER + 1));
+    EXPECT_FALSE(accept(10000 - ReplayWindow::MAX_REORDER));
+    EXPECT_FALSE(accept(0));
+}
+
+TEST_F(ReplayWindowTest, TestJumpClearsStaleBits)
+{
+    EXPECT_TRUE(accept(5));
+    // Lands on the same bitmap slot as 5, must not look like a replay
+    EXPECT_TRUE(accept(5 + ReplayWindow::WINDOW_BITS));
+    EXPECT_TRUE(accept(5 + 3 * ReplayWindow::WINDOW_BITS + 64));
+    EXPECT_FALSE(accept(5 + 3 * ReplayWindow::WINDOW_BITS + 64));
+}
+
+TEST_F(ReplayWindowTest, TestCheckDoesNotMark)
+{
+    // A packet that fails authentication is checked but never updated
+    EXPECT_TRUE(window.check(7));
+    EXPECT_TRUE(window.check(7));
+    EXPECT_TRUE(accept(7));
+}
+
+TEST_F(ReplayWindowTest, TestResetStartsNewSession)
+{
+    EXPECT_TRUE(accept(5000));
+    window.reset();
+    EXPECT_TRUE(accept(0));
+    EXPECT_TRUE(accept(1));
+    EXPECT_FALSE(accept(0));
+}
+
+TEST_F(ReplayWindowTest, TestRecentBitmap)
+{
+    EXPECT_EQ(window.getRecentBitmap(), 0u);
+    accept(100);
+    accept(99);
+    accept(97);
+    accept(36);
+    // Bit i = highest - 1 - i, 36 is exactly 64 below
+    EXPECT_EQ(window.getRecentBitmap(), (1ull << 0) | (1ull << 2) | (1ull << 63));
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include "SendScheduler.hpp"
+#include <cstring>
+#include <map>
+
+namespace
+{
+constexpr size_t SMALL_BYTES = 256;
+
+// UDP or TCP from 10.0.0.1:srcPort to 10.0.0.2:dstPort, `size` bytes of IP, `tag` after the transport header
+PacketHandle makePacket(PacketBufferPool& pool, size_t size, uint16_t srcPort, uint16_t dstPort, uint8_t tag,
+    uint8_t protocol = 17, uint8_t dscp = 0)
+{
+    PacketHandle packet = pool.acquire(size);
+    uint8_t* ip = packet.data();
+    std::memset(ip, 0, size);
+    ip[0] = 0x45;
+    ip[1] = static_cast<uint8_t>(dscp << 2);
+    ip[2] = static_cast<uint8_t>(size >> 8);
+    ip[3] = static_cast<uint8_t>(size);
+    ip[9] = protocol;
+    ip[12] = 10; ip[15] = 1;
+    ip[16] = 10; ip[19] = 2;
+    ip[20] = static_cast<uint8_t>(srcPort >> 8); ip[21] = static_cast<uint8_t>(srcPort);
+    ip[22] = static_cast<uint8_t>(dstPort >> 8); ip[23] = static_cast<uint8_t>(dstPort);
+    if (protocol == 6)
+        ip[32] = 5 << 4;
+    size_t tagAt = protocol == 6 ? 40 : 28;
+    if (tagAt < size)
+        ip[tagAt] = tag;
+    return packet;
+}
+
+uint16_t sourcePortOf(const PacketHandle& packet)
+{
+    return static_cast<uint16_t>((packet.data()[20] << 8) | packet.data()[21]);
+}
+}
+
+TEST(SendSchedulerTest, TestGameTrafficOvertakesBulk)
+{
+    auto pool = PacketBufferPool::create();
+    SendScheduler scheduler;
+    PortPriorities ports = {{27015, PortPriority::GAME}};
+
+    // A download's worth of full-size TCP segments, then a large game packet, a small UDP packet,
+    // an EF-marked one and a bare ack
+    for (uint8_t i = 0; i < 20; i++)
+        scheduler.enqueue(makePacket(*pool, 1400, 40000, 443, i, 6), ports, SMALL_BYTES);
+    scheduler.enqueue(makePacket(*pool, 1200, 50000, 27015, 1), ports, SMALL_BYTES);
+    scheduler.enqueue(makePacket(*pool, 120, 50001, 7777, 2), ports, SMALL_BYTES);
+    scheduler.enqueue(makePacket(*pool, 900, 50002, 5060, 3, 17, 46), ports, SMALL_BYTES);
+    scheduler.enqueue(makePacket(*pool, 40, 40000, 443, 4, 6), ports, SMALL_BYTES);
+    EXPECT_EQ(scheduler.size(), 24u);
+
+    std::vector<uint16_t> order;
+    for (int i = 0; i < 4; i++)
+        order.push_back(sourcePortOf(scheduler.dequeue()));
+    EXPECT_EQ(order, (std::vector<uint16_t>{50000, 50001, 50002, 40000}));
+    EXPECT_EQ(scheduler.getStats().priority, 4u);
+
+    // Then the download, in order
+    for (uint8_t i = 0; i < 20; i++)
+    {
+        PacketHandle packet = scheduler.dequeue();
+        ASSERT_TRUE(packet);
+        EXPECT_EQ(packet.data()[40], i);
+    }
+    EXPECT_TRUE(scheduler.empty());
+    EXPECT_FALSE(scheduler.dequeue());
+}
+
+TEST(SendSchedulerTest, TestFlowsShareByBytes)
+{
+    auto pool = PacketBufferPool::create();
+    SendScheduler scheduler;
+    // No small packet rule, so the 300 byte flow is just another flow
+    PortPriorities ports = {{6000, PortPriority::BULK}};
+    for (uint8_t i = 0; i < 40; i++)
+    {
+        scheduler.enqueue(makePacket(*pool, 1500, 5000, 80, i), ports, 0);
+        for (int j = 0; j < 5; j++)
+            scheduler.enqueue(makePacket(*pool, 300, 5001, 80, i), ports, 0);
+        scheduler.enqueue(makePacket(*pool, 1500, 6000, 80, i), ports, 0);
+    }
+
+    // While all three are backlogged: a packet of the big flow per round, five of the small one,
+    // and the bulk flow a quarter of the big one's bytes
+    std::map<uint16_t, size_t> bytes;
+    for (int i = 0; i < 150; i++)
+    {
+        PacketHandle packet = scheduler.dequeue();
+        bytes[sourcePortOf(packet)] += packet.size();
+    }
+    EXPECT_NEAR(static_cast<double>(bytes[5001]) / static_cast<double>(bytes[5000]), 1.0, 0.25);
+    EXPECT_NEAR(static_cast<double>(bytes[6000]) / static_cast<double>(bytes[5000]), 0.25, 0.1);
+}
+
+TEST(SendSchedulerTest, TestFullQueueDropsFromFattestFlow)
+{
+    auto pool = PacketBufferPool::create();
+    SendScheduler scheduler;
+    PortPriorities ports;
+    scheduler.enqueue(makePacket(*pool, 1000, 7000, 80, 0), ports, 0);
+    for (size_t i = 0; i < SendScheduler::MAX_PACKETS; i++)
+        scheduler.enqueue(makePacket(*pool, 1400, 8000, 80, static_cast<uint8_t>(i)), ports, 0);
+
+    EXPECT_EQ(scheduler.size(), SendScheduler::MAX_PACKETS);
+    EXPECT_EQ(scheduler.getStats().dropped, 1u);
+    EXPECT_EQ(scheduler.getStats().droppedBytes, 1400u);
+
+    // The light flow kept its packet, the heavy one lost its oldest
+    bool sawLight = false;
+    PacketHandle first;
+    while (PacketHandle packet = scheduler.dequeue())
+    {
+        if (sourcePortOf(packet) == 7000)
+            sawLight = true;
+        else if (!first)
+            first = packet;
+    }
+    EXPECT_TRUE(sawLight);
+    ASSERT_TRUE(first);
+    EXPECT_EQ(first.data()[28], 1);
+}
+
+TEST(SendSchedulerTest, TestPriorityFloodCannotStarveFlows)
+{
+    auto pool = PacketBufferPool::create();
+    SendScheduler scheduler;
+    PortPriorities ports;
+    scheduler.enqueue(makePacket(*pool, 1400, 9000, 80, 0), ports, SMALL_BYTES);
+    for (size_t i = 0; i < SendScheduler::PRIORITY_LIMIT; i++)
+        scheduler.enqueue(makePacket(*pool, 100, 9001, 80, 0, 17, 46), ports, SMALL_BYTES);
+
+    size_t position = 0;
+    while (PacketHandle packet = scheduler.dequeue())
+    {
+        if (sourcePortOf(packet) == 9000)
+            break;
+        position++;
+    }
+    EXPECT_EQ(position, SendScheduler::PRIORITY_BURST);
+}
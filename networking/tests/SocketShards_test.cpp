@@ -0,0 +1,188 @@
+#include <gtest/gtest.h>
+#include "SocketShards.hpp"
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+using ReusePort = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+
+class SocketShardsTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        pool = PacketBufferPool::create();
+        primary = std::make_unique<boost::asio::ip::udp::socket>(ioContext);
+        primary->open(boost::asio::ip::udp::v4());
+        primary->set_option(ReusePort(true));
+        primary->bind(boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+        primary->non_blocking(true);
+    }
+
+    SocketShards::Parameters shardParameters(size_t shards)
+    {
+        SocketShards::Parameters parameters;
+        parameters.shards = shards;
+        // Shares the machine with the other tests
+        parameters.pinThreads = false;
+        return parameters;
+    }
+
+    // Datagrams shard 0 got, that's the caller's socket so the test reads it itself
+    size_t drainPrimary()
+    {
+        std::array<uint8_t, 2048> buffer;
+        boost::asio::ip::udp::endpoint sender;
+        boost::system::error_code error;
+        size_t count = 0;
+        while (primary->receive_from(boost::asio::buffer(buffer), sender, 0, error) > 0 && !error)
+            count++;
+        return count;
+    }
+
+    boost::asio::io_context ioContext;
+    std::shared_ptr<PacketBufferPool> pool;
+    std::unique_ptr<boost::asio::ip::udp::socket> primary;
+};
+}
+
+TEST_F(SocketShardsTest, TestSteeredSendersLandOnTheirShard)
+{
+    constexpr size_t SHARDS = 4;
+    auto shards = SocketShards::create(*primary, pool, shardParameters(SHARDS));
+    ASSERT_TRUE(shards);
+    if (!shards->isSteered())
+        GTEST_SKIP() << "kernel refused the steering program";
+
+    std::mutex mutex;
+    std::vector<std::pair<size_t, boost::asio::ip::udp::endpoint>> arrivals;
+    shards->start([&](size_t shard, std::vector<SocketShards::Datagram>& batch)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& datagram : batch)
+        {
+            EXPECT_EQ(datagram.packet.size(), 32u);
+            arrivals.emplace_back(shard, datagram.sender);
+        }
+    });
+
+    // Senders on different ports, every shard should get someone
+    std::vector<std::unique_ptr<boost::asio::ip::udp::socket>> senders;
+    std::vector<size_t> expected(SHARDS, 0);
+    for (int i = 0; i < 32; i++)
+    {
+        senders.push_back(std::make_unique<boost::asio::ip::udp::socket>(
+            ioContext, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0)));
+        std::array<uint8_t, 32> datagram{};
+        for (int repeat = 0; repeat < 4; repeat++)
+            senders.back()->send_to(boost::asio::buffer(datagram), primary->local_endpoint());
+        expected[SocketShards::shardFor(senders.back()->local_endpoint(), SHARDS)] += 4;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    size_t onPrimary = 0;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        onPrimary += drainPrimary();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (onPrimary + arrivals.size() == 128)
+            break;
+        std::this_thread::sleep_for(1ms);
+    }
+    shards->stop();
+
+    EXPECT_EQ(onPrimary, expected[0]);
+    for (const auto& arrival : arrivals)
+        EXPECT_EQ(arrival.first, SocketShards::shardFor(arrival.second, SHARDS));
+    std::vector<uint64_t> counts = shards->getReceiveCounts();
+    for (size_t i = 1; i < SHARDS; i++)
+    {
+        EXPECT_GT(expected[i], 0u);
+        EXPECT_EQ(counts[i], expected[i]);
+    }
+}
+
+TEST_F(SocketShardsTest, TestPortWithoutReusePortIsNotShared)
+{
+    boost::asio::ip::udp::socket exclusive(ioContext, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    EXPECT_FALSE(SocketShards::create(exclusive, pool, shardParameters(2)));
+
+    // Nothing bound yet, there's no port to share
+    boost::asio::ip::udp::socket unbound(ioContext);
+    unbound.open(boost::asio::ip::udp::v4());
+    EXPECT_FALSE(SocketShards::create(unbound, pool, shardParameters(2)));
+}
+
+TEST_F(SocketShardsTest, TestStopHandsEveryBufferBack)
+{
+    auto shards = SocketShards::create(*primary, pool, shardParameters(3));
+    ASSERT_TRUE(shards);
+    std::atomic<size_t> kept{0};
+    std::vector<PacketHandle> held;
+    std::mutex mutex;
+    shards->start([&](size_t, std::vector<SocketShards::Datagram>& batch)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& datagram : batch)
+            held.push_back(std::move(datagram.packet));
+        kept += batch.size();
+    });
+
+    boost::asio::ip::udp::socket sender(ioContext, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    std::array<uint8_t, 16> datagram{};
+    for (int i = 0; i < 20; i++)
+        sender.send_to(boost::asio::buffer(datagram), primary->local_endpoint());
+    std::this_thread::sleep_for(50ms);
+    shards->stop();
+    shards.reset();
+
+    // Only what the handler took is still out
+    EXPECT_EQ(pool->getStats().slabsInUse, kept.load());
+    held.clear();
+    EXPECT_EQ(pool->getStats().slabsInUse, 0u);
+}
+
+TEST_F(SocketShardsTest, TestOversizedDatagramIsCountedAndDropped)
+{
+    constexpr size_t SHARDS = 2;
+    auto shards = SocketShards::create(*primary, pool, shardParameters(SHARDS));
+    ASSERT_TRUE(shards);
+    if (!shards->isSteered())
+        GTEST_SKIP() << "kernel refused the steering program";
+
+    std::atomic<size_t> delivered{0};
+    shards->start([&](size_t, std::vector<SocketShards::Datagram>& batch)
+    {
+        for (const auto& datagram : batch)
+        {
+            EXPECT_EQ(datagram.packet.size(), 32u);
+            delivered++;
+        }
+    });
+
+    // A sender the steering puts on shard 1, the other one is the caller's socket
+    std::unique_ptr<boost::asio::ip::udp::socket> sender;
+    while (!sender || SocketShards::shardFor(sender->local_endpoint(), SHARDS) != 1)
+    {
+        sender = std::make_unique<boost::asio::ip::udp::socket>(
+            ioContext, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    }
+    std::vector<uint8_t> oversized(PacketBufferPool::SLAB_SIZE + 1000);
+    std::array<uint8_t, 32> small{};
+    sender->send_to(boost::asio::buffer(oversized), primary->local_endpoint());
+    sender->send_to(boost::asio::buffer(small), primary->local_endpoint());
+
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (delivered == 0 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(1ms);
+    shards->stop();
+
+    EXPECT_EQ(delivered.load(), 1u);
+    EXPECT_EQ(shards->getTruncatedCount(), 1u);
+    EXPECT_EQ(shards->getReceiveCounts()[1], 2u);
+}
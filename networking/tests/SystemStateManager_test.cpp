@@ -1,6 +1,6 @@
 #include <gtest/gtest.h>
 #include "SystemStateManager.hpp"
-#include "Logger.hpp"
+#include "logger.hpp"
 
 class SystemStateManagerTest : public ::testing::Test
 {
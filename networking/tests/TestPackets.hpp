@@ -0,0 +1,20 @@
+#pragma once
+
+#include "PacketBufferPool.hpp"
+#include <cstring>
+
+// Queue tests tell packets apart by an id written into their first bytes
+inline PacketHandle makePacket(PacketBufferPool& pool, uint32_t id, size_t size = 100)
+{
+    PacketHandle packet = pool.acquire(size);
+    std::memset(packet.data(), 0, packet.size());
+    std::memcpy(packet.data(), &id, sizeof(id));
+    return packet;
+}
+
+inline uint32_t idOf(const PacketHandle& packet)
+{
+    uint32_t id;
+    std::memcpy(&id, packet.data(), sizeof(id));
+    return id;
+}
@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+#include "TunWriteQueue.hpp"
+#include "TestPackets.hpp"
+#include <thread>
+
+using namespace std::chrono_literals;
+
+TEST(TunWriteQueueTest, TestIdleWriterIsWokenInOrder)
+{
+    auto pool = PacketBufferPool::create();
+    TunWriteQueue queue;
+    queue.start();
+
+    std::vector<uint32_t> written;
+    std::thread writer([&queue, &written]()
+    {
+        std::vector<PacketHandle> batch;
+        while (queue.takeBatch(batch, 16))
+        {
+            for (const PacketHandle& packet : batch)
+                written.push_back(idOf(packet));
+            batch.clear();
+        }
+    });
+
+    // Bursts with gaps, so the writer parks in between and has to be woken
+    uint32_t next = 0;
+    for (int burst = 0; burst < 20; burst++)
+    {
+        for (int i = 0; i < 50; i++)
+            queue.push(makePacket(*pool, next++));
+        std::this_thread::sleep_for(1ms);
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (queue.getStats().dequeued < next && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(1ms);
+    queue.stop();
+    writer.join();
+
+    ASSERT_EQ(written.size(), next);
+    for (uint32_t i = 0; i < next; i++)
+        EXPECT_EQ(written[i], i);
+    CoDelQueue::Stats stats = queue.getStats();
+    EXPECT_EQ(stats.enqueued, next);
+    EXPECT_EQ(stats.depth, 0u);
+}
+
+TEST(TunWriteQueueTest, TestFullQueueDropsOldestAndCountsIt)
+{
+    auto pool = PacketBufferPool::create();
+    CoDelQueue::Parameters parameters;
+    parameters.limit = 4;
+    TunWriteQueue queue(parameters);
+    queue.start();
+
+    // No writer yet: the ring fills and the senders push the oldest out, never waiting
+    for (uint32_t i = 0; i < 10; i++)
+        queue.push(makePacket(*pool, i));
+    CoDelQueue::Stats stats = queue.getStats();
+    EXPECT_EQ(stats.enqueued, 10u);
+    EXPECT_EQ(stats.overflowDrops, 6u);
+    EXPECT_EQ(stats.droppedBytes, 600u);
+    EXPECT_EQ(stats.depth, 4u);
+
+    std::vector<PacketHandle> batch;
+    ASSERT_TRUE(queue.takeBatch(batch, 16));
+    ASSERT_EQ(batch.size(), 4u);
+    for (uint32_t i = 0; i < 4; i++)
+        EXPECT_EQ(idOf(batch[i]), 6 + i);
+    EXPECT_EQ(queue.getStats().dequeued, 4u);
+}
+
+TEST(TunWriteQueueTest, TestLimitCoversRingAndCoDelQueueTogether)
+{
+    auto pool = PacketBufferPool::create();
+    CoDelQueue::Parameters parameters;
+    parameters.limit = 4;
+    TunWriteQueue queue(parameters);
+    queue.start();
+
+    // The writer moves all four into its CoDel queue and takes one
+    for (uint32_t i = 0; i < 4; i++)
+        queue.push(makePacket(*pool, i));
+    std::vector<PacketHandle> batch;
+    ASSERT_TRUE(queue.takeBatch(batch, 1));
+    ASSERT_EQ(batch.size(), 1u);
+    batch.clear();
+
+    // One more fits, after that the newest in the ring keeps being replaced
+    for (uint32_t i = 4; i < 10; i++)
+        queue.push(makePacket(*pool, i));
+    CoDelQueue::Stats stats = queue.getStats();
+    EXPECT_EQ(stats.depth, 4u);
+    EXPECT_EQ(stats.overflowDrops, 5u);
+    EXPECT_EQ(pool->getStats().slabsInUse, 4u);
+
+    ASSERT_TRUE(queue.takeBatch(batch, 16));
+    ASSERT_EQ(batch.size(), 4u);
+    EXPECT_EQ(idOf(batch[0]), 1u);
+    EXPECT_EQ(idOf(batch[1]), 2u);
+    EXPECT_EQ(idOf(batch[2]), 3u);
+    EXPECT_EQ(idOf(batch[3]), 9u);
+    EXPECT_EQ(queue.getStats().depth, 0u);
+}
+
+TEST(TunWriteQueueTest, TestStopReleasesWriterAndClearDiscards)
+{
+    auto pool = PacketBufferPool::create();
+    TunWriteQueue queue;
+    queue.start();
+
+    std::atomic<bool> returned{false};
+    std::thread writer([&queue, &returned]()
+    {
+        std::vector<PacketHandle> batch;
+        EXPECT_FALSE(queue.takeBatch(batch, 16));
+        returned = true;
+    });
+    std::this_thread::sleep_for(20ms);
+    EXPECT_FALSE(returned);
+    queue.stop();
+    writer.join();
+
+    // Stopped: nothing comes out, what was queued is thrown away by clear()
+    queue.push(makePacket(*pool, 1));
+    queue.push(makePacket(*pool, 2));
+    std::vector<PacketHandle> batch;
+    EXPECT_FALSE(queue.takeBatch(batch, 16));
+    EXPECT_EQ(queue.clear(), 2u);
+    EXPECT_EQ(pool->getStats().slabsInUse, 0u);
+
+    // And it runs again after a restart
+    queue.start();
+    queue.push(makePacket(*pool, 3));
+    ASSERT_TRUE(queue.takeBatch(batch, 16));
+    EXPECT_EQ(idOf(batch[0]), 3u);
+}
+
+TEST(TunWriteQueueTest, TestBusyPollingWriterTakesPacketsWithoutParking)
+{
+    auto pool = PacketBufferPool::create();
+    // Long enough that the writer is still spinning when the packet comes
+    TunWriteQueue queue(CoDelQueue::Parameters(), 500ms);
+    queue.start();
+
+    std::vector<PacketHandle> batch;
+    std::atomic<bool> writing{false};
+    std::thread writer([&queue, &batch, &writing]()
+    {
+        writing = true;
+        EXPECT_TRUE(queue.takeBatch(batch, 16));
+    });
+    while (!writing)
+        std::this_thread::yield();
+    std::this_thread::sleep_for(5ms);
+    queue.push(makePacket(*pool, 7));
+    writer.join();
+
+    ASSERT_EQ(batch.size(), 1u);
+    EXPECT_EQ(idOf(batch[0]), 7u);
+    BusyPoller::Stats stats = queue.getBusyPollStats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 0u);
+    queue.stop();
+}
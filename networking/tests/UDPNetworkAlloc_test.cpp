@@ -0,0 +1,112 @@
+#define PB_UNIT_TESTING 1
+#include <gtest/gtest.h>
+#include <boost/asio.hpp>
+#include <cstring>
+#include "AllocationCounter.hpp"
+#include "NetworkingModule.hpp"
+#include "Utils.hpp"
+#ifdef _WIN32
+#include "NetworkConfigManager.hpp"
+#else
+#include "LinuxNetworkConfigManager.hpp"
+#endif
+
+// Built into PeerBridgeNet_alloc_tests, where AllocationCounter replaces the global allocator
+class UDPNetworkAllocationTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        auto socket = std::make_unique<boost::asio::ip::udp::socket>(ioContext);
+        socket->open(boost::asio::ip::udp::v4());
+        stateManager = std::make_shared<SystemStateManager>();
+        #ifdef _WIN32
+        networkConfigManager = std::make_shared<NetworkConfigManager>();
+        #else
+        networkConfigManager = std::make_shared<LinuxNetworkConfigManager>();
+        #endif
+        udpNetwork = std::make_unique<UDPNetwork>(std::move(socket), ioContext, stateManager, networkConfigManager);
+    }
+
+    boost::asio::io_context ioContext;
+    std::shared_ptr<SystemStateManager> stateManager;
+    std::shared_ptr<INetworkConfigManager> networkConfigManager;
+    std::unique_ptr<UDPNetwork> udpNetwork;
+};
+
+TEST_F(UDPNetworkAllocationTest, TestReceivePathDoesNotAllocatePerPacket)
+{
+    // The test plays the peer, sending from a real socket
+    boost::asio::ip::udp::socket peerSocket(ioContext, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    boost::asio::ip::udp::endpoint peerEndpoint = peerSocket.local_endpoint();
+
+    uint32_t selfIp = utils::ipToUint32("10.0.0.1");
+    uint32_t peerVirt = utils::ipToUint32("10.0.0.2");
+    std::array<uint8_t, crypto_box_PUBLICKEYBYTES> selfPub{}, peerPub{};
+    std::array<uint8_t, crypto_box_SECRETKEYBYTES> selfSec{}, peerSec{};
+    crypto_box_keypair(selfPub.data(), selfSec.data());
+    crypto_box_keypair(peerPub.data(), peerSec.data());
+
+    std::map<uint32_t, std::pair<std::pair<std::uint32_t, int>, std::array<uint8_t, crypto_box_PUBLICKEYBYTES>>> peerMap;
+    peerMap[peerVirt] = {{utils::ipToUint32("127.0.0.1"), peerEndpoint.port()}, peerPub};
+    ASSERT_TRUE(udpNetwork->startConnection(selfIp, selfSec, peerMap));
+    udpNetwork->testSetRunning(true);
+
+    std::array<uint8_t, crypto_box_BEFORENMBYTES> peerKey{};
+    ASSERT_EQ(crypto_box_beforenm(peerKey.data(), selfPub.data(), peerSec.data()), 0);
+
+    size_t delivered = 0;
+    udpNetwork->setMessageCallback([&delivered](PacketHandle packet)
+    {
+        if (packet.size() == 60 && packet.data()[0] == 0x45)
+            delivered++;
+    });
+
+    constexpr size_t HEADER = 16;
+    constexpr size_t OVERHEAD = HEADER + crypto_box_NONCEBYTES + crypto_box_MACBYTES;
+    auto pool = udpNetwork->getPacketPool();
+
+    auto receiveOne = [&](uint32_t seq)
+    {
+        // What the peer puts on the wire: header + nonce + MAC + encrypted IPv4 packet addressed to us
+        PacketHandle datagram = pool->acquire(OVERHEAD + 60);
+        uint8_t* base = datagram.data();
+        std::memset(base, 0, datagram.size());
+        base[0] = 0x12; base[1] = 0x34; base[2] = 0x56; base[3] = 0x78;
+        base[5] = 1;
+        base[6] = static_cast<uint8_t>(UDPNetwork::PacketType::MESSAGE);
+        base[8] = (seq >> 24) & 0xFF; base[9] = (seq >> 16) & 0xFF; base[10] = (seq >> 8) & 0xFF; base[11] = seq & 0xFF;
+        base[15] = 60;
+
+        uint8_t* ip = base + OVERHEAD;
+        ip[0] = 0x45;
+        ip[12] = 10; ip[15] = 2;
+        ip[16] = 10; ip[19] = 1;
+
+        uint8_t* nonce = base + HEADER;
+        randombytes_buf(nonce, crypto_box_NONCEBYTES);
+        crypto_box_detached_afternm(ip, nonce + crypto_box_NONCEBYTES, ip, 60, nonce, peerKey.data());
+
+        // Only the receive processing itself is counted, not building the datagram or posting it
+        boost::asio::post(ioContext, [&, datagram = std::move(datagram)]() mutable
+        {
+            AllocationCounter::setArmed(true);
+            udpNetwork->testProcessReceivedData(std::move(datagram), peerEndpoint);
+            AllocationCounter::setArmed(false);
+        });
+        ioContext.restart();
+        ioContext.poll();
+    };
+
+    // Warm up: first packet marks the peer connected, pools and asio's handler memory fill up
+    for (uint32_t seq = 0; seq < 16; seq++)
+        receiveOne(seq);
+    ASSERT_EQ(delivered, 16u);
+
+    AllocationCounter::reset();
+    for (uint32_t seq = 16; seq < 116; seq++)
+        receiveOne(seq);
+
+    EXPECT_EQ(delivered, 116u);
+    EXPECT_EQ(AllocationCounter::getCount(), 0u);
+}
@@ -1,8 +1,17 @@
 #define PB_UNIT_TESTING 1
 #include <gtest/gtest.h>
 #include <boost/asio.hpp>
+#include <cstring>
 #include "NetworkingModule.hpp"
 #include "Utils.hpp"
+#ifdef _WIN32
+#include "NetworkConfigManager.hpp"
+#else
+#include "LinuxNetworkConfigManager.hpp"
+#endif
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 class UDPNetworkTest : public ::testing::Test
 {
@@ -13,14 +22,18 @@ protected:
         // open UDP v4 but we don't bind
         socket->open(boost::asio::ip::udp::v4());
         stateManager = std::make_shared<SystemStateManager>();
+        #ifdef _WIN32
         networkConfigManager = std::make_shared<NetworkConfigManager>();
+        #else
+        networkConfigManager = std::make_shared<LinuxNetworkConfigManager>();
+        #endif
         udpNetwork = std::make_unique<UDPNetwork>(std::move(socket), ioContext, stateManager, networkConfigManager);
     }
 
     boost::asio::io_context ioContext;
     std::unique_ptr<boost::asio::ip::udp::socket> socket;
     std::shared_ptr<SystemStateManager> stateManager;
-    std::shared_ptr<NetworkConfigManager> networkConfigManager;
+    std::shared_ptr<INetworkConfigManager> networkConfigManager;
     std::unique_ptr<UDPNetwork> udpNetwork;
 };
 
@@ -59,10 +72,7 @@ TEST_F(UDPNetworkTest, TestStartConnectionSharedKeyInvalid_PeerMapsEmpty)
 
     ASSERT_TRUE(udpNetwork->startConnection(selfIp, dummySec, peerMap));
 
-    const auto& virtMap = udpNetwork->testVirtualToPublic();
-    const auto& pubMap = udpNetwork->testPublicToPeer();
-    EXPECT_TRUE(virtMap.empty());
-    EXPECT_TRUE(pubMap.empty());
+    EXPECT_TRUE(udpNetwork->testPeers().empty());
 }
 
 TEST_F(UDPNetworkTest, TestStartConnectionSharedKeyValid_PeerMapsPopulated)
@@ -84,8 +94,1550 @@ TEST_F(UDPNetworkTest, TestStartConnectionSharedKeyValid_PeerMapsPopulated)
 
     ASSERT_TRUE(udpNetwork->startConnection(selfIp, dummySelfSec, peerMap));
 
-    const auto& virtMap = udpNetwork->testVirtualToPublic();
-    ASSERT_EQ(virtMap.size(), 1u);
-    EXPECT_EQ(virtMap.at(peerVirt).first, peerPub);
-    EXPECT_EQ(virtMap.at(peerVirt).second, peerPort);
-} 
\ No newline at end of file
+    const auto& peers = udpNetwork->testPeers();
+    ASSERT_EQ(peers.size(), 1u);
+    const PeerConnectionInfo* peer = peers.findByVirtualIp(peerVirt);
+    ASSERT_NE(peer, nullptr);
+    EXPECT_EQ(peer->getPeerEndpoint().address().to_v4().to_uint(), peerPub);
+    EXPECT_EQ(peer->getPeerEndpoint().port(), peerPort);
+}
+
+TEST_F(UDPNetworkTest, TestPeersBehindOneNatKeptApart)
+{
+    uint32_t selfIp = utils::ipToUint32("10.0.0.1");
+    uint32_t natIp = utils::ipToUint32("192.168.1.100");
+    std::array<uint8_t, crypto_box_PUBLICKEYBYTES> selfPub{}, peerPub{};
+    std::array<uint8_t, crypto_box_SECRETKEYBYTES> selfSec{}, peerSec{};
+    crypto_box_keypair(selfPub.data(), selfSec.data());
+    crypto_box_keypair(peerPub.data(), peerSec.data());
+
+    // Same public address, the NAT tells them apart by port
+    std::map<uint32_t, std::pair<std::pair<std::uint32_t, int>, std::array<uint8_t, crypto_box_PUBLICKEYBYTES>>> peerMap;
+    peerMap[utils::ipToUint32("10.0.0.2")] = {{natIp, 40001}, peerPub};
+    peerMap[utils::ipToUint32("10.0.0.3")] = {{natIp, 40002}, peerPub};
+    ASSERT_TRUE(udpNetwork->startConnection(selfIp, selfSec, peerMap));
+
+    const auto& peers = udpNetwork->testPeers();
+    ASSERT_EQ(peers.size(), 2u);
+    const PeerConnectionInfo* first = peers.findByVirtualIp(utils::ipToUint32("10.0.0.2"));
+    const PeerConnectionInfo* second = peers.findByVirtualIp(utils::ipToUint32("10.0.0.3"));
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    EXPECT_EQ(first->getPeerEndpoint().port(), 40001);
+    EXPECT_EQ(second->getPeerEndpoint().port(), 40002);
+}
+
+TEST_F(UDPNetworkTest, TestSendMessageFramesInHeadroomWithoutCopy)
+{
+    boost::asio::ip::udp::socket receiver(ioContext, {boost::asio::ip::make_address("127.0.0.1"), 0});
+
+    auto pool = udpNetwork->getPacketPool();
+    PacketHandle packet = pool->acquire(100, PacketBufferPool::DEFAULT_HEADROOM);
+    ASSERT_TRUE(packet);
+    std::memset(packet.data(), 0x42, packet.size());
+
+    std::array<uint8_t, crypto_box_BEFORENMBYTES> sharedKey{};
+    ASSERT_TRUE(udpNetwork->sendMessage(std::move(packet), receiver.local_endpoint(), sharedKey));
+    ioContext.run();
+
+    std::array<uint8_t, 256> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+    size_t received = receiver.receive_from(boost::asio::buffer(datagram), sender);
+
+    EXPECT_EQ(received, 16u + crypto_box_NONCEBYTES + crypto_box_MACBYTES + 100u);
+    EXPECT_EQ(datagram[0], 0x12);
+    EXPECT_EQ(datagram[6], static_cast<uint8_t>(UDPNetwork::PacketType::MESSAGE));
+    EXPECT_EQ(datagram[15], 100);
+    EXPECT_EQ(udpNetwork->getTxCopyCount(), 0u);
+    EXPECT_EQ(pool->getStats().slabsInUse, 0u);
+}
+
+TEST_F(UDPNetworkTest, TestSendMessageCopiesSharedBuffer)
+{
+    boost::asio::ip::udp::socket receiver(ioContext, {boost::asio::ip::make_address("127.0.0.1"), 0});
+
+    auto pool = udpNetwork->getPacketPool();
+    PacketHandle packet = pool->acquire(100, PacketBufferPool::DEFAULT_HEADROOM);
+    ASSERT_TRUE(packet);
+    std::memset(packet.data(), 0x42, packet.size());
+
+    // Someone else still holds the plaintext, it must not be encrypted under them
+    PacketHandle stillReading = packet;
+    std::array<uint8_t, crypto_box_BEFORENMBYTES> sharedKey{};
+    ASSERT_TRUE(udpNetwork->sendMessage(std::move(packet), receiver.local_endpoint(), sharedKey));
+    ioContext.run();
+
+    EXPECT_EQ(udpNetwork->getTxCopyCount(), 1u);
+    EXPECT_EQ(stillReading.size(), 100u);
+    EXPECT_EQ(stillReading.headroom(), PacketBufferPool::DEFAULT_HEADROOM);
+    EXPECT_EQ(stillReading.data()[0], 0x42);
+    EXPECT_EQ(stillReading.data()[99], 0x42);
+}
+
+// Parameter: crypto worker count, 0 = inline on the IO thread
+class UDPNetworkV2Test : public UDPNetworkTest, public ::testing::WithParamInterface<int>
+{
+protected:
+    void SetUp() override
+    {
+        UDPNetworkTest::SetUp();
+
+        DataPathConfig config;
+        config.cryptoWorkers = GetParam();
+        auto v2Socket = std::make_unique<boost::asio::ip::udp::socket>(ioContext);
+        v2Socket->open(boost::asio::ip::udp::v4());
+        udpNetwork = std::make_unique<UDPNetwork>(std::move(v2Socket), ioContext, stateManager, networkConfigManager, nullptr, config);
+        ASSERT_EQ(udpNetwork->getCryptoWorkerCount(), static_cast<size_t>(GetParam()));
+
+        // The test plays the peer at 10.0.0.2, we are 10.0.0.1 so our side is the lower one
+        peerSocket = std::make_unique<boost::asio::ip::udp::socket>(
+            ioContext, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+        peerEndpoint = peerSocket->local_endpoint();
+        // Room for a burst of test datagrams without the kernel dropping any
+        peerSocket->set_option(boost::asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+
+        std::array<uint8_t, crypto_box_PUBLICKEYBYTES> selfPub{}, peerPub{};
+        std::array<uint8_t, crypto_box_SECRETKEYBYTES> peerSec{};
+        crypto_box_keypair(selfPub.data(), selfSec.data());
+        crypto_box_keypair(peerPub.data(), peerSec.data());
+
+        peerMap[utils::ipToUint32("10.0.0.2")] = {{utils::ipToUint32("127.0.0.1"), peerEndpoint.port()}, peerPub};
+        ASSERT_TRUE(udpNetwork->startConnection(utils::ipToUint32("10.0.0.1"), selfSec, peerMap));
+        udpNetwork->testSetRunning(true);
+        ASSERT_EQ(crypto_box_beforenm(peerKey.data(), selfPub.data(), peerSec.data()), 0);
+        peerCipher.setKeys(peerKey, false);
+    }
+
+    void drainPeerSocket()
+    {
+        std::array<uint8_t, 256> datagram{};
+        boost::asio::ip::udp::endpoint sender;
+        while (peerSocket->available() > 0)
+            peerSocket->receive_from(boost::asio::buffer(datagram), sender);
+    }
+
+    void receive(PacketHandle datagram)
+    {
+        udpNetwork->testProcessReceivedData(std::move(datagram), peerEndpoint);
+        ioContext.restart();
+        ioContext.poll();
+    }
+
+    // Runs the io_context until the condition holds, work done by crypto workers comes back through it
+    template <typename Condition>
+    bool runUntil(Condition condition)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (!condition())
+        {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            ioContext.restart();
+            ioContext.poll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    }
+
+    void sendToPeer(PacketHandle packet)
+    {
+        std::array<uint8_t, crypto_box_BEFORENMBYTES> unusedKey{};
+        ASSERT_TRUE(udpNetwork->sendMessage(std::move(packet), peerEndpoint, unusedKey));
+        ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; }));
+    }
+
+    // v1 hole punch advertising v2 in byte 7, cipher suites in bytes 12 / 13
+    void negotiateV2(uint8_t supportedSuites = 0, uint8_t preferredSuite = 0)
+    {
+        // Our own hole punches from startConnection
+        drainPeerSocket();
+        PacketHandle holePunch = udpNetwork->getPacketPool()->acquire(16);
+        std::memset(holePunch.data(), 0, holePunch.size());
+        uint8_t* base = holePunch.data();
+        base[0] = 0x12; base[1] = 0x34; base[2] = 0x56; base[3] = 0x78;
+        base[5] = 1;
+        base[6] = static_cast<uint8_t>(UDPNetwork::PacketType::HOLE_PUNCH);
+        base[7] = 2;
+        base[12] = supportedSuites;
+        base[13] = preferredSuite;
+        receive(std::move(holePunch));
+        // It answers with the offer of our group key, wait for it to be sealed and on its way
+        if (udpNetwork->testConfig().groupBroadcast)
+        {
+            ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; }));
+        }
+    }
+
+    // An IPv4 packet to us, optionally with an ack block in front
+    PacketHandle makeV2Datagram(uint32_t sessionId, uint64_t counter, const AckBlock* ack = nullptr)
+    {
+        size_t ackSize = ack ? AckBlock::SIZE : 0;
+        PacketHandle datagram = udpNetwork->getPacketPool()->acquire(OVERHEAD + ackSize + 60);
+        uint8_t* base = datagram.data();
+        std::memset(base, 0, datagram.size());
+        base[0] = (2 << 4) | static_cast<uint8_t>(UDPNetwork::PacketType::MESSAGE);
+        base[1] = ack ? 0x80 : 0;
+        for (int i = 0; i < 4; i++)
+            base[2 + i] = (sessionId >> (24 - 8 * i)) & 0xFF;
+        for (int i = 0; i < 8; i++)
+            base[6 + i] = (counter >> (56 - 8 * i)) & 0xFF;
+
+        uint8_t* plaintext = base + OVERHEAD;
+        if (ack)
+            ack->write(plaintext);
+        uint8_t* ip = plaintext + ackSize;
+        ip[0] = 0x45;
+        ip[12] = 10; ip[15] = 2;
+        ip[16] = 10; ip[19] = 1;
+
+        peerCipher.seal(CipherSuite::XSALSA20_POLY1305, plaintext, ackSize + 60, base + 14, base, 14, sessionId, counter);
+        return datagram;
+    }
+
+    // Any IP packet from the peer's host, as a v2 MESSAGE, or another payload of the given type
+    PacketHandle makeV2Datagram(uint32_t sessionId, uint64_t counter, const std::vector<uint8_t>& ip,
+        UDPNetwork::PacketType type = UDPNetwork::PacketType::MESSAGE)
+    {
+        PacketHandle datagram = udpNetwork->getPacketPool()->acquire(OVERHEAD + ip.size());
+        uint8_t* base = datagram.data();
+        std::memset(base, 0, OVERHEAD);
+        base[0] = (2 << 4) | static_cast<uint8_t>(type);
+        for (int i = 0; i < 4; i++)
+            base[2 + i] = (sessionId >> (24 - 8 * i)) & 0xFF;
+        for (int i = 0; i < 8; i++)
+            base[6 + i] = (counter >> (56 - 8 * i)) & 0xFF;
+        std::memcpy(base + OVERHEAD, ip.data(), ip.size());
+
+        peerCipher.seal(CipherSuite::XSALSA20_POLY1305, base + OVERHEAD, ip.size(), base + 14, base, 14, sessionId, counter);
+        return datagram;
+    }
+
+    // GROUP_KEY control packet from the peer, a v2 message in its session
+    PacketHandle makeGroupKeyPacket(uint32_t sessionId, uint64_t counter, uint8_t kind, uint32_t keyId, const GroupCipher::Key& key)
+    {
+        std::vector<uint8_t> payload(1 + 4 + sizeof(GroupCipher::Key));
+        payload[0] = kind;
+        for (int i = 0; i < 4; i++)
+            payload[1 + i] = (keyId >> (24 - 8 * i)) & 0xFF;
+        std::memcpy(payload.data() + 5, key.data(), key.size());
+        return makeV2Datagram(sessionId, counter, payload, UDPNetwork::PacketType::GROUP_KEY);
+    }
+
+    // Next GROUP_KEY packet we sent the peer, opened, skipping everything else on the way
+    bool readGroupKeyPacket(uint8_t& kind, uint32_t& keyId, GroupCipher::Key& key)
+    {
+        std::array<uint8_t, 256> datagram{};
+        boost::asio::ip::udp::endpoint sender;
+        while (runUntil([this]() { return peerSocket->available() > 0; }))
+        {
+            size_t received = peerSocket->receive_from(boost::asio::buffer(datagram), sender);
+            if (received < OVERHEAD || datagram[0] != ((2 << 4) | static_cast<uint8_t>(UDPNetwork::PacketType::GROUP_KEY)))
+                continue;
+
+            uint8_t* plaintext = datagram.data() + OVERHEAD;
+            if (!openFromUs(datagram.data(), received))
+                return false;
+            const uint8_t* payload = plaintext + ((datagram[1] & 0x80) ? AckBlock::SIZE : 0);
+            kind = payload[0];
+            keyId = (payload[1] << 24) | (payload[2] << 16) | (payload[3] << 8) | payload[4];
+            std::memcpy(key.data(), payload + 5, key.size());
+            return true;
+        }
+        return false;
+    }
+
+    // Opens a pairwise v2 datagram we sent the peer in place, with the suite its header names
+    bool openFromUs(uint8_t* datagram, size_t size)
+    {
+        uint32_t sessionId = (datagram[2] << 24) | (datagram[3] << 16) | (datagram[4] << 8) | datagram[5];
+        uint64_t counter = 0;
+        for (int i = 0; i < 8; i++)
+            counter = (counter << 8) | datagram[6 + i];
+        return peerCipher.open(static_cast<CipherSuite>(datagram[1] & 0x7F), datagram + OVERHEAD, size - OVERHEAD,
+            datagram + 14, datagram, 14, sessionId, counter);
+    }
+
+    // Broadcast to the /24 from src, as the TUN would hand it over
+    PacketHandle makeBroadcastPacket(uint8_t srcOctet)
+    {
+        PacketHandle packet = udpNetwork->getPacketPool()->acquire(60, PacketBufferPool::DEFAULT_HEADROOM);
+        std::memset(packet.data(), 0, packet.size());
+        uint8_t* ip = packet.data();
+        ip[0] = 0x45;
+        ip[12] = 10; ip[15] = srcOctet;
+        ip[16] = 10; ip[19] = 255;
+        return packet;
+    }
+
+    static constexpr uint8_t GROUP_KEY_OFFER = 1;
+    static constexpr uint8_t GROUP_KEY_CONFIRM = 2;
+    static constexpr size_t OVERHEAD = 14 + crypto_box_MACBYTES;
+
+    std::unique_ptr<boost::asio::ip::udp::socket> peerSocket;
+    boost::asio::ip::udp::endpoint peerEndpoint;
+    std::array<uint8_t, crypto_box_BEFORENMBYTES> peerKey{};
+    // The peer's side of the pairwise keys, it is the higher side
+    PeerCipher peerCipher;
+    // Same keys for every lobby, as with the one key pair per process
+    std::array<uint8_t, crypto_box_SECRETKEYBYTES> selfSec{};
+    std::map<uint32_t, std::pair<std::pair<std::uint32_t, int>, std::array<uint8_t, crypto_box_PUBLICKEYBYTES>>> peerMap;
+};
+
+TEST_P(UDPNetworkV2Test, TestNegotiatedPeerGetsCompactHeader)
+{
+    negotiateV2();
+
+    // Drain whatever the hole punch triggered
+    drainPeerSocket();
+
+    PacketHandle packet = udpNetwork->getPacketPool()->acquire(100, PacketBufferPool::DEFAULT_HEADROOM);
+    std::memset(packet.data(), 0x42, packet.size());
+    sendToPeer(std::move(packet));
+
+    std::array<uint8_t, 256> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+    size_t received = peerSocket->receive_from(boost::asio::buffer(datagram), sender);
+    ASSERT_EQ(received, OVERHEAD + 100u);
+    EXPECT_EQ(datagram[0], (2 << 4) | static_cast<uint8_t>(UDPNetwork::PacketType::MESSAGE));
+
+    // The peer's key opens it
+    EXPECT_TRUE(openFromUs(datagram.data(), received));
+    EXPECT_EQ(datagram[OVERHEAD], 0x42);
+}
+
+TEST_P(UDPNetworkV2Test, TestTunPacketsRoutedByDestination)
+{
+    negotiateV2();
+    drainPeerSocket();
+
+    auto makeTunPacket = [this](uint8_t versionAndLength, uint8_t lastOctet)
+    {
+        PacketHandle packet = udpNetwork->getPacketPool()->acquire(60, PacketBufferPool::DEFAULT_HEADROOM);
+        std::memset(packet.data(), 0, packet.size());
+        packet.data()[0] = versionAndLength;
+        packet.data()[16] = 10;
+        packet.data()[19] = lastOctet;
+        return packet;
+    };
+
+    // No peer at .9, not IPv4, then the one packet that should go out
+    udpNetwork->processPacketFromTun(makeTunPacket(0x45, 9));
+    udpNetwork->processPacketFromTun(makeTunPacket(0x60, 2));
+    udpNetwork->processPacketFromTun(makeTunPacket(0x45, 2));
+    ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; }));
+
+    std::array<uint8_t, 256> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+    EXPECT_EQ(peerSocket->receive_from(boost::asio::buffer(datagram), sender), OVERHEAD + 60u);
+    EXPECT_EQ(peerSocket->available(), 0u);
+}
+
+TEST_P(UDPNetworkV2Test, TestTunBurstRoutedByDestination)
+{
+    negotiateV2();
+    drainPeerSocket();
+
+    // The same three as above, then more than one classify chunk for the peer
+    constexpr size_t BURST = 3 + 70;
+    std::vector<PacketHandle> burst;
+    for (size_t i = 0; i < BURST; i++)
+    {
+        PacketHandle packet = udpNetwork->getPacketPool()->acquire(60, PacketBufferPool::DEFAULT_HEADROOM);
+        std::memset(packet.data(), 0, packet.size());
+        packet.data()[0] = i == 1 ? 0x60 : 0x45;
+        packet.data()[16] = 10;
+        packet.data()[19] = i == 0 ? 9 : 2;
+        burst.push_back(std::move(packet));
+    }
+    udpNetwork->processPacketsFromTun(burst.data(), burst.size());
+
+    std::array<uint8_t, 256> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+    size_t received = 0;
+    while (received < BURST - 2 && runUntil([this]() { return peerSocket->available() > 0; }))
+    {
+        EXPECT_EQ(peerSocket->receive_from(boost::asio::buffer(datagram), sender), OVERHEAD + 60u);
+        received++;
+    }
+    EXPECT_EQ(received, BURST - 2);
+    EXPECT_EQ(peerSocket->available(), 0u);
+}
+
+TEST_P(UDPNetworkV2Test, TestReplayedDatagramIsDeliveredOnce)
+{
+    negotiateV2();
+
+    size_t delivered = 0;
+    udpNetwork->setMessageCallback([&delivered](PacketHandle packet)
+    {
+        if (packet.size() == 60 && packet.data()[0] == 0x45)
+            delivered++;
+    });
+
+    PacketHandle first = makeV2Datagram(7, 5);
+    PacketHandle replayed = udpNetwork->getPacketPool()->acquire(first.size());
+    std::memcpy(replayed.data(), first.data(), first.size());
+
+    receive(std::move(first));
+    receive(std::move(replayed));
+    // Older but unseen counters still get through
+    receive(makeV2Datagram(7, 3));
+
+    EXPECT_TRUE(runUntil([&]() { return delivered == 2 && udpNetwork->getReplayDropCount() == 1; }));
+
+    // A peer restart starts a new session, its low counters are accepted again
+    receive(makeV2Datagram(8, 0));
+    EXPECT_TRUE(runUntil([&]() { return delivered == 3; }));
+    EXPECT_EQ(udpNetwork->getReplayDropCount(), 1u);
+}
+
+TEST_P(UDPNetworkV2Test, TestOldSessionReplayDoesNotReopenCurrentSession)
+{
+    negotiateV2();
+
+    size_t delivered = 0;
+    udpNetwork->setMessageCallback([&delivered](PacketHandle packet)
+    {
+        if (packet.size() == 60 && packet.data()[0] == 0x45)
+            delivered++;
+    });
+
+    auto copyOf = [this](const PacketHandle& datagram)
+    {
+        PacketHandle copy = udpNetwork->getPacketPool()->acquire(datagram.size());
+        std::memcpy(copy.data(), datagram.data(), datagram.size());
+        return copy;
+    };
+
+    // Recorded on the way: one packet of the peer's session 7, then one of session 8 after it restarted
+    PacketHandle oldSession = makeV2Datagram(7, 0);
+    PacketHandle currentSession = makeV2Datagram(8, 0);
+    PacketHandle recordedOld = copyOf(oldSession);
+    PacketHandle recordedCurrent = copyOf(currentSession);
+    receive(std::move(oldSession));
+    receive(std::move(currentSession));
+    ASSERT_TRUE(runUntil([&]() { return delivered == 2; }));
+
+    // The old session's packet authenticates, but doesn't switch sessions or reset session 8's window
+    receive(std::move(recordedOld));
+    receive(makeV2Datagram(8, 1));
+    ASSERT_TRUE(runUntil([&]() { return delivered == 3 && udpNetwork->getReplayDropCount() == 1; }));
+    EXPECT_EQ(udpNetwork->testPeers().begin()->peer.getPeerSessionId(), 8u);
+    receive(std::move(recordedCurrent));
+    EXPECT_TRUE(runUntil([&]() { return udpNetwork->getReplayDropCount() == 2; }));
+
+    // Next lobby, same key pairs: the peer's session from the last one is a recording as well
+    PacketHandle lastLobby = makeV2Datagram(8, 2);
+    udpNetwork->stopConnection();
+    ASSERT_TRUE(udpNetwork->startConnection(utils::ipToUint32("10.0.0.1"), selfSec, peerMap));
+    udpNetwork->testSetRunning(true);
+    negotiateV2();
+    receive(std::move(lastLobby));
+    receive(makeV2Datagram(9, 0));
+    EXPECT_TRUE(runUntil([&]() { return delivered == 4 && udpNetwork->getReplayDropCount() == 3; }));
+    EXPECT_EQ(delivered, 4u);
+}
+
+TEST_P(UDPNetworkV2Test, TestV1MessageFromV2PeerIsDropped)
+{
+    negotiateV2();
+
+    size_t delivered = 0;
+    udpNetwork->setMessageCallback([&delivered](PacketHandle packet)
+    {
+        if (packet.size() == 60 && packet.data()[0] == 0x45)
+            delivered++;
+    });
+
+    // A hole punch from a peer that predates v2, spoofed or real
+    auto receiveV1HolePunch = [this]()
+    {
+        PacketHandle holePunch = udpNetwork->getPacketPool()->acquire(16);
+        std::memset(holePunch.data(), 0, holePunch.size());
+        holePunch.data()[0] = 0x12; holePunch.data()[1] = 0x34; holePunch.data()[2] = 0x56; holePunch.data()[3] = 0x78;
+        holePunch.data()[5] = 1;
+        holePunch.data()[6] = static_cast<uint8_t>(UDPNetwork::PacketType::HOLE_PUNCH);
+        receive(std::move(holePunch));
+    };
+
+    // A v1 message sealed with the pairwise box
+    auto makeV1Message = [this]()
+    {
+        constexpr size_t V1_OVERHEAD = 16 + crypto_box_NONCEBYTES + crypto_box_MACBYTES;
+        PacketHandle message = udpNetwork->getPacketPool()->acquire(V1_OVERHEAD + 60);
+        uint8_t* base = message.data();
+        std::memset(base, 0, message.size());
+        base[0] = 0x12; base[1] = 0x34; base[2] = 0x56; base[3] = 0x78;
+        base[5] = 1;
+        base[6] = static_cast<uint8_t>(UDPNetwork::PacketType::MESSAGE);
+        base[15] = 60;
+        uint8_t* ip = base + V1_OVERHEAD;
+        ip[0] = 0x45;
+        ip[12] = 10; ip[15] = 2;
+        ip[16] = 10; ip[19] = 1;
+        randombytes_buf(base + 16, crypto_box_NONCEBYTES);
+        crypto_box_detached_afternm(ip, base + 16 + crypto_box_NONCEBYTES, ip, 60, base + 16, peerKey.data());
+        return message;
+    };
+
+    // Nothing from the peer authenticated as v2 yet: the hole punches are only hints, the last one wins,
+    // and the peer may still be a v1 peer whose hole punch was spoofed
+    auto& peer = udpNetwork->testPeers().begin()->peer;
+    receiveV1HolePunch();
+    EXPECT_EQ(peer.getProtocolVersion(), 1);
+    negotiateV2();
+    EXPECT_EQ(peer.getProtocolVersion(), 2);
+    receive(makeV1Message());
+    EXPECT_EQ(delivered, 1u);
+
+    // Its first v2 packet settles it
+    receive(makeV2Datagram(7, 0));
+    ASSERT_TRUE(runUntil([&]() { return delivered == 2; }));
+    EXPECT_TRUE(peer.isProtocolVersionConfirmed());
+
+    // From then on a v1 hole punch doesn't take us back to v1, and a v1 message would skip the replay window
+    receiveV1HolePunch();
+    EXPECT_EQ(peer.getProtocolVersion(), 2);
+    receive(makeV1Message());
+    EXPECT_EQ(delivered, 2u);
+
+    // The same packet as v2 gets through
+    receive(makeV2Datagram(7, 1));
+    EXPECT_TRUE(runUntil([&]() { return delivered == 3; }));
+}
+
+TEST_P(UDPNetworkV2Test, TestSuiteChangesOnlyOnceThePeerConfirmsIt)
+{
+    // No group key offer ahead of the data, so its counters start at 0
+    udpNetwork->testConfig().groupBroadcast = false;
+    // Whatever we measured as fastest, the peer can only open ChaCha20 (and the implied XSalsa20)
+    constexpr uint8_t CHACHA_ONLY = 1u << static_cast<uint8_t>(CipherSuite::CHACHA20_POLY1305);
+    constexpr uint8_t CHACHA = static_cast<uint8_t>(CipherSuite::CHACHA20_POLY1305);
+    negotiateV2(CHACHA_ONLY, CHACHA);
+
+    // The hole punch only hints, we ask the peer for its suites over the sealed channel
+    std::array<uint8_t, 256> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+    ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; }));
+    size_t received = peerSocket->receive_from(boost::asio::buffer(datagram), sender);
+    ASSERT_EQ(received, OVERHEAD + 3u);
+    EXPECT_EQ(datagram[0], (2 << 4) | static_cast<uint8_t>(UDPNetwork::PacketType::SUITES));
+    ASSERT_TRUE(openFromUs(datagram.data(), received));
+    EXPECT_EQ(datagram[OVERHEAD], 1);
+    EXPECT_EQ(datagram[OVERHEAD + 1], PeerCipher::supportedSuites());
+    drainPeerSocket();
+
+    auto sendAndReadSuite = [&]()
+    {
+        PacketHandle packet = udpNetwork->getPacketPool()->acquire(100, PacketBufferPool::DEFAULT_HEADROOM);
+        std::memset(packet.data(), 0x42, packet.size());
+        sendToPeer(std::move(packet));
+        size_t size = peerSocket->receive_from(boost::asio::buffer(datagram), sender);
+        EXPECT_EQ(size, OVERHEAD + 100u);
+        EXPECT_TRUE(openFromUs(datagram.data(), size));
+        EXPECT_EQ(datagram[OVERHEAD], 0x42);
+        return static_cast<CipherSuite>(datagram[1] & 0x7F);
+    };
+    EXPECT_EQ(sendAndReadSuite(), CipherSuite::XSALSA20_POLY1305);
+
+    // Its answer authenticated, from now on it gets ChaCha20
+    receive(makeV2Datagram(7, 0, {2, CHACHA_ONLY, CHACHA}, UDPNetwork::PacketType::SUITES));
+    ASSERT_TRUE(runUntil([this]() { return udpNetwork->testPeers().begin()->peer.getCipherSuite() == CipherSuite::CHACHA20_POLY1305; }));
+    drainPeerSocket();
+    EXPECT_EQ(sendAndReadSuite(), CipherSuite::CHACHA20_POLY1305);
+}
+
+TEST_P(UDPNetworkV2Test, TestSuitesOfferIsAnswered)
+{
+    udpNetwork->testConfig().groupBroadcast = false;
+    negotiateV2();
+    drainPeerSocket();
+
+    constexpr uint8_t CHACHA_ONLY = 1u << static_cast<uint8_t>(CipherSuite::CHACHA20_POLY1305);
+    constexpr uint8_t CHACHA = static_cast<uint8_t>(CipherSuite::CHACHA20_POLY1305);
+    receive(makeV2Datagram(7, 0, {1, CHACHA_ONLY, CHACHA}, UDPNetwork::PacketType::SUITES));
+
+    // Answered once, already sealed with the suite the offer agreed on
+    std::array<uint8_t, 256> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+    bool answered = false;
+    while (!answered && runUntil([this]() { return peerSocket->available() > 0; }))
+    {
+        size_t received = peerSocket->receive_from(boost::asio::buffer(datagram), sender);
+        if (datagram[0] != ((2 << 4) | static_cast<uint8_t>(UDPNetwork::PacketType::SUITES)))
+            continue;
+        EXPECT_EQ(datagram[1] & 0x7F, CHACHA);
+        ASSERT_TRUE(openFromUs(datagram.data(), received));
+        EXPECT_EQ(datagram[OVERHEAD + ((datagram[1] & 0x80) ? AckBlock::SIZE : 0)], 2);
+        answered = true;
+    }
+    EXPECT_TRUE(answered);
+}
+
+TEST_P(UDPNetworkV2Test, TestCountersLeaveInOrder)
+{
+    // No group key offer ahead of the data, so its counters start at 0
+    udpNetwork->testConfig().groupBroadcast = false;
+    negotiateV2();
+    drainPeerSocket();
+
+    // More than one worker's worth in flight, the per-peer flow still has to put them back in order
+    constexpr uint64_t PACKETS = 200;
+    for (uint64_t i = 0; i < PACKETS; i++)
+    {
+        PacketHandle packet = udpNetwork->getPacketPool()->acquire(1000, PacketBufferPool::DEFAULT_HEADROOM);
+        std::memset(packet.data(), static_cast<int>(i & 0xFF), packet.size());
+        std::array<uint8_t, crypto_box_BEFORENMBYTES> unusedKey{};
+        ASSERT_TRUE(udpNetwork->sendMessage(std::move(packet), peerEndpoint, unusedKey));
+    }
+
+    std::array<uint8_t, 2048> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+    for (uint64_t expected = 0; expected < PACKETS; expected++)
+    {
+        ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; })) << "packet " << expected;
+        size_t received = peerSocket->receive_from(boost::asio::buffer(datagram), sender);
+        ASSERT_EQ(received, OVERHEAD + 1000u);
+
+        uint64_t counter = 0;
+        for (int i = 0; i < 8; i++)
+            counter = (counter << 8) | datagram[6 + i];
+        ASSERT_EQ(counter, expected);
+
+        uint32_t sessionId = (datagram[2] << 24) | (datagram[3] << 16) | (datagram[4] << 8) | datagram[5];
+        ASSERT_TRUE(peerCipher.open(static_cast<CipherSuite>(datagram[1]), datagram.data() + OVERHEAD, 1000,
+            datagram.data() + 14, datagram.data(), 14, sessionId, counter));
+        EXPECT_EQ(datagram[OVERHEAD], expected & 0xFF);
+    }
+}
+
+TEST_P(UDPNetworkV2Test, TestReceivedMessagesAckedOnceAfterDelay)
+{
+    // No group key offer ahead of the data, so its counters start at 0
+    udpNetwork->testConfig().groupBroadcast = false;
+    negotiateV2();
+    drainPeerSocket();
+    udpNetwork->setMessageCallback([](PacketHandle) {});
+
+    // Nothing goes back to the peer, so the three messages get one delayed ack on its own, not one each
+    receive(makeV2Datagram(7, 0));
+    receive(makeV2Datagram(7, 1));
+    receive(makeV2Datagram(7, 3));
+    EXPECT_EQ(peerSocket->available(), 0u);
+    ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; }));
+
+    std::array<uint8_t, 256> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+    size_t received = peerSocket->receive_from(boost::asio::buffer(datagram), sender);
+    ASSERT_EQ(received, OVERHEAD + AckBlock::SIZE);
+    EXPECT_EQ(datagram[0], (2 << 4) | static_cast<uint8_t>(UDPNetwork::PacketType::ACK));
+    EXPECT_EQ(datagram[1], 0x80 | static_cast<uint8_t>(CipherSuite::XSALSA20_POLY1305));
+
+    uint32_t sessionId = (datagram[2] << 24) | (datagram[3] << 16) | (datagram[4] << 8) | datagram[5];
+    ASSERT_TRUE(peerCipher.open(CipherSuite::XSALSA20_POLY1305, datagram.data() + OVERHEAD, AckBlock::SIZE,
+        datagram.data() + 14, datagram.data(), 14, sessionId, 0));
+
+    AckBlock ack = AckBlock::read(datagram.data() + OVERHEAD);
+    EXPECT_EQ(ack.sessionId, 7u);
+    EXPECT_EQ(ack.largest, 3u);
+    EXPECT_EQ(ack.receivedCount, 3u);
+    // 2 missing, 1 and 0 there
+    EXPECT_EQ(ack.bitmap, 0b110u);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ioContext.restart();
+    ioContext.poll();
+    EXPECT_EQ(peerSocket->available(), 0u);
+}
+
+TEST_P(UDPNetworkV2Test, TestPeerAckGivesRttAndLoss)
+{
+    // No group key offer ahead of the data, so its counters start at 0
+    udpNetwork->testConfig().groupBroadcast = false;
+    negotiateV2();
+    drainPeerSocket();
+    size_t delivered = 0;
+    udpNetwork->setMessageCallback([&delivered](PacketHandle) { delivered++; });
+
+    // Four messages out, the peer only got the last three
+    uint32_t ourSession = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        PacketHandle packet = udpNetwork->getPacketPool()->acquire(100, PacketBufferPool::DEFAULT_HEADROOM);
+        std::memset(packet.data(), 0x42, packet.size());
+        sendToPeer(std::move(packet));
+
+        std::array<uint8_t, 256> datagram{};
+        boost::asio::ip::udp::endpoint sender;
+        peerSocket->receive_from(boost::asio::buffer(datagram), sender);
+        ourSession = (datagram[2] << 24) | (datagram[3] << 16) | (datagram[4] << 8) | datagram[5];
+    }
+
+    AckBlock ack;
+    ack.sessionId = ourSession;
+    ack.largest = 3;
+    ack.receivedCount = 3;
+    ack.bitmap = 0b011;
+    receive(makeV2Datagram(7, 0, &ack));
+
+    const AckTracker::Stats& stats = udpNetwork->testPeers().begin()->peer.getAckTracker().getStats();
+    EXPECT_TRUE(runUntil([&]() { return stats.acksReceived == 1; }));
+    EXPECT_EQ(stats.packetsSent, 4u);
+    EXPECT_EQ(stats.packetsAcked, 3u);
+    EXPECT_EQ(stats.packetsLost, 1u);
+    EXPECT_EQ(stats.bytesInFlight, 0u);
+    EXPECT_GT(stats.smoothedRtt.count(), 0);
+
+    // An ack for a session of ours that's gone doesn't count
+    ack.sessionId = ourSession + 1;
+    ack.largest = 100;
+    receive(makeV2Datagram(7, 1, &ack));
+    EXPECT_TRUE(runUntil([&]() { return delivered == 2; }));
+    EXPECT_EQ(stats.acksReceived, 1u);
+}
+
+TEST_P(UDPNetworkV2Test, TestRejectedCryptoJobsAreCountedNotSent)
+{
+    if (GetParam() == 0)
+        GTEST_SKIP() << "inline crypto never rejects";
+    udpNetwork->testConfig().groupBroadcast = false;
+    negotiateV2();
+    drainPeerSocket();
+    size_t delivered = 0;
+    udpNetwork->setMessageCallback([&delivered](PacketHandle) { delivered++; });
+    udpNetwork->testStopCryptoWorkers();
+
+    PacketHandle packet = udpNetwork->getPacketPool()->acquire(100, PacketBufferPool::DEFAULT_HEADROOM);
+    std::memset(packet.data(), 0x42, packet.size());
+    std::array<uint8_t, crypto_box_BEFORENMBYTES> unusedKey{};
+    EXPECT_FALSE(udpNetwork->sendMessage(std::move(packet), peerEndpoint, unusedKey));
+
+    // Nothing went out, so nothing may wait for an ack
+    const AckTracker::Stats& stats = udpNetwork->testPeers().begin()->peer.getAckTracker().getStats();
+    EXPECT_EQ(stats.packetsSent, 0u);
+    EXPECT_EQ(stats.bytesInFlight, 0u);
+
+    receive(makeV2Datagram(7, 0));
+    EXPECT_EQ(delivered, 0u);
+    EXPECT_EQ(udpNetwork->getCryptoDropCount(), 2u);
+}
+
+TEST_P(UDPNetworkV2Test, TestBroadcastSealedOnceWithGroupKey)
+{
+    negotiateV2();
+    uint8_t kind = 0;
+    uint32_t keyId = 0;
+    GroupCipher::Key key{};
+    ASSERT_TRUE(readGroupKeyPacket(kind, keyId, key));
+    EXPECT_EQ(kind, GROUP_KEY_OFFER);
+    EXPECT_NE(keyId, 0u);
+    drainPeerSocket();
+
+    std::array<uint8_t, 256> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+
+    // Until the peer confirms, broadcasts still go pairwise
+    udpNetwork->processPacketFromTun(makeBroadcastPacket(1));
+    ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; }));
+    EXPECT_EQ(peerSocket->receive_from(boost::asio::buffer(datagram), sender), OVERHEAD + 60u);
+    EXPECT_EQ(datagram[0], (2 << 4) | static_cast<uint8_t>(UDPNetwork::PacketType::MESSAGE));
+
+    receive(makeGroupKeyPacket(7, 0, GROUP_KEY_CONFIRM, keyId, GroupCipher::Key{}));
+    ASSERT_TRUE(runUntil([&]() { return udpNetwork->testPeers().find(peerEndpoint)->hasConfirmedGroupKey(keyId); }));
+    udpNetwork->processPacketFromTun(makeBroadcastPacket(1));
+    ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; }));
+    size_t received = peerSocket->receive_from(boost::asio::buffer(datagram), sender);
+    ASSERT_EQ(received, OVERHEAD + 60u);
+    EXPECT_EQ(datagram[0], (2 << 4) | static_cast<uint8_t>(UDPNetwork::PacketType::GROUP_MESSAGE));
+    EXPECT_EQ(datagram[1], static_cast<uint8_t>(GroupCipher::SUITE));
+    EXPECT_EQ(static_cast<uint32_t>((datagram[2] << 24) | (datagram[3] << 16) | (datagram[4] << 8) | datagram[5]), keyId);
+
+    // The key from the offer opens it, header authenticated
+    GroupCipher peerCopy;
+    peerCopy.setKey(key);
+    ASSERT_TRUE(peerCopy.open(datagram.data() + OVERHEAD, 60, datagram.data() + 14, datagram.data(), 14, keyId, 0));
+    EXPECT_EQ(datagram[OVERHEAD], 0x45);
+    EXPECT_EQ(datagram[OVERHEAD + 19], 255);
+
+    const UDPNetwork::FanoutStats& stats = udpNetwork->getFanoutStats();
+    EXPECT_EQ(stats.packets, 2u);
+    EXPECT_EQ(stats.datagrams, 2u);
+    EXPECT_EQ(stats.groupSeals, 1u);
+    EXPECT_EQ(stats.pairwiseSeals, 1u);
+    EXPECT_EQ(stats.copies, 0u);
+}
+
+TEST_P(UDPNetworkV2Test, TestGroupMessageFromPeerDeliveredOnce)
+{
+    negotiateV2();
+    drainPeerSocket();
+
+    size_t delivered = 0;
+    udpNetwork->setMessageCallback([&delivered](PacketHandle packet)
+    {
+        if (packet.size() == 60 && packet.data()[19] == 255)
+            delivered++;
+    });
+
+    GroupCipher peerGroup;
+    peerGroup.generate();
+    auto makeGroupDatagram = [&](uint32_t keyId, uint64_t counter)
+    {
+        PacketHandle datagram = makeBroadcastPacket(2);
+        datagram.prepend(OVERHEAD);
+        uint8_t* base = datagram.data();
+        std::memset(base, 0, OVERHEAD);
+        base[0] = (2 << 4) | static_cast<uint8_t>(UDPNetwork::PacketType::GROUP_MESSAGE);
+        base[1] = static_cast<uint8_t>(GroupCipher::SUITE);
+        for (int i = 0; i < 4; i++)
+            base[2 + i] = (keyId >> (24 - 8 * i)) & 0xFF;
+        base[13] = static_cast<uint8_t>(counter);
+        peerGroup.seal(base + OVERHEAD, 60, base + 14, base, 14, keyId, counter);
+        return datagram;
+    };
+
+    // Sealed with a key we weren't given yet
+    receive(makeGroupDatagram(0x5555, 0));
+    EXPECT_EQ(delivered, 0u);
+
+    receive(makeGroupKeyPacket(0x5555, 0, GROUP_KEY_OFFER, 0x5555, peerGroup.getKey()));
+    uint8_t kind = 0;
+    uint32_t keyId = 0;
+    GroupCipher::Key key{};
+    ASSERT_TRUE(readGroupKeyPacket(kind, keyId, key));
+    EXPECT_EQ(kind, GROUP_KEY_CONFIRM);
+    EXPECT_EQ(keyId, 0x5555u);
+    EXPECT_EQ(key, GroupCipher::Key{});
+
+    PacketHandle first = makeGroupDatagram(0x5555, 0);
+    PacketHandle replayed = udpNetwork->getPacketPool()->acquire(first.size());
+    std::memcpy(replayed.data(), first.data(), first.size());
+    uint64_t dropsBefore = udpNetwork->getReplayDropCount();
+    receive(std::move(first));
+    receive(std::move(replayed));
+    receive(makeGroupDatagram(0x5555, 1));
+    EXPECT_EQ(delivered, 2u);
+    EXPECT_EQ(udpNetwork->getReplayDropCount(), dropsBefore + 1);
+
+    // Pairwise counters are untouched by the group ones
+    EXPECT_TRUE(udpNetwork->testPeers().begin()->peer.getReplayWindow().check(1));
+}
+
+TEST_P(UDPNetworkV2Test, TestStaleGroupKeyOfferIgnored)
+{
+    negotiateV2();
+    drainPeerSocket();
+
+    size_t delivered = 0;
+    udpNetwork->setMessageCallback([&delivered](PacketHandle packet)
+    {
+        if (packet.size() == 60 && packet.data()[0] == 0x45)
+            delivered++;
+    });
+    auto peerGroupCipher = [this](uint32_t keyId) { return udpNetwork->testPeers().find(peerEndpoint)->getPeerGroupCipher(keyId); };
+
+    GroupCipher oldGroup, currentGroup;
+    oldGroup.generate();
+    currentGroup.generate();
+    PacketHandle oldOffer = makeGroupKeyPacket(0x5555, 0, GROUP_KEY_OFFER, 0x5555, oldGroup.getKey());
+    PacketHandle recorded = udpNetwork->getPacketPool()->acquire(oldOffer.size());
+    std::memcpy(recorded.data(), oldOffer.data(), oldOffer.size());
+    receive(std::move(oldOffer));
+    ASSERT_TRUE(runUntil([&]() { return peerGroupCipher(0x5555) != nullptr; }));
+
+    // The peer restarted with a new key
+    receive(makeGroupKeyPacket(0x6666, 0, GROUP_KEY_OFFER, 0x6666, currentGroup.getKey()));
+    ASSERT_TRUE(runUntil([&]() { return peerGroupCipher(0x6666) != nullptr; }));
+
+    // Neither the recorded offer nor an old key offered in the new session puts the stale key back
+    uint64_t dropsBefore = udpNetwork->getReplayDropCount();
+    receive(std::move(recorded));
+    receive(makeGroupKeyPacket(0x6666, 1, GROUP_KEY_OFFER, 0x5555, oldGroup.getKey()));
+    receive(makeV2Datagram(0x6666, 2));
+    ASSERT_TRUE(runUntil([&]() { return delivered == 1; }));
+    EXPECT_EQ(udpNetwork->getReplayDropCount(), dropsBefore + 1);
+    EXPECT_NE(peerGroupCipher(0x6666), nullptr);
+    EXPECT_EQ(peerGroupCipher(0x5555), nullptr);
+}
+
+TEST_P(UDPNetworkV2Test, TestBroadcastSentToTopOfRelayTree)
+{
+    udpNetwork->testConfig().relayFanout = 1;
+    negotiateV2();
+    uint8_t kind = 0;
+    uint32_t keyId = 0;
+    GroupCipher::Key key{};
+    ASSERT_TRUE(readGroupKeyPacket(kind, keyId, key));
+    receive(makeGroupKeyPacket(7, 0, GROUP_KEY_CONFIRM, keyId, GroupCipher::Key{}));
+    ASSERT_TRUE(runUntil([&]() { return udpNetwork->testPeers().find(peerEndpoint)->hasConfirmedGroupKey(keyId); }));
+    drainPeerSocket();
+
+    // Two more peers holding our key, each on a socket of its own
+    std::vector<std::unique_ptr<boost::asio::ip::udp::socket>> others;
+    for (const char* virtualIp : {"10.0.0.3", "10.0.0.4"})
+    {
+        others.push_back(std::make_unique<boost::asio::ip::udp::socket>(
+            ioContext, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0)));
+        boost::asio::ip::udp::endpoint endpoint = others.back()->local_endpoint();
+        PeerConnectionInfo* peer = udpNetwork->testPeers().add(utils::ipToUint32(virtualIp), endpoint, PeerConnectionInfo(endpoint));
+        ASSERT_NE(peer, nullptr);
+        peer->setProtocolVersion(2);
+        peer->setGroupKeyConfirmed(keyId);
+    }
+
+    udpNetwork->processPacketFromTun(makeBroadcastPacket(1));
+    ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; }));
+
+    // No RTTs yet, so the tree goes by octet: .2 gets it from us, .3 from .2, .4 from .3
+    constexpr size_t TREE_SIZE = 2 + 3;
+    std::array<uint8_t, 256> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+    ASSERT_EQ(peerSocket->receive_from(boost::asio::buffer(datagram), sender), OVERHEAD + TREE_SIZE + 60u);
+    EXPECT_EQ(datagram[1], static_cast<uint8_t>(GroupCipher::SUITE) | 0x40);
+    EXPECT_EQ(std::vector<uint8_t>(datagram.begin() + 14, datagram.begin() + 14 + TREE_SIZE), (std::vector<uint8_t>{1, 3, 2, 3, 4}));
+
+    // The tree is authenticated along with the header
+    GroupCipher peerCopy;
+    peerCopy.setKey(key);
+    ASSERT_TRUE(peerCopy.open(datagram.data() + OVERHEAD + TREE_SIZE, 60, datagram.data() + 14 + TREE_SIZE,
+        datagram.data(), 14 + TREE_SIZE, keyId, 0));
+    EXPECT_EQ(datagram[OVERHEAD + TREE_SIZE + 19], 255);
+
+    for (const auto& other : others)
+        EXPECT_EQ(other->available(), 0u);
+    EXPECT_EQ(udpNetwork->getFanoutStats().datagrams, 1u);
+    EXPECT_EQ(udpNetwork->getFanoutStats().groupSeals, 1u);
+}
+
+TEST_P(UDPNetworkV2Test, TestGroupMessageRelayedOnceAuthenticated)
+{
+    negotiateV2();
+    drainPeerSocket();
+
+    auto thirdSocket = std::make_unique<boost::asio::ip::udp::socket>(
+        ioContext, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    boost::asio::ip::udp::endpoint thirdEndpoint = thirdSocket->local_endpoint();
+    ASSERT_NE(udpNetwork->testPeers().add(utils::ipToUint32("10.0.0.3"), thirdEndpoint, PeerConnectionInfo(thirdEndpoint)), nullptr);
+
+    size_t delivered = 0;
+    udpNetwork->setMessageCallback([&delivered](PacketHandle packet)
+    {
+        if (packet.size() == 60 && packet.data()[19] == 255)
+            delivered++;
+    });
+
+    // .2 owns the key and hands it to us
+    GroupCipher peerGroup;
+    peerGroup.generate();
+    receive(makeGroupKeyPacket(0x5555, 0, GROUP_KEY_OFFER, 0x5555, peerGroup.getKey()));
+    ASSERT_TRUE(runUntil([&]() { return udpNetwork->testPeers().find(peerEndpoint)->getPeerGroupCipher(0x5555) != nullptr; }));
+    drainPeerSocket();
+
+    auto makeRelayedDatagram = [&](uint64_t counter, std::vector<uint8_t> tree)
+    {
+        PacketHandle datagram = makeBroadcastPacket(2);
+        datagram.prepend(OVERHEAD + tree.size());
+        uint8_t* base = datagram.data();
+        std::memset(base, 0, OVERHEAD);
+        base[0] = (2 << 4) | static_cast<uint8_t>(UDPNetwork::PacketType::GROUP_MESSAGE);
+        base[1] = static_cast<uint8_t>(GroupCipher::SUITE) | 0x40;
+        base[4] = 0x55; base[5] = 0x55;
+        base[13] = static_cast<uint8_t>(counter);
+        std::memcpy(base + 14, tree.data(), tree.size());
+        size_t headerSize = 14 + tree.size();
+        peerGroup.seal(base + headerSize + 16, 60, base + headerSize, base, headerSize, 0x5555, counter);
+        return datagram;
+    };
+    auto copyOf = [this](const PacketHandle& datagram)
+    {
+        PacketHandle copy = udpNetwork->getPacketPool()->acquire(datagram.size());
+        std::memcpy(copy.data(), datagram.data(), datagram.size());
+        return copy;
+    };
+
+    // We are first in .2's tree, .3 hangs off us
+    PacketHandle first = makeRelayedDatagram(0, {1, 2, 1, 3});
+    std::vector<uint8_t> sent(first.data(), first.data() + first.size());
+    PacketHandle replayed = copyOf(first);
+    receive(std::move(first));
+    EXPECT_EQ(delivered, 1u);
+    ASSERT_TRUE(runUntil([&]() { return thirdSocket->available() > 0; }));
+    std::array<uint8_t, 256> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+    size_t received = thirdSocket->receive_from(boost::asio::buffer(datagram), sender);
+    EXPECT_EQ(std::vector<uint8_t>(datagram.begin(), datagram.begin() + received), sent);
+
+    // Duplicates and forgeries go no further
+    receive(std::move(replayed));
+    PacketHandle forged = makeRelayedDatagram(1, {1, 2, 1, 3});
+    forged.data()[forged.size() - 1] ^= 1;
+    uint64_t acquisitions = udpNetwork->getPacketPool()->getStats().acquisitions;
+    receive(std::move(forged));
+    // Not even a buffer for the copy it would have been relayed as
+    EXPECT_EQ(udpNetwork->getPacketPool()->getStats().acquisitions, acquisitions);
+    ioContext.restart();
+    ioContext.poll();
+    EXPECT_EQ(thirdSocket->available(), 0u);
+    EXPECT_EQ(delivered, 1u);
+    EXPECT_EQ(udpNetwork->getFanoutStats().relayed, 1u);
+
+    // Relayed to us by .3, the key id still says it's .2's
+    udpNetwork->testProcessReceivedData(makeRelayedDatagram(2, {1, 2, 3, 1}), thirdEndpoint);
+    ioContext.restart();
+    ioContext.poll();
+    EXPECT_EQ(delivered, 2u);
+    EXPECT_EQ(udpNetwork->getFanoutStats().relayed, 1u);
+}
+
+TEST_P(UDPNetworkV2Test, TestMulticastOnlyToJoinedPeers)
+{
+    // Anything IGMP that reaches our TUN, the query we put there when the peer connects should be all of it
+    std::vector<std::vector<uint8_t>> igmpToTun;
+    udpNetwork->setMessageCallback([&igmpToTun](PacketHandle packet)
+    {
+        if (packet.size() >= 20 && packet.data()[9] == 2)
+            igmpToTun.emplace_back(packet.data(), packet.data() + packet.size());
+    });
+    negotiateV2();
+    drainPeerSocket();
+    ASSERT_EQ(igmpToTun.size(), 1u);
+    EXPECT_EQ(igmpToTun[0][19], 1);
+    EXPECT_EQ(igmpToTun[0][24], 0x11);
+
+    auto makeTunPacket = [this](uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    {
+        PacketHandle packet = udpNetwork->getPacketPool()->acquire(60, PacketBufferPool::DEFAULT_HEADROOM);
+        std::memset(packet.data(), 0, packet.size());
+        packet.data()[0] = 0x45;
+        packet.data()[9] = 17;
+        packet.data()[12] = 10; packet.data()[15] = 1;
+        packet.data()[16] = a; packet.data()[17] = b; packet.data()[18] = c; packet.data()[19] = d;
+        return packet;
+    };
+    const UDPNetwork::FanoutStats& stats = udpNetwork->getFanoutStats();
+
+    // SSDP before the peer's host joined it
+    udpNetwork->processPacketFromTun(makeTunPacket(239, 255, 255, 250));
+    EXPECT_EQ(stats.multicastUnjoined, 1u);
+    ioContext.restart();
+    ioContext.poll();
+    EXPECT_EQ(peerSocket->available(), 0u);
+
+    // The peer's host reports the group, we take note and keep the report from our host
+    std::vector<uint8_t> report(28);
+    report[0] = 0x45; report[3] = 28; report[8] = 1; report[9] = 2;
+    report[12] = 10; report[15] = 2;
+    report[16] = 239; report[17] = 255; report[18] = 255; report[19] = 250;
+    report[20] = 0x16;
+    report[24] = 239; report[25] = 255; report[26] = 255; report[27] = 250;
+    receive(makeV2Datagram(7, 0, report));
+    ASSERT_TRUE(runUntil([this]() { return !udpNetwork->getMulticastGroups().getGroups().empty(); }));
+    EXPECT_EQ(igmpToTun.size(), 1u);
+    drainPeerSocket();
+
+    udpNetwork->processPacketFromTun(makeTunPacket(239, 255, 255, 250));
+    EXPECT_EQ(stats.datagrams, 1u);
+    ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; }));
+    udpNetwork->processPacketFromTun(makeTunPacket(239, 1, 2, 3));
+    EXPECT_EQ(stats.datagrams, 1u);
+    // Link-local groups go to everyone
+    udpNetwork->processPacketFromTun(makeTunPacket(224, 0, 0, 251));
+    EXPECT_EQ(stats.datagrams, 2u);
+
+    const MulticastGroups::Group& group = udpNetwork->getMulticastGroups().getGroups().at(utils::ipToUint32("239.255.255.250"));
+    EXPECT_TRUE(group.members.test(2));
+    EXPECT_EQ(group.counters.packets, 1u);
+    EXPECT_EQ(group.counters.datagrams, 1u);
+    EXPECT_EQ(group.counters.skipped, 0u);
+    EXPECT_EQ(stats.multicastUnjoined, 2u);
+}
+
+TEST_P(UDPNetworkV2Test, TestIgmpReportCountsForTheSendingPeer)
+{
+    negotiateV2();
+    drainPeerSocket();
+
+    // The peer at .2 sends a report claiming to be from .9, and one from 0.0.0.0 as hosts may before they have an address
+    auto makeReport = [](uint8_t srcOctet, uint8_t groupOctet)
+    {
+        std::vector<uint8_t> report(28);
+        report[0] = 0x45; report[3] = 28; report[8] = 1; report[9] = 2;
+        if (srcOctet != 0)
+        {
+            report[12] = 10; report[15] = srcOctet;
+        }
+        report[16] = 239; report[17] = 1; report[18] = 2; report[19] = groupOctet;
+        report[20] = 0x16;
+        report[24] = 239; report[25] = 1; report[26] = 2; report[27] = groupOctet;
+        return report;
+    };
+    receive(makeV2Datagram(7, 0, makeReport(9, 3)));
+    receive(makeV2Datagram(7, 1, makeReport(0, 4)));
+    ASSERT_TRUE(runUntil([this]() { return udpNetwork->getMulticastGroups().getGroups().size() == 2; }));
+
+    for (const char* address : {"239.1.2.3", "239.1.2.4"})
+    {
+        const MulticastGroups::Group& group = udpNetwork->getMulticastGroups().getGroups().at(utils::ipToUint32(address));
+        EXPECT_TRUE(group.members.test(2));
+        EXPECT_EQ(group.members.count(), 1u);
+    }
+}
+
+TEST_P(UDPNetworkV2Test, TestBroadcastStormSuppressedBeforeFanOut)
+{
+    negotiateV2();
+    drainPeerSocket();
+    udpNetwork->testConfig().broadcastCollapseWindow = std::chrono::seconds(10);
+    udpNetwork->testConfig().broadcastRateLimit = 3;
+    const UDPNetwork::FanoutStats& fanout = udpNetwork->getFanoutStats();
+    const BroadcastSuppressor::Stats& suppression = udpNetwork->getBroadcastSuppressionStats();
+
+    // A discovery packet sent twice goes out once
+    udpNetwork->processPacketFromTun(makeBroadcastPacket(1));
+    udpNetwork->processPacketFromTun(makeBroadcastPacket(1));
+    EXPECT_EQ(fanout.packets, 1u);
+    EXPECT_EQ(suppression.duplicates, 1u);
+
+    // Then the socket runs out of its 3 per second
+    for (uint8_t tag = 1; tag <= 3; tag++)
+    {
+        PacketHandle packet = makeBroadcastPacket(1);
+        packet.data()[40] = tag;
+        udpNetwork->processPacketFromTun(std::move(packet));
+    }
+    EXPECT_EQ(fanout.packets, 3u);
+    EXPECT_EQ(suppression.rateLimited, 1u);
+    EXPECT_EQ(suppression.rateLimitedBytes, 60u);
+
+    // IGMP is never held back, hosts repeat their reports on purpose
+    std::vector<uint8_t> report(28);
+    report[0] = 0x45; report[3] = 28; report[8] = 1; report[9] = 2;
+    report[12] = 10; report[15] = 1;
+    report[16] = 239; report[19] = 1;
+    report[20] = 0x16;
+    report[24] = 239; report[27] = 1;
+    for (int i = 0; i < 2; i++)
+    {
+        PacketHandle packet = udpNetwork->getPacketPool()->acquire(report.size(), PacketBufferPool::DEFAULT_HEADROOM);
+        std::memcpy(packet.data(), report.data(), report.size());
+        udpNetwork->processPacketFromTun(std::move(packet));
+    }
+    EXPECT_EQ(fanout.packets, 5u);
+    EXPECT_EQ(suppression.passed, 3u);
+
+    ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; }));
+}
+
+TEST_P(UDPNetworkV2Test, TestUnscheduledSendsHeldToBacklogLimit)
+{
+    // Inline crypto hands datagrams straight to sendmmsg, only sealing on the workers keeps them in the backlog
+    if (GetParam() == 0)
+        GTEST_SKIP() << "nothing stays in the backlog with inline crypto";
+    udpNetwork->testConfig().sendScheduler = false;
+    udpNetwork->testConfig().groupBroadcast = false;
+    negotiateV2();
+    drainPeerSocket();
+
+    auto makeUnicast = [this]()
+    {
+        PacketHandle packet = udpNetwork->getPacketPool()->acquire(60, PacketBufferPool::DEFAULT_HEADROOM);
+        std::memset(packet.data(), 0, packet.size());
+        packet.data()[0] = 0x45;
+        packet.data()[16] = 10;
+        packet.data()[19] = 2;
+        return packet;
+    };
+
+    // Nothing completes until the io_context runs, so everything past the limit is dropped, the broadcast included
+    constexpr size_t BACKLOG_LIMIT = 64;
+    for (size_t i = 0; i < BACKLOG_LIMIT + 6; i++)
+        udpNetwork->processPacketFromTun(makeUnicast());
+    udpNetwork->processPacketFromTun(makeBroadcastPacket(1));
+    EXPECT_EQ(udpNetwork->getTxBacklogDropCount(), 7u);
+
+    std::array<uint8_t, 256> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+    size_t received = 0;
+    while (received < BACKLOG_LIMIT && runUntil([this]() { return peerSocket->available() > 0; }))
+    {
+        peerSocket->receive_from(boost::asio::buffer(datagram), sender);
+        received++;
+    }
+    EXPECT_EQ(received, BACKLOG_LIMIT);
+
+    // Once they're out there's room again
+    udpNetwork->processPacketFromTun(makeBroadcastPacket(1));
+    ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; }));
+    EXPECT_EQ(udpNetwork->getTxBacklogDropCount(), 7u);
+}
+
+TEST_P(UDPNetworkV2Test, TestGamePacketOvertakesQueuedDownload)
+{
+    negotiateV2();
+    drainPeerSocket();
+    udpNetwork->setPortPriorities({{27015, PortPriority::GAME}});
+
+    auto makeUnicast = [this](size_t size, uint8_t protocol, uint16_t dstPort)
+    {
+        PacketHandle packet = udpNetwork->getPacketPool()->acquire(size, PacketBufferPool::DEFAULT_HEADROOM);
+        std::memset(packet.data(), 0, size);
+        uint8_t* ip = packet.data();
+        ip[0] = 0x45;
+        ip[2] = static_cast<uint8_t>(size >> 8); ip[3] = static_cast<uint8_t>(size);
+        ip[9] = protocol;
+        ip[12] = 10; ip[15] = 1;
+        ip[16] = 10; ip[19] = 2;
+        ip[20] = 0xC3; ip[21] = 0x50;
+        ip[22] = static_cast<uint8_t>(dstPort >> 8); ip[23] = static_cast<uint8_t>(dstPort);
+        ip[32] = 5 << 4;
+        return packet;
+    };
+
+    // One TUN burst: a download fills the queue before the game packet shows up
+    for (int i = 0; i < 10; i++)
+        udpNetwork->processPacketFromTun(makeUnicast(1400, 6, 443));
+    udpNetwork->processPacketFromTun(makeUnicast(1200, 17, 27015));
+
+    std::vector<size_t> sizes;
+    std::array<uint8_t, 2048> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+    while (sizes.size() < 11)
+    {
+        ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; }));
+        size_t size = peerSocket->receive_from(boost::asio::buffer(datagram), sender);
+        if (size > 1000)
+            sizes.push_back(size);
+    }
+    EXPECT_LT(sizes[0], 1400u);
+    for (size_t i = 1; i < sizes.size(); i++)
+        EXPECT_GT(sizes[i], 1400u);
+
+    const SendScheduler::Stats& stats = udpNetwork->testPeers().begin()->peer.getSendScheduler().getStats();
+    EXPECT_EQ(stats.enqueued, 11u);
+    EXPECT_EQ(stats.priority, 1u);
+}
+
+TEST_P(UDPNetworkV2Test, TestWindowHoldsBackDataToSilentPeer)
+{
+    negotiateV2();
+    drainPeerSocket();
+
+    // The peer never acks, so past the initial window packets wait in its scheduler
+    constexpr size_t PACKETS = 40;
+    for (size_t i = 0; i < PACKETS; i++)
+    {
+        PacketHandle packet = udpNetwork->getPacketPool()->acquire(1400, PacketBufferPool::DEFAULT_HEADROOM);
+        std::memset(packet.data(), 0, packet.size());
+        uint8_t* ip = packet.data();
+        ip[0] = 0x45;
+        ip[2] = 1400 >> 8; ip[3] = 1400 & 0xFF;
+        ip[9] = 17;
+        ip[12] = 10; ip[15] = 1;
+        ip[16] = 10; ip[19] = 2;
+        ip[23] = 80;
+        udpNetwork->processPacketFromTun(std::move(packet));
+    }
+
+    std::array<uint8_t, 2048> datagram{};
+    boost::asio::ip::udp::endpoint sender;
+    auto receiveData = [&]()
+    {
+        size_t count = 0;
+        while (peerSocket->available() > 0)
+        {
+            if (peerSocket->receive_from(boost::asio::buffer(datagram), sender) > 1000)
+                count++;
+        }
+        return count;
+    };
+    // Until nothing more arrives for a while, well short of the probe timeout
+    size_t sent = 0;
+    auto lastArrival = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - lastArrival < std::chrono::milliseconds(50))
+    {
+        ioContext.restart();
+        ioContext.poll();
+        if (size_t count = receiveData())
+        {
+            sent += count;
+            lastArrival = std::chrono::steady_clock::now();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    const PeerConnectionInfo& peer = udpNetwork->testPeers().begin()->peer;
+    EXPECT_GT(sent, 0u);
+    EXPECT_LT(sent, PACKETS);
+    EXPECT_EQ(peer.getSendScheduler().size(), PACKETS - sent);
+    EXPECT_GE(peer.getAckTracker().getStats().bytesInFlight, CongestionController::INITIAL_WINDOW);
+    EXPECT_GT(peer.getCongestionController().getStats().windowLimited, 0u);
+
+    // Still no ack by the probe timeout, one more goes out to ask
+    ASSERT_TRUE(runUntil([this]() { return peerSocket->available() > 0; }));
+    EXPECT_EQ(receiveData(), 1u);
+    EXPECT_EQ(peer.getSendScheduler().size(), PACKETS - sent - 1);
+}
+
+INSTANTIATE_TEST_SUITE_P(CryptoWorkers, UDPNetworkV2Test, ::testing::Values(0, 4));
+
+TEST_F(UDPNetworkTest, TestOversizedDatagramIsCountedAndDropped)
+{
+    auto boundSocket = std::make_unique<boost::asio::ip::udp::socket>(
+        ioContext, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    boost::asio::ip::udp::endpoint local = boundSocket->local_endpoint();
+    DataPathConfig config;
+    config.batchedIo = true;
+    udpNetwork = std::make_unique<UDPNetwork>(std::move(boundSocket), ioContext, stateManager, networkConfigManager, nullptr, config);
+    ASSERT_TRUE(udpNetwork->startListening(0));
+
+    // Bigger than a receive slab, recvmmsg can only hand us its first part
+    boost::asio::ip::udp::socket sender(ioContext, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    std::vector<uint8_t> oversized(PacketBufferPool::SLAB_SIZE + 1000);
+    sender.send_to(boost::asio::buffer(oversized), local);
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (udpNetwork->getTruncatedDropCount() == 0 && std::chrono::steady_clock::now() < deadline)
+    {
+        ioContext.restart();
+        ioContext.poll();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(udpNetwork->getTruncatedDropCount(), 1u);
+    udpNetwork->shutdown();
+}
+
+#ifdef __linux__
+TEST_F(UDPNetworkTest, TestShardedReceiveDeliversEveryPeer)
+{
+    using ReusePort = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+    auto shardedSocket = std::make_unique<boost::asio::ip::udp::socket>(ioContext);
+    shardedSocket->open(boost::asio::ip::udp::v4());
+    shardedSocket->set_option(ReusePort(true));
+    shardedSocket->bind(boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    boost::asio::ip::udp::endpoint local = shardedSocket->local_endpoint();
+
+    DataPathConfig config;
+    config.socketShards = 4;
+    config.pinShardThreads = false;
+    config.cryptoWorkers = 0;
+    udpNetwork = std::make_unique<UDPNetwork>(std::move(shardedSocket), ioContext, stateManager, networkConfigManager, nullptr, config);
+
+    // Spread over the shards and the IO thread's own socket by their ports
+    constexpr size_t PEERS = 8;
+    constexpr uint64_t MESSAGES = 5;
+    std::array<uint8_t, crypto_box_PUBLICKEYBYTES> selfPub{};
+    std::array<uint8_t, crypto_box_SECRETKEYBYTES> selfSec{};
+    crypto_box_keypair(selfPub.data(), selfSec.data());
+    std::vector<std::unique_ptr<boost::asio::ip::udp::socket>> peerSockets;
+    std::vector<std::array<uint8_t, crypto_box_BEFORENMBYTES>> peerKeys(PEERS);
+    std::map<uint32_t, std::pair<std::pair<std::uint32_t, int>, std::array<uint8_t, crypto_box_PUBLICKEYBYTES>>> peerMap;
+    for (size_t i = 0; i < PEERS; i++)
+    {
+        peerSockets.push_back(std::make_unique<boost::asio::ip::udp::socket>(
+            ioContext, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0)));
+        std::array<uint8_t, crypto_box_PUBLICKEYBYTES> peerPub{};
+        std::array<uint8_t, crypto_box_SECRETKEYBYTES> peerSec{};
+        crypto_box_keypair(peerPub.data(), peerSec.data());
+        ASSERT_EQ(crypto_box_beforenm(peerKeys[i].data(), selfPub.data(), peerSec.data()), 0);
+        peerMap[utils::ipToUint32("10.0.0." + std::to_string(i + 2))] =
+            {{utils::ipToUint32("127.0.0.1"), peerSockets.back()->local_endpoint().port()}, peerPub};
+    }
+    ASSERT_TRUE(udpNetwork->startConnection(utils::ipToUint32("10.0.0.1"), selfSec, peerMap));
+
+    std::atomic<size_t> delivered{0};
+    udpNetwork->setMessageCallback([&delivered](PacketHandle packet)
+    {
+        if (packet.size() == 60 && packet.data()[0] == 0x45)
+            delivered++;
+    });
+    ASSERT_TRUE(udpNetwork->startListening(0));
+    ASSERT_EQ(udpNetwork->getSocketShardCount(), 4u);
+
+    constexpr size_t OVERHEAD = 14 + crypto_box_MACBYTES;
+    for (size_t i = 0; i < PEERS; i++)
+    {
+        for (uint64_t counter = 0; counter < MESSAGES; counter++)
+        {
+            // v2 MESSAGE, session 1, sealed by the higher side (the peer) for us
+            std::array<uint8_t, OVERHEAD + 60> datagram{};
+            datagram[0] = (2 << 4) | static_cast<uint8_t>(UDPNetwork::PacketType::MESSAGE);
+            datagram[5] = 1;
+            datagram[13] = static_cast<uint8_t>(counter);
+            uint8_t* ip = datagram.data() + OVERHEAD;
+            ip[0] = 0x45;
+            ip[12] = 10; ip[15] = static_cast<uint8_t>(i + 2);
+            ip[16] = 10; ip[19] = 1;
+            PeerCipher peerCipher;
+            peerCipher.setKeys(peerKeys[i], false);
+            peerCipher.seal(CipherSuite::XSALSA20_POLY1305, ip, 60, datagram.data() + 14, datagram.data(), 14, 1, counter);
+            peerSockets[i]->send_to(boost::asio::buffer(datagram), local);
+        }
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (delivered < PEERS * MESSAGES && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    EXPECT_EQ(delivered.load(), PEERS * MESSAGES);
+    udpNetwork->shutdown();
+}
+#endif
+
+TEST_F(UDPNetworkTest, TestPeerStrandsKeepEachPeersOrder)
+{
+    auto poolSocket = std::make_unique<boost::asio::ip::udp::socket>(ioContext);
+    poolSocket->open(boost::asio::ip::udp::v4());
+    poolSocket->bind(boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    boost::asio::ip::udp::endpoint local = poolSocket->local_endpoint();
+
+    // No crypto workers, so every peer's seal / open goes to its strand on the pool
+    DataPathConfig config;
+    config.ioThreads = 4;
+    config.cryptoWorkers = 0;
+    udpNetwork = std::make_unique<UDPNetwork>(std::move(poolSocket), ioContext, stateManager, networkConfigManager, nullptr, config);
+
+    constexpr size_t PEERS = 4;
+    constexpr uint8_t MESSAGES = 30;
+    std::array<uint8_t, crypto_box_PUBLICKEYBYTES> selfPub{};
+    std::array<uint8_t, crypto_box_SECRETKEYBYTES> selfSec{};
+    crypto_box_keypair(selfPub.data(), selfSec.data());
+    std::vector<std::unique_ptr<boost::asio::ip::udp::socket>> peerSockets;
+    std::vector<std::array<uint8_t, crypto_box_BEFORENMBYTES>> peerKeys(PEERS);
+    std::map<uint32_t, std::pair<std::pair<std::uint32_t, int>, std::array<uint8_t, crypto_box_PUBLICKEYBYTES>>> peerMap;
+    for (size_t i = 0; i < PEERS; i++)
+    {
+        peerSockets.push_back(std::make_unique<boost::asio::ip::udp::socket>(
+            ioContext, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0)));
+        peerSockets.back()->set_option(boost::asio::socket_base::receive_buffer_size(1024 * 1024));
+        std::array<uint8_t, crypto_box_PUBLICKEYBYTES> peerPub{};
+        std::array<uint8_t, crypto_box_SECRETKEYBYTES> peerSec{};
+        crypto_box_keypair(peerPub.data(), peerSec.data());
+        ASSERT_EQ(crypto_box_beforenm(peerKeys[i].data(), selfPub.data(), peerSec.data()), 0);
+        peerMap[utils::ipToUint32("10.0.0." + std::to_string(i + 2))] =
+            {{utils::ipToUint32("127.0.0.1"), peerSockets.back()->local_endpoint().port()}, peerPub};
+    }
+    ASSERT_TRUE(udpNetwork->startConnection(utils::ipToUint32("10.0.0.1"), selfSec, peerMap));
+
+    // Per source peer, the marker byte of each packet in the order it reached the TUN
+    std::mutex deliveredMutex;
+    std::vector<std::vector<uint8_t>> delivered(PEERS);
+    udpNetwork->setMessageCallback([&](PacketHandle packet)
+    {
+        if (packet.size() != 60 || packet.data()[0] != 0x45)
+            return;
+        std::lock_guard<std::mutex> lock(deliveredMutex);
+        delivered[packet.data()[15] - 2].push_back(packet.data()[20]);
+    });
+    ASSERT_TRUE(udpNetwork->startListening(0));
+
+    // Hole punches advertising v2, then every peer sends, interleaved
+    for (auto& peerSocket : peerSockets)
+    {
+        std::array<uint8_t, 16> holePunch{0x12, 0x34, 0x56, 0x78, 0, 1,
+            static_cast<uint8_t>(UDPNetwork::PacketType::HOLE_PUNCH), 2};
+        peerSocket->send_to(boost::asio::buffer(holePunch), local);
+    }
+    constexpr size_t OVERHEAD = 14 + crypto_box_MACBYTES;
+    for (uint8_t counter = 0; counter < MESSAGES; counter++)
+    {
+        for (size_t i = 0; i < PEERS; i++)
+        {
+            std::array<uint8_t, OVERHEAD + 60> datagram{};
+            datagram[0] = (2 << 4) | static_cast<uint8_t>(UDPNetwork::PacketType::MESSAGE);
+            datagram[5] = 1;
+            datagram[13] = counter;
+            uint8_t* ip = datagram.data() + OVERHEAD;
+            ip[0] = 0x45;
+            ip[12] = 10; ip[15] = static_cast<uint8_t>(i + 2);
+            ip[16] = 10; ip[19] = 1;
+            ip[20] = counter;
+            PeerCipher peerCipher;
+            peerCipher.setKeys(peerKeys[i], false);
+            peerCipher.seal(CipherSuite::XSALSA20_POLY1305, ip, 60, datagram.data() + 14, datagram.data(), 14, 1, counter);
+            peerSockets[i]->send_to(boost::asio::buffer(datagram), local);
+        }
+    }
+
+    // Opened on the peers' strands, delivered in the order each peer sent; the hole punch came before, so v2 is on
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    auto allDelivered = [&]()
+    {
+        std::lock_guard<std::mutex> lock(deliveredMutex);
+        for (const auto& markers : delivered)
+            if (markers.size() < MESSAGES)
+                return false;
+        return true;
+    };
+    while (!allDelivered() && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    {
+        std::lock_guard<std::mutex> lock(deliveredMutex);
+        for (size_t i = 0; i < PEERS; i++)
+        {
+            ASSERT_EQ(delivered[i].size(), MESSAGES) << "peer " << i;
+            for (uint8_t marker = 0; marker < MESSAGES; marker++)
+                EXPECT_EQ(delivered[i][marker], marker);
+        }
+    }
+
+    // And we send to every peer, through the executor the TUN side posts to
+    for (uint8_t marker = 0; marker < MESSAGES; marker++)
+    {
+        for (size_t i = 0; i < PEERS; i++)
+        {
+            PacketHandle packet = udpNetwork->getPacketPool()->acquire(60, PacketBufferPool::DEFAULT_HEADROOM);
+            std::memset(packet.data(), 0, packet.size());
+            uint8_t* ip = packet.data();
+            ip[0] = 0x45;
+            ip[12] = 10; ip[15] = 1;
+            ip[16] = 10; ip[19] = static_cast<uint8_t>(i + 2);
+            ip[20] = marker;
+            boost::asio::post(udpNetwork->getExecutor(), [this, packet = std::move(packet)]() mutable
+            {
+                udpNetwork->processPacketFromTun(std::move(packet));
+            });
+        }
+    }
+
+    // Each peer gets its v2 datagrams with rising counters (acks take some too) and the markers in the same order
+    for (size_t i = 0; i < PEERS; i++)
+    {
+        PeerCipher peerCipher;
+        peerCipher.setKeys(peerKeys[i], false);
+        std::array<uint8_t, 2048> datagram{};
+        boost::asio::ip::udp::endpoint sender;
+        std::vector<uint8_t> markers;
+        uint64_t nextCounter = 0;
+        peerSockets[i]->non_blocking(true);
+        deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (markers.size() < MESSAGES && std::chrono::steady_clock::now() < deadline)
+        {
+            boost::system::error_code error;
+            size_t received = peerSockets[i]->receive_from(boost::asio::buffer(datagram), sender, 0, error);
+            if (error)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                continue;
+            }
+            // Hole punches and acks aside
+            if (datagram[0] != ((2 << 4) | static_cast<uint8_t>(UDPNetwork::PacketType::MESSAGE)) || received < OVERHEAD + 60)
+                continue;
+
+            uint64_t counter = 0;
+            for (int byte = 0; byte < 8; byte++)
+                counter = (counter << 8) | datagram[6 + byte];
+            EXPECT_GE(counter, nextCounter);
+            nextCounter = counter + 1;
+            uint32_t sessionId = (datagram[2] << 24) | (datagram[3] << 16) | (datagram[4] << 8) | datagram[5];
+            size_t payload = received - OVERHEAD;
+            ASSERT_TRUE(peerCipher.open(static_cast<CipherSuite>(datagram[1] & 0x7F), datagram.data() + OVERHEAD, payload,
+                datagram.data() + 14, datagram.data(), 14, sessionId, counter));
+            // An ack may ride in front of the IP packet
+            markers.push_back(datagram[received - 40]);
+        }
+        ASSERT_EQ(markers.size(), MESSAGES) << "peer " << i;
+        for (uint8_t marker = 0; marker < MESSAGES; marker++)
+            EXPECT_EQ(markers[marker], marker);
+    }
+
+    udpNetwork->shutdown();
+}
@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include "UringTransport.hpp"
+#include <array>
+#include <cstring>
+#include <functional>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+class UringTransportTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        pool = PacketBufferPool::create();
+        socket = std::make_unique<boost::asio::ip::udp::socket>(
+            ioContext, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+        peer = std::make_unique<boost::asio::ip::udp::socket>(
+            ioContext, boost::asio::ip::udp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+        // Room for a burst of test datagrams without the kernel dropping any
+        socket->set_option(boost::asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+        peer->set_option(boost::asio::socket_base::receive_buffer_size(4 * 1024 * 1024));
+        peer->non_blocking(true);
+    }
+
+    // Null when this kernel (or sandbox) has no io_uring to give, the caller skips
+    std::unique_ptr<UringTransport> makeTransport(UringTransport::Parameters parameters = UringTransport::Parameters())
+    {
+        auto transport = UringTransport::create(socket->native_handle(), ioContext.get_executor(), pool, parameters);
+        if (!transport)
+            return nullptr;
+        bool started = transport->start(
+            [this](PacketHandle packet, const boost::asio::ip::udp::endpoint& sender)
+            {
+                received.push_back(std::move(packet));
+                senders.push_back(sender);
+            },
+            [this](const boost::system::error_code& error, std::size_t bytes, uint32_t tag, const boost::asio::ip::udp::endpoint&)
+            {
+                EXPECT_FALSE(error);
+                EXPECT_EQ(bytes, 100u);
+                completedTags.push_back(tag);
+            });
+        return started ? std::move(transport) : nullptr;
+    }
+
+    bool runUntil(const std::function<bool()>& done)
+    {
+        auto deadline = std::chrono::steady_clock::now() + 5s;
+        while (!done() && std::chrono::steady_clock::now() < deadline)
+            ioContext.run_one_for(10ms);
+        return done();
+    }
+
+    PacketHandle makePacket(uint32_t id)
+    {
+        PacketHandle packet = pool->acquire(100);
+        std::memset(packet.data(), 0, packet.size());
+        std::memcpy(packet.data(), &id, sizeof(id));
+        return packet;
+    }
+
+    boost::asio::io_context ioContext;
+    std::shared_ptr<PacketBufferPool> pool;
+    std::unique_ptr<boost::asio::ip::udp::socket> socket;
+    std::unique_ptr<boost::asio::ip::udp::socket> peer;
+    std::vector<PacketHandle> received;
+    std::vector<boost::asio::ip::udp::endpoint> senders;
+    std::vector<uint32_t> completedTags;
+};
+}
+
+TEST_F(UringTransportTest, TestMultishotReceiveSurvivesMoreDatagramsThanBuffers)
+{
+    UringTransport::Parameters parameters;
+    parameters.receiveBuffers = 16;
+    auto transport = makeTransport(parameters);
+    if (!transport)
+        GTEST_SKIP() << "io_uring with multishot receives not available";
+
+    // Bursts bigger than the buffer ring, so slabs have to be replaced and the receive re-armed along the way
+    constexpr uint32_t COUNT = 400;
+    for (uint32_t i = 0; i < COUNT; i++)
+    {
+        std::array<uint8_t, 64> datagram{};
+        std::memcpy(datagram.data(), &i, sizeof(i));
+        peer->send_to(boost::asio::buffer(datagram), socket->local_endpoint());
+        if (i % 40 == 39)
+            ioContext.poll();
+    }
+    ASSERT_TRUE(runUntil([&]() { return received.size() == COUNT; }));
+
+    for (uint32_t i = 0; i < COUNT; i++)
+    {
+        ASSERT_EQ(received[i].size(), 64u);
+        uint32_t id;
+        std::memcpy(&id, received[i].data(), sizeof(id));
+        EXPECT_EQ(id, i);
+        EXPECT_EQ(senders[i], peer->local_endpoint());
+        // The kernel's header and the sender address are headroom now, the payload wasn't moved
+        EXPECT_GE(received[i].headroom(), sizeof(io_uring_recvmsg_out));
+    }
+    EXPECT_EQ(transport->getStats().received, COUNT);
+}
+
+TEST_F(UringTransportTest, TestSendsGoOutInOneSubmission)
+{
+    auto transport = makeTransport();
+    if (!transport)
+        GTEST_SKIP() << "io_uring with multishot receives not available";
+
+    uint64_t entersBefore = transport->getStats().enters;
+    for (uint32_t i = 0; i < 50; i++)
+    {
+        PacketHandle packet = makePacket(i);
+        ASSERT_TRUE(transport->queueSend(packet, peer->local_endpoint(), i));
+        EXPECT_FALSE(packet);
+    }
+    EXPECT_EQ(transport->queuedSends(), 50u);
+    EXPECT_EQ(transport->flush(), 50u);
+    EXPECT_EQ(transport->getStats().enters, entersBefore + 1);
+
+    ASSERT_TRUE(runUntil([&]() { return completedTags.size() == 50; }));
+    EXPECT_EQ(transport->sendsInFlight(), 0u);
+
+    std::array<uint8_t, 2048> buffer;
+    boost::asio::ip::udp::endpoint from;
+    boost::system::error_code error;
+    size_t arrived = 0;
+    while (peer->receive_from(boost::asio::buffer(buffer), from, 0, error) == 100 && !error)
+        arrived++;
+    EXPECT_EQ(arrived, 50u);
+    EXPECT_EQ(from, socket->local_endpoint());
+}
+
+TEST_F(UringTransportTest, TestFullSlotTableLeavesPacketWithCaller)
+{
+    UringTransport::Parameters parameters;
+    parameters.sendSlots = 2;
+    auto transport = makeTransport(parameters);
+    if (!transport)
+        GTEST_SKIP() << "io_uring with multishot receives not available";
+
+    PacketHandle first = makePacket(1), second = makePacket(2), third = makePacket(3);
+    EXPECT_TRUE(transport->queueSend(first, peer->local_endpoint(), 1));
+    EXPECT_TRUE(transport->queueSend(second, peer->local_endpoint(), 2));
+    EXPECT_FALSE(transport->queueSend(third, peer->local_endpoint(), 3));
+    ASSERT_TRUE(third);
+    EXPECT_EQ(third.size(), 100u);
+
+    transport->flush();
+    ASSERT_TRUE(runUntil([&]() { return completedTags.size() == 2; }));
+    EXPECT_TRUE(transport->queueSend(third, peer->local_endpoint(), 3));
+}
+
+TEST_F(UringTransportTest, TestStopHandsEveryBufferBack)
+{
+    auto transport = makeTransport();
+    if (!transport)
+        GTEST_SKIP() << "io_uring with multishot receives not available";
+    EXPECT_GT(pool->getStats().slabsInUse, 0u);
+
+    PacketHandle packet = makePacket(0);
+    transport->queueSend(packet, peer->local_endpoint(), 0);
+    transport->flush();
+    transport->stop();
+    transport.reset();
+
+    EXPECT_EQ(pool->getStats().slabsInUse, 0u);
+}
@@ -1,4 +1,4 @@
-#include "Logger.hpp"
+#include "logger.hpp"
 #include "trace.hpp"
 #include <gtest/gtest.h>
 
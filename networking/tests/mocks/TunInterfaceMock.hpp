@@ -9,9 +9,11 @@ public:
     MOCK_METHOD(bool, initialize, (const std::string&), (override));
     MOCK_METHOD(bool, startPacketProcessing, (), (override));
     MOCK_METHOD(void, stopPacketProcessing, (), (override));
-    MOCK_METHOD(bool, sendPacket, (std::vector<uint8_t>), (override));
+    MOCK_METHOD(bool, sendPacket, (PacketHandle), (override));
     MOCK_METHOD(void, setPacketCallback, (PacketCallback callback), (override));
     MOCK_METHOD(bool, isRunning, (), (const, override));
+    MOCK_METHOD(CoDelQueue::Stats, getQueueStats, (), (const, override));
+    MOCK_METHOD(BusyPoller::Stats, getBusyPollStats, (), (const, override));
     MOCK_METHOD(void, close, (), (override));
     MOCK_METHOD(std::string, getNarrowAlias, (), (const, override));
 }; 
\ No newline at end of file
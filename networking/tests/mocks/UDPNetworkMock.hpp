@@ -17,14 +17,16 @@ public:
     MOCK_METHOD(void, stopConnection, (), (override));
     MOCK_METHOD(void, shutdown, (), (override));
     MOCK_METHOD(bool, isConnected, (), (const, override));
-    MOCK_METHOD(void, processPacketFromTun, (const std::vector<uint8_t>&), (override));
+    MOCK_METHOD(void, processPacketFromTun, (PacketHandle), (override));
+    MOCK_METHOD(void, processPacketsFromTun, (PacketHandle*, size_t), (override));
     MOCK_METHOD(
         bool,
         sendMessage,
-            (const std::vector<uint8_t>& data,
+            (PacketHandle data,
             (const boost::asio::ip::udp::endpoint& peerEndpoint),
             (const std::array<uint8_t, crypto_box_BEFORENMBYTES>& sharedKey)),
         (override));
     MOCK_METHOD(void, setMessageCallback, (MessageCallback callback), (override));
-    MOCK_METHOD(boost::asio::io_context&, getIOContext, (), (override));
+    MOCK_METHOD(void, setPortPriorities, (const PortPriorities&), (override));
+    MOCK_METHOD(boost::asio::any_io_executor, getExecutor, (), (override));
 }; 
\ No newline at end of file